@@ -12,6 +12,8 @@
 
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Internal/ADT/CopyOnWrite.h"
+#include "klee/Internal/ADT/RingBuffer.h"
 #include "klee/Internal/ADT/TreeStream.h"
 #include "klee/Internal/System/Time.h"
 #include "klee/MergeHandler.h"
@@ -30,6 +32,7 @@ namespace klee {
 class Array;
 class PTreeNode;
 struct InstructionInfo;
+struct KFunction;
 
 llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const MemoryMap &mm);
 
@@ -50,6 +53,9 @@ private:
 public:
   // Execution - Control Flow specific (include multi-threading)
   // FIXME: should I make them private?
+  /// Copied when the state forks. A Thread is a few words around its shared
+  /// stack, and the pc of the running thread changes at the next
+  /// instruction, so sharing the map would not save the copy.
   threads_ty threads;
   wlists_ty waitingLists;
   // used to allocate new wlist_id
@@ -117,13 +123,29 @@ public:
   /// object.
   unsigned replayPosition;
   unsigned replayDataRecEntriesPosition;
+  /// The node of the replay trie holding the traces this state replays
+  unsigned replayNode;
   /// The number of branches recorded
   /// regardless of fork or switch or indirectbr, symbolic or concrete
   ///   should record or not (isInPosix, isInUserMain)
   unsigned nbranches_rec;
 
+  /// A symbolic branch whose direction was taken from the replayed path
+  /// without asking the solver whether it is feasible (--trust-trace).
+  struct TrustedBranch {
+    /// position of its entry in the replayed path
+    unsigned replayPosition;
+    KInstruction *kinst;
+    ref<Expr> constraint;
+  };
+  /// Trusted branches not checked yet, in replay order
+  std::vector<TrustedBranch> uncheckedBranches;
+  /// The constraints from before the first unchecked branch, known to be
+  /// satisfiable
+  ConstraintManager checkedConstraints;
+
   /// @brief Set containing which lines in which files are covered by this state
-  std::map<const std::string *, std::set<unsigned> > coveredLines;
+  CopyOnWrite<std::map<const std::string *, std::set<unsigned>>> coveredLines;
 
   /// @brief Pointer to the process tree of the current state
   PTreeNode *ptreeNode;
@@ -131,10 +153,11 @@ public:
   /// @brief Ordered list of symbolics: used to generate test cases.
   //
   // FIXME: Move to a shared list structure (not critical).
-  std::vector<std::pair<ref<const MemoryObject>, const Array *>> symbolics;
+  CopyOnWrite<std::vector<std::pair<ref<const MemoryObject>, const Array *>>>
+      symbolics;
 
   /// @brief Set of used array names for this state.  Used to avoid collisions.
-  std::set<std::string> arrayNames;
+  CopyOnWrite<std::set<std::string>> arrayNames;
 
   // The objects handling the klee_open_merge calls this state ran through
   std::vector<ref<MergeHandler> > openMergeStack;
@@ -142,13 +165,19 @@ public:
   // The numbers of times this state has run through Executor::stepInstruction
   std::uint64_t steppedInstructions;
 
-  /// A map tracking what function was executed at the N-th instruction.
-  /// This is used to extract the list of functions executed during the suffix
-  /// of a trace
-  std::unordered_map<std::string, unsigned int> func_inst_map;
+  /// A call to a function in the target program, at the N-th instruction
+  struct FunctionCall {
+    KFunction *kf;
+    std::uint64_t instruction;
+  };
+
+  /// The last calls to functions in the target program, only recorded with
+  /// --dump-func-list-sfxlen. This is used to extract the list of functions
+  /// executed during the suffix of a trace
+  CopyOnWrite<RingBuffer<FunctionCall>> functionCalls;
 
 private:
-  ExecutionState() : replayPosition(0), replayDataRecEntriesPosition(0), nbranches_rec(0), ptreeNode(0) {}
+  ExecutionState() : replayPosition(0), replayDataRecEntriesPosition(0), replayNode(0), nbranches_rec(0), ptreeNode(0) {}
 
 public:
   ExecutionState(KFunction *kf);
@@ -212,8 +241,10 @@ public:
   const KInstIterator &pc() const { return crtThread().pc; }
   KInstIterator &prevPC() { return crtThread().prevPC; }
   const KInstIterator &prevPC() const { return crtThread().prevPC; }
-  stack_ty &stack() { return crtThread().stack; }
-  const stack_ty &stack() const { return crtThread().stack; }
+  /// The stack of the current thread, which is copied first if it is shared
+  /// with another state
+  stack_ty &stack() { return crtThread().stack.mutate(); }
+  const stack_ty &stack() const { return *crtThread().stack; }
   bool isInPOSIX() const { return crtThread().isInPOSIX; }
   bool isInLIBC() const { return crtThread().isInLIBC; }
   unsigned &incomingBBIndex() { return crtThread().incomingBBIndex; }
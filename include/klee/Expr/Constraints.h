@@ -14,7 +14,9 @@
 #include "klee/Expr/ExprReplaceVisitor.h"
 #include "klee/Expr/ExprHashMap.h"
 #include "klee/Internal/Support/IndependentElementSet.h"
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 namespace klee {
 
@@ -25,15 +27,22 @@ public:
   using const_iterator = Constraints_ty::const_iterator;
 
   ConstraintManager() = default;
-  ConstraintManager &operator=(const ConstraintManager &cs) = default;
-  ConstraintManager(ConstraintManager &&cs) = default;
-  ConstraintManager &operator=(ConstraintManager &&cs) = default;
+  // The factors and the replace visitor are owned, so copies are deep and
+  // moves leave the source empty. Both assignments copy or move into a
+  // temporary which is swapped with this one.
+  ConstraintManager &operator=(ConstraintManager cs) {
+    swap(cs);
+    return *this;
+  }
+  ConstraintManager(ConstraintManager &&cs) { swap(cs); }
 
   // create from constraints with no optimization
   explicit
   ConstraintManager(const Constraints_ty &_constraints);
   ConstraintManager(const ConstraintManager &cs);
 
+  void swap(ConstraintManager &cs);
+
   // Destructor
   ~ConstraintManager();
 
@@ -66,6 +75,15 @@ public:
   }
 
   const Constraints_ty& getAllConstraints() const { return constraints; }
+  // The version of the equalities, taken from a counter shared by all
+  // managers whenever they change, so that no two states of the equalities
+  // have the same version. replaceVisitor stamps its results with it.
+  uint64_t getVersion() const { return version; }
+  // The version since which constraints were only added to this manager. It
+  // is taken again when constraints are deleted and when the manager is
+  // created, copied or swapped, so the constraints seen at a later version of
+  // this manager are all still there.
+  uint64_t getBaseVersion() const { return baseVersion; }
   // expose getIntersection to public, should only call it when
   // `UseIndependentSolver` is enabled
   void getIntersection(const IndependentElementSet *indep,
@@ -78,10 +96,17 @@ public:
   void
   getRelatedIndependentElementSets(const Constraints_ty &constraints,
                                    IndepElemSetPtrSet_ty &out_elemsets) const;
+  // Rebuild the equalities simplifyExpr() substitutes from the current
+  // constraints, which must already be simplified, e.g. when restoring a
+  // ConstraintManager built from the constraints of another one
+  void rebuildEqualities();
   void dumpEqualities(const char *filename=nullptr);
 
 private:
   Constraints_ty constraints;
+  static uint64_t nextVersion;
+  uint64_t version = ++nextVersion;
+  uint64_t baseVersion = version;
   // When `UseIndependentSolver` is disabled, representative serves as a set of
   // constraints for deduplication
   // When `UseIndependentSolver` is enabled, representative also track the
@@ -90,14 +115,27 @@ private:
 
   class IndepElementSetIndexer {
     friend class ConstraintManager;
-    // A faster index of all IndependentElementSet::elements
-    std::unordered_map<const Array *,
-                       std::vector<klee::IndependentElementSet *>>
-        elements_index;
+    // Factors are the classes of a union-find over nodes, so that merging a
+    // factor into another does not rewrite the index of its elements.
+    // Every factor inserted gets a node, which maps to no factor once the
+    // factor is erased.
+    static const unsigned NoNode = ~0u;
+    mutable std::vector<unsigned> parent;
+    // the factor of each root node
+    std::vector<klee::IndependentElementSet *> nodeFactor;
+    std::unordered_map<const klee::IndependentElementSet *, unsigned>
+        factorNode;
+    // A faster index of all IndependentElementSet::elements, holding the node
+    // of every element or NoNode
+    std::unordered_map<const Array *, std::vector<unsigned>> elements_index;
     // A faster index of IndependentElementSet::wholeObjects
-    std::unordered_map<const Array *, klee::IndependentElementSet *>
-        wholeObj_index;
+    std::unordered_map<const Array *, unsigned> wholeObj_index;
     IndepElemSetPtrSet_ty factors;
+
+    unsigned find(unsigned node) const;
+    klee::IndependentElementSet *getFactor(unsigned node) const {
+      return node == NoNode ? nullptr : nodeFactor[find(node)];
+    }
     public:
     void insert(IndependentElementSet *indep);
     void erase(IndependentElementSet *indep);
@@ -108,6 +146,9 @@ private:
     // Insert `src` to our index, but instead of tracking `src`, we track `dst`.
     // Useful when merging two IndependentElementSet
     void redirect(const IndependentElementSet *src, IndependentElementSet *dst);
+    // Stop tracking the factor `src`, which has been added to the factor
+    // `dst`, and have its elements tracked as part of `dst`
+    void merge(IndependentElementSet *src, IndependentElementSet *dst);
     void checkExprsSum(size_t NExprs);
   };
 
@@ -125,23 +166,30 @@ private:
   mutable UNMap_ty replacedUN;
   mutable UNMap_ty visitedUN;
   mutable ExprReplaceVisitorMulti *replaceVisitor = nullptr;
+  // If we RewriteEqualities, occurrences maps every ReadExpr to the
+  // constraints containing it, so that a new equality only revisits the
+  // constraints which contain its replaced expression
+  ExprHashMap<ExprHashSet> occurrences;
 
   // returns true iff the constraints were modified
   // This function is only called when you want to rewrite existing constraints
   // based on a newly learnt equivalency
   // @param[in] visitor: a pre-built ExprReplaceVisitor, which can rewrite
   // any constraint expressions with the newly added constraint
-  // @param[in] to_replace: non-null if IndependentSolver is enabled so that we
-  // can only work on Independent sets intersecting with the expr to be
-  // replaced.
+  // @param[in] replaced: the expression `visitor` replaces, only the
+  // constraints containing it are visited
   // @param[out] deleteConstraints: output all deleted/replaced constraint
   // expressions
   // @param[out] toAddConstraints: output all new replacement constraint
   // expressions
   bool rewriteConstraints(ExprReplaceVisitorBase &visitor,
-                          const IndependentElementSet *to_replace,
+                          const ref<Expr> &replaced,
                           std::vector<ref<Expr>> &deleteConstraints,
                           std::vector<ref<Expr>> &toAddConstraints);
+  // maintain occurrences when a constraint is added to or deleted from
+  // constraints
+  void addOccurrences(const ref<Expr> &e);
+  void removeOccurrences(const ref<Expr> &e);
 
   // @param[in] e: the new constraint expression waiting to be added
   // @param[out] toAddConstraints: will append new rewritten constraints caused
@@ -156,6 +204,8 @@ private:
   // Replacement will be later added one by one until there is no new
   // replacements.
   void updateIndependentSetAdd(const ref<Expr> &e);
+  // merge `factors` into the largest of them, which is returned
+  IndependentElementSet *mergeFactors(const IndepElemSetPtrSet_ty &factors);
   void
   updateIndependentSetDelete(const std::vector<ref<Expr>> &deleteConstraints);
   // when `UseIndependentSolver` is disabled, I still need to digest constraints
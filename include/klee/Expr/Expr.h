@@ -38,6 +38,7 @@ class Array;
 class ArrayCache;
 class ConstantExpr;
 class ObjectState;
+class SmallConstantPool;
 
 template<class T> class ref;
 
@@ -220,6 +221,23 @@ protected:
 
   unsigned hashValue;
 
+  /// Set on the unique node of its structure when hash-consing is enabled
+  bool hashConsed = false;
+
+  /// Return the node structurally equal to `e` from the unique table, after
+  /// inserting `e` if there is none. Without --hash-cons-exprs, return `e`.
+  ///
+  /// `e` must be a newly allocated, non-constant expression whose hash has
+  /// been computed. Its kids are compared by address (constants by value),
+  /// which is enough since they went through the table themselves.
+  ///
+  /// kinst and flags are not part of the structure: a shared node
+  /// accumulates the bindings of all its creators through updateKInst(), so
+  /// --kinst-binding decides which one it keeps. FLAG_INSTRUCTION_ROOT, the
+  /// only flag set on expressions, stays set once any creator bound it.
+  static ref<Expr> hashCons(const ref<Expr> &e);
+  void removeFromHashConsTable();
+
   /// Compares `b` to `this` Expr and determines how they are ordered
   /// (ignoring their kid expressions - i.e. those returned by `getKid()`).
   ///
@@ -248,6 +266,8 @@ public:
   Expr() { Expr::count++; }
   virtual ~Expr() {
     Expr::count--;
+    if (hashConsed)
+      removeFromHashConsTable();
   }
 
   virtual Kind getKind() const = 0;
@@ -349,6 +369,12 @@ public:
       return 0;
   }
   const KInstruction *getKInst() const { return kinst; }
+
+  /// Whether structurally equal expressions share one node
+  /// (--hash-cons-exprs). Shared nodes must not be modified in place.
+  static bool isHashConsing();
+  /// Bind this expression to an instruction which produces it, following
+  /// --kinst-binding. Constants are not bound, as they may be shared.
   void updateKInst(const KInstruction *newkinst);
 
 public:
@@ -516,7 +542,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &src) {
     ref<Expr> r(new NotOptimizedExpr(src));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(ref<Expr> src);
@@ -716,7 +742,7 @@ public:
   static ref<Expr> alloc(const UpdateList &updates, const ref<Expr> &index) {
     ref<Expr> r(new ReadExpr(updates, index));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(const UpdateList &updates, ref<Expr> i);
@@ -774,7 +800,7 @@ public:
                          const ref<Expr> &f) {
     ref<Expr> r(new SelectExpr(c, t, f));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(ref<Expr> c, ref<Expr> t, ref<Expr> f);
@@ -844,7 +870,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {
     ref<Expr> c(new ConcatExpr(l, r));
     c->computeHash();
-    return c;
+    return hashCons(c);
   }
   
   static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);
@@ -916,7 +942,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &e, unsigned o, Width w) {
     ref<Expr> r(new ExtractExpr(e, o, w));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   /// Creates an ExtractExpr with the given bit offset and width
@@ -972,7 +998,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &e) {
     ref<Expr> r(new NotExpr(e));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(const ref<Expr> &e);
@@ -1058,7 +1084,7 @@ public:                                                          \
     static ref<Expr> alloc(const ref<Expr> &e, Width w) {        \
       ref<Expr> r(new _class_kind ## Expr(e, w));                \
       r->computeHash();                                          \
-      return r;                                                  \
+      return hashCons(r);                                        \
     }                                                            \
     static ref<Expr> create(const ref<Expr> &e, Width w);        \
     Kind getKind() const { return _class_kind; }                 \
@@ -1093,7 +1119,7 @@ CAST_EXPR_CLASS(ZExt)
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {           \
       ref<Expr> res(new _class_kind##Expr(l, r));                              \
       res->computeHash();                                                      \
-      return res;                                                              \
+      return hashCons(res);                                                    \
     }                                                                          \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);           \
     Width getWidth() const {                                                   \
@@ -1146,7 +1172,7 @@ ARITHMETIC_EXPR_CLASS(AShr)
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {           \
       ref<Expr> res(new _class_kind##Expr(l, r));                              \
       res->computeHash();                                                      \
-      return res;                                                              \
+      return hashCons(res);                                                    \
     }                                                                          \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);           \
     Kind getKind() const { return _class_kind; }                               \
@@ -1190,6 +1216,7 @@ private:
   llvm::APInt value;
 
   ConstantExpr(const llvm::APInt &v) : value(v) {}
+  friend class SmallConstantPool;
 
 public:
   ~ConstantExpr() {}
@@ -1254,6 +1281,10 @@ public:
   void toMemory(void *address);
 
   static ref<ConstantExpr> alloc(const llvm::APInt &v) {
+    if (v.getBitWidth() <= 64)
+      if (const ref<ConstantExpr> *shared = getShared(v.getZExtValue(),
+                                                      v.getBitWidth()))
+        return *shared;
     ref<ConstantExpr> r(new ConstantExpr(v));
     r->computeHash();
     return r;
@@ -1264,9 +1295,22 @@ public:
   }
 
   static ref<ConstantExpr> alloc(uint64_t v, Width w) {
+    if (w <= 64)
+      if (const ref<ConstantExpr> *shared =
+              getShared(w < 64 ? v & ((UINT64_C(1) << w) - 1) : v, w))
+        return *shared;
     return alloc(llvm::APInt(w, v));
   }
 
+  /// Small constants of the common widths (Bool, 8, 16, 32 and 64 bits),
+  /// from -16 to 255, are allocated once and shared, so that concrete
+  /// execution does not allocate a node for every such value. Other
+  /// constants are still allocated: there is no inline representation in
+  /// ref<Expr>, as its users dereference it as an Expr*.
+  /// \return the shared node of `v` of width `w`, or null if `v` is not a
+  /// small constant. `v` must fit in `w` bits.
+  static const ref<ConstantExpr> *getShared(uint64_t v, Width w);
+
   static ref<ConstantExpr> create(uint64_t v, Width w) {
 #ifndef NDEBUG
     if (w <= 64)
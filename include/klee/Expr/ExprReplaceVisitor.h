@@ -1,8 +1,11 @@
 #ifndef KLEE_EXPR_EXPRREPLACEVISITOR_H
 #define KLEE_EXPR_EXPRREPLACEVISITOR_H
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
 #include "klee/Expr/ExprVisitor.h"
 #include "klee/util/RefHashMap.h"
+
+#include <cstdint>
 namespace klee {
 typedef RefHashMap<UpdateNode, ref<UpdateNode>> UNMap_ty;
 /**
@@ -28,6 +31,7 @@ public:
   // invalidate previous visited results.
   // As a result, resetVisited is added to flush all visited results when
   // replacement rules change (new equality statement added).
+  // ExprReplaceVisitorMulti::invalidate() only invalidates the affected ones.
   void resetVisited() { visited.clear(); }
 
   // replace() is the entrance of performing a replacement.
@@ -76,10 +80,87 @@ class ExprReplaceVisitorMulti : public ExprReplaceVisitorBase {
 private:
   const ExprHashMap< ref<Expr> > &replacements;
 
+  // An over-approximation of the ReadExprs of an expression, as bits of the
+  // arrays read, of the (array, constant index) pairs read and of the arrays
+  // read at a symbolic index. Two expressions may share a ReadExpr only if
+  // they have both an array and an element in common, or one reads an array
+  // of the other at a symbolic index.
+  struct ReadSignature {
+    uint64_t arrays = 0;
+    uint64_t elements = 0;
+    uint64_t symbolic = 0;
+
+    void add(const ReadSignature &other) {
+      arrays |= other.arrays;
+      elements |= other.elements;
+      symbolic |= other.symbolic;
+    }
+  };
+  ExprHashMap<ReadSignature> signatures;
+  RefHashMap<UpdateNode, ReadSignature> updateSignatures;
+
+  ReadSignature getSignature(const ref<Expr> &e);
+  ReadSignature getSignature(const ref<UpdateNode> &un);
+
+  // Results are kept across replace() calls, stamped with the version of the
+  // replacement rules they were computed with, which the owner of the rules
+  // bumps whenever it changes them. invalidate() records the version for the
+  // bits of the changed rule's signature, so a result stays valid as long as
+  // no rule which may share a ReadExpr with it changed since.
+  struct Result {
+    ref<Expr> expr;
+    uint64_t version;
+    ReadSignature signature;
+  };
+  ExprHashMap<Result> results;
+  const uint64_t &version;
+  // the last version changing a rule with each signature bit
+  uint64_t elementsChanged[64] = {};
+  uint64_t arraysChanged[64] = {};
+  uint64_t symbolicChanged[64] = {};
+
+  bool isValid(const Result &result) const;
+
+  // When a replace() call leaves more results than this, the invalid ones
+  // and then the oldest ones are dropped, down to half of it, along with the
+  // signatures, which would otherwise keep the dropped expressions alive.
+  static const size_t maxResults = 1 << 16;
+  void sweep();
+
 public:
   ExprReplaceVisitorMulti(UNMap_ty &_replaceUN, UNMap_ty &_visitedUN,
-                      const ExprHashMap<ref<Expr>> &_replacements)
-      : ExprReplaceVisitorBase(_replaceUN, _visitedUN), replacements(_replacements) {}
+                          const ExprHashMap<ref<Expr>> &_replacements,
+                          const uint64_t &_version)
+      : ExprReplaceVisitorBase(_replaceUN, _visitedUN),
+        replacements(_replacements), version(_version) {}
+
+  // Same as ExprReplaceVisitorBase::replace(), but reusing the results of
+  // previous calls which are still valid
+  ref<Expr> replace(const ref<Expr> &e);
+  // Must be called whenever the rule for `e` is added or removed, after
+  // bumping the version, so that the results it may change are no longer
+  // used.
+  // Every rule that can apply inside an expression has its ReadExprs among
+  // those of the expression, as the replacements are constants, so only the
+  // results that may share a ReadExpr with `e` are invalidated.
+  void invalidate(const ref<Expr> &e);
+  void resetVisited() {
+    ExprReplaceVisitorBase::resetVisited();
+    results.clear();
+    signatures.clear();
+    updateSignatures.clear();
+  }
+
+  Action visitExpr(const Expr &e) {
+    ref<Expr> e_ref = ref<Expr>(const_cast<Expr*>(&e));
+    ExprHashMap<Result>::iterator it = results.find(e_ref);
+    if (it == results.end())
+      return Action::doChildren();
+    if (isValid(it->second))
+      return Action::changeTo(it->second.expr);
+    results.erase(it);
+    return Action::doChildren();
+  }
 
   Action visitExprPost(const Expr &e) {
     ref<Expr> e_ref = ref<Expr>(const_cast<Expr*>(&e));
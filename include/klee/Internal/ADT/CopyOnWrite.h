@@ -0,0 +1,54 @@
+//===-- CopyOnWrite.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_COPYONWRITE_H
+#define KLEE_COPYONWRITE_H
+
+#include <memory>
+
+namespace klee {
+  /// A value shared between copies until one of them is modified, so that
+  /// copying it is constant time. Reads go through operator* and
+  /// operator->, writes through mutate(), which copies the value first if
+  /// it is shared.
+  ///
+  /// A default constructed value is only allocated when first modified.
+  template<class T>
+  class CopyOnWrite {
+    std::shared_ptr<T> value;
+
+    static const T &empty() {
+      static const T *e = new T();
+      return *e;
+    }
+
+  public:
+    CopyOnWrite() {}
+    explicit CopyOnWrite(T v) : value(std::make_shared<T>(std::move(v))) {}
+
+    const T &operator*() const { return value ? *value : empty(); }
+    const T *operator->() const { return &**this; }
+
+    /// \return the value, which is no longer shared
+    T &mutate() {
+      if (!value)
+        value = std::make_shared<T>();
+      else if (value.use_count() > 1)
+        value = std::make_shared<T>(*value);
+      return *value;
+    }
+
+    void swap(CopyOnWrite &b) { value.swap(b.value); }
+  };
+
+  template<class T>
+  void swap(CopyOnWrite<T> &a, CopyOnWrite<T> &b) { a.swap(b); }
+}
+
+#endif /* KLEE_COPYONWRITE_H */
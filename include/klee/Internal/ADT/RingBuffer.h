@@ -0,0 +1,95 @@
+//===-- RingBuffer.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_RINGBUFFER_H
+#define KLEE_RINGBUFFER_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace klee {
+  /// A buffer of the last `capacity` elements pushed into it, where pushing
+  /// into a full buffer drops its oldest element. Elements are indexed from
+  /// the oldest one.
+  ///
+  /// Storage grows with the number of elements held, up to `capacity`, and
+  /// a copy only allocates the elements held by the original.
+  template<class T>
+  class RingBuffer {
+    std::vector<T> elements;
+    size_t capacity = 0;
+    /// index of the oldest element in `elements`
+    size_t head = 0;
+    size_t count = 0;
+
+    size_t wrap(size_t i) const {
+      return i < elements.size() ? i : i - elements.size();
+    }
+
+  public:
+    RingBuffer() {}
+    explicit RingBuffer(size_t capacity) : capacity(capacity) {
+      assert(capacity > 0 && "empty ring buffer");
+    }
+    RingBuffer(const RingBuffer &b) : capacity(b.capacity), count(b.count) {
+      elements.reserve(b.count);
+      for (size_t i = 0; i < b.count; ++i)
+        elements.push_back(b[i]);
+    }
+    RingBuffer(RingBuffer &&) = default;
+    RingBuffer &operator=(const RingBuffer &b) {
+      RingBuffer copy(b);
+      return *this = std::move(copy);
+    }
+    RingBuffer &operator=(RingBuffer &&) = default;
+
+    size_t getCapacity() const { return capacity; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    void push_back(const T &e) {
+      assert(capacity > 0 && "push into an empty ring buffer");
+      if (count < elements.size()) {
+        elements[wrap(head + count)] = e;
+        ++count;
+      } else if (elements.size() < capacity) {
+        std::rotate(elements.begin(), elements.begin() + head, elements.end());
+        head = 0;
+        elements.push_back(e);
+        ++count;
+      } else {
+        elements[head] = e;
+        head = wrap(head + 1);
+      }
+    }
+
+    void pop_front() {
+      assert(count > 0 && "pop from an empty ring buffer");
+      head = --count ? wrap(head + 1) : 0;
+    }
+
+    const T &operator[](size_t i) const {
+      assert(i < count && "out of bounds");
+      return elements[wrap(head + i)];
+    }
+
+    const T &front() const { return (*this)[0]; }
+    const T &back() const { return (*this)[count - 1]; }
+
+    void clear() {
+      elements.clear();
+      head = 0;
+      count = 0;
+    }
+  };
+}
+
+#endif /* KLEE_RINGBUFFER_H */
@@ -10,6 +10,7 @@
 #ifndef KLEE_TREESTREAM_H
 #define KLEE_TREESTREAM_H
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -33,18 +34,41 @@ namespace klee {
     friend class TreeOStream;
 
   private:
+    /// A run of consecutive entries of one stream in the file
+    struct Segment {
+      /// byte offsets of the first entry and past the last entry
+      std::streamoff begin, end;
+      unsigned len;
+    };
+    /// In-memory index of the streams written so far, so that a stream can
+    /// be extracted without rescanning the file
+    struct StreamInfo {
+      unsigned parent;
+      /// number of segments of the parent written before this stream forked
+      size_t forkSegments;
+      std::vector<Segment> segments;
+    };
+
     unsigned lastID, lastLen;
     std::iostream::pos_type lastLen_off;
     bool isWritten, lastLen_dirty;
 
     std::string path;
     std::ofstream *output;
+    /// read-only descriptor of `path` used by readStream, opened lazily
+    int inputFD;
     unsigned ids;
+    /// indexed by TreeStreamID, entry 0 is the (empty) root
+    std::vector<StreamInfo> streams;
 
     template<typename T>
     void write(TreeOStream &os, const T &entry);
     void write_metadata(TreeOStream &os);
     void flush_lastLen();
+    /// Read the bytes of all segments of `streamID` and its ancestors, in
+    /// stream order, together with the number of entries of each segment.
+    void readSegments(TreeStreamID streamID, std::string &buffer,
+                      std::vector<unsigned> &lengths);
 
   public:
     TreeStreamWriter(const std::string &_path);
@@ -57,7 +81,8 @@ namespace klee {
 
     void flush();
 
-    // hack, to be replace by proper stream capabilities
+    /// Extract all entries of a stream. Only the segments of the stream and
+    /// its ancestors are read, so this costs O(length of the stream).
     template <typename T>
     void readStream(TreeStreamID streamID, std::vector<T> &out);
   };
@@ -101,76 +126,35 @@ namespace klee {
     ++lastLen;
     lastLen_dirty = true;
   }
+  /// Minimal istream interface over the bytes returned by readSegments, for
+  /// use with deserialize()
+  class TreeStreamBuffer {
+    const char *pos;
+
+  public:
+    explicit TreeStreamBuffer(const std::string &buffer)
+        : pos(buffer.data()) {}
+    void read(char *s, std::streamsize n) {
+      std::copy(pos, pos + n, s);
+      pos += n;
+    }
+    void get(char &c) { c = *pos++; }
+  };
+
   template <typename T>
   void TreeStreamWriter::readStream(TreeStreamID streamID,
           std::vector<T> &out) {
       assert(streamID>0 && streamID<ids);
-      flush();
-
-      std::ifstream is(path.c_str(),
-              std::ios::in | std::ios::binary);
-      assert(is.good());
-      KLEE_DEBUG(llvm::errs() << "finding chain for: " << streamID << "\n");
-
-      std::map<unsigned,unsigned> parents;
-      std::vector<unsigned> roots;
-      for (;;) {
-          assert(is.good());
-          unsigned id;
-          unsigned tag;
-          is.read(reinterpret_cast<char*>(&id), sizeof(id));
-          is.read(reinterpret_cast<char*>(&tag), sizeof(tag));
-          if (tag&(1<<31)) { // fork
-              unsigned child = tag ^ (1<<31);
-
-              if (child==streamID) {
-                  roots.push_back(child);
-                  while (id) {
-                      roots.push_back(id);
-                      std::map<unsigned, unsigned>::iterator it = parents.find(id);
-                      assert(it!=parents.end());
-                      id = it->second;
-                  }
-                  break;
-              } else {
-                  parents.insert(std::make_pair(child,id));
-              }
-          } else {
-              unsigned len = tag;
-              for (unsigned i=0; i < len; ++i) {
-                  skip(is, T());
-              }
-          }
-      }
-      KLEE_DEBUG({
-              llvm::errs() << "roots: ";
-              for (size_t i = 0, e = roots.size(); i < e; ++i) {
-              llvm::errs() << roots[i] << " ";
-              }
-              llvm::errs() << "\n";
-              });
-      is.seekg(0, std::ios::beg);
-      for (;;) {
-          unsigned id;
-          unsigned tag;
-          is.read(reinterpret_cast<char*>(&id), 4);
-          is.read(reinterpret_cast<char*>(&tag), 4);
-          if (!is.good()) break;
-          if (tag&(1<<31)) { // fork
-              unsigned child = tag ^ (1<<31);
-              if (id==roots.back() && roots.size()>1 && child==roots[roots.size()-2])
-                  roots.pop_back();
-          } else {
-              unsigned len = tag;
+      std::string buffer;
+      std::vector<unsigned> lengths;
+      readSegments(streamID, buffer, lengths);
+
+      TreeStreamBuffer is(buffer);
+      for (unsigned len : lengths) {
+          for (unsigned i=0; i < len; ++i) {
               T entry;
-              for (unsigned i=0; i < len; ++i) {
-                  if (id==roots.back()) {
-                      deserialize(is, entry);
-                      out.push_back(std::move(entry));
-                  } else {
-                      skip(is, entry);
-                  }
-              }
+              deserialize(is, entry);
+              out.push_back(std::move(entry));
           }
       }
   }
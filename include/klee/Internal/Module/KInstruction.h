@@ -43,6 +43,34 @@ namespace klee {
     int *operands;
     /// Destination register index.
     unsigned dest;
+
+    /// The following are decoded once by KFunction, so that executing the
+    /// instruction does not need to go through inst for them.
+
+    /// inst->getOpcode()
+    unsigned opcode;
+    /// Width in bits of the result, 0 if the result is void or unsized
+    unsigned width;
+
+    enum CallKind : uint8_t {
+      NotACall,
+      /// call or invoke of a function or a function pointer
+      Call,
+      /// llvm.dbg.* intrinsics, ignored
+      DebugIntrinsic,
+      /// inline assembly inserted by PTWritePass
+      PTWrite,
+      /// inline assembly inserted by TagPass
+      Tag,
+      /// any other inline assembly, unsupported
+      InlineAsm
+    };
+    CallKind callKind;
+    /// Target of a call through a function, its aliases or bitcasts, null if
+    /// the call is indirect
+    llvm::Function *callee;
+    /// Instruction whose value a PTWrite call records
+    KInstruction *recorded;
     /// How many times this Instruction has been executed
     /// Maintained at Executor::executeInstruction
     unsigned int frequency = 0;
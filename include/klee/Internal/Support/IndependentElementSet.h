@@ -3,74 +3,161 @@
 #include "klee/Expr/Expr.h"
 #include "klee/Expr/ExprUtil.h"
 #include "klee/Expr/ExprHashMap.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+
 namespace klee {
 // Originally locate at IndependentSolver.cpp
+// Stored as ranges, as the elements of a factor are mostly the bytes of a few
+// contiguous accesses to arrays which may be much larger.
 template<class T>
 class DenseSet {
-  typedef std::set<T> set_ty;
-  set_ty s;
+  // disjoint and non-adjacent ranges [first, second), in increasing order
+  typedef std::vector<std::pair<T, T> > ranges_ty;
+  ranges_ty ranges;
+
+  // the first range ending at or after x
+  typename ranges_ty::iterator endingFrom(T x) {
+    return std::lower_bound(
+        ranges.begin(), ranges.end(), x,
+        [](const std::pair<T, T> &r, T x) { return r.second < x; });
+  }
+  // the first range ending after x
+  typename ranges_ty::const_iterator endingAfter(T x) const {
+    return std::upper_bound(
+        ranges.begin(), ranges.end(), x,
+        [](T x, const std::pair<T, T> &r) { return x < r.second; });
+  }
+
+  // returns true iff set is changed by addition
+  bool addRange(T start, T end) {
+    if (!(start < end))
+      return false;
+    // the ranges overlapping or adjacent to [start, end)
+    typename ranges_ty::iterator first = endingFrom(start), last = first;
+    while (last != ranges.end() && !(end < last->first))
+      ++last;
+    if (first == last) {
+      ranges.insert(first, std::make_pair(start, end));
+      return true;
+    }
+    if (!(start < first->first) && !((last - 1)->second < end) &&
+        last - first == 1)
+      return false;
+    first->first = std::min(first->first, start);
+    first->second = std::max((last - 1)->second, end);
+    ranges.erase(first + 1, last);
+    return true;
+  }
 
 public:
   DenseSet() {}
 
   void add(T x) {
-    s.insert(x);
+    addRange(x, x + 1);
   }
   void add(T start, T end) {
-    for (; start<end; start++)
-      s.insert(start);
+    addRange(start, end);
   }
 
   // returns true iff set is changed by addition
   bool add(const DenseSet &b) {
-    bool modified = false;
-    for (typename set_ty::const_iterator it = b.s.begin(), ie = b.s.end(); 
-         it != ie; ++it) {
-      if (modified || !s.count(*it)) {
-        modified = true;
-        s.insert(*it);
-      }
+    if (b.ranges.empty())
+      return false;
+    if (ranges.empty()) {
+      ranges = b.ranges;
+      return true;
+    }
+    if (b.ranges.size() * 8 < ranges.size()) {
+      // cheaper to insert the few ranges of b than to merge them all
+      bool modified = false;
+      for (const auto &r : b.ranges)
+        modified |= addRange(r.first, r.second);
+      return modified;
     }
+
+    ranges_ty merged;
+    merged.reserve(ranges.size() + b.ranges.size());
+    typename ranges_ty::const_iterator i = ranges.begin(), j = b.ranges.begin();
+    while (i != ranges.end() || j != b.ranges.end()) {
+      const std::pair<T, T> &r =
+          j == b.ranges.end() || (i != ranges.end() && i->first < j->first)
+              ? *i++
+              : *j++;
+      if (!merged.empty() && !(merged.back().second < r.first))
+        merged.back().second = std::max(merged.back().second, r.second);
+      else
+        merged.push_back(r);
+    }
+    bool modified = merged != ranges;
+    ranges.swap(merged);
     return modified;
   }
 
   bool intersects(const DenseSet &b) const {
-    // smallter_set.interesects(larger_set) is more efficient
-    if (s.size() > b.s.size()) {
+    // look up the ranges of the smaller set in the larger one
+    if (ranges.size() > b.ranges.size()) {
       return b.intersects(*this);
     }
-    for (typename set_ty::iterator it = s.begin(), ie = s.end(); 
-         it != ie; ++it)
-      if (b.s.count(*it))
+    for (const auto &r : ranges) {
+      typename ranges_ty::const_iterator it = b.endingAfter(r.first);
+      if (it != b.ranges.end() && it->first < r.second)
         return true;
+    }
     return false;
   }
 
-  std::set<unsigned>::iterator begin(){
-    return s.begin();
-  }
-  std::set<unsigned>::const_iterator begin() const {
-    return s.cbegin();
-  }
+  // iterates over the elements, in increasing order
+  class const_iterator
+      : public std::iterator<std::forward_iterator_tag, T, std::ptrdiff_t,
+                             const T *, T> {
+    typename ranges_ty::const_iterator range, rangesEnd;
+    T value;
 
-  std::set<unsigned>::iterator end(){
-    return s.end();
+  public:
+    const_iterator(typename ranges_ty::const_iterator range,
+                   typename ranges_ty::const_iterator rangesEnd)
+        : range(range), rangesEnd(rangesEnd),
+          value(range == rangesEnd ? T() : range->first) {}
+    T operator*() const { return value; }
+    const_iterator &operator++() {
+      if (++value == range->second)
+        value = ++range == rangesEnd ? T() : range->first;
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator it = *this;
+      ++*this;
+      return it;
+    }
+    bool operator==(const const_iterator &b) const {
+      return range == b.range && value == b.value;
+    }
+    bool operator!=(const const_iterator &b) const { return !(*this == b); }
+  };
+
+  const_iterator begin() const {
+    return const_iterator(ranges.begin(), ranges.end());
   }
-  std::set<unsigned>::const_iterator end() const {
-    return s.cend();
+  const_iterator end() const {
+    return const_iterator(ranges.end(), ranges.end());
   }
 
+  bool empty() const { return ranges.empty(); }
+
   void print(llvm::raw_ostream &os) const {
     bool first = true;
     os << "{";
-    for (typename set_ty::iterator it = s.begin(), ie = s.end(); 
-        it != ie; ++it) {
+    for (T x : *this) {
       if (first) {
         first = false;
       } else {
         os << ",";
       }
-      os << *it;
+      os << x;
     }
     os << "}";
   }
@@ -0,0 +1,143 @@
+//===-- PathFormat.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// On-disk formats of recorded .path and .path_datarec files.
+//
+// Version 1 is a raw dump of the in-memory structures: every PathEntry takes
+// sizeof(PathEntry) bytes and every DataRecEntry repeats its full
+// instruction ID. Version 1 files have no header. klee still writes version
+// 1 by default, so that existing readers keep working; readers in this tree
+// accept both.
+//
+// Version 2 files start with a 4 byte magic followed by a version byte.
+//
+// .path (v2): varint number of entries, then a sequence of records. The low
+// 3 bits of the first byte of a record hold the PathEntry type, the high 5
+// bits hold a payload:
+//   FORK      payload is the number of branches in the run minus one,
+//             followed by the branch bits packed LSB first.
+//   others    payload is the value (switch/indirectbr index, target thread
+//             id or DATAREC width) if it is smaller than PayloadEscape,
+//             otherwise PayloadEscape followed by varint(value - PayloadEscape)
+//
+// .path_datarec (v2): varint number of interned instruction IDs, each one a
+// varint width, varint length and the ID bytes, followed by one record per
+// DataRecEntry: varint dictionary index and the data truncated to the width
+// of the dictionary entry, in little-endian order.
+//
+// Compressed v2 files use a different magic. The header and the part
+// preceding the records (number of entries or dictionary) are kept as is, so
+// that dictionary IDs can still be referenced from the mapped file. Records
+// are then split at record boundaries into blocks of about BlockSize bytes,
+// each one compressed independently. A footer index follows the blocks:
+// varint number of blocks, then for every block its varint compressed size,
+// uncompressed size and number of entries. The file ends with the offset of
+// the footer index as a little-endian uint64_t.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PATHFORMAT_H
+#define KLEE_PATHFORMAT_H
+
+#include "klee/Internal/Support/SerializableTypes.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace klee {
+namespace pathformat {
+
+const unsigned CurrentVersion = 2;
+
+enum FileKind { PathFile, DataRecFile };
+
+const char PathMagic[4] = {'E', 'R', 'P', 'T'};
+const char DataRecMagic[4] = {'E', 'R', 'D', 'R'};
+const char CompressedPathMagic[4] = {'E', 'R', 'P', 'Z'};
+const char CompressedDataRecMagic[4] = {'E', 'R', 'D', 'Z'};
+const size_t HeaderSize = sizeof(PathMagic) + 1;
+const size_t FooterSize = sizeof(uint64_t);
+
+/// Uncompressed size above which a block of a compressed file is closed
+const size_t BlockSize = 64 * 1024;
+
+const unsigned TypeBits = 3;
+const uint8_t TypeMask = (1u << TypeBits) - 1;
+const uint8_t PayloadEscape = (1u << (8 - TypeBits)) - 1;
+/// Max number of branches packed in one FORK record
+const unsigned MaxForkRun = PayloadEscape + 1;
+
+static_assert(PathEntry::NUM_PATHENTRY_T <= (1u << TypeBits),
+              "PathEntry_t does not fit in a v2 record header");
+
+/// \return the format version of a trace file starting with `data`, based on
+/// the magics of the expected file kind. Files without magic are version 1.
+/// `compressed` is set if the file is made of compressed blocks.
+unsigned detectVersion(const char *data, size_t size, FileKind kind,
+                       bool &compressed);
+
+/// \return whether this build can read and write compressed trace files
+bool compressionSupported();
+
+/// Compress one block of a trace file into `out`.
+/// \return false on failure or if compression is not supported
+bool compressBlock(const char *data, size_t size, std::vector<char> &out);
+
+/// Uncompress one block of exactly `dstSize` bytes into `dst`.
+/// \return false if the block is corrupted or compression is not supported
+bool uncompressBlock(const char *src, size_t srcSize, char *dst,
+                     size_t dstSize);
+
+/// Append the varint (LEB128) encoding of `v` to `out`.
+inline void encodeVarint(uint64_t v, std::vector<char> &out) {
+  while (v >= 0x80) {
+    out.push_back(static_cast<char>((v & 0x7f) | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<char>(v));
+}
+
+/// Decode a varint starting at `data[offset]`, without reading beyond `size`.
+/// \return the offset past the varint, 0 if it is truncated or malformed
+inline size_t decodeVarint(const char *data, size_t size, size_t offset,
+                           uint64_t &v) {
+  v = 0;
+  for (unsigned shift = 0; offset < size && shift < 64; shift += 7) {
+    uint8_t byte = static_cast<uint8_t>(data[offset++]);
+    v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return offset;
+  }
+  return 0;
+}
+
+/// Write `entries` as a .path file of the given format version. Only
+/// version 2 files can be compressed.
+void writePathFile(llvm::raw_ostream &os,
+                   const std::vector<PathEntry> &entries,
+                   unsigned version = CurrentVersion, bool compress = false);
+
+/// Write `entries` as a .path_datarec file of the given format version.
+/// `pathEntries` is the matching .path, which provides the width of each
+/// recorded value: its DATAREC entries pair up with `entries` in order.
+void writeDataRecFile(llvm::raw_ostream &os,
+                      const std::vector<DataRecEntry> &entries,
+                      const std::vector<PathEntry> &pathEntries,
+                      unsigned version = CurrentVersion,
+                      bool compress = false);
+
+} // namespace pathformat
+} // namespace klee
+
+#endif /* KLEE_PATHFORMAT_H */
@@ -0,0 +1,185 @@
+//===-- PathReader.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Readers of recorded .path and .path_datarec files used during replay.
+// Both files are memory mapped and decoded lazily, so that replaying a trace
+// of hundreds of millions of entries neither deserializes the whole trace
+// upfront nor keeps a decoded copy of it in memory. Both format versions
+// described in PathFormat.h are accepted.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PATHREADER_H
+#define KLEE_PATHREADER_H
+
+#include "klee/Internal/Support/SerializableTypes.h"
+
+#include "llvm/ADT/StringRef.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace klee {
+
+/// A read-only memory mapping of a whole file.
+class MappedFile {
+  const char *begin = nullptr;
+  size_t length = 0;
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  /// \return false and set `error` if the file cannot be mapped.
+  bool open(const std::string &name, std::string &error);
+
+  const char *data() const { return begin; }
+  size_t size() const { return length; }
+
+  /// Ask the kernel to read [offset, offset+len) ahead of time. Readahead is
+  /// asynchronous, so the next chunk is fetched in the background while the
+  /// current one is being consumed.
+  void prefetch(size_t offset, size_t len) const;
+};
+
+/// Zero-copy view of one DataRecEntry. `instUniqueID` points into the mapped
+/// .path_datarec file and stays valid as long as the reader is alive, even
+/// for compressed files, whose dictionary is not compressed.
+struct DataRecEntryRef {
+  uint64_t data;
+  llvm::StringRef instUniqueID;
+};
+
+/// Common part of the readers of variable-length trace records.
+/// The records following the file header are seen as a list of blocks, each
+/// one either mapped as is or compressed on disk and inflated on demand.
+/// Uncompressed files are made of a single block, and the footer index of
+/// compressed files maps any entry to its block, so only that block is
+/// inflated.
+/// Records are located through a cursor remembering the last decoded one, so
+/// sequential reads cost O(1). Within each block, the first record at or
+/// after every `CheckpointInterval`-th entry is remembered, so that seeking
+/// backwards (e.g. for a state forked earlier) only rescans a bounded number
+/// of records.
+class TraceRecordReader {
+  static const size_t CheckpointInterval = 1024;
+
+  struct Position {
+    /// index of the first entry of the record
+    size_t index;
+    /// byte offset of the record in its block
+    size_t offset;
+  };
+
+  struct Block {
+    size_t offset;
+    /// 0 if the block is stored uncompressed
+    size_t compressedSize;
+    size_t size;
+    /// index of the first entry in this block
+    size_t firstEntry;
+    /// checkpoints[i] is the first record at or after entry
+    /// firstEntry + i * CheckpointInterval, known up to the furthest record
+    /// decoded so far
+    std::vector<Position> checkpoints;
+  };
+
+  std::vector<Block> blocks;
+  /// the compressed block currently inflated into `inflated`
+  size_t inflatedBlock = ~size_t(0);
+  std::vector<char> inflated;
+
+  const char *loadBlock(size_t block);
+
+protected:
+  MappedFile file;
+  unsigned version = 1;
+  bool compressed = false;
+  size_t prefetchedUntil = 0;
+
+  /// The record found by the last successful seek(), in `cursorBlock`
+  size_t cursorBlock = 0;
+  Position cursor = {0, 0};
+  const char *cursorData = nullptr;
+  size_t cursorSize = 0;
+
+  /// Set up blocks covering the records that start at `offset`, reading the
+  /// footer index if the file is compressed.
+  /// \return false and set `error` if the file is corrupted
+  bool initBlocks(size_t offset, const std::string &name, std::string &error);
+
+  /// Decode the record at `data + offset`, and set `count` to the number of
+  /// entries it holds.
+  /// \return the offset of the next record, 0 if the data is corrupted
+  virtual size_t decodeRecord(const char *data, size_t size, size_t offset,
+                              size_t &count) = 0;
+
+  /// Move the cursor to the record holding entry `index` and decode it.
+  /// \return false if `index` is beyond the last entry
+  bool seek(size_t index);
+
+public:
+  virtual ~TraceRecordReader() = default;
+};
+
+/// Random access to the PathEntry sequence stored in a .path file.
+/// Accesses are expected to be mostly sequential (replay), and the reader
+/// prefetches the chunk following the most recent access.
+/// Version 1 entries have a fixed size and are read directly, version 2
+/// records may hold a run of several FORK entries.
+class PathEntryReader : public TraceRecordReader {
+  size_t numEntries = 0;
+  /// first entry of the record decoded last
+  PathEntry current;
+
+  size_t decodeRecord(const char *data, size_t size, size_t offset,
+                      size_t &count) override;
+
+public:
+  static std::unique_ptr<PathEntryReader> open(const std::string &name,
+                                               std::string &error);
+
+  /// Number of PathEntry in the file
+  size_t size() const { return numEntries; }
+
+  /// \return false if `index` is out of range
+  bool read(size_t index, PathEntry &pe);
+};
+
+/// Random access to the variable-length DataRecEntry sequence stored in a
+/// .path_datarec file.
+class DataRecEntryReader : public TraceRecordReader {
+  /// v2 only: interned instruction IDs and the width of their values
+  std::vector<std::pair<llvm::StringRef, unsigned>> dictionary;
+  DataRecEntryRef current;
+
+  size_t decodeRecord(const char *data, size_t size, size_t offset,
+                      size_t &count) override;
+
+public:
+  /// An empty reader, e.g. when a .path comes without its .path_datarec
+  DataRecEntryReader() = default;
+
+  static std::unique_ptr<DataRecEntryReader> open(const std::string &name,
+                                                  std::string &error);
+
+  /// \return false if `index` is beyond the last entry
+  bool read(size_t index, DataRecEntryRef &dre);
+};
+
+} // namespace klee
+
+#endif /* KLEE_PATHREADER_H */
@@ -27,8 +27,10 @@ class raw_fd_ostream;
 }
 
 namespace klee {
+class DataRecEntryReader;
 class ExecutionState;
 class Interpreter;
+class PathEntryReader;
 class TreeStreamWriter;
 
 class InterpreterHandler {
@@ -147,10 +149,13 @@ public:
   virtual void setReplayKTest(const struct KTest *out) = 0;
 
   // supply a list of branch decisions specifying which direction to
-  // take on forks. this can be used to drive the interpretation down
-  // a user specified path. use null to reset.
-  virtual void setReplayPath(const std::vector<PathEntry> *path) = 0;
-  virtual void setReplayDataRecEntries(const std::vector<DataRecEntry> *datarec) = 0;
+  // take on forks, and the data recorded along them. this can be used to
+  // drive the interpretation down a user specified path. paths added
+  // together are replayed at once, executing their common prefix once and
+  // forking where they diverge. returns false if the path is the same as
+  // one added before, and will not be replayed again.
+  virtual bool addReplayPath(PathEntryReader *path,
+                             DataRecEntryReader *datarec) = 0;
 
   // supply a set of symbolic bindings that will be used as "seeds"
   // for the search. use null to reset.
@@ -187,6 +192,10 @@ public:
 
   virtual unsigned getStatsPathStreamID(const ExecutionState &state) = 0;
 
+  /// \return the index, in the order they were added, of the replay path
+  /// followed by the state
+  virtual unsigned getReplayPathIndex(const ExecutionState &state) = 0;
+
   virtual void getConstraintLog(const ExecutionState &state,
                                 std::string &res,
                                 LogType logFormat = STP) = 0;
@@ -104,6 +104,9 @@ public:
   SolverRunStatus getOperationStatusCode();
   char *getConstraintLog(const Query&);
   void setCoreSolverTimeout(time::Span timeout);
+  void learnValidity(const Query &query, Solver::Validity result,
+                     const Assignment *trueModel,
+                     const Assignment *falseModel);
 };
 
 }
@@ -22,6 +22,7 @@
 #include <string>
 
 namespace klee {
+  class Assignment;
   class SolverImpl;
 
   struct Query {
@@ -237,6 +238,14 @@ namespace klee {
     virtual char *getConstraintLog(const Query& query);
     virtual void setCoreSolverTimeout(time::Span timeout);
 
+    /// learnValidity - Record the validity of a query which was solved
+    /// elsewhere, e.g. in a forked process, in the caches of this solver.
+    ///
+    /// \sa SolverImpl::learnValidity()
+    void learnValidity(const Query &query, Validity result,
+                       const Assignment *trueModel,
+                       const Assignment *falseModel);
+
     //void writeStackKQueries(std::string &buf);
   };
 
@@ -271,6 +280,19 @@ namespace klee {
   /// \param s - The underlying solver to use.
   Solver *createCexCachingSolver(Solver *s);
 
+  /// createPersistentCachingSolver - Create a solver which caches results on
+  /// disk, keyed by the structure of the queries, so that they can be reused
+  /// by later runs.
+  ///
+  /// \param s - The underlying solver to use.
+  /// \param warmStorePath - Store written by a previous run to start from,
+  /// or empty.
+  /// \param storePath - Where to write the store of this run, which includes
+  /// the results loaded from `warmStorePath`, or empty.
+  Solver *createPersistentCachingSolver(Solver *s,
+                                        const std::string &warmStorePath,
+                                        const std::string &storePath);
+
   /// createFastCexSolver - Create a "fast counterexample solver", which tries
   /// to quickly compute a satisfying assignment for a constraint set using
   /// value propogation and range analysis.
@@ -298,6 +320,15 @@ namespace klee {
                                     bool logTimedOut);
 
 
+  /// createPortfolioSolver - Create a solver which runs every query on both
+  /// backends in parallel processes, returns the first answer and kills the
+  /// other process. The number of queries won by each backend is recorded in
+  /// the PortfolioSTPWins and PortfolioZ3Wins statistics.
+  ///
+  /// \param stp - An STP solver, which must not fork on its own.
+  /// \param z3 - A Z3 solver.
+  Solver *createPortfolioSolver(Solver *stp, Solver *z3);
+
   /// createDummySolver - Create a dummy solver implementation which always
   /// fails.
   Solver *createDummySolver();
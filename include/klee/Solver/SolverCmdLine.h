@@ -28,6 +28,10 @@ extern llvm::cl::opt<bool> UseCexCache;
 
 extern llvm::cl::opt<bool> UseBranchCache;
 
+extern llvm::cl::opt<bool> UsePersistentQueryCache;
+
+extern llvm::cl::opt<std::string> QueryCacheDir;
+
 extern llvm::cl::opt<bool> UseIndependentSolver;
 
 enum class IndependentSolverType { PER_FACTOR, BATCH };
@@ -37,6 +41,8 @@ extern llvm::cl::opt<bool> EnableIndepExprCheckSum;
 
 extern llvm::cl::opt<unsigned int> ExprNumThreshold;
 
+extern llvm::cl::opt<unsigned> IndependentSolverJobs;
+
 extern llvm::cl::opt<bool> DebugValidateSolver;
 
 extern llvm::cl::opt<std::string> MinQueryTimeToLog;
@@ -66,6 +72,7 @@ enum CoreSolverType {
   METASMT_SOLVER,
   DUMMY_SOLVER,
   Z3_SOLVER,
+  PORTFOLIO_SOLVER,
   NO_SOLVER
 };
 
@@ -17,6 +17,7 @@
 
 namespace klee {
   class Array;
+  class Assignment;
   class ExecutionState;
   class Expr;
   struct Query;
@@ -108,6 +109,19 @@ namespace klee {
 
     virtual void setCoreSolverTimeout(time::Span timeout) {};
 
+    /// learnValidity - Record the validity of a query which was solved
+    /// outside of this solver, so that caching solvers can answer it without
+    /// solving it again. Solvers which wrap another one forward the result.
+    ///
+    /// \param trueModel - An assignment satisfying the constraints and the
+    /// query expression, or null if there is none or it was not computed.
+    /// \param falseModel - An assignment satisfying the constraints and the
+    /// negated query expression, or null if there is none or it was not
+    /// computed.
+    virtual void learnValidity(const Query &query, Solver::Validity result,
+                               const Assignment *trueModel,
+                               const Assignment *falseModel) {}
+
 };
 
 }
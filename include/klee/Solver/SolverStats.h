@@ -22,9 +22,14 @@ namespace stats {
   extern Statistic queryCacheMisses;
   extern Statistic queryCexCacheHits;
   extern Statistic queryCexCacheMisses;
+  extern Statistic queryPersistentCacheHits;
+  extern Statistic queryPersistentCacheMisses;
   extern Statistic queryConstructTime;
   extern Statistic queryConstructs;
   extern Statistic queryCounterexamples;
+  extern Statistic queryIncrementalResyncs;
+  extern Statistic portfolioSTPWins;
+  extern Statistic portfolioZ3Wins;
   extern Statistic independentConstraints;
   extern Statistic independentAllConstraints;
   // Solver Time related stats
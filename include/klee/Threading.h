@@ -34,6 +34,8 @@
  */
 #ifndef _KLEE_THREADING_H_
 #define _KLEE_THREADING_H_
+#include "klee/Internal/ADT/CopyOnWrite.h"
+#include "klee/Internal/Module/Cell.h"
 #include "klee/Internal/Module/KInstIterator.h"
 #include "klee/Internal/Module/KModule.h"
 
@@ -41,7 +43,6 @@
 namespace klee {
 
 class CallPathNode;
-struct Cell;
 class MemoryObject;
 struct StackFrame {
   KInstIterator caller;
@@ -49,7 +50,9 @@ struct StackFrame {
   CallPathNode *callPathNode;
 
   std::vector<const MemoryObject *> allocas;
-  Cell *locals;
+  /// Registers, shared with the copies of this frame until either of them
+  /// writes one
+  CopyOnWrite<std::vector<Cell>> locals;
 
   /// Minimum distance to an uncovered instruction once the function
   /// returns. This is not a good place for this but is used to
@@ -66,8 +69,6 @@ struct StackFrame {
   MemoryObject *varargs;
 
   StackFrame(KInstIterator caller, KFunction *kf);
-  StackFrame(const StackFrame &s);
-  ~StackFrame();
 };
 
 // note that I have not ported multi-processes support, process_id_t is just a
@@ -93,8 +94,9 @@ private:
   /// @brief Pointer to instruction which is currently executed
   KInstIterator prevPC;
 
-  /// @brief Stack representing the current instruction stream
-  stack_ty stack;
+  /// @brief Stack representing the current instruction stream, shared with
+  /// the copies of this thread until either of them changes it
+  CopyOnWrite<stack_ty> stack;
 
   /// @brief Remember from which Basic Block control flow arrived
   /// (i.e. to select the right phi values)
@@ -35,6 +35,40 @@ public:
   void set(unsigned idx) { bits[idx/32] |= 1<<(idx&0x1F); }
   void unset(unsigned idx) { bits[idx/32] &= ~(1<<(idx&0x1F)); }
   void set(unsigned idx, bool value) { if (value) set(idx); else unset(idx); }
+
+  /// Whether the \p n bits from \p idx are all set, a word at a time
+  bool isRangeSet(unsigned idx, unsigned n) {
+    while (n) {
+      uint32_t mask = rangeMask(idx, n);
+      if ((bits[idx/32] & mask) != mask)
+        return false;
+      unsigned k = 32 - (idx&0x1F);
+      if (k >= n)
+        break;
+      idx += k;
+      n -= k;
+    }
+    return true;
+  }
+  /// Set the \p n bits from \p idx, a word at a time
+  void setRange(unsigned idx, unsigned n) {
+    while (n) {
+      bits[idx/32] |= rangeMask(idx, n);
+      unsigned k = 32 - (idx&0x1F);
+      if (k >= n)
+        break;
+      idx += k;
+      n -= k;
+    }
+  }
+
+private:
+  /// mask of the bits from idx to at most idx+n in the word of idx
+  static uint32_t rangeMask(unsigned idx, unsigned n) {
+    unsigned bit = idx&0x1F;
+    unsigned k = n < 32 - bit ? n : 32 - bit;
+    return (k == 32 ? ~0u : ((1u << k) - 1)) << bit;
+  }
 };
 
 } // End klee namespace
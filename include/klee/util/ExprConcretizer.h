@@ -115,19 +115,15 @@ namespace klee {
 
     // return the indirect depth of a given Expr if found
     // init not found Expr with default indirect depth -1
-    int getLevel(const ref<Expr> &e);
-    void putLevel(const ref<Expr> &e, int level);
-    /// assert that Expr `e` occurs in a certain constaint with indirect depth `level` 
-    /// \return the maximum indirect depth encountered when recursively analysing the kids of e.
-    ///   Note that this is mostly for recursively get the max indirect depth.
+    int getLevel(const Expr *e);
+    void putLevel(const Expr *e, int level);
+    /// assert that Expr `e` occurs in a certain constaint with indirect depth
+    /// `readLevel`, and propagate it to its kids. This walks an explicit
+    /// worklist rather than recursing, so that deep expressions do not
+    /// overflow the stack. maxLevel is updated along the way.
     ///
     /// TODO: enrich this framework to analyse more statistics than just maximum.
-    int assignDepth(const ref<Expr> &e, int readLevel);
-    inline void updateMaxLevelfromKid(const ref<Expr> &e, int readLevel, int &max) {
-      if (!e.isNull()) {
-        max = std::max(max, assignDepth(e, readLevel));
-      }
-    }
+    void assignDepth(const ref<Expr> &e, int readLevel);
 
   public:
     // all calculation is done in the constructor
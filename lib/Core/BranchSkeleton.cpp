@@ -0,0 +1,271 @@
+//===-- BranchSkeleton.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "BranchSkeleton.h"
+
+#include "klee/Internal/Module/KInstruction.h"
+#include "klee/Internal/Module/KModule.h"
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/ErrorHandling.h"
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+bool isScalar(const Type *t) { return t->isIntegerTy() || t->isPointerTy(); }
+
+/// \return true if `i` is evaluated by BranchSkeleton
+bool isEvaluated(const Instruction &i) {
+  switch (i.getOpcode()) {
+  case Instruction::Add:
+  case Instruction::Sub:
+  case Instruction::Mul:
+  case Instruction::UDiv:
+  case Instruction::SDiv:
+  case Instruction::URem:
+  case Instruction::SRem:
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+  case Instruction::ICmp:
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+  case Instruction::SExt:
+  case Instruction::PtrToInt:
+  case Instruction::IntToPtr:
+  case Instruction::BitCast:
+  case Instruction::Select:
+  case Instruction::GetElementPtr:
+  case Instruction::PHI:
+    return isScalar(i.getType());
+  default:
+    return false;
+  }
+}
+
+bool compare(CmpInst::Predicate predicate, const APInt &a, const APInt &b) {
+  switch (predicate) {
+  case CmpInst::ICMP_EQ: return a.eq(b);
+  case CmpInst::ICMP_NE: return a.ne(b);
+  case CmpInst::ICMP_UGT: return a.ugt(b);
+  case CmpInst::ICMP_UGE: return a.uge(b);
+  case CmpInst::ICMP_ULT: return a.ult(b);
+  case CmpInst::ICMP_ULE: return a.ule(b);
+  case CmpInst::ICMP_SGT: return a.sgt(b);
+  case CmpInst::ICMP_SGE: return a.sge(b);
+  case CmpInst::ICMP_SLT: return a.slt(b);
+  case CmpInst::ICMP_SLE: return a.sle(b);
+  default:
+    llvm_unreachable("invalid integer predicate");
+  }
+}
+} // namespace
+
+std::unique_ptr<BranchSkeleton>
+BranchSkeleton::create(const KFunction *kf, const DataLayout &dataLayout) {
+  std::unique_ptr<BranchSkeleton> skeleton(
+      new BranchSkeleton(kf, dataLayout));
+
+  std::vector<const Value *> worklist;
+  for (const BasicBlock &bb : *kf->function) {
+    const Instruction *term = bb.getTerminator();
+    if (const BranchInst *bi = dyn_cast<BranchInst>(term)) {
+      if (bi->isConditional())
+        worklist.push_back(bi->getCondition());
+    } else if (!isa<ReturnInst>(term) && !isa<UnreachableInst>(term)) {
+      return nullptr;
+    }
+  }
+
+  DenseMap<const Instruction *, const KInstruction *> kinstructions;
+  for (unsigned i = 0; i < kf->numInstructions; ++i)
+    kinstructions[kf->instructions[i]->inst] = kf->instructions[i];
+
+  while (!worklist.empty()) {
+    const Value *v = worklist.back();
+    worklist.pop_back();
+    if (isa<ConstantInt>(v) || isa<ConstantPointerNull>(v))
+      continue;
+    if (isa<Argument>(v)) {
+      if (!isScalar(v->getType()))
+        return nullptr;
+      continue;
+    }
+    const Instruction *i = dyn_cast<Instruction>(v);
+    if (!i || !isEvaluated(*i))
+      return nullptr;
+    if (!skeleton->slice.insert(std::make_pair(i, kinstructions[i])).second)
+      continue;
+    for (const Use &op : i->operands())
+      worklist.push_back(op.get());
+  }
+  return skeleton;
+}
+
+bool BranchSkeleton::lookup(const values_ty &values, const Value *v,
+                            APInt &result) const {
+  if (const ConstantInt *ci = dyn_cast<ConstantInt>(v)) {
+    result = ci->getValue();
+    return true;
+  }
+  if (isa<ConstantPointerNull>(v)) {
+    result = APInt(dataLayout.getTypeSizeInBits(v->getType()), 0);
+    return true;
+  }
+  // symbolic arguments have no value
+  auto it = values.find(v);
+  if (it == values.end())
+    return false;
+  result = it->second;
+  return true;
+}
+
+bool BranchSkeleton::evaluateInstruction(const Instruction &i,
+                                         values_ty &values) const {
+  unsigned width = dataLayout.getTypeSizeInBits(i.getType());
+  APInt a, b, result;
+  if (!lookup(values, i.getOperand(0), a))
+    return false;
+
+  switch (i.getOpcode()) {
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+  case Instruction::PtrToInt:
+  case Instruction::IntToPtr:
+  case Instruction::BitCast:
+    result = a.zextOrTrunc(width);
+    break;
+  case Instruction::SExt:
+    result = a.sext(width);
+    break;
+
+  case Instruction::Select: {
+    if (!lookup(values, i.getOperand(a.getBoolValue() ? 1 : 2), result))
+      return false;
+    break;
+  }
+
+  case Instruction::GetElementPtr: {
+    // the offsets computed for the executor, see Executor::computeOffsets
+    const KGEPInstruction *kgepi =
+        static_cast<const KGEPInstruction *>(slice.lookup(&i));
+    result = a + APInt(width, kgepi->offset);
+    for (const auto &index : kgepi->indices) {
+      if (!lookup(values, i.getOperand(index.first), b))
+        return false;
+      result += b.sextOrTrunc(width) * APInt(width, index.second);
+    }
+    break;
+  }
+
+  default: {
+    if (!lookup(values, i.getOperand(1), b))
+      return false;
+    if (const ICmpInst *ci = dyn_cast<ICmpInst>(&i)) {
+      result = APInt(1, compare(ci->getPredicate(), a, b));
+      break;
+    }
+    switch (i.getOpcode()) {
+    case Instruction::Add: result = a + b; break;
+    case Instruction::Sub: result = a - b; break;
+    case Instruction::Mul: result = a * b; break;
+    case Instruction::And: result = a & b; break;
+    case Instruction::Or: result = a | b; break;
+    case Instruction::Xor: result = a ^ b; break;
+    case Instruction::UDiv:
+    case Instruction::SDiv:
+    case Instruction::URem:
+    case Instruction::SRem:
+      if (!b)
+        return false;
+      switch (i.getOpcode()) {
+      case Instruction::UDiv: result = a.udiv(b); break;
+      case Instruction::SDiv: result = a.sdiv(b); break;
+      case Instruction::URem: result = a.urem(b); break;
+      default: result = a.srem(b); break;
+      }
+      break;
+    case Instruction::Shl:
+    case Instruction::LShr:
+    case Instruction::AShr:
+      if (b.uge(a.getBitWidth()))
+        return false;
+      switch (i.getOpcode()) {
+      case Instruction::Shl: result = a.shl(b); break;
+      case Instruction::LShr: result = a.lshr(b); break;
+      default: result = a.ashr(b); break;
+      }
+      break;
+    default:
+      llvm_unreachable("instruction not in a branch skeleton");
+    }
+  }
+  }
+
+  values[&i] = result;
+  return true;
+}
+
+bool BranchSkeleton::evaluate(const std::vector<ref<Expr>> &arguments,
+                              std::vector<bool> &branches) const {
+  values_ty values;
+  unsigned index = 0;
+  for (const Argument &arg : kf->function->args()) {
+    if (index == arguments.size())
+      break;
+    if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(arguments[index++]))
+      values[&arg] = CE->getAPValue();
+  }
+
+  const BasicBlock *bb = &kf->function->getEntryBlock();
+  const BasicBlock *pred = nullptr;
+  std::vector<std::pair<const PHINode *, APInt>> incoming;
+  for (;;) {
+    // the phi nodes of a block take their values at once
+    BasicBlock::const_iterator it = bb->begin();
+    incoming.clear();
+    for (; isa<PHINode>(*it); ++it) {
+      const PHINode *phi = cast<PHINode>(&*it);
+      APInt v;
+      if (!slice.count(phi))
+        continue;
+      if (!lookup(values, phi->getIncomingValueForBlock(pred), v))
+        return false;
+      incoming.push_back(std::make_pair(phi, v));
+    }
+    for (const auto &phi : incoming)
+      values[phi.first] = phi.second;
+
+    for (; !it->isTerminator(); ++it) {
+      if (slice.count(&*it) && !evaluateInstruction(*it, values))
+        return false;
+    }
+
+    const BranchInst *bi = dyn_cast<BranchInst>(&*it);
+    if (!bi)
+      return isa<ReturnInst>(*it);
+    pred = bb;
+    if (bi->isUnconditional()) {
+      bb = bi->getSuccessor(0);
+      continue;
+    }
+    APInt condition;
+    if (!lookup(values, bi->getCondition(), condition))
+      return false;
+    branches.push_back(condition.getBoolValue());
+    bb = bi->getSuccessor(condition.getBoolValue() ? 0 : 1);
+  }
+}
@@ -0,0 +1,70 @@
+//===-- BranchSkeleton.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_BRANCHSKELETON_H
+#define KLEE_BRANCHSKELETON_H
+
+#include "klee/Expr/Expr.h"
+
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/DenseMap.h"
+
+#include <memory>
+#include <vector>
+
+namespace llvm {
+class DataLayout;
+class Instruction;
+class Value;
+} // namespace llvm
+
+namespace klee {
+struct KFunction;
+struct KInstruction;
+
+/// BranchSkeleton - The instructions deciding the conditional branches of a
+/// function whose branches only depend on its arguments.
+///
+/// Evaluating them on concrete arguments gives the directions of the
+/// branches a call takes, without executing the rest of the body. Memory
+/// routines executed natively use this to put the branches of their body
+/// into the recorded path.
+class BranchSkeleton {
+  typedef llvm::DenseMap<const llvm::Value *, llvm::APInt> values_ty;
+
+  const KFunction *kf;
+  const llvm::DataLayout &dataLayout;
+  /// The instructions the branch conditions depend on
+  llvm::DenseMap<const llvm::Instruction *, const KInstruction *> slice;
+
+  BranchSkeleton(const KFunction *kf, const llvm::DataLayout &dataLayout)
+      : kf(kf), dataLayout(dataLayout) {}
+
+  bool lookup(const values_ty &values, const llvm::Value *v,
+              llvm::APInt &result) const;
+  bool evaluateInstruction(const llvm::Instruction &i,
+                           values_ty &values) const;
+
+public:
+  /// \return null if a conditional branch of `kf` depends on memory, a call
+  /// or another instruction not evaluated here, or if `kf` ends a block
+  /// with another terminator than a branch, a return or unreachable
+  static std::unique_ptr<BranchSkeleton>
+  create(const KFunction *kf, const llvm::DataLayout &dataLayout);
+
+  /// Compute the directions of the conditional branches taken by a call on
+  /// `arguments`, in the order they are taken.
+  /// \return false if the branches depend on a symbolic argument, or the
+  /// call reaches undefined behaviour
+  bool evaluate(const std::vector<ref<Expr>> &arguments,
+                std::vector<bool> &branches) const;
+};
+} // namespace klee
+
+#endif /* KLEE_BRANCHSKELETON_H */
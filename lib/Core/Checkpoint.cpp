@@ -0,0 +1,558 @@
+//===-- Checkpoint.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The file starts with a 4 byte magic and a version byte, followed by the
+// number of functions and instructions of the module it was taken in and the
+// number of DAG records. Then come the DAG records and the body, whose
+// layout is up to the caller.
+//
+// A DAG record is a tag, 'A' (Array), 'U' (UpdateNode) or 'E' (Expr),
+// followed by its fields. References to records, instructions and functions
+// are written as their index plus one, 0 standing for null.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Checkpoint.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Internal/Module/KInstruction.h"
+#include "klee/Internal/Module/KModule.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+
+#include "llvm/ADT/APInt.h"
+#include "llvm/IR/GlobalValue.h"
+#include "llvm/IR/Module.h"
+
+#include <cstdio>
+
+using namespace klee;
+
+namespace {
+const char CheckpointMagic[4] = {'K', 'C', 'K', 'P'};
+const char CheckpointVersion = 3;
+} // namespace
+
+/***/
+
+KModuleIndex::KModuleIndex(const KModule *kmodule) : kmodule(kmodule) {
+  for (const auto &kf : kmodule->functions) {
+    uint64_t id = functionIds.size();
+    functionIds[kf.get()] = id;
+    for (unsigned i = 0; i < kf->numInstructions; ++i) {
+      KInstruction *ki = kf->instructions[i];
+      instructionIds[ki] = instructions.size();
+      valueIds[ki->inst] = instructions.size();
+      instructions.push_back(&kf->instructions[i]);
+    }
+  }
+}
+
+uint64_t KModuleIndex::getId(const KInstruction *ki) const {
+  auto it = instructionIds.find(ki);
+  return it == instructionIds.end() ? -1 : it->second;
+}
+
+uint64_t KModuleIndex::getId(const llvm::Value *inst) const {
+  auto it = valueIds.find(inst);
+  return it == valueIds.end() ? -1 : it->second;
+}
+
+uint64_t KModuleIndex::getId(const KFunction *kf) const {
+  auto it = functionIds.find(kf);
+  return it == functionIds.end() ? -1 : it->second;
+}
+
+KFunction *KModuleIndex::getFunction(uint64_t id) const {
+  return kmodule->functions[id].get();
+}
+
+/***/
+
+void CheckpointWriter::writeVarint(std::ostream &os, uint64_t v) {
+  while (v >= 0x80) {
+    os.put(static_cast<char>(v | 0x80));
+    v >>= 7;
+  }
+  os.put(static_cast<char>(v));
+}
+
+void CheckpointWriter::write(const std::string &s) {
+  write(s.size());
+  body.write(s.data(), s.size());
+}
+
+void CheckpointWriter::writeBytes(const void *data, size_t size) {
+  body.write(static_cast<const char *>(data), size);
+}
+
+bool CheckpointWriter::isInterned(char tag, const void *p) const {
+  switch (tag) {
+  case 'E':
+    return exprIds.count(static_cast<const Expr *>(p));
+  case 'U':
+    return updateNodeIds.count(static_cast<const UpdateNode *>(p));
+  default:
+    return arrayIds.count(static_cast<const Array *>(p));
+  }
+}
+
+void CheckpointWriter::intern(char tag, const void *root) {
+  // kids are pushed above their parent, so they are written first
+  struct Item {
+    char tag;
+    const void *p;
+    bool expanded;
+  };
+  std::vector<Item> stack{{tag, root, false}};
+  auto push = [&](char tag, const void *p) {
+    if (p && !isInterned(tag, p))
+      stack.push_back({tag, p, false});
+  };
+
+  while (!stack.empty()) {
+    Item item = stack.back();
+    if (isInterned(item.tag, item.p)) {
+      stack.pop_back();
+      continue;
+    }
+    if (item.expanded) {
+      writeRecord(item.tag, item.p);
+      stack.pop_back();
+      continue;
+    }
+    stack.back().expanded = true;
+
+    switch (item.tag) {
+    case 'E': {
+      const Expr *e = static_cast<const Expr *>(item.p);
+      if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+        push('A', re->updates.root);
+        push('U', re->updates.head.get());
+      }
+      for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+        push('E', e->getKid(i).get());
+      break;
+    }
+    case 'U': {
+      const UpdateNode *un = static_cast<const UpdateNode *>(item.p);
+      push('U', un->next.get());
+      push('E', un->index.get());
+      push('E', un->value.get());
+      break;
+    }
+    default: {
+      const Array *array = static_cast<const Array *>(item.p);
+      for (const auto &c : array->constantValues)
+        push('E', c.get());
+      break;
+    }
+    }
+  }
+}
+
+void CheckpointWriter::writeRecord(char tag, const void *p) {
+  dag.put(tag);
+  switch (tag) {
+  case 'E': {
+    const Expr *e = static_cast<const Expr *>(p);
+    writeVarint(dag, e->getKind());
+    writeVarint(dag, index.getId(e->getKInst()) + 1);
+    if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(e)) {
+      const llvm::APInt &v = ce->getAPValue();
+      writeVarint(dag, v.getBitWidth());
+      for (unsigned i = 0; i < v.getNumWords(); ++i)
+        writeVarint(dag, v.getRawData()[i]);
+    } else if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+      writeVarint(dag, arrayIds.at(re->updates.root) + 1);
+      writeVarint(dag, re->updates.head.isNull()
+                           ? 0
+                           : updateNodeIds.at(re->updates.head.get()) + 1);
+      writeVarint(dag, exprIds.at(re->index.get()) + 1);
+    } else {
+      for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+        writeVarint(dag, exprIds.at(e->getKid(i).get()) + 1);
+      if (const ExtractExpr *ee = dyn_cast<ExtractExpr>(e))
+        writeVarint(dag, ee->offset);
+      if (isa<ExtractExpr>(e) || isa<CastExpr>(e))
+        writeVarint(dag, e->getWidth());
+    }
+    uint64_t id = exprIds.size();
+    exprIds[e] = id;
+    break;
+  }
+  case 'U': {
+    const UpdateNode *un = static_cast<const UpdateNode *>(p);
+    writeVarint(dag, un->next.isNull() ? 0
+                                       : updateNodeIds.at(un->next.get()) + 1);
+    writeVarint(dag, exprIds.at(un->index.get()) + 1);
+    writeVarint(dag, exprIds.at(un->value.get()) + 1);
+    writeVarint(dag, un->flags);
+    writeVarint(dag, index.getId(un->kinst) + 1);
+    uint64_t id = updateNodeIds.size();
+    updateNodeIds[un] = id;
+    break;
+  }
+  default: {
+    const Array *array = static_cast<const Array *>(p);
+    writeVarint(dag, array->name.size());
+    dag.write(array->name.data(), array->name.size());
+    writeVarint(dag, array->size);
+    writeVarint(dag, array->domain);
+    writeVarint(dag, array->range);
+    writeVarint(dag, array->constantValues.size());
+    for (const auto &c : array->constantValues)
+      writeVarint(dag, exprIds.at(c.get()) + 1);
+    uint64_t id = arrayIds.size();
+    arrayIds[array] = id;
+    break;
+  }
+  }
+}
+
+void CheckpointWriter::write(const ref<Expr> &e) {
+  if (e.isNull()) {
+    write(uint64_t(0));
+    return;
+  }
+  intern('E', e.get());
+  write(exprIds[e.get()] + 1);
+}
+
+void CheckpointWriter::write(const UpdateNode *un) {
+  if (!un) {
+    write(uint64_t(0));
+    return;
+  }
+  intern('U', un);
+  write(updateNodeIds[un] + 1);
+}
+
+void CheckpointWriter::write(const Array *array) {
+  if (!array) {
+    write(uint64_t(0));
+    return;
+  }
+  intern('A', array);
+  write(arrayIds[array] + 1);
+}
+
+void CheckpointWriter::write(const UpdateList &updates) {
+  write(updates.root);
+  write(updates.head.get());
+}
+
+void CheckpointWriter::write(const KInstruction *ki) {
+  write(index.getId(ki) + 1);
+}
+
+void CheckpointWriter::write(KInstIterator it) {
+  write(it ? static_cast<const KInstruction *>(it) : nullptr);
+}
+
+void CheckpointWriter::write(const KFunction *kf) {
+  write(index.getId(kf) + 1);
+}
+
+void CheckpointWriter::writeValue(const llvm::Value *v) {
+  uint64_t id = index.getId(v);
+  if (id != (uint64_t)-1) {
+    write(uint64_t(1));
+    write(id);
+  } else if (const auto *gv = dyn_cast_or_null<llvm::GlobalValue>(v)) {
+    write(uint64_t(2));
+    write(gv->getName().str());
+  } else {
+    write(uint64_t(0));
+  }
+}
+
+bool CheckpointWriter::commit(const std::string &path, std::string &error) {
+  std::string tmp = path + ".tmp";
+  {
+    std::ofstream os(tmp, std::ios::binary | std::ios::trunc);
+    os.write(CheckpointMagic, sizeof(CheckpointMagic));
+    os.put(CheckpointVersion);
+    writeVarint(os, index.getNumFunctions());
+    writeVarint(os, index.getNumInstructions());
+    writeVarint(os, exprIds.size() + updateNodeIds.size() + arrayIds.size());
+    // the buffers of output string streams cannot be read from
+    os << dag.str() << body.str();
+    os.flush();
+    if (!os) {
+      error = "cannot write " + tmp;
+      return false;
+    }
+  }
+  if (std::rename(tmp.c_str(), path.c_str())) {
+    error = "cannot rename " + tmp + " to " + path;
+    return false;
+  }
+  return true;
+}
+
+/***/
+
+void CheckpointReader::fail(const std::string &message) const {
+  klee_error("checkpoint %s: %s", path.c_str(), message.c_str());
+}
+
+uint64_t CheckpointReader::readVarint() {
+  uint64_t v = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    int c = is.get();
+    if (c == EOF)
+      fail("truncated");
+    v |= uint64_t(c & 0x7f) << shift;
+    if (!(c & 0x80))
+      return v;
+  }
+  fail("malformed integer");
+}
+
+std::string CheckpointReader::readString() {
+  std::string s(readVarint(), '\0');
+  readBytes(&s[0], s.size());
+  return s;
+}
+
+void CheckpointReader::readBytes(void *data, size_t size) {
+  if (!is.read(static_cast<char *>(data), size))
+    fail("truncated");
+}
+
+ref<Expr> CheckpointReader::getExpr(uint64_t id) const {
+  if (!id)
+    return ref<Expr>();
+  if (id > exprs.size())
+    fail("invalid expression reference");
+  return exprs[id - 1];
+}
+
+ref<UpdateNode> CheckpointReader::getUpdateNode(uint64_t id) const {
+  if (!id)
+    return ref<UpdateNode>();
+  if (id > updateNodes.size())
+    fail("invalid update reference");
+  return updateNodes[id - 1];
+}
+
+const Array *CheckpointReader::getArray(uint64_t id) const {
+  if (!id)
+    return nullptr;
+  if (id > arrays.size())
+    fail("invalid array reference");
+  return arrays[id - 1];
+}
+
+void CheckpointReader::open(const std::string &_path) {
+  path = _path;
+  is.open(path, std::ios::binary);
+  if (!is)
+    fail("cannot open");
+
+  char magic[sizeof(CheckpointMagic)];
+  readBytes(magic, sizeof(magic));
+  if (!std::equal(magic, magic + sizeof(magic), CheckpointMagic))
+    fail("not a checkpoint");
+  if (is.get() != CheckpointVersion)
+    fail("unsupported version");
+  if (readVarint() != index.getNumFunctions() ||
+      readVarint() != index.getNumInstructions())
+    fail("taken with a different module");
+  readDAG(readVarint());
+}
+
+void CheckpointReader::readDAG(uint64_t numRecords) {
+  for (uint64_t i = 0; i < numRecords; ++i) {
+    switch (is.get()) {
+    case 'E':
+      exprs.push_back(readExprRecord());
+      break;
+    case 'U': {
+      ref<UpdateNode> next = readUpdateNode();
+      ref<Expr> updateIndex = readExpr();
+      ref<Expr> value = readExpr();
+      uint64_t flags = readVarint();
+      KInstruction *ki = readKInst();
+      if (updateIndex.isNull() || value.isNull())
+        fail("malformed update");
+      updateNodes.push_back(
+          new UpdateNode(next, updateIndex, value, flags, ki));
+      break;
+    }
+    case 'A': {
+      std::string name = readString();
+      uint64_t size = readVarint();
+      Expr::Width domain = readVarint();
+      Expr::Width range = readVarint();
+      std::vector<ref<ConstantExpr>> values(readVarint());
+      for (auto &value : values) {
+        ref<Expr> e = readExpr();
+        if (e.isNull() || !isa<ConstantExpr>(e))
+          fail("malformed constant array");
+        value = cast<ConstantExpr>(e);
+      }
+      arrays.push_back(arrayCache.CreateArray(
+          name, size, values.data(), values.data() + values.size(), domain,
+          range));
+      break;
+    }
+    default:
+      fail("malformed DAG record");
+    }
+  }
+}
+
+ref<Expr> CheckpointReader::readExprRecord() {
+  Expr::Kind kind = static_cast<Expr::Kind>(readVarint());
+  KInstruction *ki = readKInst();
+  std::vector<ref<Expr>> kids;
+  auto readKids = [&](unsigned n) {
+    for (unsigned i = 0; i < n; ++i) {
+      kids.push_back(readExpr());
+      if (kids.back().isNull())
+        fail("malformed expression");
+    }
+  };
+
+  ref<Expr> e;
+  switch (kind) {
+  case Expr::Constant: {
+    unsigned width = readVarint();
+    std::vector<uint64_t> words((width + 63) / 64);
+    for (auto &word : words)
+      word = readVarint();
+    e = ConstantExpr::alloc(llvm::APInt(width, words));
+    break;
+  }
+  case Expr::NotOptimized:
+    readKids(1);
+    e = NotOptimizedExpr::alloc(kids[0]);
+    break;
+  case Expr::Read: {
+    const Array *root = readArray();
+    ref<UpdateNode> head = readUpdateNode();
+    readKids(1);
+    if (!root)
+      fail("malformed read");
+    e = ReadExpr::alloc(UpdateList(root, head), kids[0]);
+    break;
+  }
+  case Expr::Select:
+    readKids(3);
+    e = SelectExpr::alloc(kids[0], kids[1], kids[2]);
+    break;
+  case Expr::Concat:
+    readKids(2);
+    e = ConcatExpr::alloc(kids[0], kids[1]);
+    break;
+  case Expr::Extract: {
+    readKids(1);
+    unsigned offset = readVarint();
+    e = ExtractExpr::alloc(kids[0], offset, readVarint());
+    break;
+  }
+  case Expr::ZExt:
+    readKids(1);
+    e = ZExtExpr::alloc(kids[0], readVarint());
+    break;
+  case Expr::SExt:
+    readKids(1);
+    e = SExtExpr::alloc(kids[0], readVarint());
+    break;
+  case Expr::Not:
+    readKids(1);
+    e = NotExpr::alloc(kids[0]);
+    break;
+#define BINARY_EXPR_CASE(T)                                                    \
+  case Expr::T:                                                                \
+    readKids(2);                                                               \
+    e = T##Expr::alloc(kids[0], kids[1]);                                      \
+    break;
+    BINARY_EXPR_CASE(Add)
+    BINARY_EXPR_CASE(Sub)
+    BINARY_EXPR_CASE(Mul)
+    BINARY_EXPR_CASE(UDiv)
+    BINARY_EXPR_CASE(SDiv)
+    BINARY_EXPR_CASE(URem)
+    BINARY_EXPR_CASE(SRem)
+    BINARY_EXPR_CASE(And)
+    BINARY_EXPR_CASE(Or)
+    BINARY_EXPR_CASE(Xor)
+    BINARY_EXPR_CASE(Shl)
+    BINARY_EXPR_CASE(LShr)
+    BINARY_EXPR_CASE(AShr)
+    BINARY_EXPR_CASE(Eq)
+    BINARY_EXPR_CASE(Ne)
+    BINARY_EXPR_CASE(Ult)
+    BINARY_EXPR_CASE(Ule)
+    BINARY_EXPR_CASE(Ugt)
+    BINARY_EXPR_CASE(Uge)
+    BINARY_EXPR_CASE(Slt)
+    BINARY_EXPR_CASE(Sle)
+    BINARY_EXPR_CASE(Sgt)
+    BINARY_EXPR_CASE(Sge)
+#undef BINARY_EXPR_CASE
+  default:
+    fail("malformed expression");
+  }
+  if (ki)
+    e->updateKInst(ki);
+  return e;
+}
+
+UpdateList CheckpointReader::readUpdates() {
+  const Array *root = readArray();
+  return UpdateList(root, readUpdateNode());
+}
+
+KInstruction *CheckpointReader::readKInst() {
+  KInstIterator it = readKInstIterator();
+  return it ? static_cast<KInstruction *>(it) : nullptr;
+}
+
+KInstIterator CheckpointReader::readKInstIterator() {
+  uint64_t id = readVarint();
+  if (!id)
+    return KInstIterator();
+  if (id > index.getNumInstructions())
+    fail("invalid instruction reference");
+  return index.getIterator(id - 1);
+}
+
+KFunction *CheckpointReader::readFunction() {
+  uint64_t id = readVarint();
+  if (!id)
+    return nullptr;
+  if (id > index.getNumFunctions())
+    fail("invalid function reference");
+  return index.getFunction(id - 1);
+}
+
+const llvm::Value *CheckpointReader::readValue() {
+  switch (readVarint()) {
+  case 0:
+    return nullptr;
+  case 1: {
+    uint64_t id = readVarint();
+    if (id >= index.getNumInstructions())
+      fail("invalid instruction reference");
+    return static_cast<KInstruction *>(index.getIterator(id))->inst;
+  }
+  case 2: {
+    std::string name = readString();
+    const llvm::Value *v = index.getModule()->module->getNamedValue(name);
+    if (!v)
+      fail("unknown global " + name);
+    return v;
+  }
+  default:
+    fail("malformed value");
+  }
+}
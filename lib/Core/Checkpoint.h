@@ -0,0 +1,158 @@
+//===-- Checkpoint.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CHECKPOINT_H
+#define KLEE_CHECKPOINT_H
+
+#include "klee/Expr/Expr.h"
+#include "klee/Internal/Module/KInstIterator.h"
+
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace llvm {
+class Value;
+}
+
+namespace klee {
+class ArrayCache;
+class KModule;
+struct KFunction;
+struct KInstruction;
+
+/// Numbers the functions and instructions of a module, in module order, so
+/// that a checkpoint can refer to them across processes executing the same
+/// module.
+class KModuleIndex {
+  const KModule *kmodule;
+  std::vector<KInstruction **> instructions;
+  std::unordered_map<const KInstruction *, uint64_t> instructionIds;
+  std::unordered_map<const llvm::Value *, uint64_t> valueIds;
+  std::unordered_map<const KFunction *, uint64_t> functionIds;
+
+public:
+  explicit KModuleIndex(const KModule *kmodule);
+
+  const KModule *getModule() const { return kmodule; }
+  uint64_t getNumFunctions() const { return functionIds.size(); }
+  uint64_t getNumInstructions() const { return instructions.size(); }
+
+  /// \return the id of an instruction, or -1 if it is not in the module
+  uint64_t getId(const KInstruction *ki) const;
+  /// \return the id of an llvm::Instruction, or -1
+  uint64_t getId(const llvm::Value *inst) const;
+  uint64_t getId(const KFunction *kf) const;
+
+  /// \return the iterator to instruction `id`, which is a valid id
+  KInstIterator getIterator(uint64_t id) const { return instructions[id]; }
+  KFunction *getFunction(uint64_t id) const;
+};
+
+/// Writes a checkpoint: a header, the expression DAG, then the body.
+///
+/// Expressions, update nodes and arrays are written once, the first time they
+/// are referenced, after all of their kids, and referred to by their index
+/// in their own table from then on. So subterms shared within the state stay
+/// shared in the file, and a reader resolves every index when reading it.
+/// Integers are written as LEB128 varints.
+class CheckpointWriter {
+  const KModuleIndex &index;
+
+  /// expression DAG, written before the body
+  std::ostringstream dag;
+  std::ostringstream body;
+
+  std::unordered_map<const Expr *, uint64_t> exprIds;
+  std::unordered_map<const UpdateNode *, uint64_t> updateNodeIds;
+  std::unordered_map<const Array *, uint64_t> arrayIds;
+
+  static void writeVarint(std::ostream &os, uint64_t v);
+  /// Write the records of `root` and of all its unwritten kids to the DAG.
+  void intern(char tag, const void *root);
+  bool isInterned(char tag, const void *p) const;
+  void writeRecord(char tag, const void *p);
+
+public:
+  explicit CheckpointWriter(const KModuleIndex &index) : index(index) {}
+
+  void write(uint64_t v) { writeVarint(body, v); }
+  void writeBool(bool b) { write(b ? 1 : 0); }
+  void write(const std::string &s);
+  void writeBytes(const void *data, size_t size);
+
+  /// Null references are allowed.
+  void write(const ref<Expr> &e);
+  void write(const UpdateNode *un);
+  void write(const Array *array);
+  void write(const UpdateList &updates);
+
+  /// Null instructions are allowed.
+  void write(const KInstruction *ki);
+  void write(KInstIterator it);
+  void write(const KFunction *kf);
+  /// Instructions and globals, anything else is written as null.
+  void writeValue(const llvm::Value *v);
+
+  /// Write the checkpoint to `path`, through a temporary file renamed over
+  /// it, so that a process dying while writing leaves the previous one.
+  bool commit(const std::string &path, std::string &error);
+};
+
+/// Reads a checkpoint written by CheckpointWriter. Malformed checkpoints are
+/// fatal errors.
+class CheckpointReader {
+  const KModuleIndex &index;
+  ArrayCache &arrayCache;
+  std::ifstream is;
+  std::string path;
+
+  std::vector<ref<Expr>> exprs;
+  std::vector<ref<UpdateNode>> updateNodes;
+  std::vector<const Array *> arrays;
+
+  uint64_t readVarint();
+  void readDAG(uint64_t numRecords);
+  ref<Expr> readExprRecord();
+
+  ref<Expr> getExpr(uint64_t id) const;
+  ref<UpdateNode> getUpdateNode(uint64_t id) const;
+  const Array *getArray(uint64_t id) const;
+
+public:
+  CheckpointReader(const KModuleIndex &index, ArrayCache &arrayCache)
+      : index(index), arrayCache(arrayCache) {}
+
+  /// Open the checkpoint and read its DAG, the body is read on demand.
+  void open(const std::string &path);
+
+  [[noreturn]] void fail(const std::string &message) const;
+
+  uint64_t read() { return readVarint(); }
+  bool readBool() { return readVarint() != 0; }
+  std::string readString();
+  void readBytes(void *data, size_t size);
+
+  ref<Expr> readExpr() { return getExpr(readVarint()); }
+  ref<UpdateNode> readUpdateNode() { return getUpdateNode(readVarint()); }
+  const Array *readArray() { return getArray(readVarint()); }
+  UpdateList readUpdates();
+
+  KInstruction *readKInst();
+  KInstIterator readKInstIterator();
+  KFunction *readFunction();
+  const llvm::Value *readValue();
+};
+
+} // namespace klee
+
+#endif /* KLEE_CHECKPOINT_H */
@@ -58,6 +58,8 @@ Statistic stats::symbolicSwitch("SymbolicSwitch", "SSwitch");
 Statistic stats::symbolicSelect("SymbolicSelect", "SSelect");
 Statistic stats::symbolicCall("SymbolicCall", "SCall");
 Statistic stats::dataRecLoadedEffective("DataLoadedEffective", "DataLoadedEffective");
+Statistic stats::trustedBranches("TrustedBranches", "TBr");
+Statistic stats::trustedBranchChecks("TrustedBranchChecks", "TBrChecks");
 Statistic stats::instMain("InstMain", "IM");
 Statistic stats::instLibc("InstLibc", "IL");
 Statistic stats::instPosix("InstPosix", "IP");
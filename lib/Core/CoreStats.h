@@ -58,6 +58,8 @@ namespace stats {
   extern Statistic allocaTime;
   extern Statistic dummy3;
   extern Statistic dataRecLoadedEffective;
+  extern Statistic trustedBranches;
+  extern Statistic trustedBranchChecks;
 
   extern Statistic instMain;
   extern Statistic instLibc;
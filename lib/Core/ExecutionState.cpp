@@ -87,6 +87,7 @@ ExecutionState::ExecutionState(KFunction *kf) :
     forkDisabled(false),
     replayPosition(0),
     replayDataRecEntriesPosition(0),
+    replayNode(0),
     nbranches_rec(0),
     ptreeNode(0),
     steppedInstructions(0){
@@ -98,17 +99,18 @@ ExecutionState::ExecutionState(KFunction *kf) :
 }
 
 ExecutionState::ExecutionState(const Constraints_ty &assumptions)
-    : wlistCounter(1), constraints(assumptions), replayPosition(0), replayDataRecEntriesPosition(0), nbranches_rec(0), ptreeNode(0) {}
+    : wlistCounter(1), constraints(assumptions), replayPosition(0), replayDataRecEntriesPosition(0), replayNode(0), nbranches_rec(0), ptreeNode(0) {}
 
 ExecutionState::~ExecutionState() {
   for (auto cur_mergehandler: openMergeStack){
     cur_mergehandler->removeOpenState(this);
   }
 
-  for (threads_ty::value_type &tit: threads) {
-    Thread &t = tit.second;
-    while (!t.stack.empty()) popFrame(t);
-  }
+  // without popping the frames, which would copy shared stacks
+  for (const threads_ty::value_type &tit: threads)
+    for (const StackFrame &sf : *tit.second.stack)
+      for (const MemoryObject *mo : sf.allocas)
+        addressSpace.unbindObject(mo);
 }
 
 ExecutionState::ExecutionState(const ExecutionState& state):
@@ -135,14 +137,18 @@ ExecutionState::ExecutionState(const ExecutionState& state):
 
     replayPosition(state.replayPosition),
     replayDataRecEntriesPosition(state.replayDataRecEntriesPosition),
+    replayNode(state.replayNode),
     nbranches_rec(state.nbranches_rec),
+    uncheckedBranches(state.uncheckedBranches),
+    checkedConstraints(state.checkedConstraints),
 
     coveredLines(state.coveredLines),
     ptreeNode(state.ptreeNode),
     symbolics(state.symbolics),
     arrayNames(state.arrayNames),
     openMergeStack(state.openMergeStack),
-    steppedInstructions(state.steppedInstructions) {
+    steppedInstructions(state.steppedInstructions),
+    functionCalls(state.functionCalls) {
   for (auto cur_mergehandler: openMergeStack)
     cur_mergehandler->addOpenState(this);
   crtThreadIt = threads.find(state.crtThreadIt->first);
@@ -153,7 +159,7 @@ ExecutionState *ExecutionState::branch() {
 
   ExecutionState *falseState = new ExecutionState(*this);
   falseState->coveredNew = false;
-  falseState->coveredLines.clear();
+  falseState->coveredLines = {};
 
   // initialize PathOS based on existence of existing PathOS field
   if (pathOS.isValid()) {
@@ -176,7 +182,8 @@ ExecutionState *ExecutionState::branch() {
 }
 
 void ExecutionState::addSymbolic(const MemoryObject *mo, const Array *array) {
-  symbolics.emplace_back(std::make_pair(ref<const MemoryObject>(mo), array));
+  symbolics.mutate().emplace_back(
+      std::make_pair(ref<const MemoryObject>(mo), array));
 }
 
 /**/
@@ -205,7 +212,7 @@ bool ExecutionState::merge(const ExecutionState &b) {
   // XXX is it even possible for these to differ? does it matter? probably
   // implies difference in object states?
 
-  if (symbolics != b.symbolics)
+  if (*symbolics != *b.symbolics)
     return false;
 
   {
@@ -320,8 +327,8 @@ bool ExecutionState::merge(const ExecutionState &b) {
     StackFrame &af = *itA;
     const StackFrame &bf = *itB;
     for (unsigned i=0; i<af.kf->numRegisters; i++) {
-      ref<Expr> &av = af.locals[i].value;
-      const ref<Expr> &bv = bf.locals[i].value;
+      ref<Expr> &av = af.locals.mutate()[i].value;
+      const ref<Expr> &bv = (*bf.locals)[i].value;
       if (av.isNull() || bv.isNull()) {
         // if one is null then by implication (we are at same pc)
         // we cannot reuse this local, so just ignore
@@ -360,7 +367,7 @@ bool ExecutionState::merge(const ExecutionState &b) {
   return true;
 }
 void ExecutionState::pushFrame(Thread &t, KInstIterator caller, KFunction *kf) {
-  t.stack.push_back(StackFrame(caller,kf));
+  t.stack.mutate().push_back(StackFrame(caller,kf));
   ++kf->frequency;
   if (!isInUserMain && (kf->function->getName() == PathRecordingEntryPoint)) {
     isInUserMain = true;
@@ -382,15 +389,25 @@ void ExecutionState::pushFrame(Thread &t, KInstIterator caller, KFunction *kf) {
   }
 
   // Log at what instruction a function has been executed to generate the list
-  // of functions which get executed during the suffix of a trace.
-  if (DumpFunctionListSuffixLen > 0) {
-    if (isInTargetProgram())
-      func_inst_map[kf->function->getName()] = steppedInstructions;
+  // of functions which get executed during the suffix of a trace. A call
+  // takes at least one instruction, so the last N+1 calls cover the last N
+  // instructions. Calls before the last N instructions are dropped, so that
+  // the first call after a fork only copies the calls of the suffix.
+  if (DumpFunctionListSuffixLen > 0 && isInTargetProgram()) {
+    if (functionCalls->getCapacity() == 0)
+      functionCalls = CopyOnWrite<RingBuffer<FunctionCall>>(
+          RingBuffer<FunctionCall>(DumpFunctionListSuffixLen + 1));
+    RingBuffer<FunctionCall> &calls = functionCalls.mutate();
+    while (!calls.empty() && calls.front().instruction +
+                                     DumpFunctionListSuffixLen <
+                                 steppedInstructions)
+      calls.pop_front();
+    calls.push_back({kf, steppedInstructions});
   }
 }
 
 void ExecutionState::popFrame(Thread &t) {
-  StackFrame &sf = t.stack.back();
+  StackFrame &sf = t.stack.mutate().back();
   for (std::vector<const MemoryObject*>::iterator it = sf.allocas.begin(), 
          ie = sf.allocas.end(); it != ie; ++it)
     addressSpace.unbindObject(*it);
@@ -410,7 +427,7 @@ void ExecutionState::popFrame(Thread &t) {
       t.isInLIBC = false;
     }
   }
-  t.stack.pop_back();
+  t.stack.mutate().pop_back();
 }
 
 /* Multithreading related function  */
@@ -21,6 +21,7 @@
 #include "SeedInfo.h"
 #include "SpecialFunctionHandler.h"
 #include "StatsTracker.h"
+#include "SolverWorkerPool.h"
 #include "TimingSolver.h"
 #include "UserSearcher.h"
 #include "ExecutorDebugHelper.h"
@@ -164,6 +165,15 @@ cl::opt<bool>
                                   "querying the solver (default=true)"),
                          cl::cat(SolvingCat));
 
+cl::opt<unsigned> SolverWorkers(
+    "solver-workers",
+    cl::desc("Number of branch queries of different states solved "
+             "concurrently in forked processes while exploring. Disables "
+             "--use-forked-solver. Not used when replaying or seeding "
+             "(default=0, solve synchronously)"),
+    cl::init(0),
+    cl::cat(SolvingCat));
+
 
 /*** External call policy options ***/
 
@@ -418,6 +428,24 @@ cl::opt<bool>
     CallSolver("call-solver", cl::init(true),
                cl::desc("Call solver at Executor::fork. (default=true)"),
                cl::cat(HASECat));
+cl::opt<bool> TrustTrace(
+    "trust-trace", cl::init(false),
+    cl::desc("When replaying a path, take the recorded direction of symbolic "
+             "branches without calling the solver, and check that they are "
+             "feasible in batches (default=false)"),
+    cl::cat(HASECat));
+cl::opt<unsigned> TrustTraceBatch(
+    "trust-trace-batch", cl::init(64),
+    cl::desc("Check the feasibility of trusted branches every that many "
+             "branches, 0 to only check them when the path ends "
+             "(default=64)"),
+    cl::cat(HASECat));
+cl::opt<std::string> TrustTraceInterval(
+    "trust-trace-interval",
+    cl::desc("Also check the feasibility of trusted branches when that much "
+             "time has passed since the last check. Set to 0s to disable "
+             "(default=0s)"),
+    cl::cat(HASECat));
 cl::opt<bool>
     DoOutofBoundaryCheck("oob-check", cl::init(true),
                          cl::desc("Disable out of boundary check during memory "
@@ -457,6 +485,11 @@ cl::opt<unsigned>
                    cl::desc("How frequent (every n seconds) klee should print "
                             "execution info. (default=300)"),
                    cl::cat(HASECat));
+cl::opt<unsigned> ReplayBookkeepingInterval(
+    "replay-bookkeeping-interval", cl::init(1024),
+    cl::desc("When replaying a single state, check the report interval and "
+             "state dump requests every n instructions only (default=1024)"),
+    cl::cat(HASECat));
 } // namespace
 
 namespace klee {
@@ -499,7 +532,7 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
       pathWriter(0), pathDataRecWriter(0), symPathWriter(0),
       stackPathWriter(0), consPathWriter(0), statsPathWriter(0),
       specialFunctionHandler(0), timers{time::Span(TimerInterval)},
-      replayKTest(0), oracle_eval(0), replayPath(0), usingSeeds(0),
+      replayKTest(0), oracle_eval(0), usingSeeds(0),
       atMemoryLimit(false), inhibitForking(false), haltExecution(false),
       ivcEnabled(false), debugLogBuffer(debugBufferString), info_requested(false) {
 
@@ -511,7 +544,12 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
       }));
 
   coreSolverTimeout = time::Span{MaxCoreSolverTime};
+  trustedBranchCheckInterval = time::Span{TrustTraceInterval};
+  lastTrustedBranchCheck = time::getWallTime();
   if (coreSolverTimeout) UseForkedCoreSolver = true;
+  // Solver workers already run in their own process and handle timeouts.
+  // Concurrent forked core solvers would also share one result buffer.
+  if (SolverWorkers) UseForkedCoreSolver = false;
   Solver *coreSolver = klee::createCoreSolver(CoreSolverToUse);
   if (!coreSolver) {
     klee_error("Failed to create core solver\n");
@@ -522,9 +560,12 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
       interpreterHandler->getOutputFilename(ALL_QUERIES_SMT2_FILE_NAME),
       interpreterHandler->getOutputFilename(SOLVER_QUERIES_SMT2_FILE_NAME),
       interpreterHandler->getOutputFilename(ALL_QUERIES_KQUERY_FILE_NAME),
-      interpreterHandler->getOutputFilename(SOLVER_QUERIES_KQUERY_FILE_NAME));
+      interpreterHandler->getOutputFilename(SOLVER_QUERIES_KQUERY_FILE_NAME),
+      interpreterHandler->getOutputFilename(QUERY_CACHE_FILE_NAME));
 
   this->solver = new TimingSolver(solver, EqualitySubstitution);
+  if (SolverWorkers)
+    solverPool.reset(new SolverWorkerPool(this->solver, SolverWorkers));
 
   if (OracleKTest != "") {
     oracle_eval = new OracleEvaluator(OracleKTest);
@@ -640,6 +681,7 @@ Executor::setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
 }
 
 Executor::~Executor() {
+  solverPool.reset();
   delete memory;
   delete externalDispatcher;
   delete specialFunctionHandler;
@@ -997,6 +1039,9 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
   std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it =
     seedMap.find(&current);
   bool isSeeding = it != seedMap.end();
+  // the recorded direction of a symbolic branch is taken without a query
+  bool trusted = TrustTrace && replayTrie && !isSeeding && !isInternal &&
+                 current.shouldRecord();
 
   // When (!isSeeding), the condition is non-constant, and states already forked
   // exceed configured threshold (forked too many || solver costs too many time, etc.):
@@ -1031,7 +1076,20 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
     }
   }
 
-  if (CallSolver || !current.shouldRecord() || isInternal) {
+  auto prefetched = prefetchedValidity.find(&current);
+  if (prefetched != prefetchedValidity.end() &&
+      prefetched->second.condition == condition) {
+    // solved by a solver worker while current was suspended
+    bool success = prefetched->second.success;
+    res = prefetched->second.validity;
+    prefetchedValidity.erase(prefetched);
+    if (!success) {
+      current.pc() = current.prevPC();
+      terminateStateEarly(current, "Query timed out (fork).");
+      return StatePair(0, 0);
+    }
+  } else if ((CallSolver && !trusted) || !current.shouldRecord() ||
+             isInternal) {
     time::Span timeout = coreSolverTimeout;
     time::Span fork_queryCost_begin = current.queryCost;
     if (isSeeding)
@@ -1063,7 +1121,7 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
   ref<Expr> new_constraint;
   if (!isSeeding) {
     // replaying, read recorded branch condition
-    if (replayPath && !isInternal) {
+    if (replayTrie && !isInternal) {
       if (res==Solver::True) { // Concrete branch
         if (current.shouldRecord()) {
           AssertNextBranchTaken(current, true);
@@ -1078,6 +1136,8 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
         assert(current.isInUserMain && "We assumed that during replay, uClibc doesn't need recorded path, wrong!");
         assert(!current.isInPOSIX() && "We assumed that no constraints will be added inside POSIX runtime, wrong!");
         getNextBranchConstraint(current, condition, new_constraint, res);
+        if (trusted)
+          trustBranch(current, new_constraint);
       }
     } else if (res==Solver::Unknown) {
       assert(!replayKTest && "in replay mode, only one branch can be true.");
@@ -1159,6 +1219,8 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
         terminateStateOnError(current, "add a invalid constraint", Abort);
       }
     }
+    if (isTrustedBranchCheckDue(current) && !checkTrustedBranches(current))
+      return StatePair(0, 0);
     if (res == Solver::True) {
       return StatePair(&current, 0);
     }
@@ -1169,7 +1231,7 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
     // res is still Solver::Unknown in this branch, which means current state
     // should fork here.
     ExecutionState *falseState, *trueState = &current;
-    if (replayPath) {
+    if (replayTrie) {
       klee_warning("ExecutionState forks in replay mode:");
       current.dumpStack();
     }
@@ -1321,8 +1383,9 @@ const Cell& Executor::eval(KInstruction *ki, unsigned index,
     return kmodule->constantTable[index];
   } else {
     unsigned index = vnumber;
-    StackFrame &sf = state.stack().back();
-    return sf.locals[index];
+    // reading through the const stack does not copy a shared frame
+    const ExecutionState &cs = state;
+    return (*cs.stack().back().locals)[index];
   }
 }
 
@@ -1481,7 +1544,42 @@ void Executor::printDebugInstructions(ExecutionState &state) {
   }
 }
 
+void Executor::splitReplay(ExecutionState &state) {
+  while (replayTrie->hasDiverged(state.replayNode, state.replayPosition)) {
+    const std::vector<unsigned> &children =
+        replayTrie->getChildren(state.replayNode);
+    if (state.replayPosition > replayTrie->getEnd(state.replayNode)) {
+      // an instruction read several entries, the diverging one included,
+      // from the trace of the first child
+      klee_warning("replay: %zu traces diverging within an instruction at "
+                   "%zu are not replayed",
+                   children.size() - 1, replayTrie->getEnd(state.replayNode));
+      state.replayNode = children.front();
+      continue;
+    }
+
+    klee_message("replay: %zu traces diverge at %u", children.size(),
+                 state.replayPosition);
+    for (size_t i = 1; i < children.size(); ++i) {
+      ++stats::forks;
+      ExecutionState *ns = state.branch();
+      ns->replayNode = children[i];
+      addedStates.push_back(ns);
+      processTree->attach(state.ptreeNode, ns, &state);
+      if (symPathWriter)
+        ns->symPathOS = symPathWriter->open(state.symPathOS);
+    }
+    state.replayNode = children.front();
+  }
+}
+
 void Executor::stepInstruction(ExecutionState &state) {
+  // traces are split between instructions, before reading their first
+  // diverging entry
+  if (replayTrie && replayTrie->hasDiverged(state.replayNode,
+                                            state.replayPosition))
+    splitReplay(state);
+
   printDebugInstructions(state);
   if (statsTracker)
     statsTracker->stepInstruction(state);
@@ -1526,6 +1624,37 @@ static inline const llvm::fltSemantics *fpWidthToSemantics(unsigned width) {
   }
 }
 
+void Executor::executeMemoryIntrinsic(ExecutionState &state,
+                                      KInstruction *ki, Function *f,
+                                      std::vector<ref<Expr>> &arguments) {
+  const char *name;
+  switch (f->getIntrinsicID()) {
+  case Intrinsic::memcpy: name = "memcpy"; break;
+  case Intrinsic::memmove: name = "memmove"; break;
+  default: name = "memset"; break;
+  }
+  // declared by IntrinsicCleanerPass, so that the routine is linked in
+  Function *routine = kmodule->module->getFunction(name);
+  assert(routine && "memory routine not declared");
+
+  // drop the alignment and volatile operands, and pass the value of memset
+  // and the length with the widths of the routine parameters
+  FunctionType *type = routine->getFunctionType();
+  std::vector<ref<Expr>> routineArguments;
+  for (unsigned i = 0; i < 3; ++i) {
+    ref<Expr> arg = arguments[i];
+    if (i < type->getNumParams()) {
+      Expr::Width width = getWidthForLLVMType(type->getParamType(i));
+      if (width > arg->getWidth())
+        arg = ZExtExpr::create(arg, width);
+      else if (width < arg->getWidth())
+        arg = ExtractExpr::create(arg, 0, width);
+    }
+    routineArguments.push_back(arg);
+  }
+  executeCall(state, ki, routine, routineArguments);
+}
+
 void Executor::executeCall(ExecutionState &state,
                            KInstruction *ki,
                            Function *f,
@@ -1601,6 +1730,12 @@ void Executor::executeCall(ExecutionState &state,
       // with va_end, however (like call it twice).
       break;
 
+    case Intrinsic::memcpy:
+    case Intrinsic::memmove:
+    case Intrinsic::memset:
+      executeMemoryIntrinsic(state, ki, f, arguments);
+      return;
+
     case Intrinsic::vacopy:
       // va_copy should have been lowered.
       //
@@ -1613,6 +1748,10 @@ void Executor::executeCall(ExecutionState &state,
     if (InvokeInst *ii = dyn_cast<InvokeInst>(I))
       transferToBasicBlock(ii->getNormalDest(), I->getParent(), state);
   } else {
+    if (isa<CallInst>(ki->inst) &&
+        specialFunctionHandler->handleNative(state, f, ki, arguments))
+      return;
+
     // Check if maximum stack size was reached.
     // We currently only count the number of stack frames
     if (RuntimeMaxStackFrames && state.stack().size() > RuntimeMaxStackFrames) {
@@ -1795,40 +1934,10 @@ void Executor::transferToBasicBlock(const BasicBlock *dst, BasicBlock *src,
   }
 }
 
-/// Compute the true target of a function call, resolving LLVM aliases
-/// and bitcasts.
-Function* Executor::getTargetFunction(Value *calledVal, ExecutionState &state) {
-  SmallPtrSet<const GlobalValue*, 3> Visited;
-
-  Constant *c = dyn_cast<Constant>(calledVal);
-  if (!c)
-    return 0;
-
-  while (true) {
-    if (GlobalValue *gv = dyn_cast<GlobalValue>(c)) {
-      if (!Visited.insert(gv).second)
-        return 0;
-
-      if (Function *f = dyn_cast<Function>(gv))
-        return f;
-      else if (GlobalAlias *ga = dyn_cast<GlobalAlias>(gv))
-        c = ga->getAliasee();
-      else
-        return 0;
-    } else if (llvm::ConstantExpr *ce = dyn_cast<llvm::ConstantExpr>(c)) {
-      if (ce->getOpcode()==Instruction::BitCast)
-        c = ce->getOperand(0);
-      else
-        return 0;
-    } else
-      return 0;
-  }
-}
-
 void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   Instruction *i = ki->inst;
   ++ki->frequency;
-  switch (i->getOpcode()) {
+  switch (ki->opcode) {
     // Control flow
   case Instruction::Ret: {
     ReturnInst *ri = cast<ReturnInst>(i);
@@ -1867,11 +1976,10 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       }
 
       if (!isVoidReturn) {
-        Type *t = caller->getType();
-        if (t != Type::getVoidTy(i->getContext())) {
+        if (kcaller->width) {
           // may need to do coercion due to bitcasts
           Expr::Width from = result->getWidth();
-          Expr::Width to = getWidthForLLVMType(t);
+          Expr::Width to = kcaller->width;
 
           if (from != to) {
             CallSite cs = (isa<InvokeInst>(caller) ? CallSite(cast<InvokeInst>(caller)) :
@@ -1916,6 +2024,10 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
       cond = optimizer.optimizeExpr(cond, false);
 
+      // a suspended branch is executed again, and counted then
+      if (suspendForSolverWorker(state, cond))
+        break;
+
       if (isa<ConstantExpr>(cond))
         ++stats::concreteBr;
       else
@@ -2017,7 +2129,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
           "Can't find this concrete basicblock address, it may never exist or it is unfeasible");
       if (state.shouldRecord()) { // need to consider record/replay
         PathEntry pe;
-        if (replayPath) {
+        if (replayTrie) {
           // replaying, check
           getNextPathEntry(state, pe);
           assert((pe.t == PathEntry::INDIRECTBR) &&
@@ -2037,7 +2149,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     // symbolic address
     std::vector<ExecutionState *> branches;
-    if (state.shouldRecord() && replayPath) {
+    if (state.shouldRecord() && replayTrie) {
       PathEntry pe;
       getNextPathEntry(state, pe);
       assert((pe.t == PathEntry::INDIRECTBR) &&
@@ -2150,7 +2262,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     }
     assert(BBindex2bb.size() == bbindex);
 
-    if (state.shouldRecord() && replayPath) {
+    if (state.shouldRecord() && replayTrie) {
       ; // replaying, do not try to simplify cond
     }
     else {
@@ -2175,7 +2287,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 #endif
       if (state.shouldRecord()) { // need to consider record/replay
         PathEntry pe;
-        if (replayPath) { // replaying
+        if (replayTrie) { // replaying
           getNextPathEntry(state, pe);
           assert((pe.t == PathEntry::SWITCH_EXPIDX) && "When replaying Instruction::Switch concrete condition, wrong PathEntry Type");
           assert((pe.body.switchIndex == exp_idx) && "When replaying Instruction::Switch concrete condition, recorded index mismatch");
@@ -2222,7 +2334,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       std::vector<ref<Expr>> conditions;
       // used to store the forked state(s) returned by Executor::branch
       std::vector<ExecutionState*> branches;
-      if (state.shouldRecord() && replayPath) {
+      if (state.shouldRecord() && replayTrie) {
         // replay
         PathEntry pe;
         getNextPathEntry(state, pe);
@@ -2338,25 +2450,20 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::Call: {
     TimerStatIncrementer time(stats::callTime);
     // Ignore debug intrinsic calls
-    if (isa<DbgInfoIntrinsic>(i))
+    if (ki->callKind == KInstruction::DebugIntrinsic)
       break;
     CallSite cs(i);
 
     unsigned numArgs = cs.arg_size();
     Value *fp = cs.getCalledValue();
 
-    if (llvm::InlineAsm *AI = dyn_cast<llvm::InlineAsm>(fp)) {
-      if (AI->getAsmString() == "ptwrite $0") {
-        llvm::Instruction *recI = dyn_cast<llvm::Instruction>(i->getOperand(0));
-        assert(recI != nullptr);
-        KInstruction *recKI = kmodule->getKInstruction(recI);
-        assert(recKI != nullptr);
-
-        tryLoadDataRecording(state, recKI);
-        tryStoreDataRecording(state, recKI);
+    if (ki->callKind != KInstruction::Call) {
+      if (ki->callKind == KInstruction::PTWrite) {
+        tryLoadDataRecording(state, ki->recorded);
+        tryStoreDataRecording(state, ki->recorded);
         break;
       }
-      else if (AI->getAsmString() == "tag") {
+      else if (ki->callKind == KInstruction::Tag) {
         uint64_t mcnt = stats::instMain;
         uint64_t lcnt = stats::instLibc;
         uint64_t pcnt = stats::instPosix;
@@ -2381,7 +2488,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       break;
     }
 
-    Function *f = getTargetFunction(fp, state);
+    Function *f = ki->callee;
 
     // evaluate arguments
     std::vector< ref<Expr> > arguments;
@@ -2762,38 +2869,32 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     // Conversion
   case Instruction::Trunc: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = ExtractExpr::create(eval(ki, 0, state).value,
-                                           0,
-                                           getWidthForLLVMType(ci->getType()));
+    ref<Expr> result = ExtractExpr::create(eval(ki, 0, state).value, 0,
+                                           ki->width);
     bindLocal(ki, state, result);
     break;
   }
   case Instruction::ZExt: {
-    CastInst *ci = cast<CastInst>(i);
     ref<Expr> result = ZExtExpr::create(eval(ki, 0, state).value,
-                                        getWidthForLLVMType(ci->getType()));
+                                        ki->width);
     bindLocal(ki, state, result);
     break;
   }
   case Instruction::SExt: {
-    CastInst *ci = cast<CastInst>(i);
     ref<Expr> result = SExtExpr::create(eval(ki, 0, state).value,
-                                        getWidthForLLVMType(ci->getType()));
+                                        ki->width);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::IntToPtr: {
-    CastInst *ci = cast<CastInst>(i);
-    Expr::Width pType = getWidthForLLVMType(ci->getType());
+    Expr::Width pType = ki->width;
     ref<Expr> arg = eval(ki, 0, state).value;
     bindLocal(ki, state, ZExtExpr::create(arg, pType));
     break;
   }
   case Instruction::PtrToInt: {
-    CastInst *ci = cast<CastInst>(i);
-    Expr::Width iType = getWidthForLLVMType(ci->getType());
+    Expr::Width iType = ki->width;
     ref<Expr> arg = eval(ki, 0, state).value;
     bindLocal(ki, state, ZExtExpr::create(arg, iType));
     break;
@@ -2882,8 +2983,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPTrunc: {
-    FPTruncInst *fi = cast<FPTruncInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > arg->getWidth())
@@ -2899,8 +2999,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPExt: {
-    FPExtInst *fi = cast<FPExtInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                         "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || arg->getWidth() > resultType)
@@ -2915,8 +3014,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPToUI: {
-    FPToUIInst *fi = cast<FPToUIInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
@@ -2937,8 +3035,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPToSI: {
-    FPToSIInst *fi = cast<FPToSIInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
@@ -2959,8 +3056,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::UIToFP: {
-    UIToFPInst *fi = cast<UIToFPInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                        "floating point");
     const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
@@ -2975,8 +3071,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::SIToFP: {
-    SIToFPInst *fi = cast<SIToFPInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                        "floating point");
     const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
@@ -3105,7 +3200,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     ref<Expr> agg = eval(ki, 0, state).value;
 
-    ref<Expr> result = ExtractExpr::create(agg, kgepi->offset*8, getWidthForLLVMType(i->getType()));
+    ref<Expr> result = ExtractExpr::create(agg, kgepi->offset*8, ki->width);
 
     bindLocal(ki, state, result);
     break;
@@ -3206,6 +3301,11 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 void Executor::updateStates(ExecutionState *current) {
   if (searcher) {
     searcher->update(current, addedStates, removedStates);
+    if (!suspendedStates.empty()) {
+      searcher->update(nullptr, std::vector<ExecutionState *>(),
+                       suspendedStates);
+      suspendedStates.clear();
+    }
   }
 
   states.insert(addedStates.begin(), addedStates.end());
@@ -3222,6 +3322,7 @@ void Executor::updateStates(ExecutionState *current) {
       seedMap.find(es);
     if (it3 != seedMap.end())
       seedMap.erase(it3);
+    prefetchedValidity.erase(es);
     processTree->remove(es->ptreeNode);
     delete es;
   }
@@ -3350,6 +3451,79 @@ void Executor::doDumpStates() {
   updateStates(nullptr);
 }
 
+bool Executor::suspendForSolverWorker(ExecutionState &state,
+                                      ref<Expr> condition) {
+  if (!solverPool || !searcher || solverPool->full() ||
+      isa<ConstantExpr>(condition) || replayTrie || replayKTest ||
+      !seedMap.empty() || !(CallSolver || !state.shouldRecord()))
+    return false;
+  auto prefetched = prefetchedValidity.find(&state);
+  if (prefetched != prefetchedValidity.end() &&
+      prefetched->second.condition == condition)
+    return false;
+  if (!solverPool->dispatch(state, condition, coreSolverTimeout))
+    return false;
+  // execute the branch again once the query is solved
+  state.pc() = state.prevPC();
+  suspendedStates.push_back(&state);
+  return true;
+}
+
+void Executor::resumeSuspendedStates(bool wait) {
+  std::vector<SolverWorkerPool::Result> results;
+  solverPool->collect(results, wait);
+  if (results.empty())
+    return;
+  std::vector<ExecutionState *> resumed;
+  for (auto &r : results) {
+    resumed.push_back(r.state);
+    prefetchedValidity.erase(r.state);
+    prefetchedValidity.insert(std::make_pair(r.state, r));
+  }
+  searcher->update(nullptr, resumed, std::vector<ExecutionState *>());
+}
+
+void Executor::printInfoIfDue(time::Point &lastReportT) {
+  // default report interval is 5 mins
+  time::Point nowT = time::getWallTime();
+  time::Span elapsed = nowT - lastReportT;
+  if (elapsed.toSeconds() >= ReportInterval) {
+    lastReportT = nowT;
+    info_requested = true;
+  }
+  if (info_requested) {
+    info_requested = false;
+    printInfo(llvm::errs());
+  }
+}
+
+void Executor::runReplay(ExecutionState &state, time::Point &lastReportT) {
+  const unsigned interval = std::max(1U, unsigned(ReplayBookkeepingInterval));
+  unsigned untilBookkeeping = interval;
+  while (!haltExecution) {
+    KInstruction *ki = state.pc();
+    stepInstruction(state);
+
+    executeInstruction(state, ki);
+    // Each instruction takes one unit of time
+    state.stateTime++;
+
+    if (!addedStates.empty() || !removedStates.empty()) {
+      // the state forked or terminated, the searcher takes over
+      updateStates(&state);
+      return;
+    }
+    if (checkpointEntries || checkpointInterval)
+      checkpointIfDue();
+    if (--untilBookkeeping == 0) {
+      untilBookkeeping = interval;
+      if (::dumpStates) dumpStates();
+      if (::dumpPTree) dumpPTree();
+      printInfoIfDue(lastReportT);
+    }
+  }
+}
+
 void Executor::run(ExecutionState &initialState) {
   bindModuleConstants();
 
@@ -3431,26 +3605,38 @@ void Executor::run(ExecutionState &initialState) {
   interpreterHandler->getInfoStream()
       << "Executor run started: "
       << std::asctime(std::localtime(&startT_time_t)) << '\n';
+  setupCheckpoints();
   time::Point lastReportT = time::getWallTime();
   while (!states.empty() && !haltExecution) {
-    // default report interval is 5 mins
-    time::Point nowT = time::getWallTime();
-    time::Span elapsed = nowT - lastReportT;
-    if (elapsed.toSeconds() >= ReportInterval) {
-      lastReportT = nowT;
-      info_requested = true;
-    }
-    if (info_requested) {
-      info_requested = false;
-      printInfo(llvm::errs());
+    printInfoIfDue(lastReportT);
+    // a replay down to one state, at the start or once the others have
+    // terminated, goes back to the fast loop
+    if (replayTrie && states.size() == 1) {
+      runReplay(**states.begin(), lastReportT);
+      continue;
     }
+    if (solverPool)
+      resumeSuspendedStates(searcher->empty());
     ExecutionState &state = searcher->selectState();
+    if (solverPool && solverPool->isRunning(state)) {
+      // searchers walking the process tree may still pick suspended states
+      resumeSuspendedStates(true);
+      continue;
+    }
     KInstruction *ki = state.pc();
-    stepInstruction(state);
+    // the branch was already stepped before the state got suspended
+    bool resumed = prefetchedValidity.count(&state);
+    if (resumed) {
+      state.prevPC() = state.pc();
+      ++state.pc();
+    } else {
+      stepInstruction(state);
+    }
 
     executeInstruction(state, ki);
     // Each instruction takes one unit of time
-    state.stateTime++;
+    if (!resumed)
+      state.stateTime++;
     //timers.invoke();
     if (::dumpStates) dumpStates();
     if (::dumpPTree) dumpPTree();
@@ -3458,6 +3644,14 @@ void Executor::run(ExecutionState &initialState) {
     //checkMemoryUsage();
 
     updateStates(&state);
+    if (checkpointEntries || checkpointInterval)
+      checkpointIfDue();
+  }
+
+  if (solverPool) {
+    // suspended states stay in `states`, at the branch they were querying
+    std::vector<ExecutionState *> cancelled;
+    solverPool->cancelAll(cancelled);
   }
 
   delete searcher;
@@ -3561,6 +3755,8 @@ void Executor::terminateStateEarly(ExecutionState &state,
 }
 
 void Executor::terminateStateOnExit(ExecutionState &state) {
+  if (!checkTrustedBranches(state))
+    return;
   if (!OnlyOutputStatesCoveringNew || state.coveredNew ||
       (AlwaysOutputSeeds && seedMap.count(&state)))
     interpreterHandler->processTestCase(state, /*getSymbolicSolution*/ true, 0,
@@ -3815,7 +4011,7 @@ void Executor::callExternalFunction(ExecutionState &state,
 ref<Expr> Executor::replaceReadWithSymbolic(ExecutionState &state,
                                             ref<Expr> e) {
   unsigned n = interpreterOpts.MakeConcreteSymbolic;
-  if (!n || replayKTest || replayPath)
+  if (!n || replayKTest || replayTrie)
     return e;
 
   // right now, we don't replace symbolics (is there any reason to?)
@@ -4100,7 +4296,7 @@ void Executor::executeMemoryOperation(ExecutionState &state, bool isWrite,
                                       bool force /* overwrite RO */) {
   TimerStatIncrementer timerS1(stats::executeMemopTimeS1);
   Expr::Width type = (isWrite ? value->getWidth() :
-                     getWidthForLLVMType(target->inst->getType()));
+                     target->width);
   unsigned bytes = Expr::getMinBytesForWidth(type);
 
   if (SimplifySymIndices) {
@@ -4277,7 +4473,7 @@ void Executor::executeMakeSymbolic(ExecutionState &state,
     // or if that fails try adding a unique identifier.
     unsigned id = 0;
     std::string uniqueName = name;
-    while (!state.arrayNames.insert(uniqueName).second) {
+    while (!state.arrayNames.mutate().insert(uniqueName).second) {
       uniqueName = name + "_" + llvm::utostr(++id);
     }
     const Array *array = arrayCache.CreateArray(uniqueName, mo->size);
@@ -4444,6 +4640,7 @@ void Executor::runFunctionAsMain(Function *f,
   }
 
   initializeGlobals(*state);
+  resumeFromCheckpoint(*state);
 
   processTree = std::make_unique<PTree>(state);
   run(*state);
@@ -4491,6 +4688,11 @@ unsigned Executor::getStatsPathStreamID(const ExecutionState &state) {
   return state.statsPathOS.getID();
 }
 
+unsigned Executor::getReplayPathIndex(const ExecutionState &state) {
+  assert(replayTrie);
+  return replayTrie->getTraceIndex(state.replayNode);
+}
+
 void Executor::getConstraintLog(const ExecutionState &state, std::string &res,
                                 Interpreter::LogType logFormat) {
 
@@ -4513,8 +4715,8 @@ void Executor::getConstraintLog(const ExecutionState &state, std::string &res,
     const Array* const *evalArraysEnd = 0;
     
     std::vector<const Array*> objects;
-    for (unsigned i = 0; i != state.symbolics.size(); ++i)
-      objects.push_back(state.symbolics[i].second);
+    for (unsigned i = 0; i != state.symbolics->size(); ++i)
+      objects.push_back((*state.symbolics)[i].second);
 
     if (!objects.empty()) {
         evalArraysBegin = &(objects[0]);
@@ -4559,8 +4761,8 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
   // the preferred constraints.  See test/Features/PreferCex.c for
   // an example) While this process can be very expensive, it can
   // also make understanding individual test cases much easier.
-  for (unsigned i = 0; i != state.symbolics.size(); ++i) {
-    const auto &mo = state.symbolics[i].first;
+  for (unsigned i = 0; i != state.symbolics->size(); ++i) {
+    const auto &mo = (*state.symbolics)[i].first;
     std::vector< ref<Expr> >::const_iterator pi =
       mo->cexPreferences.begin(), pie = mo->cexPreferences.end();
     for (; pi != pie; ++pi) {
@@ -4582,8 +4784,8 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
 
   std::vector< std::vector<unsigned char> > values;
   std::vector<const Array*> objects;
-  for (unsigned i = 0; i != state.symbolics.size(); ++i)
-    objects.push_back(state.symbolics[i].second);
+  for (unsigned i = 0; i != state.symbolics->size(); ++i)
+    objects.push_back((*state.symbolics)[i].second);
   bool success = solver->getInitialValues(tmp, objects, values);
   solver->setTimeout(time::Span());
   if (!success) {
@@ -4596,14 +4798,14 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
     return false;
   }
 
-  for (unsigned i = 0; i != state.symbolics.size(); ++i)
-    res.push_back(std::make_pair(state.symbolics[i].first->name, values[i]));
+  for (unsigned i = 0; i != state.symbolics->size(); ++i)
+    res.push_back(std::make_pair((*state.symbolics)[i].first->name, values[i]));
   return true;
 }
 
 void Executor::getCoveredLines(const ExecutionState &state,
                                std::map<const std::string*, std::set<unsigned> > &res) {
-  res = state.coveredLines;
+  res = *state.coveredLines;
 }
 
 void Executor::doImpliedValueConcretization(ExecutionState &state,
@@ -4737,8 +4939,8 @@ void Executor::printInfo(llvm::raw_ostream &os) {
   unsigned int i=0;
   for (auto s: states) {
     msg_oss << "================ ExecutionState: " << i << '\n'
-       << "  ReplayPosition: " << (replayPath?std::to_string(s->replayPosition):"N/A")
-         << " / " << (replayPath?std::to_string(replayPath->size()):"N/A") << '\n'
+       << "  ReplayPosition: " << (replayTrie?std::to_string(s->replayPosition):"N/A")
+         << " / " << (replayTrie?std::to_string(getReplayPathSize(*s)):"N/A") << '\n'
        << "  Stack:\n";
     s->dumpStack(msg_oss);
     if (DebugDumpKQuery) {
@@ -4817,6 +5019,42 @@ void Executor::record1BitAtFork(ExecutionState &current, Solver::Validity solval
   }
 }
 
+bool Executor::canTakeConcreteBranches(const ExecutionState &state,
+                                       const std::vector<bool> &branches) {
+  if (!replayTrie || branches.empty())
+    return true;
+  // the traces must not diverge before the last branch is read
+  size_t end = state.replayPosition + branches.size();
+  if (!replayTrie->getChildren(state.replayNode).empty() &&
+      replayTrie->getEnd(state.replayNode) < end)
+    return false;
+  PathEntryReader *path = replayTrie->getTrace(state.replayNode).path;
+  for (size_t i = 0; i != branches.size(); ++i) {
+    PathEntry pe;
+    // a mismatch is reported by executing the body
+    if (!path->read(state.replayPosition + i, pe) ||
+        pe.t != PathEntry::FORK || pe.body.br != branches[i])
+      return false;
+  }
+  return true;
+}
+
+void Executor::takeConcreteBranches(ExecutionState &state,
+                                    const std::vector<bool> &branches) {
+  if (branches.empty())
+    return;
+  if (replayTrie)
+    state.replayPosition += branches.size();
+  for (bool br : branches) {
+    record1BitAtFork(state, br ? Solver::True : Solver::False);
+    ++state.nbranches_rec;
+    dumpStateAtFork(state, ref<Expr>());
+  }
+  stats::concreteBr += branches.size();
+  if (isTrustedBranchCheckDue(state))
+    checkTrustedBranches(state);
+}
+
 void Executor::dumpPTree() {
   if (!::dumpPTree) return;
 
@@ -4899,13 +5137,16 @@ void Executor::AssertNextBranchTaken(ExecutionState &state, bool br) {
     klee_error("Wrong PathEntry_t during asserting next branch");
   }
   if (br != recorded_br) {
+    // more likely caused by an infeasible trusted branch
+    if (!checkTrustedBranches(state))
+      return;
     std::string constraints;
     getConstraintLog(state, constraints, Interpreter::KQUERY);
     auto f = interpreterHandler->openOutputFile("debugKQuery");
     if (f) {
       *f << constraints;
     }
-    klee_message("replay: %d/%lu runtime: %d recorded: %d, stack:\n", state.replayPosition-1, replayPath->size(), br, recorded_br);
+    klee_message("replay: %d/%lu runtime: %d recorded: %d, stack:\n", state.replayPosition-1, getReplayPathSize(state), br, recorded_br);
     state.dumpStack(llvm::errs());
     terminateStateOnError(state, "hit invalid branch in replay path mode", ReplayPath);
   }
@@ -4923,6 +5164,97 @@ void Executor::getNextBranchConstraint(ExecutionState &state, ref<Expr> conditio
   }
 }
 
+void Executor::trustBranch(ExecutionState &state, ref<Expr> constraint) {
+  if (state.uncheckedBranches.empty())
+    state.checkedConstraints = state.constraints;
+  state.uncheckedBranches.push_back(
+      {state.replayPosition - 1, state.prevPC(), constraint});
+  ++stats::trustedBranches;
+}
+
+bool Executor::isTrustedBranchCheckDue(const ExecutionState &state) {
+  if (state.uncheckedBranches.empty())
+    return false;
+  if (TrustTraceBatch && state.uncheckedBranches.size() >= TrustTraceBatch)
+    return true;
+  return trustedBranchCheckInterval &&
+         time::getWallTime() - lastTrustedBranchCheck >=
+             trustedBranchCheckInterval;
+}
+
+bool Executor::checkTrustedBranches(ExecutionState &state) {
+  if (state.uncheckedBranches.empty())
+    return true;
+  lastTrustedBranchCheck = time::getWallTime();
+  std::vector<ExecutionState::TrustedBranch> branches;
+  branches.swap(state.uncheckedBranches);
+  ConstraintManager checked;
+  std::swap(checked, state.checkedConstraints);
+
+  auto conjunction = [&](size_t n) {
+    ref<Expr> conj = ConstantExpr::alloc(1, Expr::Bool);
+    for (size_t i = 0; i < n; ++i)
+      conj = AndExpr::create(conj, branches[i].constraint);
+    return conj;
+  };
+  auto timedOut = [&]() {
+    terminateStateEarly(state, "Query timed out (trusted branch check).");
+    return false;
+  };
+
+  // The branches are part of the constraints of the state already, this
+  // checks whether they are satisfiable.
+  ++stats::trustedBranchChecks;
+  bool feasible;
+  solver->setTimeout(coreSolverTimeout);
+  bool success = solver->mayBeTrue(state, state.constraints,
+                                   conjunction(branches.size()), feasible);
+  solver->setTimeout(time::Span());
+  if (!success)
+    return timedOut();
+  if (feasible)
+    return true;
+
+  // Find the first infeasible branch: the shortest prefix of the branches
+  // that contradicts the constraints from before the batch.
+  size_t lo = 0, hi = branches.size();
+  solver->setTimeout(coreSolverTimeout);
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    ++stats::trustedBranchChecks;
+    if (!solver->mayBeTrue(state, checked, conjunction(mid + 1), feasible)) {
+      solver->setTimeout(time::Span());
+      return timedOut();
+    }
+    if (feasible)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  solver->setTimeout(time::Span());
+
+  if (lo == branches.size()) {
+    // the branches only contradict constraints added along them
+    klee_message("replay: trusted branches at %u-%u/%lu contradict the "
+                 "constraints added along them",
+                 branches.front().replayPosition,
+                 branches.back().replayPosition, getReplayPathSize(state));
+    lo = branches.size() - 1;
+  } else {
+    klee_message("replay: trusted branch at %u/%lu is infeasible",
+                 branches[lo].replayPosition, getReplayPathSize(state));
+  }
+  const ExecutionState::TrustedBranch &branch = branches[lo];
+  std::string info;
+  llvm::raw_string_ostream os(info);
+  os << "replay position: " << branch.replayPosition << '\n'
+     << "branch: " << branch.kinst->getSourceLocation() << '\n'
+     << "constraint: " << branch.constraint << '\n';
+  terminateStateOnError(state, "infeasible branch in trusted replay path",
+                        ReplayPath, nullptr, os.str());
+  return false;
+}
+
 /*
  * try to load data for KInstruction KI from recorded data (do nothing if we are
  * not replaying)
@@ -4938,14 +5270,14 @@ void Executor::getNextBranchConstraint(ExecutionState &state, ref<Expr> conditio
  *   warning will be display.
  */
 bool Executor::tryLoadDataRecording(ExecutionState &state, KInstruction *KI) {
-  if (replayPath && replayDataRecEntries) {
+  if (replayTrie) {
     std::string uniqID = KI->getUniqueID();
     PathEntry pe;
-    DataRecEntry dre;
+    DataRecEntryRef dre;
     getNextPathEntry(state, pe);
     getNextDataRecEntry(state, dre);
     assert((pe.t == PathEntry::DATAREC) && "When try loading DataRecording, PathEntry Type mismatches");
-    assert((pe.body.drec.IDlen = uniqID.size()) && "When try loading DataRecording, uniqID length mismatches");
+    assert((dre.instUniqueID == uniqID) && "When try loading DataRecording, uniqID mismatches");
     ref<Expr> replayedValue = getDestCell(state, KI).value;
     ref<ConstantExpr> loadedValue = ConstantExpr::alloc(dre.data, pe.body.drec.width);
     if (!isa<ConstantExpr>(replayedValue)) {
@@ -5117,7 +5449,7 @@ bool Executor::schedule(ExecutionState &state, bool yield) {
     pe.body.tgtid = afterSchedule.first;
     state.pathOS << pe;
   }
-  if (replayPath) {
+  if (replayTrie) {
     PathEntry pe;
     getNextPathEntry(state, pe);
     assert(pe.t == PathEntry::SCHEDULE && "Wrong PathEntry_t during schedule");
@@ -5141,9 +5473,9 @@ void Executor::executeThreadCreate(ExecutionState &state, thread_id_t tid,
     if (find_it != kmodule->functionMap.end()) {
       KFunction *kf = find_it->second;
       Thread &t = state.createThread(tid, kf);
-      bindArgumentToPthreadCreate(kf, 0, t.stack.back(), arg);
+      bindArgumentToPthreadCreate(kf, 0, t.stack.mutate().back(), arg);
       if (statsTracker)
-        statsTracker->framePushed(state, &t.stack.back());
+        statsTracker->framePushed(state, &t.stack.mutate().back());
       return;
     }
   }
@@ -20,6 +20,7 @@
 #include "klee/Internal/Module/Cell.h"
 #include "klee/Internal/Module/KInstruction.h"
 #include "klee/Internal/Module/KModule.h"
+#include "klee/Internal/Support/PathReader.h"
 #include "klee/Internal/System/Time.h"
 #include "klee/Interpreter.h"
 #include "klee/util/OracleEvaluator.h"
@@ -30,6 +31,9 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include "../Expr/ArrayExprOptimizer.h"
+#include "Checkpoint.h"
+#include "ReplayTrie.h"
+#include "SolverWorkerPool.h"
 
 #include <map>
 #include <memory>
@@ -174,11 +178,11 @@ private:
   /// When non-null, this evaluator knows all inputs of symbolic objects
   OracleEvaluator *oracle_eval;
 
-  /// When non-null a list of branch decisions to be used for replay.
-  const std::vector<PathEntry> *replayPath;
-  const std::vector<DataRecEntry> *replayDataRecEntries;
+  /// When non-null the traces of branch decisions to be used for replay.
+  /// Entries are decoded lazily from the mapped trace files.
+  std::unique_ptr<ReplayTrie> replayTrie;
 
-  /// The index into the current \ref replayKTest or \ref replayPath
+  /// The index into the current \ref replayKTest or \ref replayTrie
   /// object. (moved inside ExecutionState, since we might replay multiple states at the same time)
   /// unsigned replayPosition;
 
@@ -230,13 +234,48 @@ private:
   /// `nullptr` if merging is disabled
   MergingSearcher *mergingSearcher = nullptr;
 
-  llvm::Function* getTargetFunction(llvm::Value *calledVal,
-                                    ExecutionState &state);
+  /// Solves branch queries of several states concurrently,
+  /// `nullptr` unless --solver-workers is set
+  std::unique_ptr<SolverWorkerPool> solverPool;
+
+  /// States which dispatched a query to \ref solverPool during the current
+  /// instruction step, to be removed from the searcher until it is solved.
+  std::vector<ExecutionState *> suspendedStates;
+
+  /// Results of \ref solverPool for resumed states, consumed by fork() when
+  /// the suspended branch is executed again.
+  std::map<ExecutionState *, SolverWorkerPool::Result> prefetchedValidity;
+
+  /// Numbers the module for checkpoints, built by the first one
+  std::unique_ptr<KModuleIndex> checkpointIndex;
+
+  /// Save a checkpoint of the replayed state every that many trace entries,
+  /// or when \ref checkpointInterval has elapsed. Both are zero unless
+  /// --checkpoint-every is set.
+  unsigned checkpointEntries = 0;
+  time::Span checkpointInterval;
+  unsigned lastCheckpointPosition = 0;
+  time::Point lastCheckpointTime;
+
+  /// Check trusted branches when that much time has passed since the last
+  /// check (--trust-trace-interval)
+  time::Span trustedBranchCheckInterval;
+  time::Point lastTrustedBranchCheck;
 
   void executeInstruction(ExecutionState &state, KInstruction *ki);
 
   void run(ExecutionState &initialState);
 
+  /// Step the single state of a replay without going through the searcher,
+  /// until it terminates or forks. run() enters it whenever a replay is
+  /// down to one state. The periodic work of the main loop is done every
+  /// --replay-bookkeeping-interval instructions.
+  void runReplay(ExecutionState &state, time::Point &lastReportT);
+
+  /// Print the execution info if --report-interval has passed since
+  /// `lastReportT` or if it was requested.
+  void printInfoIfDue(time::Point &lastReportT);
+
   // Given a concrete object in our [klee's] address space, add it to
   // objects checked code can reference.
   MemoryObject *addExternalObject(ExecutionState &state, void *addr,
@@ -249,6 +288,16 @@ private:
 
   void stepInstruction(ExecutionState &state);
   void updateStates(ExecutionState *current);
+
+  /// Dispatch the query for a symbolic branch of `state` to \ref solverPool
+  /// and suspend the state until it is solved, so that other states can run
+  /// meanwhile.
+  /// \return false if the branch must be executed right away
+  bool suspendForSolverWorker(ExecutionState &state, ref<Expr> condition);
+
+  /// Give states whose query was solved back to the searcher. If `wait` is
+  /// set, block until at least one query is solved.
+  void resumeSuspendedStates(bool wait);
   void transferToBasicBlock(const llvm::BasicBlock *dst,
 			    llvm::BasicBlock *src,
 			    ExecutionState &state);
@@ -318,6 +367,12 @@ private:
                    ref<Expr> address,
                    KInstruction *target = 0);
 
+  /// Execute a call to llvm.memcpy, llvm.memmove or llvm.memset as a call
+  /// to the routine implementing it.
+  void executeMemoryIntrinsic(ExecutionState &state, KInstruction *ki,
+                              llvm::Function *f,
+                              std::vector<ref<Expr>> &arguments);
+
   /// NOTE: ki could be null if this function call is "pthread_exit" created by
   /// the Instruction::Ret of a thread
   void executeCall(ExecutionState &state,
@@ -368,16 +423,16 @@ private:
   Cell& getArgumentCell(ExecutionState &state,
                         KFunction *kf,
                         unsigned index) {
-    return state.stack().back().locals[kf->getArgRegister(index)];
+    return state.stack().back().locals.mutate()[kf->getArgRegister(index)];
   }
 
   Cell& getArgumentCell(StackFrame &sf, KFunction *kf, unsigned index) {
-    return sf.locals[kf->getArgRegister(index)];
+    return sf.locals.mutate()[kf->getArgRegister(index)];
   }
 
   Cell& getDestCell(ExecutionState &state,
                     KInstruction *target) {
-    return state.stack().back().locals[target->dest];
+    return state.stack().back().locals.mutate()[target->dest];
   }
 
   void bindLocal(KInstruction *target,
@@ -448,6 +503,27 @@ private:
                                  const llvm::Twine &info="") {
     terminateStateOnError(state, message, Exec, NULL, info);
   }
+  /// Parse --checkpoint-every, called before the first instruction.
+  void setupCheckpoints();
+  /// Save a checkpoint of the replayed state if one is due.
+  void checkpointIfDue();
+  /// Write the state, its memory and the expressions it references to
+  /// replay.ckpt in the output directory.
+  void saveCheckpoint(const ExecutionState &state);
+  /// Overwrite a freshly initialized state with the checkpoint given by
+  /// --resume-from, if any.
+  void resumeFromCheckpoint(ExecutionState &state);
+
+  /// Queue the constraint of a symbolic branch taken from the replayed path
+  /// without a query (--trust-trace), for \ref checkTrustedBranches.
+  void trustBranch(ExecutionState &state, ref<Expr> constraint);
+  bool isTrustedBranchCheckDue(const ExecutionState &state);
+  /// Check that the unchecked trusted branches of the state are feasible, as
+  /// a single query. If they are not, find the first infeasible one by
+  /// bisection and terminate the state on it.
+  /// \return false if the state was terminated
+  bool checkTrustedBranches(ExecutionState &state);
+
   void exitOnSolverTimeout(ExecutionState &state, const llvm::Twine &message) {
     terminateStateOnError(state, message, Timeout);
     interpreterHandler->reportInEngineTime();
@@ -480,6 +556,15 @@ private:
   /// \param[in] solvalid The solver validity result (means "must be" True or False) returned from a solver query
   void record1BitAtFork(ExecutionState &current, Solver::Validity solvalid);
 
+  /// \return true if the replayed path of `state` continues with the
+  /// concrete `branches`, which are not executed but taken at once
+  bool canTakeConcreteBranches(const ExecutionState &state,
+                               const std::vector<bool> &branches);
+  /// Take the concrete `branches` of code executed natively at once, as
+  /// fork() does for each of them: record them, and advance the replay.
+  void takeConcreteBranches(ExecutionState &state,
+                            const std::vector<bool> &branches);
+
   static inline void getConstraintFromBool(ref<Expr> condition, ref<Expr> &new_constraint, Solver::Validity &res, bool br) {
     if (br) {
       res = Solver::True;
@@ -550,20 +635,27 @@ public:
   }
 
   void setReplayKTest(const struct KTest *out) override {
-    assert(!replayPath && "cannot replay both buffer and path");
+    assert(!replayTrie && "cannot replay both buffer and path");
     replayKTest = out;
   }
 
-  void setReplayPath(const std::vector<PathEntry> *path) override {
+  bool addReplayPath(PathEntryReader *path,
+                     DataRecEntryReader *datarec) override {
     assert(!replayKTest && "cannot replay both buffer and path");
-    replayPath = path;
+    if (!replayTrie)
+      replayTrie = std::make_unique<ReplayTrie>();
+    return replayTrie->addTrace(path, datarec);
   }
 
-  void setReplayDataRecEntries(const std::vector<DataRecEntry> *datarec) override {
-    assert(!replayKTest && "cannot replay both buffer and path");
-    replayDataRecEntries = datarec;
+  /// The number of entries of the trace replayed by `state`
+  size_t getReplayPathSize(const ExecutionState &state) const {
+    return replayTrie->getTrace(state.replayNode).path->size();
   }
 
+  /// Fork a state for each trace group diverging at the current replay
+  /// position, before the diverging entry is read.
+  void splitReplay(ExecutionState &state);
+
   /// Try load the value of a given KInstuction from recorded path file
   /// \param[out] true if given KInst is loaded successfully
   bool tryLoadDataRecording(ExecutionState &state, KInstruction *KI);
@@ -577,15 +669,19 @@ public:
 
   // Read next PathEntry using (and advancing) the cursor in state
   void getNextPathEntry(ExecutionState &state, PathEntry &pe) {
-    assert(replayPath && "Trying to get next PathEntry without a valud replayPath");
-    assert(state.replayPosition < replayPath->size() && "replayPath exhausts too early");
-    pe = (*replayPath)[state.replayPosition++];
+    assert(replayTrie && "Trying to get next PathEntry without a valud replayPath");
+    bool success __attribute__((unused)) =
+        replayTrie->getTrace(state.replayNode).path->read(
+            state.replayPosition++, pe);
+    assert(success && "replayPath exhausts too early");
   }
 
-  void getNextDataRecEntry(ExecutionState &state, DataRecEntry &dre) {
-    assert(replayDataRecEntries && "Trying to get next DataRecEntry without a valid replayDataRecEntries");
-    assert(state.replayDataRecEntriesPosition < replayDataRecEntries->size() && "replayDataRecEntries exhausts too early");
-    dre = (*replayDataRecEntries)[state.replayDataRecEntriesPosition++];
+  void getNextDataRecEntry(ExecutionState &state, DataRecEntryRef &dre) {
+    assert(replayTrie && "Trying to get next DataRecEntry without a valid replayDataRecEntries");
+    bool success __attribute__((unused)) =
+        replayTrie->getTrace(state.replayNode).dataRec->read(
+            state.replayDataRecEntriesPosition++, dre);
+    assert(success && "replayDataRecEntries exhausts too early");
   }
 
   llvm::Module *setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
@@ -626,6 +722,8 @@ public:
   
   unsigned getStatsPathStreamID(const ExecutionState &state) override;
 
+  unsigned getReplayPathIndex(const ExecutionState &state) override;
+
   void getConstraintLog(const ExecutionState &state, std::string &res,
                         Interpreter::LogType logFormat =
                             Interpreter::STP) override;
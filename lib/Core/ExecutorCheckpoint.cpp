@@ -0,0 +1,439 @@
+//===-- ExecutorCheckpoint.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Replay checkpoints: the replayed ExecutionState is saved with its memory
+// and the expressions it references, so that a replay that died (e.g. on a
+// solver timeout) can be resumed close to where it stopped.
+//
+// A checkpoint is restored into the initial state of a new run of the same
+// program, with the same arguments and options, after its globals have been
+// initialized. Objects allocated until then get the same addresses, so they
+// are matched by address with the objects of the checkpoint. The heaps of
+// the deterministic allocator are restored as a whole, so later allocations
+// get the addresses they would have had in the original run. External
+// objects (e.g. errno) are matched by address as well, which requires the
+// host libraries to be mapped at the same addresses (e.g. without ASLR).
+//
+//===----------------------------------------------------------------------===//
+
+#include "Executor.h"
+
+#include "Checkpoint.h"
+#include "Memory.h"
+#include "MemoryManager.h"
+#include "StatsTracker.h"
+
+#include "klee/ExecutorCmdLine.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/OptionCategories.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cinttypes>
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+cl::opt<std::string> CheckpointEvery(
+    "checkpoint-every",
+    cl::desc("Periodically save the replayed state to replay.ckpt, either "
+             "every N trace entries (e.g. 1000000) or every time span (e.g. "
+             "30min). Requires --allocate-determ (default=off)"),
+    cl::cat(HASECat));
+
+cl::opt<std::string> ResumeFrom(
+    "resume-from",
+    cl::desc("Resume a replay from a checkpoint saved by --checkpoint-every. "
+             "The program, its arguments and the options must be the same "
+             "as when the checkpoint was taken"),
+    cl::cat(HASECat));
+} // namespace
+
+void Executor::setupCheckpoints() {
+  if (CheckpointEvery.empty())
+    return;
+  if (!replayTrie)
+    klee_error("--checkpoint-every is only supported when replaying a path");
+  if (!memory->isDeterministic())
+    klee_error("--checkpoint-every requires --allocate-determ");
+
+  const std::string &every = CheckpointEvery;
+  if (std::all_of(every.begin(), every.end(),
+                  [](char c) { return std::isdigit(c); }))
+    checkpointEntries = std::stoul(every);
+  else
+    checkpointInterval = time::Span(every);
+  if (!checkpointEntries && !checkpointInterval)
+    klee_error("invalid --checkpoint-every=%s", every.c_str());
+
+  lastCheckpointTime = time::getWallTime();
+  if (states.size() == 1)
+    lastCheckpointPosition = (*states.begin())->replayPosition;
+}
+
+void Executor::checkpointIfDue() {
+  // only between instructions of the single replayed state
+  if (states.size() != 1 || !suspendedStates.empty() ||
+      !prefetchedValidity.empty())
+    return;
+  ExecutionState &state = **states.begin();
+  if (checkpointEntries) {
+    if (state.replayPosition - lastCheckpointPosition < checkpointEntries)
+      return;
+  } else {
+    // reading the clock at every instruction would show in profiles
+    if (state.steppedInstructions % 1024)
+      return;
+    if (time::getWallTime() - lastCheckpointTime < checkpointInterval)
+      return;
+  }
+  // a checkpoint only holds feasible branches
+  if (!checkTrustedBranches(state))
+    return;
+  saveCheckpoint(state);
+  lastCheckpointPosition = state.replayPosition;
+  lastCheckpointTime = time::getWallTime();
+}
+
+void Executor::saveCheckpoint(const ExecutionState &state) {
+  if (!checkpointIndex)
+    checkpointIndex = std::make_unique<KModuleIndex>(kmodule.get());
+  CheckpointWriter w(*checkpointIndex);
+
+  w.write(uint64_t(state.replayPosition));
+  w.write(uint64_t(state.replayDataRecEntriesPosition));
+  w.write(uint64_t(state.replayNode));
+  w.write(uint64_t(state.nbranches_rec));
+  w.write(state.stateTime);
+  w.write(uint64_t(state.depth));
+  w.write(state.steppedInstructions);
+  w.writeBool(state.isInUserMain);
+  w.write(uint64_t(state.instsSinceCovNew));
+  w.writeBool(state.coveredNew);
+  w.writeBool(state.forkDisabled);
+  if (!state.openMergeStack.empty())
+    klee_warning("checkpoint: open merges are not saved");
+
+  // Memory objects: the bound ones first, in address space order, then
+  // those only referenced by symbolics or stack frames.
+  std::vector<const MemoryObject *> objects;
+  std::unordered_map<const MemoryObject *, uint64_t> objectIds;
+  auto addObject = [&](const MemoryObject *mo) {
+    if (objectIds.emplace(mo, objects.size()).second)
+      objects.push_back(mo);
+  };
+  for (const auto &it : state.addressSpace.objects)
+    addObject(it.first);
+  size_t numBound = objects.size();
+  for (const auto &symbolic : *state.symbolics)
+    addObject(symbolic.first.get());
+  for (const auto &it : state.threads) {
+    for (const StackFrame &sf : *it.second.stack) {
+      for (const MemoryObject *mo : sf.allocas)
+        addObject(mo);
+      if (sf.varargs)
+        addObject(sf.varargs);
+    }
+  }
+
+  w.write(uint64_t(objects.size()));
+  w.write(uint64_t(numBound));
+  for (const MemoryObject *mo : objects) {
+    w.write(mo->address);
+    w.write(uint64_t(mo->size));
+    w.write(mo->name);
+    w.writeBool(mo->isLocal);
+    w.writeBool(mo->isGlobal);
+    w.writeBool(mo->isFixed);
+    w.writeBool(mo->isUserSpecified);
+    w.writeBool(mo->isDeterm);
+    w.writeValue(mo->allocSite);
+    w.write(uint64_t(mo->cexPreferences.size()));
+    for (const auto &e : mo->cexPreferences)
+      w.write(e);
+  }
+  memory->saveHeaps(w);
+  for (const auto &it : state.addressSpace.objects)
+    it.second->save(w);
+
+  w.write(uint64_t(state.symbolics->size()));
+  for (const auto &symbolic : *state.symbolics) {
+    w.write(objectIds[symbolic.first.get()]);
+    w.write(symbolic.second);
+  }
+  w.write(uint64_t(state.arrayNames->size()));
+  for (const auto &name : *state.arrayNames)
+    w.write(name);
+
+  w.write(uint64_t(state.constraints.size()));
+  for (const auto &e : state.constraints)
+    w.write(e);
+
+  w.write(uint64_t(state.functionCalls->size()));
+  for (size_t i = 0, n = state.functionCalls->size(); i < n; ++i) {
+    w.write((*state.functionCalls)[i].kf);
+    w.write((*state.functionCalls)[i].instruction);
+  }
+
+  w.write(state.wlistCounter);
+  w.write(uint64_t(state.waitingLists.size()));
+  for (const auto &wlist : state.waitingLists) {
+    w.write(wlist.first);
+    w.write(uint64_t(wlist.second.size()));
+    for (const auto &tuid : wlist.second) {
+      w.write(tuid.first);
+      w.write(tuid.second);
+    }
+  }
+
+  w.write(uint64_t(state.threads.size()));
+  for (const auto &it : state.threads) {
+    const Thread &thread = it.second;
+    w.write(thread.tuid.first);
+    w.write(thread.tuid.second);
+    w.write(thread.pc);
+    w.write(thread.prevPC);
+    w.write(uint64_t(thread.incomingBBIndex));
+    w.writeBool(thread.enabled);
+    w.write(thread.waitingList);
+    w.writeBool(thread.isInPOSIX);
+    w.write(uint64_t(thread.POSIXDepth));
+    w.writeBool(thread.isInLIBC);
+    w.write(uint64_t(thread.LIBCDepth));
+    w.write(uint64_t(thread.stack->size()));
+    for (const StackFrame &sf : *thread.stack) {
+      w.write(sf.kf);
+      w.write(sf.caller);
+      w.write(uint64_t(sf.minDistToUncoveredOnReturn));
+      w.write(uint64_t(sf.allocas.size()));
+      for (const MemoryObject *mo : sf.allocas)
+        w.write(objectIds.at(mo));
+      w.write(sf.varargs ? objectIds.at(sf.varargs) + 1 : 0);
+      for (unsigned i = 0; i < sf.kf->numRegisters; ++i)
+        w.write((*sf.locals)[i].value);
+    }
+  }
+  w.write(state.crtThreadIt->first.first);
+  w.write(state.crtThreadIt->first.second);
+
+  std::string path = interpreterHandler->getOutputFilename("replay.ckpt");
+  std::string error;
+  if (!w.commit(path, error)) {
+    klee_warning("checkpoint: %s", error.c_str());
+    return;
+  }
+  klee_message("checkpoint at trace position %u saved to %s",
+               state.replayPosition, path.c_str());
+}
+
+void Executor::resumeFromCheckpoint(ExecutionState &state) {
+  if (ResumeFrom.empty())
+    return;
+  if (!replayTrie)
+    klee_error("--resume-from is only supported when replaying a path");
+  if (!memory->isDeterministic())
+    klee_error("--resume-from requires --allocate-determ");
+
+  if (!checkpointIndex)
+    checkpointIndex = std::make_unique<KModuleIndex>(kmodule.get());
+  CheckpointReader r(*checkpointIndex, arrayCache);
+  r.open(ResumeFrom);
+
+  state.replayPosition = r.read();
+  state.replayDataRecEntriesPosition = r.read();
+  state.replayNode = r.read();
+  if (state.replayNode >= replayTrie->getNumNodes())
+    r.fail("invalid replay node, the replayed paths differ");
+  state.nbranches_rec = r.read();
+  state.stateTime = r.read();
+  state.depth = r.read();
+  state.steppedInstructions = r.read();
+  state.isInUserMain = r.readBool();
+  state.instsSinceCovNew = r.read();
+  state.coveredNew = r.readBool();
+  state.forkDisabled = r.readBool();
+
+  // objects allocated so far by this run, by address
+  std::map<uint64_t, ObjectPair> existing;
+  for (const auto &it : state.addressSpace.objects)
+    existing[it.first->address] = {it.first, it.second.get()};
+
+  std::vector<ref<const MemoryObject>> objects(r.read());
+  uint64_t numBound = r.read();
+  if (numBound > objects.size())
+    r.fail("malformed objects");
+  for (auto &object : objects) {
+    uint64_t address = r.read();
+    uint64_t size = r.read();
+    std::string name = r.readString();
+    bool isLocal = r.readBool();
+    bool isGlobal = r.readBool();
+    bool isFixed = r.readBool();
+    bool isUserSpecified = r.readBool();
+    bool isDeterm = r.readBool();
+    const llvm::Value *allocSite = r.readValue();
+
+    MemoryObject *mo;
+    auto match = existing.find(address);
+    if (match != existing.end() && match->second.first->size == size) {
+      mo = const_cast<MemoryObject *>(match->second.first);
+      existing.erase(match);
+    } else if (isFixed) {
+      klee_warning("checkpoint: external object at 0x%" PRIx64
+                   " does not exist in this process",
+                   address);
+      mo = memory->allocateFixed(address, size, allocSite);
+    } else {
+      mo = memory->allocateRestored(address, size, isLocal, isGlobal,
+                                    isDeterm, allocSite);
+    }
+    mo->setName(name);
+    mo->isUserSpecified = isUserSpecified;
+    mo->cexPreferences.resize(r.read());
+    for (auto &e : mo->cexPreferences)
+      e = r.readExpr();
+    object = mo;
+  }
+
+  // Objects of this run that are not in the checkpoint must not be freed
+  // into the restored heaps, but external ones stay valid.
+  std::vector<ObjectPair> external;
+  for (const auto &it : existing) {
+    if (it.second.first->isFixed)
+      external.push_back(it.second);
+    else
+      memory->forget(it.second.first);
+  }
+  memory->restoreHeaps(r);
+
+  std::vector<ref<ObjectState>> keepExternal;
+  for (const auto &op : external)
+    keepExternal.push_back(const_cast<ObjectState *>(op.second));
+  state.addressSpace.objects = MemoryMap();
+  for (uint64_t i = 0; i < numBound; ++i) {
+    ObjectState *os = new ObjectState(objects[i].get());
+    os->restore(r);
+    state.addressSpace.bindObject(objects[i].get(), os);
+  }
+  for (size_t i = 0; i < external.size(); ++i)
+    state.addressSpace.bindObject(external[i].first, keepExternal[i].get());
+
+  auto readObject = [&]() -> const MemoryObject * {
+    uint64_t id = r.read();
+    if (id >= objects.size())
+      r.fail("invalid object reference");
+    return objects[id].get();
+  };
+
+  state.symbolics = {};
+  for (uint64_t i = 0, n = r.read(); i < n; ++i) {
+    const MemoryObject *mo = readObject();
+    state.symbolics.mutate().emplace_back(mo, r.readArray());
+  }
+  state.arrayNames = {};
+  for (uint64_t i = 0, n = r.read(); i < n; ++i)
+    state.arrayNames.mutate().insert(r.readString());
+
+  Constraints_ty constraints;
+  for (uint64_t i = 0, n = r.read(); i < n; ++i)
+    constraints.insert(r.readExpr());
+  state.constraints = ConstraintManager(constraints);
+  state.constraints.rebuildEqualities();
+
+  state.functionCalls = {};
+  if (uint64_t n = r.read()) {
+    RingBuffer<ExecutionState::FunctionCall> calls(
+        std::max<uint64_t>(n, DumpFunctionListSuffixLen + 1));
+    for (uint64_t i = 0; i < n; ++i) {
+      KFunction *kf = r.readFunction();
+      calls.push_back({kf, r.read()});
+    }
+    state.functionCalls =
+        CopyOnWrite<RingBuffer<ExecutionState::FunctionCall>>(std::move(calls));
+  }
+
+  state.wlistCounter = r.read();
+  state.waitingLists.clear();
+  for (uint64_t i = 0, n = r.read(); i < n; ++i) {
+    std::set<thread_uid_t> &wlist = state.waitingLists[r.read()];
+    for (uint64_t j = 0, m = r.read(); j < m; ++j) {
+      thread_id_t tid = r.read();
+      wlist.insert({tid, r.read()});
+    }
+  }
+
+  state.threads.clear();
+  for (uint64_t i = 0, n = r.read(); i < n; ++i) {
+    thread_id_t tid = r.read();
+    process_id_t pid = r.read();
+    KInstIterator pc = r.readKInstIterator();
+    KInstIterator prevPC = r.readKInstIterator();
+    unsigned incomingBBIndex = r.read();
+    bool enabled = r.readBool();
+    wlist_id_t waitingList = r.read();
+    bool isInPOSIX = r.readBool();
+    unsigned POSIXDepth = r.read();
+    bool isInLIBC = r.readBool();
+    unsigned LIBCDepth = r.read();
+    std::vector<StackFrame> stack;
+    for (uint64_t j = 0, m = r.read(); j < m; ++j) {
+      KFunction *kf = r.readFunction();
+      if (!kf)
+        r.fail("malformed stack frame");
+      stack.emplace_back(r.readKInstIterator(), kf);
+      StackFrame &sf = stack.back();
+      sf.minDistToUncoveredOnReturn = r.read();
+      for (uint64_t k = 0, numAllocas = r.read(); k < numAllocas; ++k)
+        sf.allocas.push_back(readObject());
+      if (uint64_t varargs = r.read()) {
+        if (varargs > objects.size())
+          r.fail("invalid object reference");
+        sf.varargs = const_cast<MemoryObject *>(objects[varargs - 1].get());
+      }
+      for (unsigned k = 0; k < kf->numRegisters; ++k)
+        sf.locals.mutate()[k].value = r.readExpr();
+    }
+    if (!pc || stack.empty())
+      r.fail("malformed thread");
+
+    state.crtThreadIt =
+        state.threads
+            .emplace(thread_uid_t(tid, pid), Thread(tid, pid, stack[0].kf))
+            .first;
+    Thread &thread = state.crtThread();
+    thread.pc = pc;
+    thread.prevPC = prevPC;
+    thread.incomingBBIndex = incomingBBIndex;
+    thread.enabled = enabled;
+    thread.waitingList = waitingList;
+    thread.isInPOSIX = isInPOSIX;
+    thread.POSIXDepth = POSIXDepth;
+    thread.isInLIBC = isInLIBC;
+    thread.LIBCDepth = LIBCDepth;
+    // frames are pushed one by one, for the stats tracker to see them
+    ExecutionState::stack_ty &threadStack = thread.stack.mutate();
+    threadStack.clear();
+    for (const StackFrame &sf : stack) {
+      threadStack.push_back(sf);
+      if (statsTracker)
+        statsTracker->framePushed(
+            state, threadStack.size() > 1 ? &threadStack.end()[-2] : nullptr);
+    }
+  }
+  thread_id_t tid = r.read();
+  state.crtThreadIt = state.threads.find({tid, r.read()});
+  if (state.crtThreadIt == state.threads.end())
+    r.fail("invalid current thread");
+
+  klee_message("resumed from %s at trace position %u", ResumeFrom.c_str(),
+               state.replayPosition);
+}
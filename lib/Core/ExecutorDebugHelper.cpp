@@ -36,7 +36,7 @@ void debugDumpConstraintsEval(ExecutionState &state, ConstraintManager &cm,
   for (const ref<Expr> &e: expr_vec) {
     simplified_expr_vec.push_back(cm.simplifyExpr(e));
   }
-  for (auto s: state.symbolics) {
+  for (auto s: *state.symbolics) {
     symbolic_objs.push_back(s.second);
   }
   debugDumpConstraintsImpl(cm.getAllConstraints(), symbolic_objs,
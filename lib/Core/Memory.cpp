@@ -9,6 +9,7 @@
 
 #include "Memory.h"
 
+#include "Checkpoint.h"
 #include "Context.h"
 #include "MemoryManager.h"
 
@@ -26,6 +27,7 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include <cassert>
+#include <cstring>
 #include <sstream>
 
 using namespace llvm;
@@ -39,6 +41,29 @@ namespace {
                     cl::cat(SolvingCat));
 }
 
+namespace {
+void saveBits(CheckpointWriter &w, BitArray *bits, unsigned size) {
+  w.writeBool(bits);
+  if (!bits)
+    return;
+  std::vector<uint8_t> packed((size + 7) / 8);
+  for (unsigned i = 0; i < size; ++i)
+    packed[i / 8] |= bits->get(i) << (i % 8);
+  w.writeBytes(packed.data(), packed.size());
+}
+
+BitArray *restoreBits(CheckpointReader &r, unsigned size) {
+  if (!r.readBool())
+    return nullptr;
+  std::vector<uint8_t> packed((size + 7) / 8);
+  r.readBytes(packed.data(), packed.size());
+  BitArray *bits = new BitArray(size);
+  for (unsigned i = 0; i < size; ++i)
+    bits->set(i, (packed[i / 8] >> (i % 8)) & 1);
+  return bits;
+}
+} // namespace
+
 /***/
 
 int MemoryObject::counter = 0;
@@ -76,8 +101,7 @@ ObjectState::ObjectState(const MemoryObject *mo)
   : copyOnWriteOwner(0),
     object(mo),
     concreteStore(new uint8_t[mo->size]),
-    flagStore(new uint64_t[mo->size]),
-    kinstStore(new KInstruction*[mo->size]),
+    provenance(mo->size, {Expr::FLAG_INTERNAL, nullptr}),
     concreteMask(0),
     flushMask(0),
     knownSymbolics(0),
@@ -91,10 +115,6 @@ ObjectState::ObjectState(const MemoryObject *mo)
     updates = UpdateList(array, 0);
   }
   memset(concreteStore, 0, size);
-  for (unsigned i = 0; i < size; i++) {
-    flagStore[i] = Expr::FLAG_INTERNAL;
-  }
-  memset(kinstStore, 0, size*sizeof(KInstruction*));
 }
 
 
@@ -102,8 +122,7 @@ ObjectState::ObjectState(const MemoryObject *mo, const Array *array)
   : copyOnWriteOwner(0),
     object(mo),
     concreteStore(new uint8_t[mo->size]),
-    flagStore(new uint64_t[mo->size]),
-    kinstStore(new KInstruction*[mo->size]),
+    provenance(mo->size, {Expr::FLAG_INTERNAL, nullptr}),
     concreteMask(0),
     flushMask(0),
     knownSymbolics(0),
@@ -112,18 +131,13 @@ ObjectState::ObjectState(const MemoryObject *mo, const Array *array)
     readOnly(false) {
   makeSymbolic();
   memset(concreteStore, 0, size);
-  for (unsigned i = 0; i < size; i++) {
-    flagStore[i] = Expr::FLAG_INTERNAL;
-  }
-  memset(kinstStore, 0, size*sizeof(KInstruction*));
 }
 
 ObjectState::ObjectState(const ObjectState &os) 
   : copyOnWriteOwner(0),
     object(os.object),
     concreteStore(new uint8_t[os.size]),
-    flagStore(new uint64_t[os.size]),
-    kinstStore(new KInstruction*[os.size]),
+    provenance(os.provenance),
     concreteMask(os.concreteMask ? new BitArray(*os.concreteMask, os.size) : 0),
     flushMask(os.flushMask ? new BitArray(*os.flushMask, os.size) : 0),
     knownSymbolics(0),
@@ -138,8 +152,6 @@ ObjectState::ObjectState(const ObjectState &os)
   }
 
   memcpy(concreteStore, os.concreteStore, size*sizeof(*concreteStore));
-  memcpy(flagStore, os.flagStore, size*sizeof(*flagStore));
-  memcpy(kinstStore, os.kinstStore, size*sizeof(*kinstStore));
 }
 
 ObjectState::~ObjectState() {
@@ -147,8 +159,6 @@ ObjectState::~ObjectState() {
   delete flushMask;
   delete[] knownSymbolics;
   delete[] concreteStore;
-  delete[] flagStore;
-  delete[] kinstStore;
 }
 
 ArrayCache *ObjectState::getArrayCache() const {
@@ -254,10 +264,7 @@ void ObjectState::makeSymbolic() {
 void ObjectState::initializeToZero() {
   makeConcrete();
   memset(concreteStore, 0, size);
-  for (unsigned i = 0; i < size; i++) {
-    flagStore[i] = Expr::FLAG_INITIALIZATION;
-  }
-  memset(kinstStore, 0, size*sizeof(KInstruction*));
+  provenance.reset({Expr::FLAG_INITIALIZATION, nullptr});
 }
 
 void ObjectState::initializeToRandom() {  
@@ -266,10 +273,7 @@ void ObjectState::initializeToRandom() {
     // randomly selected by 256 sided die
     concreteStore[i] = 0xAB;
   }
-  for (unsigned i = 0; i < size; i++) {
-    flagStore[i] = Expr::FLAG_INITIALIZATION;
-  }
-  memset(kinstStore, 0, size*sizeof(KInstruction*));
+  provenance.reset({Expr::FLAG_INITIALIZATION, nullptr});
 }
 
 /*
@@ -296,12 +300,12 @@ void ObjectState::flushRangeForRead(unsigned rangeBase,
       if (isByteConcrete(offset)) {
         updates.extend(ConstantExpr::create(offset, Expr::Int32),
                        ConstantExpr::create(concreteStore[offset], Expr::Int8),
-                       flagStore[offset], kinstStore[offset]);
+                       getFlags(offset), getKInst(offset));
       } else {
         assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
         updates.extend(ConstantExpr::create(offset, Expr::Int32),
                        knownSymbolics[offset],
-                       flagStore[offset], kinstStore[offset]);
+                       getFlags(offset), getKInst(offset));
       }
 
       flushMask->unset(offset);
@@ -318,18 +322,14 @@ void ObjectState::flushRangeForWrite(unsigned rangeBase,
       if (isByteConcrete(offset)) {
         updates.extend(ConstantExpr::create(offset, Expr::Int32),
                        ConstantExpr::create(concreteStore[offset], Expr::Int8),
-                       flagStore[offset], kinstStore[offset]);
+                       getFlags(offset), getKInst(offset));
         markByteSymbolic(offset);
-        //flagStore[offset] = 0;
-        //kinstStore[offset] = 0;
       } else {
         assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
         updates.extend(ConstantExpr::create(offset, Expr::Int32),
                        knownSymbolics[offset],
-                       flagStore[offset], kinstStore[offset]);
+                       getFlags(offset), getKInst(offset));
         setKnownSymbolic(offset, 0);
-        //flagStore[offset] = 0;
-        //kinstStore[offset] = 0;
       }
 
       flushMask->unset(offset);
@@ -349,6 +349,10 @@ bool ObjectState::isByteConcrete(unsigned offset) const {
   return !concreteMask || concreteMask->get(offset);
 }
 
+bool ObjectState::isRangeConcrete(unsigned offset, unsigned n) const {
+  return !concreteMask || concreteMask->isRangeSet(offset, n);
+}
+
 bool ObjectState::isByteFlushed(unsigned offset) const {
   return flushMask && !flushMask->get(offset);
 }
@@ -431,17 +435,17 @@ void ObjectState::write8(unsigned offset, uint8_t value,
 
   //assert(read_only == false && "writing to read-only object!");
   concreteStore[offset] = value;
-  flagStore[offset] = flags;
-  kinstStore[offset] = kinst;
+  provenance.set(offset, offset + 1, {flags, kinst});
   setKnownSymbolic(offset, 0);
 
   markByteConcrete(offset);
   markByteUnflushed(offset);
 }
 
-void ObjectState::increaseUntaggedWriteCnt(uint64_t flags, KInstruction *kinst) {
+void ObjectState::increaseUntaggedWriteCnt(uint64_t flags, KInstruction *kinst,
+                                           unsigned bytes) {
   if ((flags & Expr::FLAG_INITIALIZATION) == 0 && kinst == nullptr)
-    untaggedWriteCnt++;
+    untaggedWriteCnt += bytes;
 }
 
 void ObjectState::write8(unsigned offset, ref<Expr> value,
@@ -453,8 +457,7 @@ void ObjectState::write8(unsigned offset, ref<Expr> value,
     increaseUntaggedWriteCnt(flags, kinst);
 
     setKnownSymbolic(offset, value.get());
-    flagStore[offset] = flags;
-    kinstStore[offset] = kinst;
+    provenance.set(offset, offset + 1, {flags, kinst});
 
     markByteSymbolic(offset);
     markByteUnflushed(offset);
@@ -515,9 +518,20 @@ ref<Expr> ObjectState::read(unsigned offset, Expr::Width width) const {
   if (width == Expr::Bool)
     return ExtractExpr::create(read8(offset), 0, Expr::Bool);
 
-  // Otherwise, follow the slow general case.
   unsigned NumBytes = width / 8;
   assert(width == NumBytes * 8 && "Invalid width for read size!");
+
+  // Fast path for fully concrete ranges, without concatenating bytes.
+  if (width <= Expr::Int64 && isRangeConcrete(offset, NumBytes)) {
+    uint64_t value = 0;
+    for (unsigned i = 0; i != NumBytes; ++i) {
+      unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
+      value |= (uint64_t) concreteStore[offset + idx] << (8 * i);
+    }
+    return ConstantExpr::create(value, width);
+  }
+
+  // Otherwise, follow the slow general case.
   ref<Expr> Res(0);
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
@@ -592,29 +606,106 @@ void ObjectState::write(unsigned offset, ref<Expr> value,
 
 void ObjectState::write16(unsigned offset, uint16_t value,
             uint64_t flags, KInstruction *kinst) {
-  unsigned NumBytes = 2;
-  for (unsigned i = 0; i != NumBytes; ++i) {
-    unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    write8(offset + idx, (uint8_t) (value >> (8 * i)), flags, kinst);
-  }
+  writeConcrete(offset, value, 2, flags, kinst);
 }
 
 void ObjectState::write32(unsigned offset, uint32_t value,
             uint64_t flags, KInstruction *kinst) {
-  unsigned NumBytes = 4;
-  for (unsigned i = 0; i != NumBytes; ++i) {
-    unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    write8(offset + idx, (uint8_t) (value >> (8 * i)), flags, kinst);
-  }
+  writeConcrete(offset, value, 4, flags, kinst);
 }
 
 void ObjectState::write64(unsigned offset, uint64_t value,
             uint64_t flags, KInstruction *kinst) {
-  unsigned NumBytes = 8;
+  writeConcrete(offset, value, 8, flags, kinst);
+}
+
+/// Same as write8() of every byte, but updates the masks and the provenance
+/// of the whole range at once.
+void ObjectState::writeConcrete(unsigned offset, uint64_t value,
+            unsigned NumBytes, uint64_t flags, KInstruction *kinst) {
+  increaseUntaggedWriteCnt(flags, kinst, NumBytes);
+
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    write8(offset + idx, (uint8_t) (value >> (8 * i)), flags, kinst);
+    concreteStore[offset + idx] = (uint8_t) (value >> (8 * i));
+  }
+  provenance.set(offset, offset + NumBytes, {flags, kinst});
+  if (knownSymbolics) {
+    for (unsigned i = 0; i != NumBytes; ++i)
+      knownSymbolics[offset + i] = nullptr;
+  }
+
+  if (concreteMask)
+    concreteMask->setRange(offset, NumBytes);
+  if (flushMask)
+    flushMask->setRange(offset, NumBytes);
+}
+
+void ObjectState::readBytes(unsigned offset, unsigned n, uint8_t *bytes,
+                            std::vector<ref<Expr>> &symbolic) const {
+  symbolic.clear();
+  if (isRangeConcrete(offset, n)) {
+    memcpy(bytes, concreteStore + offset, n);
+    return;
+  }
+
+  symbolic.resize(n);
+  for (unsigned i = 0; i != n; ++i) {
+    if (isByteConcrete(offset + i))
+      bytes[i] = concreteStore[offset + i];
+    else
+      symbolic[i] = read8(offset + i);
+  }
+}
+
+/// Same as writeConcrete(), for a range of any size.
+void ObjectState::writeBytes(unsigned offset, const uint8_t *bytes,
+                             unsigned n, uint64_t flags, KInstruction *kinst) {
+  increaseUntaggedWriteCnt(flags, kinst, n);
+
+  memmove(concreteStore + offset, bytes, n);
+  provenance.set(offset, offset + n, {flags, kinst});
+  if (knownSymbolics) {
+    for (unsigned i = 0; i != n; ++i)
+      knownSymbolics[offset + i] = nullptr;
+  }
+
+  if (concreteMask)
+    concreteMask->setRange(offset, n);
+  if (flushMask)
+    flushMask->setRange(offset, n);
+}
+
+void ObjectState::copy(unsigned offset, const ObjectState &src,
+                       unsigned srcOffset, unsigned n, uint64_t flags,
+                       KInstruction *kinst) {
+  // read the whole source first, as writing may overwrite it
+  std::vector<uint8_t> bytes(n);
+  std::vector<ref<Expr>> symbolic;
+  src.readBytes(srcOffset, n, bytes.data(), symbolic);
+  if (symbolic.empty()) {
+    writeBytes(offset, bytes.data(), n, flags, kinst);
+    return;
   }
+
+  for (unsigned i = 0; i != n;) {
+    if (!symbolic[i].isNull()) {
+      write8(offset + i, symbolic[i], flags, kinst);
+      ++i;
+      continue;
+    }
+    unsigned end = i + 1;
+    while (end != n && symbolic[end].isNull())
+      ++end;
+    writeBytes(offset + i, &bytes[i], end - i, flags, kinst);
+    i = end;
+  }
+}
+
+void ObjectState::fill(unsigned offset, uint8_t value, unsigned n,
+                       uint64_t flags, KInstruction *kinst) {
+  std::vector<uint8_t> bytes(n, value);
+  writeBytes(offset, bytes.data(), n, flags, kinst);
 }
 
 void ObjectState::print() const {
@@ -638,3 +729,36 @@ void ObjectState::print() const {
     llvm::errs() << "\t\t[" << un->index << "] = " << un->value << "\n";
   }
 }
+
+void ObjectState::save(CheckpointWriter &w) const {
+  w.writeBool(readOnly);
+  w.write(uint64_t(untaggedWriteCnt));
+  w.writeBytes(concreteStore, size);
+  saveBits(w, concreteMask, size);
+  saveBits(w, flushMask, size);
+  w.writeBool(knownSymbolics);
+  if (knownSymbolics)
+    for (unsigned i = 0; i < size; ++i)
+      w.write(knownSymbolics[i]);
+  w.write(updates);
+  provenance.save(w);
+}
+
+void ObjectState::restore(CheckpointReader &r) {
+  readOnly = r.readBool();
+  untaggedWriteCnt = r.read();
+  r.readBytes(concreteStore, size);
+  delete concreteMask;
+  concreteMask = restoreBits(r, size);
+  delete flushMask;
+  flushMask = restoreBits(r, size);
+  delete[] knownSymbolics;
+  knownSymbolics = nullptr;
+  if (r.readBool()) {
+    knownSymbolics = new ref<Expr>[size];
+    for (unsigned i = 0; i < size; ++i)
+      knownSymbolics[i] = r.readExpr();
+  }
+  updates = r.readUpdates();
+  provenance.restore(r);
+}
@@ -11,6 +11,7 @@
 #define KLEE_MEMORY_H
 
 #include "Context.h"
+#include "ProvenanceMap.h"
 #include "TimingSolver.h"
 #include "klee/Expr/Expr.h"
 //#include "klee/Internal/Module/KInstruction.h"
@@ -27,6 +28,8 @@ namespace llvm {
 namespace klee {
 
 class BitArray;
+class CheckpointReader;
+class CheckpointWriter;
 class MemoryManager;
 class Solver;
 class ArrayCache;
@@ -182,8 +185,8 @@ private:
   ref<const MemoryObject> object;
 
   uint8_t *concreteStore;
-  uint64_t *flagStore;
-  KInstruction **kinstStore;
+  /// flags and instruction of the last write to every byte
+  ProvenanceMap provenance;
 
   // XXX cleanup name of flushMask (its backwards or something)
   // if an offset is concrete, corresponding bit will be set
@@ -227,12 +230,12 @@ public:
   // make contents all concrete and random
   void initializeToRandom();
 
-  uint64_t getFlags(unsigned offset) {
-      return flagStore[offset];
+  uint64_t getFlags(unsigned offset) const {
+    return provenance.get(offset).flags;
   }
 
-  KInstruction *getKInst(unsigned offset) {
-      return kinstStore[offset];
+  KInstruction *getKInst(unsigned offset) const {
+    return provenance.get(offset).kinst;
   }
 
   ref<Expr> read(ref<Expr> offset, Expr::Width width) const;
@@ -247,8 +250,30 @@ public:
   void write16(unsigned offset, uint16_t value, uint64_t flags, KInstruction *kinst);
   void write32(unsigned offset, uint32_t value, uint64_t flags, KInstruction *kinst);
   void write64(unsigned offset, uint64_t value, uint64_t flags, KInstruction *kinst);
+
+  /// Read `n` bytes from `offset` into `bytes`. If some of them are
+  /// symbolic, `symbolic` is resized to `n` and holds the expressions of the
+  /// symbolic bytes, and null for the concrete ones; otherwise it is empty.
+  void readBytes(unsigned offset, unsigned n, uint8_t *bytes,
+                 std::vector<ref<Expr>> &symbolic) const;
+  /// Write `n` concrete bytes at `offset`, as write8() of each of them.
+  void writeBytes(unsigned offset, const uint8_t *bytes, unsigned n,
+                  uint64_t flags, KInstruction *kinst);
+  /// Copy `n` bytes at `srcOffset` of `src`, which may be this object, to
+  /// `offset`. The ranges may overlap.
+  void copy(unsigned offset, const ObjectState &src, unsigned srcOffset,
+            unsigned n, uint64_t flags, KInstruction *kinst);
+  /// Set `n` bytes at `offset` to `value`.
+  void fill(unsigned offset, uint8_t value, unsigned n, uint64_t flags,
+            KInstruction *kinst);
+
   void print() const;
 
+  /// Save the contents of this object, but not the memory object.
+  void save(CheckpointWriter &w) const;
+  /// Restore the contents saved by save() for the same memory object.
+  void restore(CheckpointReader &r);
+
   /*
     Looks at all the symbolic bytes of this object, gets a value for them
     from the solver and puts them in the concreteStore.
@@ -273,6 +298,7 @@ private:
   void flushRangeForWrite(unsigned rangeBase, unsigned rangeSize);
 
   bool isByteConcrete(unsigned offset) const;
+  bool isRangeConcrete(unsigned offset, unsigned n) const;
   bool isByteFlushed(unsigned offset) const;
   bool isByteKnownSymbolic(unsigned offset) const;
 
@@ -282,7 +308,11 @@ private:
   void markByteUnflushed(unsigned offset);
   void setKnownSymbolic(unsigned offset, Expr *value);
 
-  void increaseUntaggedWriteCnt(uint64_t flags, KInstruction *kinst);
+  void writeConcrete(unsigned offset, uint64_t value, unsigned NumBytes,
+                     uint64_t flags, KInstruction *kinst);
+
+  void increaseUntaggedWriteCnt(uint64_t flags, KInstruction *kinst,
+                                unsigned bytes = 1);
 
   ArrayCache *getArrayCache() const;
 };
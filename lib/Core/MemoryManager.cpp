@@ -9,6 +9,7 @@
 
 #include "MemoryManager.h"
 
+#include "Checkpoint.h"
 #include "CoreStats.h"
 #include "Memory.h"
 
@@ -20,6 +21,7 @@
 
 #include <inttypes.h>
 #include <sys/mman.h>
+#include <vector>
 
 using namespace klee;
 
@@ -222,3 +224,44 @@ size_t MemoryManager::getUsedDeterministicSize() {
     return 0;
   }
 }
+
+void MemoryManager::saveHeaps(CheckpointWriter &w) const {
+  assert(isDeterministic() && "heaps are only saved with --allocate-determ");
+  for (mspace msp : {determ_msp, undeterm_msp}) {
+    size_t size;
+    void *base = mspace_region(msp, &size);
+    w.write((uint64_t)base);
+    w.write((uint64_t)size);
+    w.writeBytes(base, size);
+  }
+}
+
+void MemoryManager::restoreHeaps(CheckpointReader &r) {
+  assert(isDeterministic() && "heaps are only restored with --allocate-determ");
+  for (mspace msp : {determ_msp, undeterm_msp}) {
+    size_t currentSize;
+    uint64_t base = (uint64_t)mspace_region(msp, &currentSize);
+    if (r.read() != base)
+      r.fail("heaps were taken with different start addresses");
+    std::vector<char> image(r.read());
+    r.readBytes(image.data(), image.size());
+    if (mspace_load_region(msp, image.data(), image.size()))
+      r.fail("cannot restore heap at " + std::to_string(base));
+  }
+}
+
+MemoryObject *MemoryManager::allocateRestored(uint64_t address, uint64_t size,
+                                              bool isLocal, bool isGlobal,
+                                              bool isDeterm,
+                                              const llvm::Value *allocSite) {
+  ++stats::allocations;
+  MemoryObject *res =
+      new MemoryObject(address, size, isLocal, isGlobal, /*isFixed*/false,
+                       isDeterm, allocSite, this);
+  objects.insert(res);
+  return res;
+}
+
+void MemoryManager::forget(const MemoryObject *mo) {
+  objects.erase(const_cast<MemoryObject *>(mo));
+}
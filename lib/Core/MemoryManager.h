@@ -24,6 +24,8 @@ class Value;
 namespace klee {
 class MemoryObject;
 class ArrayCache;
+class CheckpointReader;
+class CheckpointWriter;
 
 class MemoryManager {
 private:
@@ -69,6 +71,26 @@ public:
    * Returns the size used by deterministic allocation in bytes
    */
   size_t getUsedDeterministicSize();
+
+  /// Whether memory is allocated deterministically, which is required to
+  /// restore a checkpoint at the same addresses.
+  bool isDeterministic() const { return determ_msp != NULL; }
+
+  /// Save the whole state of the deterministic allocators.
+  void saveHeaps(CheckpointWriter &w) const;
+  /// Restore the allocators saved by saveHeaps(), possibly in another
+  /// process. All objects of this manager not in the checkpoint must have
+  /// been forgotten before.
+  void restoreHeaps(CheckpointReader &r);
+
+  /// Create an object of a checkpoint, whose memory is part of the heaps
+  /// restored by restoreHeaps().
+  MemoryObject *allocateRestored(uint64_t address, uint64_t size,
+                                 bool isLocal, bool isGlobal, bool isDeterm,
+                                 const llvm::Value *allocSite);
+  /// Stop tracking an object without releasing its memory, which belongs to
+  /// the heaps being restored.
+  void forget(const MemoryObject *mo);
 };
 
 } // End klee namespace
@@ -0,0 +1,137 @@
+//===-- ProvenanceMap.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ProvenanceMap.h"
+
+#include "Checkpoint.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace klee;
+
+size_t ProvenanceMap::find(unsigned offset) const {
+  const std::vector<Run> &v = runs->runs;
+  auto it = std::upper_bound(
+      v.begin(), v.end(), offset,
+      [](unsigned offset, const Run &run) { return offset < run.start; });
+  assert(it != v.begin() && "first run does not start at 0");
+  return (it - v.begin()) - 1;
+}
+
+Provenance ProvenanceMap::get(unsigned offset) const {
+  assert(offset < size && "out of bounds provenance lookup");
+  if (runs.isNull())
+    return uniform;
+  return runs->runs[find(offset)].provenance;
+}
+
+void ProvenanceMap::set(unsigned begin, unsigned end, Provenance provenance) {
+  assert(begin < end && end <= size && "invalid provenance range");
+  if (begin == 0 && end == size) {
+    reset(provenance);
+    return;
+  }
+
+  // Writes that do not change anything, e.g. a loop initializing an array,
+  // must neither allocate nor unshare the runs.
+  size_t first = 0;
+  if (runs.isNull()) {
+    if (uniform == provenance)
+      return;
+  } else {
+    first = find(begin);
+    const std::vector<Run> &v = runs->runs;
+    unsigned runEnd = first + 1 < v.size() ? v[first + 1].start : size;
+    if (v[first].provenance == provenance && end <= runEnd)
+      return;
+  }
+
+  if (runs.isNull()) {
+    runs = new Runs();
+    runs->runs.push_back({0, uniform});
+  } else if (runs->_refCount.getCount() > 1) {
+    Runs *copy = new Runs();
+    copy->runs = runs->runs;
+    runs = copy;
+  }
+
+  std::vector<Run> &v = runs->runs;
+  size_t last = find(end - 1);
+
+  // Runs [first, to) are replaced in place by at most three runs: what
+  // remains of the first run, the run of the range and what remains of the
+  // last run. The run of the range is merged into a neighbour with the same
+  // provenance instead, so that overwriting or extending a run leaves the
+  // other runs where they are.
+  Run replacement[3];
+  size_t n = 0, to = last + 1;
+  if (v[first].start < begin)
+    replacement[n++] = v[first];
+  bool mergedLeft = n ? v[first].provenance == provenance
+                      : first && v[first - 1].provenance == provenance;
+  if (!mergedLeft)
+    replacement[n++] = {begin, provenance};
+  if (end < size) {
+    if (to < v.size() && v[to].start == end) {
+      if (v[to].provenance == provenance)
+        ++to;
+    } else if (v[last].provenance != provenance) {
+      replacement[n++] = {end, v[last].provenance};
+    }
+  }
+
+  size_t replaced = to - first;
+  std::copy(replacement, replacement + std::min(n, replaced),
+            v.begin() + first);
+  if (n < replaced)
+    v.erase(v.begin() + first + n, v.begin() + to);
+  else if (n > replaced)
+    v.insert(v.begin() + to, replacement + replaced, replacement + n);
+
+  if (v.size() == 1)
+    reset(v.front().provenance);
+}
+
+void ProvenanceMap::save(CheckpointWriter &w) const {
+  if (runs.isNull()) {
+    w.write(uint64_t(0));
+    w.write(uniform.flags);
+    w.write(uniform.kinst);
+    return;
+  }
+  w.write(uint64_t(runs->runs.size()));
+  for (const Run &run : runs->runs) {
+    w.write(uint64_t(run.start));
+    w.write(run.provenance.flags);
+    w.write(run.provenance.kinst);
+  }
+}
+
+void ProvenanceMap::restore(CheckpointReader &r) {
+  uint64_t numRuns = r.read();
+  if (!numRuns) {
+    uint64_t flags = r.read();
+    reset({flags, r.readKInst()});
+    return;
+  }
+  runs = new Runs();
+  std::vector<Run> &v = runs->runs;
+  v.resize(numRuns);
+  for (Run &run : v) {
+    run.start = r.read();
+    run.provenance.flags = r.read();
+    run.provenance.kinst = r.readKInst();
+  }
+  bool valid = v.front().start == 0;
+  for (size_t i = 1; i < v.size(); ++i)
+    valid &= v[i - 1].start < v[i].start && v[i].start < size;
+  if (!valid)
+    r.fail("malformed provenance");
+}
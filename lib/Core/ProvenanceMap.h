@@ -0,0 +1,90 @@
+//===-- ProvenanceMap.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PROVENANCEMAP_H
+#define KLEE_PROVENANCEMAP_H
+
+#include "klee/util/Ref.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace klee {
+
+class CheckpointReader;
+class CheckpointWriter;
+struct KInstruction;
+
+/// Flags and instruction of the last write to a byte of an object.
+struct Provenance {
+  uint64_t flags;
+  KInstruction *kinst;
+
+  bool operator==(const Provenance &b) const {
+    return flags == b.flags && kinst == b.kinst;
+  }
+  bool operator!=(const Provenance &b) const { return !(*this == b); }
+};
+
+/// ProvenanceMap - Provenance of every byte of an object, stored as runs of
+/// bytes sharing the same provenance.
+///
+/// As long as the whole object has a single provenance, nothing is
+/// allocated. Otherwise the runs live in a reference counted vector that is
+/// shared between copies of the map and only copied by the first copy that
+/// changes it.
+class ProvenanceMap {
+  struct Run {
+    /// First byte of the run, which extends up to the next run
+    unsigned start;
+    Provenance provenance;
+  };
+
+  struct Runs {
+    /// @brief Required by klee::ref-managed objects
+    class ReferenceCounter _refCount;
+    /// Sorted by start, the first run starts at 0, and no two consecutive
+    /// runs have the same provenance
+    std::vector<Run> runs;
+  };
+
+  unsigned size;
+  /// Provenance of the whole object when runs is null
+  Provenance uniform;
+  ref<Runs> runs;
+
+  /// \return the index of the run holding byte `offset`
+  size_t find(unsigned offset) const;
+
+public:
+  ProvenanceMap(unsigned size, Provenance provenance)
+      : size(size), uniform(provenance) {}
+
+  Provenance get(unsigned offset) const;
+
+  /// Set the provenance of bytes [begin, end).
+  void set(unsigned begin, unsigned end, Provenance provenance);
+
+  /// Set the provenance of the whole object, dropping all runs.
+  void reset(Provenance provenance) {
+    uniform = provenance;
+    runs = ref<Runs>();
+  }
+
+  /// \return the number of runs, 1 when nothing is allocated
+  size_t getNumRuns() const { return runs.isNull() ? 1 : runs->runs.size(); }
+
+  void save(CheckpointWriter &w) const;
+  /// Restore the provenance saved by save() for an object of the same size.
+  void restore(CheckpointReader &r);
+};
+
+} // namespace klee
+
+#endif /* KLEE_PROVENANCEMAP_H */
@@ -0,0 +1,126 @@
+//===-- ReplayTrie.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ReplayTrie.h"
+
+#include "klee/Internal/Support/PathReader.h"
+
+using namespace klee;
+
+bool ReplayTrie::sameEntry(const Trace &a, const Trace &b, size_t position,
+                           size_t dataPosition, bool &isDataRec) {
+  PathEntry pa, pb;
+  if (!a.path->read(position, pa) || !b.path->read(position, pb))
+    return false;
+  isDataRec = pa.t == PathEntry::DATAREC;
+  if (pa.t != pb.t)
+    return false;
+
+  switch (pa.t) {
+  case PathEntry::FORK:
+    return pa.body.br == pb.body.br;
+  case PathEntry::SWITCH_EXPIDX:
+  case PathEntry::SWITCH_BBIDX:
+    return pa.body.switchIndex == pb.body.switchIndex;
+  case PathEntry::INDIRECTBR:
+    return pa.body.indirectbrIndex == pb.body.indirectbrIndex;
+  case PathEntry::SCHEDULE:
+    return pa.body.tgtid == pb.body.tgtid;
+  case PathEntry::DATAREC: {
+    // IDlen is not compared: v2 traces do not record it, and the IDs
+    // themselves are compared below
+    if (pa.body.drec.width != pb.body.drec.width)
+      return false;
+    DataRecEntryRef da, db;
+    bool hasA = a.dataRec->read(dataPosition, da);
+    bool hasB = b.dataRec->read(dataPosition, db);
+    if (hasA != hasB)
+      return false;
+    return !hasA ||
+           (da.data == db.data && da.instUniqueID == db.instUniqueID);
+  }
+  default:
+    return true;
+  }
+}
+
+void ReplayTrie::split(unsigned node, size_t position) {
+  Node rest = {position, nodes[node].end, nodes[node].trace,
+               std::move(nodes[node].children)};
+  nodes[node].end = position;
+  nodes[node].children.clear();
+  nodes.push_back(std::move(rest));
+  nodes[node].children.push_back(nodes.size() - 1);
+}
+
+void ReplayTrie::addLeaf(unsigned parent, unsigned trace, size_t position) {
+  nodes.push_back({position, traces[trace].path->size(), trace, {}});
+  nodes[parent].children.push_back(nodes.size() - 1);
+}
+
+bool ReplayTrie::addTrace(PathEntryReader *path, DataRecEntryReader *dataRec) {
+  Trace trace = {path, dataRec};
+  unsigned t = traces.size();
+  traces.push_back(trace);
+  if (nodes.empty()) {
+    nodes.push_back({0, path->size(), t, {}});
+    return true;
+  }
+
+  unsigned n = getRoot();
+  size_t position = 0, dataPosition = 0;
+  for (;;) {
+    bool isDataRec;
+    while (position < nodes[n].end && position < path->size() &&
+           sameEntry(traces[nodes[n].trace], trace, position, dataPosition,
+                     isDataRec)) {
+      ++position;
+      if (isDataRec)
+        ++dataPosition;
+    }
+
+    if (position < nodes[n].end) {
+      // diverges from, or ends within, the entries of the node
+      split(n, position);
+      addLeaf(n, t, position);
+      return true;
+    }
+
+    if (nodes[n].children.empty()) {
+      if (position == path->size())
+        return false;
+      // goes on after the end of the node's trace, which becomes an empty
+      // leaf
+      split(n, position);
+      addLeaf(n, t, position);
+      return true;
+    }
+
+    // look for the child holding the same next entry, or also ending here
+    unsigned next = nodes.size();
+    for (unsigned c : nodes[n].children) {
+      const Node &child = nodes[c];
+      bool childEnds = child.begin == child.end;
+      if (position == path->size()
+              ? childEnds
+              : !childEnds && sameEntry(traces[child.trace], trace, position,
+                                        dataPosition, isDataRec)) {
+        next = c;
+        break;
+      }
+    }
+    if (next == nodes.size()) {
+      addLeaf(n, t, position);
+      return true;
+    }
+    if (position == path->size())
+      return false;
+    n = next;
+  }
+}
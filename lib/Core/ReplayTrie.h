@@ -0,0 +1,94 @@
+//===-- ReplayTrie.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_REPLAYTRIE_H
+#define KLEE_REPLAYTRIE_H
+
+#include <cstddef>
+#include <vector>
+
+namespace klee {
+class DataRecEntryReader;
+class PathEntryReader;
+
+/// The traces replayed together, merged into a trie on their common
+/// prefixes, so that a single state executes a prefix shared by several
+/// traces and forks where they diverge.
+///
+/// Each node stands for the traces of its subtree, which share their
+/// entries [begin, end), and whose entries at `end` differ between its
+/// children. Two entries are the same if they have the same path entry and,
+/// for DATAREC entries, the same recorded data. A state replaying a node
+/// reads the entries of the node's trace, which is any trace of the subtree.
+/// Traces are only read up to the point where they diverge from the ones
+/// already in the trie.
+class ReplayTrie {
+public:
+  struct Trace {
+    PathEntryReader *path;
+    DataRecEntryReader *dataRec;
+  };
+
+private:
+  struct Node {
+    size_t begin;
+    size_t end;
+    /// the index of the trace read by a state replaying this node, which is
+    /// also the trace of its first child
+    unsigned trace;
+    std::vector<unsigned> children;
+  };
+
+  std::vector<Trace> traces;
+  std::vector<Node> nodes;
+
+  /// \return true if `a` and `b` hold the same entry at `position`, reading
+  /// their data entry at `dataPosition` for DATAREC entries
+  static bool sameEntry(const Trace &a, const Trace &b, size_t position,
+                        size_t dataPosition, bool &isDataRec);
+
+  /// Make the entries of `node` from `position` on a child of it.
+  void split(unsigned node, size_t position);
+  void addLeaf(unsigned parent, unsigned trace, size_t position);
+
+public:
+  /// Merge a trace into the trie. Traces are indexed in the order they are
+  /// added.
+  /// \return false if the trace is the same as one added before, in which
+  /// case it is not replayed
+  bool addTrace(PathEntryReader *path, DataRecEntryReader *dataRec);
+
+  size_t getNumTraces() const { return traces.size(); }
+  size_t getNumNodes() const { return nodes.size(); }
+
+  /// The node of the state starting the replay
+  unsigned getRoot() const { return 0; }
+
+  /// \return the index of the trace read when replaying `node`
+  unsigned getTraceIndex(unsigned node) const { return nodes[node].trace; }
+  const Trace &getTrace(unsigned node) const {
+    return traces[nodes[node].trace];
+  }
+
+  /// \return true if the traces of `node` have diverged when `position`
+  /// entries have been replayed
+  bool hasDiverged(unsigned node, size_t position) const {
+    return nodes[node].end <= position && !nodes[node].children.empty();
+  }
+
+  /// The position at which the children of `node` diverge
+  size_t getEnd(unsigned node) const { return nodes[node].end; }
+  const std::vector<unsigned> &getChildren(unsigned node) const {
+    return nodes[node].children;
+  }
+};
+
+} // namespace klee
+
+#endif /* KLEE_REPLAYTRIE_H */
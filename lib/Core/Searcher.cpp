@@ -194,6 +194,9 @@ ExecutionState &WeightedRandomSearcher::selectState() {
 }
 
 double WeightedRandomSearcher::getWeight(ExecutionState *es) {
+  // read through the const accessor, which does not unshare the stack
+  const ExecutionState::stack_ty &stack =
+      static_cast<const ExecutionState *>(es)->stack();
   switch(type) {
   default:
   case Depth:
@@ -207,7 +210,7 @@ double WeightedRandomSearcher::getWeight(ExecutionState *es) {
     return inv * inv;
   }
   case CPInstCount: {
-    StackFrame &sf = es->stack().back();
+    const StackFrame &sf = stack.back();
     uint64_t count = sf.callPathNode->statistics.getValue(stats::instructions);
     double inv = 1. / std::max((uint64_t) 1, count);
     return inv;
@@ -217,7 +220,7 @@ double WeightedRandomSearcher::getWeight(ExecutionState *es) {
   case CoveringNew:
   case MinDistToUncovered: {
     uint64_t md2u = computeMinDistToUncovered(es->pc(),
-                                              es->stack().back().minDistToUncoveredOnReturn);
+                                              stack.back().minDistToUncoveredOnReturn);
 
     double invMD2U = 1. / (md2u ? md2u : 10000);
     if (type==CoveringNew) {
@@ -0,0 +1,303 @@
+//===-- SolverWorkerPool.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SolverWorkerPool.h"
+
+#include "TimingSolver.h"
+
+#include "klee/ExecutionState.h"
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/ExprUtil.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Statistics.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace klee;
+
+SolverWorkerPool::SolverWorkerPool(TimingSolver *solver, unsigned maxWorkers)
+    : solver(solver), maxWorkers(maxWorkers) {}
+
+SolverWorkerPool::~SolverWorkerPool() {
+  std::vector<ExecutionState *> states;
+  cancelAll(states);
+}
+
+bool SolverWorkerPool::isRunning(const ExecutionState &state) const {
+  return std::any_of(workers.begin(), workers.end(),
+                     [&](const Worker &w) { return w.state == &state; });
+}
+
+bool SolverWorkerPool::dispatch(ExecutionState &state, ref<Expr> condition,
+                                time::Span timeout) {
+  assert(!full() && "dispatching to a full solver worker pool");
+  int fds[2];
+  if (pipe(fds) < 0) {
+    klee_warning_once(0, "pipe() for solver worker failed: %s",
+                      strerror(errno));
+    return false;
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    klee_warning_once(0, "fork() for solver worker failed: %s",
+                      strerror(errno));
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+
+  if (pid == 0) {
+    close(fds[0]);
+    if (timeout) {
+      solver->setTimeout(timeout);
+      // backstop for core solvers which only time out when forked
+      ::alarm(std::max(1u, static_cast<unsigned>(timeout.toSeconds())));
+    }
+    runWorker(fds[1], state, condition);
+    // skip atexit handlers and buffered output owned by the executor
+    _exit(0);
+  }
+
+  close(fds[1]);
+  fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+  workers.emplace_back();
+  Worker &w = workers.back();
+  w.pid = pid;
+  w.fd = fds[0];
+  w.state = &state;
+  w.condition = condition;
+  return true;
+}
+
+void SolverWorkerPool::getObjects(const ConstraintManager &constraints,
+                                  ref<Expr> condition,
+                                  std::vector<const Array *> &objects) {
+  std::vector<ref<Expr>> exprs(constraints.begin(), constraints.end());
+  exprs.push_back(condition);
+  findSymbolicObjects(exprs.begin(), exprs.end(), objects);
+}
+
+static bool writeAll(int fd, const std::vector<unsigned char> &msg) {
+  for (size_t written = 0; written < msg.size();) {
+    ssize_t ret = ::write(fd, msg.data() + written, msg.size() - written);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0)
+      return false;
+    written += ret;
+  }
+  return true;
+}
+
+// The child writes the success and the validity of the query. Then, for the
+// true and the false side of the branch, a flag whether a model follows and
+// the bytes of the model, in the order of getObjects(). Last, the increase
+// of every statistic while solving. The validity is written first, so the
+// executor can go on before the models are computed, and so it is not lost
+// if the child times out afterwards.
+void SolverWorkerPool::runWorker(int fd, const ExecutionState &state,
+                                 ref<Expr> condition) {
+  std::vector<uint64_t> statistics;
+  for (unsigned i = 0; i < theStatisticManager->getNumStatistics(); ++i)
+    statistics.push_back(
+        theStatisticManager->getValue(theStatisticManager->getStatistic(i)));
+
+  Solver::Validity validity;
+  bool success = solver->evaluate(state, condition, validity);
+  std::vector<unsigned char> msg{static_cast<unsigned char>(success),
+                                 static_cast<unsigned char>(validity)};
+  if (!writeAll(fd, msg) || !success)
+    return;
+
+  std::vector<const Array *> objects;
+  getObjects(state.constraints, condition, objects);
+  // getInitialValues() finds a model of the constraints and the negated
+  // query expression, answered by the counterexample cache which the
+  // evaluation filled
+  const bool feasible[2] = {validity != Solver::False,
+                            validity != Solver::True};
+  const ref<Expr> negated[2] = {Expr::createIsZero(condition), condition};
+  msg.clear();
+  for (unsigned i = 0; i < 2; ++i) {
+    std::vector<std::vector<unsigned char>> values;
+    if (!feasible[i] ||
+        !solver->solver->getInitialValues(Query(state.constraints, negated[i]),
+                                          objects, values)) {
+      msg.push_back(0);
+      continue;
+    }
+    msg.push_back(1);
+    for (const auto &v : values)
+      msg.insert(msg.end(), v.begin(), v.end());
+  }
+
+  for (unsigned i = 0; i < statistics.size(); ++i) {
+    uint64_t delta =
+        theStatisticManager->getValue(theStatisticManager->getStatistic(i)) -
+        statistics[i];
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&delta);
+    msg.insert(msg.end(), bytes, bytes + sizeof(delta));
+  }
+  writeAll(fd, msg);
+}
+
+bool SolverWorkerPool::readAvailable(Worker &w) {
+  unsigned char buf[4096];
+  for (;;) {
+    ssize_t ret = read(w.fd, buf, sizeof(buf));
+    if (ret > 0)
+      w.msg.insert(w.msg.end(), buf, buf + ret);
+    else if (ret < 0 && errno == EINTR)
+      continue;
+    else
+      return !(ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+  }
+}
+
+void SolverWorkerPool::finish(Worker &w,
+                              const ConstraintManager &constraints) {
+  close(w.fd);
+  exiting.push_back(w.pid);
+
+  const std::vector<unsigned char> &msg = w.msg;
+  // a child killed by its timeout closes the pipe without writing
+  if (msg.size() < 2 || !msg[0])
+    return;
+  Solver::Validity validity =
+      static_cast<Solver::Validity>(static_cast<int8_t>(msg[1]));
+
+  // the models are only learnt if the child sent both sides
+  std::vector<const Array *> objects;
+  getObjects(constraints, w.condition, objects);
+  std::unique_ptr<Assignment> sides[2];
+  size_t pos = 2;
+  bool complete = true;
+  for (auto &model : sides) {
+    if (pos >= msg.size()) {
+      complete = false;
+      break;
+    }
+    if (!msg[pos++])
+      continue;
+    std::vector<std::vector<unsigned char>> values;
+    for (const Array *os : objects) {
+      if (msg.size() - pos < os->size) {
+        complete = false;
+        break;
+      }
+      values.emplace_back(msg.begin() + pos, msg.begin() + pos + os->size);
+      pos += os->size;
+    }
+    if (!complete)
+      break;
+    model.reset(new Assignment(objects, values));
+  }
+  if (!complete) {
+    sides[0].reset();
+    sides[1].reset();
+  }
+  solver->learnValidity(constraints, w.condition, validity, sides[0].get(),
+                        sides[1].get());
+
+  // statistics are only added to the totals, as the child did not execute
+  // the instruction the executor is at now
+  unsigned numStatistics = theStatisticManager->getNumStatistics();
+  if (!complete || msg.size() - pos != numStatistics * sizeof(uint64_t))
+    return;
+  for (unsigned i = 0; i < numStatistics; ++i) {
+    uint64_t delta;
+    memcpy(&delta, &msg[pos + i * sizeof(delta)], sizeof(delta));
+    Statistic &s = theStatisticManager->getStatistic(i);
+    theStatisticManager->setValue(s, theStatisticManager->getValue(s) + delta);
+  }
+}
+
+void SolverWorkerPool::reap(bool wait) {
+  std::vector<pid_t> running;
+  for (pid_t pid : exiting) {
+    int status;
+    pid_t ret;
+    do {
+      ret = waitpid(pid, &status, wait ? 0 : WNOHANG);
+    } while (ret < 0 && errno == EINTR);
+    if (ret == 0)
+      running.push_back(pid);
+  }
+  exiting.swap(running);
+}
+
+void SolverWorkerPool::collect(std::vector<Result> &results, bool wait) {
+  reap(false);
+  size_t collected = results.size();
+  while (!workers.empty()) {
+    bool waiting =
+        wait && results.size() == collected &&
+        std::any_of(workers.begin(), workers.end(),
+                    [](const Worker &w) { return w.state != nullptr; });
+    std::vector<pollfd> pfds;
+    for (const auto &w : workers)
+      pfds.push_back(pollfd{w.fd, POLLIN, 0});
+    int ready;
+    do {
+      ready = poll(pfds.data(), pfds.size(), waiting ? -1 : 0);
+    } while (ready < 0 && errno == EINTR);
+    if (ready <= 0)
+      return;
+
+    std::vector<Worker> running;
+    for (unsigned i = 0; i < workers.size(); ++i) {
+      Worker &w = workers[i];
+      bool closed = pfds[i].revents && readAvailable(w);
+      if (w.state && (closed || w.msg.size() >= 2)) {
+        bool success = w.msg.size() >= 2 && w.msg[0];
+        Solver::Validity validity =
+            success
+                ? static_cast<Solver::Validity>(static_cast<int8_t>(w.msg[1]))
+                : Solver::Unknown;
+        results.push_back(Result{w.state, w.condition, success, validity});
+        // the state goes on, the models refer to the constraints it had
+        if (!closed)
+          w.constraints = w.state->constraints;
+        else
+          finish(w, w.state->constraints);
+        w.state = nullptr;
+      } else if (closed) {
+        finish(w, w.constraints);
+      }
+      if (!closed)
+        running.push_back(std::move(w));
+    }
+    workers.swap(running);
+    if (!waiting)
+      return;
+  }
+}
+
+void SolverWorkerPool::cancelAll(std::vector<ExecutionState *> &states) {
+  for (const auto &w : workers) {
+    kill(w.pid, SIGKILL);
+    close(w.fd);
+    exiting.push_back(w.pid);
+    if (w.state)
+      states.push_back(w.state);
+  }
+  workers.clear();
+  reap(true);
+}
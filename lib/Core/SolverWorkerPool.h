@@ -0,0 +1,113 @@
+//===-- SolverWorkerPool.h --------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SOLVERWORKERPOOL_H
+#define KLEE_SOLVERWORKERPOOL_H
+
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Internal/System/Time.h"
+#include "klee/Solver/Solver.h"
+
+#include <sys/types.h>
+#include <vector>
+
+namespace klee {
+class ExecutionState;
+class TimingSolver;
+
+/// Evaluates the branch conditions of several states concurrently.
+///
+/// Every dispatched query is solved in a forked child process, which shares
+/// the expressions and constraints of the querying state with the executor
+/// through copy-on-write memory, so nothing has to be serialized. For the
+/// same reason a child only serves the query it was forked for: a long-lived
+/// worker would not see the states created after it.
+///
+/// The child reports the validity of the query through a pipe first, then a
+/// model of each feasible side of the branch and the solver statistics it
+/// gathered. The executor collects a query as soon as its validity arrives,
+/// and reads the rest later without blocking. Once the child is done, its
+/// results are learnt by the caches of the executor's solver chain, as if
+/// the executor had solved the query itself, and its statistics are added.
+class SolverWorkerPool {
+public:
+  struct Result {
+    ExecutionState *state;
+    ref<Expr> condition;
+    /// false if the query failed or timed out
+    bool success;
+    Solver::Validity validity;
+  };
+
+private:
+  struct Worker {
+    pid_t pid;
+    /// non-blocking read end of the pipe the child reports its result to
+    int fd;
+    /// the suspended state, or null once the validity was collected
+    ExecutionState *state;
+    ref<Expr> condition;
+    /// the constraints of the query, copied when the validity is collected
+    /// for learning the models the child reports afterwards
+    ConstraintManager constraints;
+    /// the bytes read from the pipe so far
+    std::vector<unsigned char> msg;
+  };
+
+  TimingSolver *solver;
+  unsigned maxWorkers;
+  std::vector<Worker> workers;
+  /// children which closed their pipe but had not exited yet
+  std::vector<pid_t> exiting;
+
+  /// The arrays models are reported for, which the executor and the child
+  /// compute alike from the unchanged constraints.
+  static void getObjects(const ConstraintManager &constraints,
+                         ref<Expr> condition,
+                         std::vector<const Array *> &objects);
+  /// Run in the child: solve the query and write the result to `fd`.
+  void runWorker(int fd, const ExecutionState &state, ref<Expr> condition);
+  /// Read what the child of `w` wrote so far.
+  /// \return true if the child closed the pipe
+  static bool readAvailable(Worker &w);
+  /// Learn the complete result of `w` and release its child.
+  void finish(Worker &w, const ConstraintManager &constraints);
+  /// Reap the children in `exiting`, waiting for them if `wait` is set.
+  void reap(bool wait);
+
+public:
+  SolverWorkerPool(TimingSolver *solver, unsigned maxWorkers);
+  ~SolverWorkerPool();
+
+  /// Children still reporting models count as workers, as they still use a
+  /// processor.
+  bool full() const { return workers.size() >= maxWorkers; }
+  bool empty() const { return workers.empty(); }
+
+  /// \return whether a query of `state` is being solved
+  bool isRunning(const ExecutionState &state) const;
+
+  /// Start evaluating `condition` under the constraints of `state` in a
+  /// child process. The state must not change until its result is collected.
+  /// \return false if no child process could be started
+  bool dispatch(ExecutionState &state, ref<Expr> condition,
+                time::Span timeout);
+
+  /// Append the results of queries whose validity is known to `results`.
+  /// If `wait` is set, block until at least one query is answered, unless
+  /// no state waits for one.
+  void collect(std::vector<Result> &results, bool wait);
+
+  /// Kill all running queries and append their states to `states`.
+  void cancelAll(std::vector<ExecutionState *> &states);
+};
+} // namespace klee
+
+#endif /* KLEE_SOLVERWORKERPOOL_H */
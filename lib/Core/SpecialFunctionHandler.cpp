@@ -27,6 +27,7 @@
 
 #include "llvm/ADT/Twine.h"
 #include "llvm/IR/DataLayout.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Module.h"
 
 #include <errno.h>
@@ -50,6 +51,14 @@ cl::opt<bool>
                               "condition given to klee_assume() rather than "
                               "emitting an error (default=false)"),
                      cl::cat(TerminationCat));
+
+cl::opt<bool>
+    NativeMemoryRoutines("native-memory-routines", cl::init(true),
+                         cl::desc("Execute memcpy, memmove, memset and "
+                                  "memcmp natively on concrete operands, "
+                                  "rather than interpreting their body "
+                                  "(default=true)"),
+                         cl::cat(HASECat));
 } // namespace
 
 /// \todo Almost all of the demands in this file should be replaced
@@ -230,6 +239,37 @@ void SpecialFunctionHandler::bind() {
     if (f && (!hi.doNotOverride || f->isDeclaration()))
       handlers[f] = std::make_pair(hi.handler, hi.hasReturnValue);
   }
+
+  if (!NativeMemoryRoutines)
+    return;
+
+  static const std::pair<const char *, NativeHandler> nativeHandlerInfo[] = {
+    {"memcmp", &SpecialFunctionHandler::handleMemcmp},
+    {"memcpy", &SpecialFunctionHandler::handleMemcpy},
+    {"memmove", &SpecialFunctionHandler::handleMemmove},
+    {"memset", &SpecialFunctionHandler::handleMemset},
+  };
+  for (const auto &hi : nativeHandlerInfo) {
+    Function *f = executor.kmodule->module->getFunction(hi.first);
+    // a body calling other functions, such as the instrumentation of the
+    // target program, does more than the routine itself
+    if (f && !f->isDeclaration() && !callsFunctions(*f)) {
+      nativeHandlers[f] = hi.second;
+      nativeSkeletons[f] = BranchSkeleton::create(
+          executor.kmodule->functionMap[f], *executor.kmodule->targetData);
+    }
+  }
+}
+
+bool SpecialFunctionHandler::callsFunctions(const Function &f) {
+  for (const auto &bb : f) {
+    for (const auto &i : bb) {
+      if ((isa<CallInst>(i) || isa<InvokeInst>(i)) &&
+          !isa<DbgInfoIntrinsic>(i))
+        return true;
+    }
+  }
+  return false;
 }
 
 
@@ -254,6 +294,27 @@ bool SpecialFunctionHandler::handle(ExecutionState &state,
   }
 }
 
+bool SpecialFunctionHandler::handleNative(ExecutionState &state,
+                                          Function *f,
+                                          KInstruction *target,
+                                          std::vector< ref<Expr> > &arguments) {
+  native_handlers_ty::iterator it = nativeHandlers.find(f);
+  if (it == nativeHandlers.end())
+    return false;
+  if (!state.shouldRecord())
+    return (this->*(it->second))(state, target, arguments);
+
+  // the branches of the body are part of the recorded path
+  const BranchSkeleton *skeleton = nativeSkeletons[f].get();
+  std::vector<bool> branches;
+  if (!skeleton || !skeleton->evaluate(arguments, branches) ||
+      !executor.canTakeConcreteBranches(state, branches) ||
+      !(this->*(it->second))(state, target, arguments))
+    return false;
+  executor.takeConcreteBranches(state, branches);
+  return true;
+}
+
 /****/
 
 // reads a concrete string from memory
@@ -1177,3 +1238,129 @@ void SpecialFunctionHandler::handleSetTime (
         state, "klee_set_time requries a constant argument", Executor::User);
   }
 }
+
+/* Native memory routines */
+
+bool SpecialFunctionHandler::resolveRange(ExecutionState &state,
+                                          ref<Expr> address, uint64_t n,
+                                          ObjectPair &op, unsigned &offset) {
+  ConstantExpr *CE = dyn_cast<ConstantExpr>(address);
+  if (!CE || !state.addressSpace.resolveOne(CE, op))
+    return false;
+  uint64_t a = CE->getZExtValue();
+  const MemoryObject *mo = op.first;
+  if (a < mo->address || a - mo->address > mo->size ||
+      n > mo->size - (a - mo->address))
+    return false;
+  offset = a - mo->address;
+  return true;
+}
+
+bool SpecialFunctionHandler::copyMemory(ExecutionState &state,
+                                        KInstruction *target,
+                                        std::vector<ref<Expr>> &arguments,
+                                        bool mayOverlap) {
+  assert(arguments.size() == 3 && "invalid number of arguments to memcpy");
+  ConstantExpr *n = dyn_cast<ConstantExpr>(arguments[2]);
+  if (!n)
+    return false;
+  uint64_t len = n->getZExtValue();
+  if (len) {
+    ObjectPair dst, src;
+    unsigned dstOffset, srcOffset;
+    if (!resolveRange(state, arguments[0], len, dst, dstOffset) ||
+        !resolveRange(state, arguments[1], len, src, srcOffset) ||
+        dst.second->readOnly)
+      return false;
+    // the body of memcpy decides what overlapping ranges hold
+    if (!mayOverlap && dst.first == src.first &&
+        dstOffset < srcOffset + len && srcOffset < dstOffset + len)
+      return false;
+
+    ObjectState *wos = state.addressSpace.getWriteable(dst.first, dst.second);
+    // the source is read before writing, so it does not matter whether it
+    // still is the copied object
+    wos->copy(dstOffset, dst.first == src.first ? *wos : *src.second,
+              srcOffset, len, Expr::FLAG_INSTRUCTION_ROOT, target);
+  }
+  executor.bindLocal(target, state, arguments[0]);
+  return true;
+}
+
+// void *memcpy(void *dst, const void *src, size_t n);
+bool SpecialFunctionHandler::handleMemcpy(ExecutionState &state,
+                                          KInstruction *target,
+                                          std::vector<ref<Expr>> &arguments) {
+  return copyMemory(state, target, arguments, false);
+}
+
+// void *memmove(void *dst, const void *src, size_t n);
+bool SpecialFunctionHandler::handleMemmove(ExecutionState &state,
+                                           KInstruction *target,
+                                           std::vector<ref<Expr>> &arguments) {
+  return copyMemory(state, target, arguments, true);
+}
+
+// void *memset(void *s, int c, size_t n);
+bool SpecialFunctionHandler::handleMemset(ExecutionState &state,
+                                          KInstruction *target,
+                                          std::vector<ref<Expr>> &arguments) {
+  assert(arguments.size() == 3 && "invalid number of arguments to memset");
+  ConstantExpr *c = dyn_cast<ConstantExpr>(arguments[1]);
+  ConstantExpr *n = dyn_cast<ConstantExpr>(arguments[2]);
+  if (!c || !n)
+    return false;
+  uint64_t len = n->getZExtValue();
+  if (len) {
+    ObjectPair op;
+    unsigned offset;
+    if (!resolveRange(state, arguments[0], len, op, offset) ||
+        op.second->readOnly)
+      return false;
+    ObjectState *wos = state.addressSpace.getWriteable(op.first, op.second);
+    wos->fill(offset, c->getZExtValue(8), len, Expr::FLAG_INSTRUCTION_ROOT,
+              target);
+  }
+  executor.bindLocal(target, state, arguments[0]);
+  return true;
+}
+
+// int memcmp(const void *s1, const void *s2, size_t n);
+bool SpecialFunctionHandler::handleMemcmp(ExecutionState &state,
+                                          KInstruction *target,
+                                          std::vector<ref<Expr>> &arguments) {
+  assert(arguments.size() == 3 && "invalid number of arguments to memcmp");
+  ConstantExpr *n = dyn_cast<ConstantExpr>(arguments[2]);
+  if (!n)
+    return false;
+  uint64_t len = n->getZExtValue();
+  int result = 0;
+  if (len) {
+    ObjectPair a, b;
+    unsigned aOffset, bOffset;
+    if (!resolveRange(state, arguments[0], len, a, aOffset) ||
+        !resolveRange(state, arguments[1], len, b, bOffset))
+      return false;
+
+    std::vector<uint8_t> aBytes(len), bBytes(len);
+    std::vector<ref<Expr>> aSymbolic, bSymbolic;
+    a.second->readBytes(aOffset, len, aBytes.data(), aSymbolic);
+    b.second->readBytes(bOffset, len, bBytes.data(), bSymbolic);
+    for (uint64_t i = 0; i != len; ++i) {
+      // the body forks on symbolic bytes
+      if ((!aSymbolic.empty() && !aSymbolic[i].isNull()) ||
+          (!bSymbolic.empty() && !bSymbolic[i].isNull()))
+        return false;
+      if (aBytes[i] != bBytes[i]) {
+        result = (int) aBytes[i] - (int) bBytes[i];
+        break;
+      }
+    }
+  }
+  executor.bindLocal(
+      target, state,
+      ConstantExpr::alloc(APInt(
+          executor.getWidthForLLVMType(target->inst->getType()), result,
+          true)));
+  return true;
+}
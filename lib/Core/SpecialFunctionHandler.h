@@ -10,8 +10,12 @@
 #ifndef KLEE_SPECIALFUNCTIONHANDLER_H
 #define KLEE_SPECIALFUNCTIONHANDLER_H
 
+#include "BranchSkeleton.h"
+
+#include <cstdint>
 #include <iterator>
 #include <map>
+#include <memory>
 #include <vector>
 #include <string>
 
@@ -24,6 +28,8 @@ namespace klee {
   class Expr;
   class ExecutionState;
   struct KInstruction;
+  class MemoryObject;
+  class ObjectState;
   template<typename T> class ref;
   
   class SpecialFunctionHandler {
@@ -38,6 +44,23 @@ namespace klee {
     handlers_ty handlers;
     class Executor &executor;
 
+    /// A handler run in place of a defined function, which returns false to
+    /// have the function body executed instead
+    typedef bool (SpecialFunctionHandler::*NativeHandler)(
+        ExecutionState &state, KInstruction *target,
+        std::vector<ref<Expr> > &arguments);
+    typedef std::map<const llvm::Function*, NativeHandler> native_handlers_ty;
+
+    /// The memory routines executed natively when their operands are
+    /// concrete, by the function implementing them
+    native_handlers_ty nativeHandlers;
+    /// The branches of the native routines, which are recorded or replayed
+    /// in place of executing their body. Routines whose branches depend on
+    /// memory have none and are only executed natively outside of the
+    /// recorded path.
+    std::map<const llvm::Function*, std::unique_ptr<BranchSkeleton> >
+        nativeSkeletons;
+
     struct HandlerInfo {
       const char *name;
       SpecialFunctionHandler::Handler handler;
@@ -91,9 +114,31 @@ namespace klee {
                 KInstruction *target,
                 std::vector< ref<Expr> > &arguments);
 
+    /// Execute the defined function `f` natively, if it is a memory routine
+    /// whose operands are concrete. Where the state records, the branches
+    /// the body would take are recorded, or read from the replayed path,
+    /// instead.
+    /// \return false if the function body must be executed instead
+    bool handleNative(ExecutionState &state,
+                      llvm::Function *f,
+                      KInstruction *target,
+                      std::vector< ref<Expr> > &arguments);
+
     /* Convenience routines */
 
     std::string readStringAtAddress(ExecutionState &state, ref<Expr> address);
+
+    /// \return true if the body of `f` calls another function
+    static bool callsFunctions(const llvm::Function &f);
+
+    /// Resolve the `n` bytes at the concrete `address` to a single object.
+    /// \return false if the address is symbolic or the bytes are not all in
+    /// bounds of one object
+    bool resolveRange(ExecutionState &state, ref<Expr> address, uint64_t n,
+                      std::pair<const MemoryObject*, const ObjectState*> &op,
+                      unsigned &offset);
+    bool copyMemory(ExecutionState &state, KInstruction *target,
+                    std::vector<ref<Expr> > &arguments, bool mayOverlap);
     
     /* Handlers */
 
@@ -162,6 +207,17 @@ namespace klee {
     HANDLER(handleGetTime);
     HANDLER(handleSetTime);
 #undef HANDLER
+
+    /* Native memory routines */
+
+#define NATIVE_HANDLER(name) bool name(ExecutionState &state, \
+                                       KInstruction *target, \
+                                       std::vector< ref<Expr> > &arguments)
+    NATIVE_HANDLER(handleMemcmp);
+    NATIVE_HANDLER(handleMemcpy);
+    NATIVE_HANDLER(handleMemmove);
+    NATIVE_HANDLER(handleMemset);
+#undef NATIVE_HANDLER
   };
 } // End klee namespace
 
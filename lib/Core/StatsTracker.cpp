@@ -338,7 +338,9 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
 
     Instruction *inst = es.pc()->inst;
     const InstructionInfo &ii = *es.pc()->info;
-    StackFrame &sf = es.stack().back();
+    // read through the const accessor, which does not unshare the stack
+    const StackFrame &sf =
+        static_cast<const ExecutionState &>(es).stack().back();
     theStatisticManager->setIndex(ii.id);
     if (UseCallPaths)
       theStatisticManager->setContext(&sf.callPathNode->statistics);
@@ -353,7 +355,7 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
         //
         // FIXME: This trick no longer works, we should fix this in the line
         // number propogation.
-          es.coveredLines[&ii.file].insert(ii.line);
+          es.coveredLines.mutate()[&ii.file].insert(ii.line);
 	es.coveredNew = true;
         es.instsSinceCovNew = 1;
 	++stats::coveredInstructions;
@@ -570,7 +572,7 @@ void StatsTracker::writeStatsLine() {
 void StatsTracker::updateStateStatistics(uint64_t addend) {
   for (std::set<ExecutionState*>::iterator it = executor.states.begin(),
          ie = executor.states.end(); it != ie; ++it) {
-    ExecutionState &state = **it;
+    const ExecutionState &state = **it;
     const InstructionInfo &ii = *state.pc()->info;
     theStatisticManager->incrementIndexedValue(stats::states, ii.id, addend);
     if (UseCallPaths)
@@ -44,22 +44,9 @@ namespace klee {
 /***/
 
 StackFrame::StackFrame(KInstIterator _caller, KFunction *_kf)
-    : caller(_caller), kf(_kf), callPathNode(0), minDistToUncoveredOnReturn(0),
-      varargs(0) {
-  locals = new Cell[kf->numRegisters];
-}
-
-StackFrame::StackFrame(const StackFrame &s)
-    : caller(s.caller), kf(s.kf), callPathNode(s.callPathNode),
-      allocas(s.allocas),
-      minDistToUncoveredOnReturn(s.minDistToUncoveredOnReturn),
-      varargs(s.varargs) {
-  locals = new Cell[s.kf->numRegisters];
-  for (unsigned i = 0; i < s.kf->numRegisters; i++)
-    locals[i] = s.locals[i];
-}
-
-StackFrame::~StackFrame() { delete[] locals; }
+    : caller(_caller), kf(_kf), callPathNode(0),
+      locals(std::vector<Cell>(kf->numRegisters)),
+      minDistToUncoveredOnReturn(0), varargs(0) {}
 
 Thread::Thread(thread_id_t tid, process_id_t pid, KFunction *start_function)
     : enabled(true), waitingList(0), isInPOSIX(false),
@@ -68,7 +55,7 @@ Thread::Thread(thread_id_t tid, process_id_t pid, KFunction *start_function)
          "null start_function when creating a new thread");
   tuid = std::make_pair(tid, pid);
   if (start_function) {
-    stack.push_back(StackFrame(nullptr, start_function));
+    stack.mutate().push_back(StackFrame(nullptr, start_function));
     pc = start_function->instructions;
     prevPC = nullptr;
   }
@@ -84,7 +71,7 @@ void Thread::dumpStack(llvm::raw_ostream &out) const {
   out << "Thread " << tuid.first << ", Process " << tuid.second << ", "
       << (enabled ? "enabled" : "disabled") << '\n';
   for (stack_ty::const_reverse_iterator
-         it = stack.rbegin(), ie = stack.rend();
+         it = stack->rbegin(), ie = stack->rend();
        it != ie; ++it) {
     const StackFrame &sf = *it;
     Function *f = sf.kf->function;
@@ -102,7 +89,7 @@ void Thread::dumpStack(llvm::raw_ostream &out) const {
 
       out << ai->getName().str();
       // XXX should go through function
-      ref<Expr> value = sf.locals[sf.kf->getArgRegister(index++)].value;
+      ref<Expr> value = (*sf.locals)[sf.kf->getArgRegister(index++)].value;
       if (value.get() && isa<ConstantExpr>(value))
         out << "=" << value;
     }
@@ -44,6 +44,20 @@ bool TimingSolver::evaluate(const ExecutionState& state, ref<Expr> expr,
   return success;
 }
 
+void TimingSolver::learnValidity(const ConstraintManager &constraints,
+                                 ref<Expr> expr, Solver::Validity result,
+                                 const Assignment *trueModel,
+                                 const Assignment *falseModel) {
+  if (isa<ConstantExpr>(expr))
+    return;
+
+  if (simplifyExprs)
+    expr = constraints.simplifyExpr(expr);
+
+  solver->learnValidity(Query(constraints, expr), result, trueModel,
+                        falseModel);
+}
+
 bool TimingSolver::mustBeTrue(const ExecutionState& state, ref<Expr> expr,
                               bool &result) {
   // Fast path, to avoid timer and OS overhead.
@@ -78,6 +92,23 @@ bool TimingSolver::mayBeTrue(const ExecutionState& state, ref<Expr> expr,
   return true;
 }
 
+bool TimingSolver::mayBeTrue(const ExecutionState& state,
+                             const ConstraintManager &constraints,
+                             ref<Expr> expr, bool &result) {
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(expr)) {
+    result = CE->isTrue() ? true : false;
+    return true;
+  }
+
+  TimerStatIncrementer timer(stats::solverTime);
+
+  bool success = solver->mayBeTrue(Query(constraints, expr), result);
+
+  state.queryCost += timer.delta();
+
+  return success;
+}
+
 bool TimingSolver::mayBeFalse(const ExecutionState& state, ref<Expr> expr,
                               bool &result) {
   bool res;
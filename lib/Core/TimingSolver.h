@@ -50,6 +50,13 @@ namespace klee {
 
     bool evaluate(const ExecutionState&, ref<Expr>, Solver::Validity &result);
 
+    /// Record the result of evaluate() on a state with the given constraints
+    /// and the same expression, computed elsewhere, in the caches of the
+    /// solver chain.
+    void learnValidity(const ConstraintManager &constraints, ref<Expr>,
+                       Solver::Validity result, const Assignment *trueModel,
+                       const Assignment *falseModel);
+
     bool mustBeTrue(const ExecutionState&, ref<Expr>, bool &result);
 
     bool mustBeFalse(const ExecutionState&, ref<Expr>, bool &result);
@@ -58,6 +65,13 @@ namespace klee {
 
     bool mayBeFalse(const ExecutionState&, ref<Expr>, bool &result);
 
+    /// Whether \p expr may be true under \p constraints rather than under
+    /// the constraints of the state, which is only charged for the query.
+    /// \p expr is not simplified, so it may already be one of the
+    /// constraints, to check that they are satisfiable.
+    bool mayBeTrue(const ExecutionState&, const ConstraintManager &constraints,
+                   ref<Expr>, bool &result);
+
     bool getValue(const ExecutionState &, ref<Expr> expr,
                   ref<ConstantExpr> &result);
 
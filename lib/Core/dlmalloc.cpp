@@ -5980,6 +5980,37 @@ size_t mspace_max_footprint(mspace msp) {
   return result;
 }
 
+void* mspace_region(mspace msp, size_t* size) {
+  void* result = 0;
+  mstate ms = (mstate)msp;
+  if (ok_magic(ms)) {
+    result = ms->seg.base;
+    *size = ms->seg.size;
+  }
+  else {
+    USAGE_ERROR_ACTION(ms,ms);
+  }
+  return result;
+}
+
+int mspace_load_region(mspace msp, const void* image, size_t size) {
+  mstate ms = (mstate)msp;
+  char* base;
+  if (!ok_magic(ms)) {
+    USAGE_ERROR_ACTION(ms,ms);
+    return -1;
+  }
+  base = ms->seg.base;
+  if (mprotect(base, size, MMAP_PROT) == -1)
+    return -1;
+  memcpy(base, image, size);
+  /* the image comes from another process, adopt it */
+  ms->magic = mparams.magic;
+  if (use_lock(ms))
+    (void)INITIAL_LOCK(&ms->mutex);
+  return 0;
+}
+
 size_t mspace_footprint_limit(mspace msp) {
   size_t result = 0;
   mstate ms = (mstate)msp;
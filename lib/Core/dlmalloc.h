@@ -627,6 +627,16 @@ int mspace_trim(mspace msp, size_t pad);
 size_t mspace_footprint(mspace msp);
 size_t mspace_max_footprint(mspace msp);
 size_t mspace_footprint_limit(mspace msp);
+/*
+  mspace_region returns the base and the size of the region holding all
+  memory of an mspace created with a base address, bookkeeping included.
+  Since that region grows contiguously, saving it saves the whole space.
+  mspace_load_region overwrites the region of an mspace created with the
+  same base address by such an image, possibly saved by another process.
+  It returns 0 on success.
+*/
+void* mspace_region(mspace msp, size_t* size);
+int mspace_load_region(mspace msp, const void* image, size_t size);
 size_t mspace_set_footprint_limit(mspace msp, size_t bytes);
 void mspace_inspect_all(mspace msp, 
                         void(*handler)(void *, void *, size_t, void*),
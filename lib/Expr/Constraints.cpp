@@ -10,6 +10,7 @@
 #include "klee/Expr/Constraints.h"
 
 #include "klee/Expr/ExprPPrinter.h"
+#include "klee/Expr/ExprUtil.h"
 #include "klee/Internal/Module/KModule.h"
 #include "klee/OptionCategories.h"
 #include "klee/Solver/SolverCmdLine.h"
@@ -21,6 +22,7 @@
 #include <map>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include "klee/Expr/ExprHashMap.h"
 #include "klee/util/RefHashMap.h"
 
@@ -37,66 +39,72 @@ llvm::cl::opt<bool> RewriteEqualities(
     llvm::cl::cat(SolvingCat));
 }
 
-// Non-null `to_replace` implies `UseIndependentSolver`
+// Only the constraints containing `replaced` are visited. Such a constraint
+// contains every ReadExpr of `replaced`, so it is enough to visit the
+// constraints indexed under the least frequent one.
 // For each successful rewriting, the old expression should be added to
 // `deletedConstraints` and deleted from constraints.
 // The new replacement expression should be added to `toAddConstraints`.
 // Other internal data structures (e.g. indep_indexer) should left untouched.
 bool ConstraintManager::rewriteConstraints(
-    ExprReplaceVisitorBase &visitor, const IndependentElementSet *to_replace,
+    ExprReplaceVisitorBase &visitor, const ref<Expr> &replaced,
     std::vector<ref<Expr>> &deleteConstraints,
     std::vector<ref<Expr>> &toAddConstraints) {
+  std::vector<ref<ReadExpr>> reads;
+  findReads(replaced, /*visitUpdates=*/true, reads);
+  const ExprHashSet *candidates = &constraints;
+  for (const ref<ReadExpr> &re : reads) {
+    auto it = occurrences.find(re);
+    if (it == occurrences.end())
+      return false;
+    if (it->second.size() < candidates->size())
+      candidates = &it->second;
+  }
+
+  // rewriting erases from the candidates, so iterate over a copy
+  std::vector<ref<Expr>> worklist(candidates->begin(), candidates->end());
   bool changed = false;
-  if (to_replace) {
-    assert(to_replace->exprs.size() == 1 &&
-           "Should only replace one Expr at a time");
-    // calculate independent elements related to the expr to be relaced
-    IndepElemSetPtrSet_ty indep_elemsets;
-    indep_indexer.getIntersection(to_replace, indep_elemsets);
-    if (DebugIndependentIntersection) {
-      IndepElemSetPtrSet_ty intersection_slowcheck;
-      for (auto it = factor_begin(); it != factor_end(); ++it) {
-        IndependentElementSet *elemset = *it;
-        if (to_replace->intersects(*elemset)) {
-          intersection_slowcheck.insert(elemset);
-        }
-      }
-      assert(indep_elemsets == intersection_slowcheck && "Indexer bug");
-    }
-    for (const IndependentElementSet *elemset : indep_elemsets) {
-      for (const ref<Expr> &e : elemset->exprs) {
-        ref<Expr> new_e = visitor.replace(e);
-        if (new_e != e) {
-          deleteConstraints.push_back(e);
-          toAddConstraints.push_back(new_e);
-          constraints.erase(e);
-          changed = true;
-        }
-      }
-    }
-  } else {
-    for (Constraints_ty::iterator it = constraints.begin(),
-                                  ie = constraints.end();
-         it != ie; ++it) {
-      const ref<Expr> &e = *it;
-      ref<Expr> new_e = visitor.replace(e);
-
-      if (new_e != e) {
-        // TODO: maybe I can check if the rewritten expr has the same
-        // IndependentSet as previous one.
-        deleteConstraints.push_back(e);
-        toAddConstraints.push_back(new_e);
-        constraints.erase(it++);
-        changed = true;
-      } else {
-        ++it;
-      }
+  for (const ref<Expr> &e : worklist) {
+    ref<Expr> new_e = visitor.replace(e);
+    if (new_e != e) {
+      // TODO: maybe I can check if the rewritten expr has the same
+      // IndependentSet as previous one.
+      deleteConstraints.push_back(e);
+      toAddConstraints.push_back(new_e);
+      constraints.erase(e);
+      removeOccurrences(e);
+      changed = true;
     }
   }
 
+  if (changed)
+    version = baseVersion = ++nextVersion;
   return changed;
 }
 
+void ConstraintManager::addOccurrences(const ref<Expr> &e) {
+  if (!RewriteEqualities)
+    return;
+  std::vector<ref<ReadExpr>> reads;
+  findReads(e, /*visitUpdates=*/true, reads);
+  for (const ref<ReadExpr> &re : reads)
+    occurrences[re].insert(e);
+}
+
+void ConstraintManager::removeOccurrences(const ref<Expr> &e) {
+  if (!RewriteEqualities)
+    return;
+  std::vector<ref<ReadExpr>> reads;
+  findReads(e, /*visitUpdates=*/true, reads);
+  for (const ref<ReadExpr> &re : reads) {
+    auto it = occurrences.find(re);
+    assert(it != occurrences.end() && "constraint was not indexed");
+    it->second.erase(e);
+    if (it->second.empty())
+      occurrences.erase(it);
+  }
+}
+
 void ConstraintManager::simplifyForValidConstraint(ref<Expr> e) {
   // XXX 
 }
@@ -105,7 +113,8 @@ ref<Expr> ConstraintManager::simplifyExpr(ref<Expr> e) const {
   if (isa<ConstantExpr>(e))
     return e;
   if (!replaceVisitor) {
-    replaceVisitor = new klee::ExprReplaceVisitorMulti(replacedUN, visitedUN, equalities);
+    replaceVisitor = new klee::ExprReplaceVisitorMulti(replacedUN, visitedUN,
+                                                       equalities, version);
   }
   ref<Expr> res = replaceVisitor->replace(e);
   return res;
@@ -154,21 +163,13 @@ bool ConstraintManager::addConstraintInternal(
           ExprReplaceVisitorSingle visitor(replacedUN, visitedUN, be->right,
                                      be->left);
           visitedUN.clear();
-          if (replaceVisitor)
-            replaceVisitor->resetVisited();
-          if (UseIndependentSolver) {
-            // create a new IndependentElementSet of the expr to be replaced
-            IndependentElementSet to_replace(be->right);
-            changed |= rewriteConstraints(visitor, &to_replace,
-                                          deleteConstraints, toAddConstraints);
-          } else {
-            changed |= rewriteConstraints(visitor, nullptr, deleteConstraints,
-                                          toAddConstraints);
-          }
+          changed |= rewriteConstraints(visitor, be->right, deleteConstraints,
+                                        toAddConstraints);
         }
       }
     }
     constraints.insert(e);
+    addOccurrences(e);
     updateEqualities(e, deleteConstraints);
     if (UseIndependentSolver) {
       // should first process deleted constraints then newly added
@@ -183,6 +184,7 @@ bool ConstraintManager::addConstraintInternal(
   default:
     // deleteConstraints should be empty here.
     constraints.insert(e);
+    addOccurrences(e);
     updateEqualities(e, deleteConstraints);
     if (UseIndependentSolver) {
       // should first process deleted constraints then newly added
@@ -287,33 +289,45 @@ void ConstraintManager::updateIndependentSetAdd(const ref<Expr> &e) {
     assert(indep_elemsets == intersection_slowcheck && "Indexer BUG");
   }
 
-  if (indep_elemsets.size() == 1) {
-    // lucky and cheap case: newly added constraint falls exactly in one
-    // existing factor we can reuse the existing factor
-    IndependentElementSet *singleIntersect = *(indep_elemsets.begin());
-    singleIntersect->add(*current);
-    indep_indexer.redirect(current, singleIntersect);
+  if (indep_elemsets.empty()) {
     for (auto &it : current->exprs) {
-      representative[it] = singleIntersect;
+      representative[it] = current;
     }
-    delete current;
+    indep_indexer.insert(current);
   } else {
-    // expensive case: need to merge multiple intersected independent sets
-    for (IndependentElementSet *indepSet : indep_elemsets) {
-      current->add(*indepSet);
-    }
-    // Update representative and factors.
-    for (auto it = current->exprs.begin(); it != current->exprs.end(); it++) {
-      representative[*it] = current;
+    // When several factors intersect the new constraint, they are merged
+    // into the largest one, which the new constraint is then added to.
+    IndependentElementSet *target = mergeFactors(indep_elemsets);
+    target->add(*current);
+    indep_indexer.redirect(current, target);
+    for (auto &it : current->exprs) {
+      representative[it] = target;
     }
+    delete current;
+  }
+}
 
-    for (IndependentElementSet *victim : indep_elemsets) {
-      indep_indexer.erase(victim);
-      delete victim;
+IndependentElementSet *
+ConstraintManager::mergeFactors(const IndepElemSetPtrSet_ty &factors) {
+  assert(!factors.empty() && "no factor to merge");
+  // merging the smaller factors into the larger one bounds the number of
+  // times an element or expression is copied
+  IndependentElementSet *target = *factors.begin();
+  for (IndependentElementSet *indepSet : factors) {
+    if (indepSet->exprs.size() > target->exprs.size())
+      target = indepSet;
+  }
+  for (IndependentElementSet *victim : factors) {
+    if (victim == target)
+      continue;
+    target->add(*victim);
+    for (auto &it : victim->exprs) {
+      representative[it] = target;
     }
-
-    indep_indexer.insert(current);
+    indep_indexer.merge(victim, target);
+    delete victim;
   }
+  return target;
 }
 
 void ConstraintManager::updateDeleteAdd(
@@ -326,16 +340,23 @@ void ConstraintManager::updateDeleteAdd(
 
 void ConstraintManager::updateEqualities(
     const ref<Expr> &e, const std::vector<ref<Expr>> &deleteConstraints) {
+  // the simplification results of replaceVisitor are invalidated per changed
+  // key, only those which may contain it are computed again
+  version = ++nextVersion;
   { // add one new constraint e
     bool isConstantEq = false;
     if (const EqExpr *EE = dyn_cast<EqExpr>(e)) {
       if (isa<ConstantExpr>(EE->left)) {
         equalities[EE->right] = EE->left;
+        if (replaceVisitor)
+          replaceVisitor->invalidate(EE->right);
         isConstantEq = true;
       }
     }
     if (!isConstantEq) {
       equalities[e] = ConstantExpr::alloc(1, Expr::Bool);
+      if (replaceVisitor)
+        replaceVisitor->invalidate(e);
     }
   }
   for (auto refE: deleteConstraints) {
@@ -343,11 +364,15 @@ void ConstraintManager::updateEqualities(
     if (const EqExpr *EE = dyn_cast<EqExpr>(refE)) {
       if (isa<ConstantExpr>(EE->left)) {
         equalities.erase(EE->right);
+        if (replaceVisitor)
+          replaceVisitor->invalidate(EE->right);
         isConstantEq = true;
       }
     }
     if (!isConstantEq) {
       equalities.erase(refE);
+      if (replaceVisitor)
+        replaceVisitor->invalidate(refE);
     }
   }
 }
@@ -402,6 +427,7 @@ ConstraintManager::ConstraintManager(const Constraints_ty &_constraints)
   std::vector<IndependentElementSet *> init_indep;
   for (const ref<Expr> &e : _constraints) {
     init_indep.push_back(new IndependentElementSet(e));
+    addOccurrences(e);
   }
   for (IndependentElementSet *indep : init_indep) {
     IndepElemSetPtrSet_ty intersected;
@@ -409,20 +435,12 @@ ConstraintManager::ConstraintManager(const Constraints_ty &_constraints)
     if (intersected.empty()) {
       // no intersection, just add
       indep_indexer.insert(indep);
-    } else if (intersected.size() == 1) {
-      // intersected with one element, easy merge
-      IndependentElementSet *singleIntersect = *(intersected.begin());
-      singleIntersect->add(*indep);
-      indep_indexer.redirect(indep, singleIntersect);
-      delete indep;
     } else {
-      // intersected with multiple elements, complex merge
-      for (IndependentElementSet *intersect : intersected) {
-        indep->add(*intersect);
-        indep_indexer.erase(intersect);
-        delete intersect;
-      }
-      indep_indexer.insert(indep);
+      // intersected with one or more factors, merge into them
+      IndependentElementSet *target = mergeFactors(intersected);
+      target->add(*indep);
+      indep_indexer.redirect(indep, target);
+      delete indep;
     }
   }
   for (auto it = factor_begin(); it != factor_end(); ++it) {
@@ -432,7 +450,8 @@ ConstraintManager::ConstraintManager(const Constraints_ty &_constraints)
   }
 }
 
-ConstraintManager::ConstraintManager(const ConstraintManager &cs) : constraints(cs.constraints) {
+ConstraintManager::ConstraintManager(const ConstraintManager &cs)
+    : constraints(cs.constraints), occurrences(cs.occurrences) {
   // Copy constructor needs to make deep copy of factors and representative
   // Here we assume every IndependentElementSet point in representative also exist in factors.
   for (auto it = cs.factor_begin(); it != cs.factor_end(); it++) {
@@ -444,6 +463,24 @@ ConstraintManager::ConstraintManager(const ConstraintManager &cs) : constraints(
   }
 }
 
+void ConstraintManager::swap(ConstraintManager &cs) {
+  std::swap(constraints, cs.constraints);
+  std::swap(representative, cs.representative);
+  std::swap(indep_indexer, cs.indep_indexer);
+  std::swap(equalities, cs.equalities);
+  std::swap(replacedUN, cs.replacedUN);
+  std::swap(visitedUN, cs.visitedUN);
+  std::swap(occurrences, cs.occurrences);
+  // a visitor refers to the equalities of its own ConstraintManager and caches
+  // results of them, so neither can be kept
+  delete replaceVisitor;
+  replaceVisitor = nullptr;
+  delete cs.replaceVisitor;
+  cs.replaceVisitor = nullptr;
+  version = baseVersion = ++nextVersion;
+  cs.version = cs.baseVersion = ++nextVersion;
+}
+
 // Destructor
 ConstraintManager::~ConstraintManager() {
   // Here we assume every IndependentElementSet point in representative also exist in factors.
@@ -456,8 +493,30 @@ ConstraintManager::~ConstraintManager() {
   // TODO Double check your assumption
 }
 
+uint64_t ConstraintManager::nextVersion = 0;
+
+const unsigned ConstraintManager::IndepElementSetIndexer::NoNode;
+
+unsigned
+ConstraintManager::IndepElementSetIndexer::find(unsigned node) const {
+  unsigned root = node;
+  while (parent[root] != root)
+    root = parent[root];
+  // path compression
+  while (parent[node] != root) {
+    unsigned next = parent[node];
+    parent[node] = root;
+    node = next;
+  }
+  return root;
+}
+
 void ConstraintManager::IndepElementSetIndexer::insert(
     IndependentElementSet *indep) {
+  unsigned node = parent.size();
+  parent.push_back(node);
+  nodeFactor.push_back(indep);
+  factorNode[indep] = node;
   redirect(indep, indep);
   factors.insert(indep);
 }
@@ -470,21 +529,31 @@ void ConstraintManager::IndepElementSetIndexer::erase(IndependentElementSet *ind
     wholeObj_index.erase(arr);
   }
   for (auto &elem : indep->elements) {
-    const Array *arr = elem.first;
-    const DenseSet<unsigned> &index_set = elem.second;
-    assert(wholeObj_index.count(arr) == 0 &&
+    assert(wholeObj_index.count(elem.first) == 0 &&
            "Removing invalid indep elemset: whole object is conflict with "
            "existing sparse elements.");
-    auto it = elements_index.find(arr);
-    if (it != elements_index.end()) {
-      for (unsigned index : index_set) {
-        it->second[index] = nullptr;
-      }
-    }
-  }
+    (void)elem;
+  }
+  // the elements still indexed with the node of the factor, or of factors
+  // merged into it, now map to no factor
+  auto it = factorNode.find(indep);
+  assert(it != factorNode.end() && "erasing an unknown factor");
+  nodeFactor[it->second] = nullptr;
+  factorNode.erase(it);
   factors.erase(indep);
 }
 
+void ConstraintManager::IndepElementSetIndexer::merge(
+    IndependentElementSet *src, IndependentElementSet *dst) {
+  auto it = factorNode.find(src);
+  assert(it != factorNode.end() && "merging an unknown factor");
+  unsigned node = it->second;
+  parent[node] = factorNode.at(dst);
+  nodeFactor[node] = nullptr;
+  factorNode.erase(it);
+  factors.erase(src);
+}
+
 void ConstraintManager::IndepElementSetIndexer::getIntersection(const IndependentElementSet *indep, IndepElemSetPtrSet_ty &out_intersected) const {
   // check wholeObject intersection
   for (const Array *arr : indep->wholeObjects) {
@@ -493,11 +562,13 @@ void ConstraintManager::IndepElementSetIndexer::getIntersection(const Independen
     if (wholeObj_it != wholeObj_index.end()) {
       // wholeObject intersects with wholeObject
       assert(elem_it == elements_index.end());
-      out_intersected.insert(wholeObj_it->second);
+      if (IndependentElementSet *p = getFactor(wholeObj_it->second)) {
+        out_intersected.insert(p);
+      }
     } else if (elem_it != elements_index.end()) {
       // wholeObject intersects with elements
-      for (IndependentElementSet *p : elem_it->second) {
-        if (p) {
+      for (unsigned node : elem_it->second) {
+        if (IndependentElementSet *p = getFactor(node)) {
           out_intersected.insert(p);
         }
       }
@@ -511,12 +582,13 @@ void ConstraintManager::IndepElementSetIndexer::getIntersection(const Independen
     if (wholeObj_it != wholeObj_index.end()) {
       // elements intersects with wholeObject
       assert(elem_it == elements_index.end());
-      out_intersected.insert(wholeObj_it->second);
+      if (IndependentElementSet *p = getFactor(wholeObj_it->second)) {
+        out_intersected.insert(p);
+      }
     } else if (elem_it != elements_index.end()) {
       // elements intersects with elements
       for (unsigned index : index_set) {
-        IndependentElementSet *p = elem_it->second[index];
-        if (p) {
+        if (IndependentElementSet *p = getFactor(elem_it->second[index])) {
           out_intersected.insert(p);
         }
       }
@@ -526,6 +598,7 @@ void ConstraintManager::IndepElementSetIndexer::getIntersection(const Independen
 
 void ConstraintManager::IndepElementSetIndexer::redirect(
     const IndependentElementSet *src, IndependentElementSet *dst) {
+  unsigned node = factorNode.at(dst);
   for (const Array *arr : src->wholeObjects) {
     // It is possible that an array is first accessed via independent elements
     // and then accessed symbolically (i.e. wholeObjects) in a new constraint.
@@ -534,22 +607,22 @@ void ConstraintManager::IndepElementSetIndexer::redirect(
     // independent set, which tracks wholeObjects.
     //
     // In the case of multiple old sets converted to a new set:
-    // Those old independent sets are always erased first (i.e. the expensive
-    // case in `UpdateIndependentSetAdd`) but an all-zero elements_index[arr]
-    // was not reclaimed.
+    // Those old independent sets are first merged into the largest of them
+    // (i.e. `mergeFactors`), which the new set is then combined into, so
+    // elements_index[arr] only maps to the merged factor.
     //
     // As for the second case, a single old independent set (tracks elements)
     // should be updated to include a new independent set (tracks wholeObject).
     // This is the lucky and cheap case in `UpdateIndependentSetAdd`, where the
     // new independent set (param src is combined into the old one (param. dst).
-    // In this case, elements_index[arr] is not all-zero, but should still be
+    // In both cases, elements_index[arr] is not all-zero, but should still be
     // erased.
     elements_index.erase(arr);
-    wholeObj_index[arr] = dst;
+    wholeObj_index[arr] = node;
   }
-  for (auto elem : src->elements) {
+  for (auto &elem : src->elements) {
     const Array *arr = elem.first;
-    DenseSet<unsigned> &index_set = elem.second;
+    const DenseSet<unsigned> &index_set = elem.second;
     // It is possible that an array is accessed via independent elements but is
     // accessed symbolically (i.e. wholeObjects) in existing constraints.
     // In this scenario, there could only be one intersected independent set,
@@ -560,13 +633,12 @@ void ConstraintManager::IndepElementSetIndexer::redirect(
     // In that case, we should only update wholeObj_index.
     auto wholeObj_it = wholeObj_index.find(arr);
     if (wholeObj_it != wholeObj_index.end()) {
-      wholeObj_it->second = dst;
+      wholeObj_it->second = node;
     } else {
-      auto it = elements_index.emplace(std::make_pair(
-          arr,
-          std::move(std::vector<IndependentElementSet *>(arr->size, nullptr))));
+      auto it = elements_index.emplace(
+          arr, std::vector<unsigned>(arr->size, NoNode));
       for (unsigned index : index_set) {
-        it.first->second[index] = dst;
+        it.first->second[index] = node;
       }
     }
   }
@@ -580,6 +652,14 @@ void ConstraintManager::IndepElementSetIndexer::checkExprsSum(size_t NExprs) {
   assert(n == NExprs);
 }
 
+void ConstraintManager::rebuildEqualities() {
+  equalities.clear();
+  if (replaceVisitor)
+    replaceVisitor->resetVisited();
+  for (const ref<Expr> &e : constraints)
+    updateEqualities(e, {});
+}
+
 // For debugging, dump all equalities to a given file
 void ConstraintManager::dumpEqualities(const char *filename) {
   char fallback_filename[] = "-";
@@ -24,6 +24,7 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include <sstream>
+#include <unordered_map>
 
 using namespace klee;
 using llvm::APInt;
@@ -63,6 +64,86 @@ cl::opt<Expr::KInstBindingPolicy> KInstBinding(
             "overwrite existing bindings if new bindings are cheaper")
             KLEE_LLVM_CL_VAL_END),
     cl::init(Expr::KInstBindingPolicy::LessCost), cl::cat(ExprCat));
+
+cl::opt<bool> HashConsExprs(
+    "hash-cons-exprs", cl::init(false),
+    cl::desc("Share one node between structurally equal non-constant "
+             "expressions, so that equality is decided by address. A shared "
+             "node is bound to instructions following --kinst-binding "
+             "(default=false)"),
+    cl::cat(ExprCat));
+
+/// Unique table of hash-consed expressions, by hash value. It is never
+/// destroyed, as expressions may outlive static destructors.
+std::unordered_multimap<unsigned, Expr *> &hashConsTable() {
+  static auto *table = new std::unordered_multimap<unsigned, Expr *>();
+  return *table;
+}
+}
+
+/// Shared nodes of small constants, see ConstantExpr::getShared(). The pool
+/// is never destroyed, as expressions may outlive static destructors.
+class klee::SmallConstantPool {
+  static const unsigned NumWidths = 5;
+  /// 0 to 255, only 0 and 1 for Bool: every concrete byte read from memory,
+  /// truth values, and most sizes, indices and counters
+  static const unsigned NumLow = 256;
+  /// -16 to -1, for the widths above 8 bits: all-ones masks, error codes
+  /// and small negative offsets
+  static const unsigned NumHigh = 16;
+
+  ref<ConstantExpr> low[NumWidths][NumLow];
+  ref<ConstantExpr> high[NumWidths][NumHigh];
+
+  static int getIndex(Expr::Width w) {
+    switch (w) {
+    case Expr::Bool:  return 0;
+    case Expr::Int8:  return 1;
+    case Expr::Int16: return 2;
+    case Expr::Int32: return 3;
+    case Expr::Int64: return 4;
+    default: return -1;
+    }
+  }
+
+  static ref<ConstantExpr> allocNode(const llvm::APInt &v) {
+    ref<ConstantExpr> r(new ConstantExpr(v));
+    r->computeHash();
+    return r;
+  }
+
+public:
+  SmallConstantPool() {
+    for (Expr::Width w : {Expr::Bool, Expr::Int8, Expr::Int16, Expr::Int32,
+                          Expr::Int64}) {
+      int i = getIndex(w);
+      for (unsigned v = 0; v < (w == Expr::Bool ? 2 : NumLow); ++v)
+        low[i][v] = allocNode(llvm::APInt(w, v));
+      if (w > Expr::Int8)
+        for (unsigned k = 0; k < NumHigh; ++k)
+          high[i][k] = allocNode(-llvm::APInt(w, k + 1));
+    }
+  }
+
+  const ref<ConstantExpr> *get(uint64_t v, Expr::Width w) const {
+    int i = getIndex(w);
+    if (i < 0)
+      return nullptr;
+    if (v < NumLow)
+      return low[i][v].isNull() ? nullptr : &low[i][v];
+    if (w <= Expr::Int8)
+      return nullptr;
+    // -v as a w-bit integer
+    uint64_t neg = (w == Expr::Int64 ? 0 : UINT64_C(1) << w) - v;
+    if (neg - 1 < NumHigh)
+      return &high[i][neg - 1];
+    return nullptr;
+  }
+};
+
+const ref<ConstantExpr> *ConstantExpr::getShared(uint64_t v, Width w) {
+  static const SmallConstantPool *pool = new SmallConstantPool();
+  return pool->get(v, w);
 }
 
 /***/
@@ -114,7 +195,7 @@ void Expr::updateKInst(const KInstruction *newkinst) {
   // NOTE: Since kinst tracked with "lastoccur" or "lessfreq" policy is no
   // longer guaranteed to be the latest instruction bind this symbolic value to
   // a llvm register, I should never use Expr::kinst to locate a llvm register.
-  if (!newkinst) return;
+  if (!newkinst || getKind() == Expr::Constant) return;
   bool should_update = false;
   switch (KInstBinding) {
   case KInstBindingPolicy::FirstOccur:
@@ -233,6 +314,51 @@ int Expr::compare(const Expr &b) const {
   return r;
 }
 
+bool Expr::isHashConsing() { return HashConsExprs; }
+
+ref<Expr> Expr::hashCons(const ref<Expr> &e) {
+  if (!HashConsExprs)
+    return e;
+  assert(!isa<ConstantExpr>(e) && "constants are not hash-consed");
+
+  auto &table = hashConsTable();
+  unsigned numKids = e->getNumKids();
+  Kind kind = e->getKind();
+  Width width = e->getWidth();
+  CompareCacheSemaphoreHolder CCSH;
+  auto range = table.equal_range(e->hashValue);
+  for (auto it = range.first; it != range.second; ++it) {
+    const Expr &other = *it->second;
+    if (other.getKind() != kind || other.getWidth() != width ||
+        other.getNumKids() != numKids)
+      continue;
+    bool same = true;
+    for (unsigned i = 0; same && i < numKids; ++i) {
+      ref<Expr> a = e->getKid(i), b = other.getKid(i);
+      same = a.get() == b.get() ||
+             (isa<ConstantExpr>(a) && isa<ConstantExpr>(b) &&
+              a->compareContents(*b) == 0);
+    }
+    if (same && e->compareContents(other) == 0)
+      return it->second;
+  }
+
+  e->hashConsed = true;
+  table.emplace(e->hashValue, e.get());
+  return e;
+}
+
+void Expr::removeFromHashConsTable() {
+  auto &table = hashConsTable();
+  auto range = table.equal_range(hashValue);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == this) {
+      table.erase(it);
+      return;
+    }
+  }
+}
+
 // returns 0 if b is structurally equal to *this
 int Expr::compare_internal(const Expr &b) const {
   if (this == &b) return 0;
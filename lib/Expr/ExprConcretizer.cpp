@@ -212,11 +212,11 @@ Constraints_ty ExprConcretizer::evaluate(const Constraints_ty &constraints) {
 /*
  * IndirectReadDepthCalculator
  */
-int IndirectReadDepthCalculator::getLevel(const ref<Expr> &e) {
-  auto it = depthStore.find(e.get());
+int IndirectReadDepthCalculator::getLevel(const Expr *e) {
+  auto it = depthStore.find(e);
 
   if (it == depthStore.end()) {
-    depthStore.insert(std::make_pair(e.get(), -1));
+    depthStore.insert(std::make_pair(e, -1));
     return -1;
   }
   else {
@@ -224,82 +224,75 @@ int IndirectReadDepthCalculator::getLevel(const ref<Expr> &e) {
   }
 }
 
-void IndirectReadDepthCalculator::putLevel(const ref<Expr> &e, int level) {
-  auto it = depthStore.find(e.get());
+void IndirectReadDepthCalculator::putLevel(const Expr *e, int level) {
+  auto it = depthStore.find(e);
   assert(it != depthStore.end());
 
   it->second = level;
 }
 
-int IndirectReadDepthCalculator::assignDepth(const ref<Expr> &e, int readLevel) {
-  int initialLevel = getLevel(e);
-
-  if (initialLevel >= readLevel) {
-    return initialLevel;
-  }
-  putLevel(e, readLevel);
-
-  // m means the maximum indirect depth which is maintained recursively
-  int m = readLevel;
-  if (ReadExpr *RE = dyn_cast<ReadExpr>(e)) {
-    updateMaxLevelfromKid(RE->index, readLevel + 1, m);
-    const UpdateNode *un = RE->updates.head.get();
-    std::vector<const UpdateNode *> un_vec;
-    while (un) {
-      un_vec.push_back(un);
-      updateMaxLevelfromKid(un->index, readLevel + 1, m);
-      updateMaxLevelfromKid(un->value, readLevel, m);
-      /*
-       * Indirect depth of an UpdateNode depends on its parent ReadExpr
-       */
-      auto insert_pair = depthStoreUNode.insert(std::make_pair(un, readLevel));
-      if (insert_pair.second) {
-        // insert successfully, meaning see this UNode first time
-        // do nothing
-        ;
+void IndirectReadDepthCalculator::assignDepth(const ref<Expr> &root,
+                                              int rootLevel) {
+  // (expr, indirect depth it occurs at), an expr is only walked again if it
+  // is reached at a larger depth
+  std::vector<std::pair<Expr *, int>> worklist;
+  worklist.push_back(std::make_pair(root.get(), rootLevel));
+  while (!worklist.empty()) {
+    Expr *e = worklist.back().first;
+    int readLevel = worklist.back().second;
+    worklist.pop_back();
+
+    if (getLevel(e) >= readLevel)
+      continue;
+    putLevel(e, readLevel);
+    maxLevel = std::max(maxLevel, readLevel);
+
+    if (ReadExpr *RE = dyn_cast<ReadExpr>(e)) {
+      if (!RE->index.isNull())
+        worklist.push_back(std::make_pair(RE->index.get(), readLevel + 1));
+      for (const UpdateNode *un = RE->updates.head.get(); un;
+           un = un->next.get()) {
+        if (!un->index.isNull())
+          worklist.push_back(std::make_pair(un->index.get(), readLevel + 1));
+        if (!un->value.isNull())
+          worklist.push_back(std::make_pair(un->value.get(), readLevel));
+        /*
+         * Indirect depth of an UpdateNode depends on its parent ReadExpr
+         */
+        auto insert_pair = depthStoreUNode.insert(std::make_pair(un, readLevel));
+        if (!insert_pair.second && readLevel > insert_pair.first->second)
+          insert_pair.first->second = readLevel;
       }
-      else {
-        decltype(depthStoreUNode)::iterator &existed = insert_pair.first;
-        if (readLevel > existed->second) {
-          existed->second = readLevel;
-        }
-      }
-      un = un->next.get();
-    }
 
-    if (!RE->index.isNull() && (RE->index->getKind() == Expr::Constant) &&
-        RE->updates.head.isNull()) {
-      lastLevelReads.insert(RE);
+      if (!RE->index.isNull() && (RE->index->getKind() == Expr::Constant) &&
+          RE->updates.head.isNull()) {
+        lastLevelReads.insert(RE);
+      }
     }
-  }
-  else {
-    for (unsigned int i=0; i < e->getNumKids(); ++i) {
-      updateMaxLevelfromKid(e->getKid(i), readLevel, m);
+    else {
+      for (unsigned int i=0; i < e->getNumKids(); ++i) {
+        Expr *kid = e->getKid(i).get();
+        if (kid)
+          worklist.push_back(std::make_pair(kid, readLevel));
+      }
     }
   }
-  return m;
 }
 
 IndirectReadDepthCalculator::IndirectReadDepthCalculator(
     const Constraints_ty &constraints) {
   maxLevel = 0;
-  for (const ref<Expr> &e: constraints) {
-    int m = assignDepth(e, 0);
-    if (m > maxLevel) maxLevel = m;
-  }
+  for (const ref<Expr> &e: constraints)
+    assignDepth(e, 0);
 }
 
 IndirectReadDepthCalculator::IndirectReadDepthCalculator(
     const expr::QueryCommand &QC) {
   maxLevel = 0;
-  for (const ref<Expr> &e: QC.Constraints) {
-    int m = assignDepth(e, 0);
-    if (m > maxLevel) maxLevel = m;
-  }
-  for (const ref<Expr> &e: QC.Values) {
-    int m = assignDepth(e, 0);
-    if (m > maxLevel) maxLevel = m;
-  }
+  for (const ref<Expr> &e: QC.Constraints)
+    assignDepth(e, 0);
+  for (const ref<Expr> &e: QC.Values)
+    assignDepth(e, 0);
 }
 
 
@@ -1,4 +1,11 @@
 #include "klee/Expr/ExprReplaceVisitor.h"
+
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
 using namespace klee;
 ref<UpdateNode>
 ExprReplaceVisitorBase::visitUpdateNode(const ref<UpdateNode> &un) {
@@ -67,3 +74,131 @@ ExprReplaceVisitorBase::visitUpdateNode(const ref<UpdateNode> &un) {
   }
   return nextUN;
 }
+
+ExprReplaceVisitorMulti::ReadSignature
+ExprReplaceVisitorMulti::getSignature(const ref<Expr> &e) {
+  ReadSignature sig;
+  if (isa<ConstantExpr>(e))
+    return sig;
+  auto it = signatures.find(e);
+  if (it != signatures.end())
+    return it->second;
+  if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+    size_t array = std::hash<const Array *>()(re->updates.root);
+    sig.arrays = 1ull << (array % 64);
+    if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index)) {
+      uint64_t element = array ^ (CE->getZExtValue() * 0x9e3779b97f4a7c15ull);
+      sig.elements = 1ull << (element % 64);
+    } else {
+      sig.symbolic = sig.arrays;
+      sig.add(getSignature(re->index));
+    }
+    if (!re->updates.head.isNull())
+      sig.add(getSignature(re->updates.head));
+  } else {
+    for (unsigned i = 0; i < e->getNumKids(); ++i)
+      sig.add(getSignature(e->getKid(i)));
+  }
+  signatures.insert(std::make_pair(e, sig));
+  return sig;
+}
+
+ExprReplaceVisitorMulti::ReadSignature
+ExprReplaceVisitorMulti::getSignature(const ref<UpdateNode> &un) {
+  // update lists can be long, so walk down to the first node with a known
+  // signature and fold the signatures back up
+  std::vector<ref<UpdateNode>> worklist;
+  ReadSignature sig;
+  for (ref<UpdateNode> n = un; !n.isNull(); n = n->next) {
+    auto it = updateSignatures.find(n);
+    if (it != updateSignatures.end()) {
+      sig = it->second;
+      break;
+    }
+    worklist.push_back(n);
+  }
+  while (!worklist.empty()) {
+    const ref<UpdateNode> &n = worklist.back();
+    sig.add(getSignature(n->index));
+    sig.add(getSignature(n->value));
+    updateSignatures.insert(std::make_pair(n, sig));
+    worklist.pop_back();
+  }
+  return sig;
+}
+
+static bool changedSince(uint64_t bits, const uint64_t *changed,
+                         uint64_t version) {
+  for (; bits; bits &= bits - 1)
+    if (changed[llvm::countTrailingZeros(bits)] > version)
+      return true;
+  return false;
+}
+
+static void markChanged(uint64_t bits, uint64_t *changed, uint64_t version) {
+  for (; bits; bits &= bits - 1)
+    changed[llvm::countTrailingZeros(bits)] = version;
+}
+
+bool ExprReplaceVisitorMulti::isValid(const Result &result) const {
+  // whether a rule changed after the result may share a ReadExpr with it, see
+  // ReadSignature
+  const ReadSignature &sig = result.signature;
+  if (changedSince(sig.elements, elementsChanged, result.version) &&
+      changedSince(sig.arrays, arraysChanged, result.version))
+    return false;
+  return !changedSince(sig.symbolic, arraysChanged, result.version) &&
+         !changedSince(sig.arrays, symbolicChanged, result.version);
+}
+
+ref<Expr> ExprReplaceVisitorMulti::replace(const ref<Expr> &e) {
+  ref<Expr> e_ret = ExprReplaceVisitorBase::replace(e);
+  // visited only dedups within this call, the results outlive it
+  for (const auto &it : visited) {
+    Result &result = results[it.first];
+    result.expr = it.second;
+    result.version = version;
+    result.signature = getSignature(it.first);
+  }
+  visited.clear();
+  if (results.size() > maxResults)
+    sweep();
+  return e_ret;
+}
+
+void ExprReplaceVisitorMulti::sweep() {
+  std::vector<uint64_t> versions;
+  for (auto it = results.begin(); it != results.end();) {
+    if (isValid(it->second)) {
+      versions.push_back(it->second.version);
+      ++it;
+    } else {
+      it = results.erase(it);
+    }
+  }
+
+  if (results.size() > maxResults / 2) {
+    auto oldest = versions.end() - maxResults / 2;
+    std::nth_element(versions.begin(), oldest, versions.end());
+    const uint64_t keepFrom = *oldest;
+    for (auto it = results.begin(); it != results.end();) {
+      if (it->second.version < keepFrom)
+        it = results.erase(it);
+      else
+        ++it;
+    }
+    // a single replace() call may have produced all of them
+    if (results.size() > maxResults)
+      results.clear();
+  }
+
+  signatures.clear();
+  updateSignatures.clear();
+}
+
+void ExprReplaceVisitorMulti::invalidate(const ref<Expr> &e) {
+  const ReadSignature sig = getSignature(e);
+  markChanged(sig.elements, elementsChanged, version);
+  markChanged(sig.arrays, arraysChanged, version);
+  markChanged(sig.symbolic, symbolicChanged, version);
+}
@@ -66,45 +66,24 @@ void IndependentElementSet::print(llvm::raw_ostream &os) const {
 
 // more efficient when this is the smaller set
 bool IndependentElementSet::intersects(const IndependentElementSet &b) const {
-  // If there are any symbolic arrays in our query that b accesses
-  const std::set<const Array*> *smallerWholeObjects = nullptr;
-  const std::set<const Array*> *largerWholeObjects = nullptr;
-  const elements_ty *elementsWithlargerWholeObjects = nullptr;
-  if (wholeObjects.size() < b.wholeObjects.size()) {
-    smallerWholeObjects = &wholeObjects;
-    largerWholeObjects = &(b.wholeObjects);
-    elementsWithlargerWholeObjects = &(b.elements);
-  } else {
-    smallerWholeObjects = &(b.wholeObjects);
-    largerWholeObjects = &wholeObjects;
-    elementsWithlargerWholeObjects = &elements;
+  // If there are any symbolic arrays in our query that b accesses, or the
+  // other way round
+  for (const Array *array : wholeObjects) {
+    if (b.wholeObjects.count(array) || b.elements.count(array))
+      return true;
   }
-  for (const Array* array: *smallerWholeObjects) {
-    if (largerWholeObjects->count(array) ||
-        (elementsWithlargerWholeObjects->find(array) !=
-         elementsWithlargerWholeObjects->end()))
+  for (const Array *array : b.wholeObjects) {
+    if (elements.count(array))
       return true;
   }
 
   // check whether concrete array accesses overlap
-  const elements_ty *smallerElements = nullptr;
-  const elements_ty *largerElements = nullptr;
-  const std::set<const Array*> *wholeObjectsWithlargerElements = nullptr;
-  if (elements.size() < b.elements.size()) {
-    smallerElements = &elements;
-    largerElements = &(b.elements);
-    wholeObjectsWithlargerElements = &(b.wholeObjects);
-  } else {
-    smallerElements = &(b.elements);
-    largerElements = &elements;
-    wholeObjectsWithlargerElements = &wholeObjects;
-  }
+  const elements_ty *smallerElements = &elements;
+  const elements_ty *largerElements = &(b.elements);
+  if (smallerElements->size() > largerElements->size())
+    std::swap(smallerElements, largerElements);
   for (const elements_ty::value_type &it : *smallerElements) {
-    const Array *array = it.first;
-    // if the array we access is symbolic in b
-    if (wholeObjectsWithlargerElements->count(array))
-      return true;
-    elements_ty::const_iterator it2 = largerElements->find(array);
+    elements_ty::const_iterator it2 = largerElements->find(it.first);
     // if any of the elements we access are also accessed by b
     if (it2 != largerElements->end()) {
       if (it.second.intersects(it2->second))
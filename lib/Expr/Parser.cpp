@@ -457,7 +457,10 @@ void ParserImpl::ParseUniqID(Token &Tok) {
 
     auto it = ExprSymTab.find(id);
     if (it != ExprSymTab.end()) {
-      assert(it->second->getKInst() == nullptr);
+      // with --hash-cons-exprs, labels of structurally equal expressions
+      // name one shared node, whose binding follows --kinst-binding
+      assert((Expr::isHashConsing() || it->second->getKInst() == nullptr) &&
+             "expression bound twice");
       it->second->updateKInst(ki);
     }
   }
@@ -64,6 +64,28 @@ bool IntrinsicCleanerPass::runOnBasicBlock(BasicBlock &b, Module &M) {
       case Intrinsic::fabs:
         break;
 
+        // Keep memory intrinsics, which the executor runs as calls to the
+        // routines implementing them. Declaring the routines has them
+        // linked in.
+      case Intrinsic::memcpy:
+      case Intrinsic::memmove: {
+        Type *i8p = Type::getInt8PtrTy(ctx);
+        Type *sizeType = DataLayout.getIntPtrType(ctx);
+        M.getOrInsertFunction(ii->getIntrinsicID() == Intrinsic::memcpy
+                                  ? "memcpy"
+                                  : "memmove",
+                              i8p, i8p, i8p,
+                              sizeType KLEE_LLVM_GOIF_TERMINATOR);
+        break;
+      }
+      case Intrinsic::memset: {
+        Type *i8p = Type::getInt8PtrTy(ctx);
+        M.getOrInsertFunction("memset", i8p, i8p, Type::getInt32Ty(ctx),
+                              DataLayout.getIntPtrType(ctx)
+                                  KLEE_LLVM_GOIF_TERMINATOR);
+        break;
+      }
+
         // Lower vacopy so that object resolution etc is handled by
         // normal instructions.
         //
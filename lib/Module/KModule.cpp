@@ -27,10 +27,13 @@
 #else
 #include "llvm/Bitcode/ReaderWriter.h"
 #endif
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
@@ -500,6 +503,70 @@ static int getOperandNum(Value *v,
   }
 }
 
+/// Compute the true target of a function call, resolving LLVM aliases
+/// and bitcasts.
+static Function *getTargetFunction(Value *calledVal) {
+  SmallPtrSet<const GlobalValue*, 3> Visited;
+
+  Constant *c = dyn_cast<Constant>(calledVal);
+  if (!c)
+    return 0;
+
+  while (true) {
+    if (GlobalValue *gv = dyn_cast<GlobalValue>(c)) {
+      if (!Visited.insert(gv).second)
+        return 0;
+
+      if (Function *f = dyn_cast<Function>(gv))
+        return f;
+      else if (GlobalAlias *ga = dyn_cast<GlobalAlias>(gv))
+        c = ga->getAliasee();
+      else
+        return 0;
+    } else if (llvm::ConstantExpr *ce = dyn_cast<llvm::ConstantExpr>(c)) {
+      if (ce->getOpcode()==Instruction::BitCast)
+        c = ce->getOperand(0);
+      else
+        return 0;
+    } else
+      return 0;
+  }
+}
+
+/// Decode the fields of ki that executing it needs, other than its operands.
+static void decodeInstruction(KInstruction *ki, const DataLayout &targetData,
+                              const std::map<Instruction*, KInstruction*> &kis) {
+  Instruction *inst = ki->inst;
+  ki->opcode = inst->getOpcode();
+  Type *ty = inst->getType();
+  ki->width = ty->isSized() ? targetData.getTypeSizeInBits(ty) : 0;
+  ki->callKind = KInstruction::NotACall;
+  ki->callee = nullptr;
+  ki->recorded = nullptr;
+
+  if (!isa<CallInst>(inst) && !isa<InvokeInst>(inst))
+    return;
+  CallSite cs(inst);
+  if (isa<DbgInfoIntrinsic>(inst)) {
+    ki->callKind = KInstruction::DebugIntrinsic;
+  } else if (InlineAsm *ia = dyn_cast<InlineAsm>(cs.getCalledValue())) {
+    const std::string &asmString = ia->getAsmString();
+    if (asmString == "ptwrite $0") {
+      ki->callKind = KInstruction::PTWrite;
+      auto it = kis.find(dyn_cast<Instruction>(inst->getOperand(0)));
+      assert(it != kis.end() && "ptwrite of a value which is not an instruction");
+      ki->recorded = it->second;
+    } else if (asmString == "tag") {
+      ki->callKind = KInstruction::Tag;
+    } else {
+      ki->callKind = KInstruction::InlineAsm;
+    }
+  } else {
+    ki->callKind = KInstruction::Call;
+    ki->callee = getTargetFunction(cs.getCalledValue());
+  }
+}
+
 KFunction::KFunction(llvm::Function *_function,
                      KModule *km) 
   : function(_function),
@@ -568,6 +635,13 @@ KFunction::KFunction(llvm::Function *_function,
       instructions[i++] = ki;
     }
   }
+
+  // after all instructions are built, as a ptwrite may record a later one
+  std::map<Instruction*, KInstruction*> kis;
+  for (unsigned j = 0; j < numInstructions; ++j)
+    kis[instructions[j]->inst] = instructions[j];
+  for (unsigned j = 0; j < numInstructions; ++j)
+    decodeInstruction(instructions[j], *km->targetData, kis);
 }
 
 KFunction::~KFunction() {
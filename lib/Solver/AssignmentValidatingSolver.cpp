@@ -35,6 +35,9 @@ public:
   SolverRunStatus getOperationStatusCode();
   char *getConstraintLog(const Query &);
   void setCoreSolverTimeout(time::Span timeout);
+  void learnValidity(const Query &query, Solver::Validity result,
+                     const Assignment *trueModel,
+                     const Assignment *falseModel);
 };
 
 // TODO: use computeInitialValues for all queries for more stress testing
@@ -153,6 +156,13 @@ void AssignmentValidatingSolver::setCoreSolverTimeout(time::Span timeout) {
   return solver->impl->setCoreSolverTimeout(timeout);
 }
 
+void AssignmentValidatingSolver::learnValidity(const Query &query,
+                                               Solver::Validity result,
+                                               const Assignment *trueModel,
+                                               const Assignment *falseModel) {
+  solver->impl->learnValidity(query, result, trueModel, falseModel);
+}
+
 Solver *createAssignmentValidatingSolver(Solver *s) {
   return new Solver(new AssignmentValidatingSolver(s));
 }
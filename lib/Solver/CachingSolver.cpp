@@ -86,6 +86,9 @@ public:
   SolverRunStatus getOperationStatusCode();
   char *getConstraintLog(const Query&);
   void setCoreSolverTimeout(time::Span timeout);
+  void learnValidity(const Query &query, Solver::Validity result,
+                     const Assignment *trueModel,
+                     const Assignment *falseModel);
 };
 
 /** @returns the canonical version of the given query.  The reference
@@ -253,6 +256,20 @@ void CachingSolver::setCoreSolverTimeout(time::Span timeout) {
   solver->impl->setCoreSolverTimeout(timeout);
 }
 
+void CachingSolver::learnValidity(const Query &query, Solver::Validity result,
+                                  const Assignment *trueModel,
+                                  const Assignment *falseModel) {
+  switch (result) {
+  case Solver::True:
+    cacheInsert(query, IncompleteSolver::MustBeTrue); break;
+  case Solver::False:
+    cacheInsert(query, IncompleteSolver::MustBeFalse); break;
+  default:
+    cacheInsert(query, IncompleteSolver::TrueOrFalse); break;
+  }
+  solver->impl->learnValidity(query, result, trueModel, falseModel);
+}
+
 ///
 
 Solver *klee::createCachingSolver(Solver *_solver) {
@@ -83,6 +83,10 @@ class CexCachingSolver : public SolverImpl {
   }
 
   bool getAssignment(const Query& query, Assignment *&result);
+
+  /// Cache `model` as the answer of `query`, if it binds all the arrays of
+  /// the query, or that the query has no solution if `model` is null.
+  void learnAssignment(const Query &query, const Assignment *model);
   
 public:
   CexCachingSolver(Solver *_solver) : solver(_solver) {}
@@ -98,6 +102,9 @@ public:
   SolverRunStatus getOperationStatusCode();
   char *getConstraintLog(const Query& query);
   void setCoreSolverTimeout(time::Span timeout);
+  void learnValidity(const Query &query, Solver::Validity result,
+                     const Assignment *trueModel,
+                     const Assignment *falseModel);
 };
 
 ///
@@ -262,6 +269,35 @@ bool CexCachingSolver::getAssignment(const Query& query, Assignment *&result) {
   return true;
 }
 
+void CexCachingSolver::learnAssignment(const Query &query,
+                                       const Assignment *model) {
+  KeyType key(query.constraints.begin(), query.constraints.end());
+  key.insert(Expr::createIsZero(query.expr));
+
+  Assignment *binding = 0;
+  if (model) {
+    std::vector<const Array*> objects;
+    findSymbolicObjects(key.begin(), key.end(), objects);
+    std::vector< std::vector<unsigned char> > values;
+    for (const Array *os : objects) {
+      auto it = model->bindings.find(os);
+      if (it == model->bindings.end())
+        return;
+      values.push_back(it->second);
+    }
+    binding = new Assignment(objects, values);
+
+    std::pair<assignmentsTable_ty::iterator, bool>
+      res = assignmentsTable.insert(binding);
+    if (!res.second) {
+      delete binding;
+      binding = *res.first;
+    }
+  }
+
+  cache.insert(key, binding);
+}
+
 ///
 
 CexCachingSolver::~CexCachingSolver() {
@@ -382,6 +418,19 @@ void CexCachingSolver::setCoreSolverTimeout(time::Span timeout) {
   solver->impl->setCoreSolverTimeout(timeout);
 }
 
+void CexCachingSolver::learnValidity(const Query &query,
+                                     Solver::Validity result,
+                                     const Assignment *trueModel,
+                                     const Assignment *falseModel) {
+  // getAssignment(query) looks for a model of the negated query expression
+  if (result == Solver::True || falseModel)
+    learnAssignment(query, result == Solver::True ? 0 : falseModel);
+  if (result == Solver::False || trueModel)
+    learnAssignment(query.negateExpr(),
+                    result == Solver::False ? 0 : trueModel);
+  solver->impl->learnValidity(query, result, trueModel, falseModel);
+}
+
 ///
 
 Solver *klee::createCexCachingSolver(Solver *_solver) {
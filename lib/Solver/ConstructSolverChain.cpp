@@ -24,7 +24,8 @@ Solver *constructSolverChain(Solver *coreSolver,
                              std::string querySMT2LogPath,
                              std::string baseSolverQuerySMT2LogPath,
                              std::string queryKQueryLogPath,
-                             std::string baseSolverQueryKQueryLogPath) {
+                             std::string baseSolverQueryKQueryLogPath,
+                             std::string queryCachePath) {
   Solver *solver = coreSolver;
   const time::Span minQueryTimeToLog(MinQueryTimeToLog);
 
@@ -40,6 +41,15 @@ Solver *constructSolverChain(Solver *coreSolver,
                  baseSolverQuerySMT2LogPath.c_str());
   }
 
+  if (UsePersistentQueryCache || !QueryCacheDir.empty()) {
+    std::string warmStorePath;
+    if (!QueryCacheDir.empty())
+      warmStorePath = QueryCacheDir + "/" + QUERY_CACHE_FILE_NAME;
+    solver = createPersistentCachingSolver(solver, warmStorePath,
+                                           queryCachePath);
+    klee_message("Recording solver results to %s", queryCachePath.c_str());
+  }
+
   if (UseAssignmentValidatingSolver)
     solver = createAssignmentValidatingSolver(solver);
 
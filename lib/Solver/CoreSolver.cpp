@@ -49,6 +49,16 @@ Solver *createCoreSolver(CoreSolverType cst) {
 #else
     klee_message("Not compiled with Z3 support");
     return NULL;
+#endif
+  case PORTFOLIO_SOLVER:
+#if defined(ENABLE_STP) && defined(ENABLE_Z3)
+    klee_message("Using portfolio of STP and Z3 solver backends");
+    // every backend already runs in its own process
+    return createPortfolioSolver(
+        new STPSolver(false, CoreSolverOptimizeDivides), new Z3Solver());
+#else
+    klee_message("Portfolio solver requires both STP and Z3 support");
+    return NULL;
 #endif
   case NO_SOLVER:
     klee_message("Invalid solver");
@@ -147,3 +147,10 @@ void StagedSolverImpl::setCoreSolverTimeout(time::Span timeout) {
   secondary->impl->setCoreSolverTimeout(timeout);
 }
 
+void StagedSolverImpl::learnValidity(const Query &query,
+                                     Solver::Validity result,
+                                     const Assignment *trueModel,
+                                     const Assignment *falseModel) {
+  secondary->impl->learnValidity(query, result, trueModel, falseModel);
+}
+
@@ -21,11 +21,18 @@
 #include "klee/TimerStatIncrementer.h"
 #include "klee/Solver/SolverImpl.h"
 
+#include "PipeIO.h"
+
+#include "llvm/Support/Errno.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <csignal>
 #include <list>
 #include <map>
 #include <ostream>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <vector>
 
 #undef INDEPENDENT_DEBUG
@@ -120,6 +127,16 @@ void calculateArrayReferences(const IndependentElementSet & ie,
   }
 }
 
+/// A query on some factors, answered with the values of the arrays they
+/// reference
+struct FactorQuery {
+  const Constraints_ty *constraints;
+  const IndependentElementSet *elements;
+  std::vector<const Array *> arrays;
+  /// the factors whose elements are taken from the answer
+  std::vector<const IndependentElementSet *> factors;
+};
+
 class IndependentSolver : public SolverImpl {
 private:
   Solver *solver;
@@ -154,9 +171,33 @@ public:
                             const std::vector<const Array*> &objects,
                             std::vector< std::vector<unsigned char> > &values,
                             bool &hasSolution);
+
+  /// Solve the factor queries, one after another or in parallel, and merge
+  /// their answers into the values of `objects`.
+  bool solveFactors(const Query &query,
+                    const std::vector<FactorQuery> &factorQueries,
+                    const std::vector<const Array *> &objects,
+                    std::vector<std::vector<unsigned char>> &values,
+                    bool &hasSolution);
+  bool solveFactor(const Query &query, const FactorQuery &factorQuery,
+                   std::vector<std::vector<unsigned char>> &values,
+                   bool &hasSolution);
+  /// Solve up to --independent-solver-jobs factor queries at once, each one
+  /// in its own process, since neither the solvers nor the expression
+  /// library are thread safe. Stops at the first failure or factor without
+  /// a solution.
+  bool solveFactorsForked(
+      const Query &query, const std::vector<FactorQuery> &factorQueries,
+      std::vector<std::vector<std::vector<unsigned char>>> &factorValues,
+      bool &hasSolution);
+  void runFactor(int fd, const Query &query, const FactorQuery &factorQuery);
+
   SolverRunStatus getOperationStatusCode();
   char *getConstraintLog(const Query&);
   void setCoreSolverTimeout(time::Span timeout);
+  void learnValidity(const Query &query, Solver::Validity result,
+                     const Assignment *trueModel,
+                     const Assignment *falseModel);
 };
   
 bool IndependentSolver::computeValidity(const Query& query,
@@ -234,35 +275,36 @@ bool assertCreatedPointEvaluatesToTrue(
   return cast<ConstantExpr>(q)->isTrue();
 }
 
-bool IndependentSolver::computeInitialValuesPerFactor(
-    const Query &query, const std::vector<const Array *> &objects,
-    std::vector<std::vector<unsigned char>> &values, bool &hasSolution) {
-  TimerStatIncrementer t(stats::independentTime);
-  // We assume the query has a solution except proven differently
-  // This is important in case we don't have any constraints but
-  // we need initial values for requested array objects.
-  hasSolution = true;
-  IndepElemSetPtrSet_ty::const_iterator factors_begin;
-  IndepElemSetPtrSet_ty::const_iterator factors_end;
-  // factors is only used if the query only contains a subset of constraints
-  IndepElemSetPtrSet_ty factors;
-  size_t factors_size __attribute__((unused));
+/// Get the factors of the query, which are all the factors of the
+/// ConstraintManager if the query has all of its constraints.
+static void getFactors(const Query &query,
+                       IndepElemSetPtrSet_ty::const_iterator &factors_begin,
+                       IndepElemSetPtrSet_ty::const_iterator &factors_end,
+                       IndepElemSetPtrSet_ty &factors) {
   if (&query.constraints == &query.constraintMgr.getAllConstraints()) {
     // the query contains all constraints managed by the ConstraintManager
     factors_begin = query.constraintMgr.factor_begin();
     factors_end = query.constraintMgr.factor_end();
-    factors_size = query.constraintMgr.factor_size();
   } else {
     // the query only contains a subset of constraints
     query.constraintMgr.getRelatedIndependentElementSets(query.constraints,
                                                          factors);
     factors_begin = factors.begin();
     factors_end = factors.end();
-    factors_size = factors.size();
   }
+}
 
-  //Used to rearrange all of the answers into the correct order
-  std::unordered_map<const Array*, std::vector<unsigned char> > retMap;
+bool IndependentSolver::computeInitialValuesPerFactor(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char>> &values, bool &hasSolution) {
+  TimerStatIncrementer t(stats::independentTime);
+  IndepElemSetPtrSet_ty::const_iterator factors_begin;
+  IndepElemSetPtrSet_ty::const_iterator factors_end;
+  // factors is only used if the query only contains a subset of constraints
+  IndepElemSetPtrSet_ty factors;
+  getFactors(query, factors_begin, factors_end, factors);
+
+  std::vector<FactorQuery> factorQueries;
 #ifdef INDEPENDENT_DEBUG
   unsigned int id = 0;
 #endif
@@ -271,87 +313,33 @@ bool IndependentSolver::computeInitialValuesPerFactor(
     const IndependentElementSet *indep = *it;
     std::unordered_set<const Array*> arraysInFactorSet;
     calculateArrayReferences(*indep, arraysInFactorSet);
-    std::vector<const Array *> arraysInFactor(arraysInFactorSet.begin(),
-                                              arraysInFactorSet.end());
     // Going to use this as the "fresh" expression for the Query() invocation below
     assert(indep->exprs.size() >= 1 && "No null/empty factors");
-    if (arraysInFactor.size() == 0){
+    if (arraysInFactorSet.size() == 0){
       continue;
     }
+    factorQueries.push_back(
+        {&indep->exprs, indep,
+         std::vector<const Array *>(arraysInFactorSet.begin(),
+                                    arraysInFactorSet.end()),
+         {indep}});
 #ifdef INDEPENDENT_DEBUG
     /* IndependentSolver performance debugging */
-    llvm::errs() << "independent set " << id << " / " << factors_size
-                 << " #array: " << arraysInFactor.size()
-                 << " #expr: " << indep->exprs.size() << ' ';
+    llvm::errs() << "independent set " << id
+                 << " #array: " << factorQueries.back().arrays.size()
+                 << " #expr: " << indep->exprs.size() << '\n';
 #ifdef INDEPENDENT_DEBUG_DUMPCONSTRAINTS
     char dumpfilename[128];
     snprintf(dumpfilename, sizeof(dumpfilename), "independentQuery_%05u.kquery",
              id);
-    ++id;
-    debugDumpConstraintsImpl(indep->exprs, arraysInFactor, dumpfilename);
-#endif
-    const WallTimer solver_timer;
-#endif
-    std::vector<std::vector<unsigned char> > tempValues;
-    if (!solver->impl->computeInitialValues(
-            Query(query.constraintMgr, indep->exprs,
-                  ConstantExpr::alloc(0, Expr::Bool), indep),
-            arraysInFactor, tempValues, hasSolution)) {
-      values.clear();
-      return false;
-    } else if (!hasSolution) {
-      values.clear();
-      return true;
-    } else {
-#ifdef INDEPENDENT_DEBUG
-      time::Span solver_time = solver_timer.delta();
-      const WallTimer result_timer;
+    debugDumpConstraintsImpl(indep->exprs, factorQueries.back().arrays,
+                             dumpfilename);
 #endif
-      assert(tempValues.size() == arraysInFactor.size() &&
-             "Should be equal number arrays and answers");
-      for (unsigned i = 0; i < tempValues.size(); i++){
-        if (retMap.count(arraysInFactor[i])){
-          // We already have an array with some partially correct answers,
-          // so we need to place the answers to the new query into the right
-          // spot while avoiding the undetermined values also in the array
-          std::vector<unsigned char> * tempPtr = &retMap[arraysInFactor[i]];
-          assert(tempPtr->size() == tempValues[i].size() &&
-                 "we're talking about the same array here");
-          auto find_it = indep->elements.find(arraysInFactor[i]);
-          assert(find_it != indep->elements.end());
-          const DenseSet<unsigned> * ds = &(find_it->second);
-          for (auto it2 = ds->begin(); it2 != ds->end(); it2++){
-            unsigned index = * it2;
-            (* tempPtr)[index] = tempValues[i][index];
-          }
-        } else {
-          // Dump all the new values into the array
-          retMap[arraysInFactor[i]] = tempValues[i];
-        }
-      }
-#ifdef INDEPENDENT_DEBUG
-      time::Span result_time = result_timer.delta();
-      llvm::errs() << "solver_time(us): " << solver_time.toMicroseconds()
-                   << " result_time(us): " << result_time.toMicroseconds()
-                   << "\n";
+    ++id;
 #endif
-    }
-  }
-  for (std::vector<const Array *>::const_iterator it = objects.begin();
-       it != objects.end(); it++){
-    const Array * arr = * it;
-    if (!retMap.count(arr)){
-      // this means we have an array that is somehow related to the
-      // constraint, but whose values aren't actually required to
-      // satisfy the query.
-      std::vector<unsigned char> ret(arr->size);
-      values.push_back(ret);
-    } else {
-      values.push_back(retMap[arr]);
-    }
   }
-  assert(assertCreatedPointEvaluatesToTrue(query, objects, values, retMap) && "should satisfy the equation");
-  return true;
+
+  return solveFactors(query, factorQueries, objects, values, hasSolution);
 }
 
 SolverImpl::SolverRunStatus IndependentSolver::getOperationStatusCode() {
@@ -366,6 +354,20 @@ void IndependentSolver::setCoreSolverTimeout(time::Span timeout) {
   solver->impl->setCoreSolverTimeout(timeout);
 }
 
+void IndependentSolver::learnValidity(const Query &query,
+                                      Solver::Validity result,
+                                      const Assignment *trueModel,
+                                      const Assignment *falseModel) {
+  // reduce the query as computeValidity() does, so that the learnt result
+  // is found under the same key
+  Constraints_ty required;
+  IndependentElementSet eltsClosure;
+  getIndependentConstraints(query, required, eltsClosure);
+  solver->impl->learnValidity(
+      Query(query.constraintMgr, required, query.expr, &eltsClosure), result,
+      trueModel, falseModel);
+}
+
 Solver *klee::createIndependentSolver(Solver *s) {
   return new Solver(new IndependentSolver(s));
 }
@@ -378,29 +380,13 @@ bool IndependentSolver::computeInitialValuesBatch(const Query& query,
 #ifdef INDEPENDENT_DEBUG
   const WallTimer total_timer;
 #endif
-  // We assume the query has a solution except proven differently
-  // This is important in case we don't have any constraints but
-  // we need initial values for requested array objects.
-  hasSolution = true;
   IndepElemSetPtrSet_ty::const_iterator factors_begin;
   IndepElemSetPtrSet_ty::const_iterator factors_end;
   // factors is only used if the query only contains a subset of constraints
   IndepElemSetPtrSet_ty factors;
-  if (&query.constraints == &query.constraintMgr.getAllConstraints()) {
-    // the query contains all constraints managed by the ConstraintManager
-    factors_begin = query.constraintMgr.factor_begin();
-    factors_end = query.constraintMgr.factor_end();
-  } else {
-    // the query only contains a subset of constraints
-    query.constraintMgr.getRelatedIndependentElementSets(query.constraints,
-                                                         factors);
-    factors_begin = factors.begin();
-    factors_end = factors.end();
-  }
+  getFactors(query, factors_begin, factors_end, factors);
 
-  //Used to rearrange all of the answers into the correct order
-  std::unordered_map<const Array*, std::vector<unsigned char> > retMap;
-  typedef std::vector<IndependentElementSet *> IndEleSetPart_t;
+  typedef std::vector<const IndependentElementSet *> IndEleSetPart_t;
   std::vector<IndEleSetPart_t> part_container(1);
 #ifdef INDEPENDENT_DEBUG
   unsigned int id = 0;
@@ -438,81 +424,105 @@ bool IndependentSolver::computeInitialValuesBatch(const Query& query,
 #else
   }
 #endif
-  for (const IndEleSetPart_t &p : part_container) {
-    Constraints_ty constraints;
+
+  // the constraints and elements of each part, which the queries point to
+  std::vector<Constraints_ty> constraints(part_container.size());
+  std::vector<IndependentElementSet> combined(part_container.size());
+  std::vector<FactorQuery> factorQueries;
+  for (size_t i = 0; i < part_container.size(); ++i) {
+    const IndEleSetPart_t &p = part_container[i];
     std::unordered_set<const Array *> arraysInFactorSet;
-    std::vector<const Array *> arraysInFactor;
-    IndependentElementSet combined;
-    for (IndependentElementSet *indep : p) {
+    for (const IndependentElementSet *indep : p) {
       calculateArrayReferences(*indep, arraysInFactorSet);
       // Going to use this as the "fresh" expression for the Query() invocation
       // below
       assert(indep->exprs.size() >= 1 && "No null/empty factors");
       assert(arraysInFactorSet.size() > 0);
-      constraints.insert(indep->exprs.begin(), indep->exprs.end());
-      combined.add(*indep);
+      constraints[i].insert(indep->exprs.begin(), indep->exprs.end());
+      combined[i].add(*indep);
     }
-    arraysInFactor.insert(arraysInFactor.end(), arraysInFactorSet.begin(),
-                          arraysInFactorSet.end());
+    factorQueries.push_back(
+        {&constraints[i], &combined[i],
+         std::vector<const Array *>(arraysInFactorSet.begin(),
+                                    arraysInFactorSet.end()),
+         p});
 #ifdef INDEPENDENT_DEBUG
     /* IndependentSolver performance debugging */
     llvm::errs() << "independent set part" << id
-                 << " #array: " << arraysInFactor.size()
-                 << " #expr: " << constraints.size() << ' ';
+                 << " #array: " << factorQueries.back().arrays.size()
+                 << " #expr: " << constraints[i].size() << '\n';
     char dumpfilename[128];
     snprintf(dumpfilename, sizeof(dumpfilename), "independentQuery_%05u.kquery",
              id);
     ++id;
-    debugDumpConstraintsImpl(constraints, arraysInFactor, dumpfilename);
-    const WallTimer solver_timer;
+    debugDumpConstraintsImpl(constraints[i], factorQueries.back().arrays,
+                             dumpfilename);
 #endif
-    std::vector<std::vector<unsigned char>> tempValues;
-    if (!solver->impl->computeInitialValues(
-            Query(query.constraintMgr, constraints,
-                  ConstantExpr::alloc(0, Expr::Bool), &combined),
-            arraysInFactor, tempValues, hasSolution)) {
-      values.clear();
-      return false;
-    } else if (!hasSolution) {
-      values.clear();
-      return true;
-    } else {
+  }
+
+  bool success = solveFactors(query, factorQueries, objects, values,
+                              hasSolution);
 #ifdef INDEPENDENT_DEBUG
-      time::Span solver_time = solver_timer.delta();
-      const WallTimer result_timer;
+  time::Span total_time = total_timer.delta();
+  llvm::errs() << "total time(us): " << total_time.toMicroseconds() << '\n';
 #endif
-      assert(tempValues.size() == arraysInFactor.size() &&
-             "Should be equal number arrays and answers");
-      for (unsigned i = 0; i < tempValues.size(); i++) {
-        if (retMap.count(arraysInFactor[i])) {
-          // We already have an array with some partially correct answers,
-          // so we need to place the answers to the new query into the right
-          // spot while avoiding the undetermined values also in the array
-          std::vector<unsigned char> *tempPtr = &retMap[arraysInFactor[i]];
-          assert(tempPtr->size() == tempValues[i].size() &&
-                 "we're talking about the same array here");
-          for (IndependentElementSet *it : p) {
-            auto find_it = it->elements.find(arraysInFactor[i]);
-            // assert(find_it != it->elements.end() &&
-            //       "Array found in IndependentElementSet is now gone");
-            if (find_it != it->elements.end()) {
-              const DenseSet<unsigned> &ds = find_it->second;
-              for (auto index : ds) {
-                (*tempPtr)[index] = tempValues[i][index];
-              }
+  return success;
+}
+
+bool IndependentSolver::solveFactors(
+    const Query &query, const std::vector<FactorQuery> &factorQueries,
+    const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char>> &values, bool &hasSolution) {
+  // We assume the query has a solution except proven differently
+  // This is important in case we don't have any constraints but
+  // we need initial values for requested array objects.
+  hasSolution = true;
+  std::vector<std::vector<std::vector<unsigned char>>> factorValues(
+      factorQueries.size());
+  bool success;
+  if (IndependentSolverJobs > 1 && factorQueries.size() > 1) {
+    success = solveFactorsForked(query, factorQueries, factorValues,
+                                 hasSolution);
+  } else {
+    success = true;
+    for (size_t i = 0; i < factorQueries.size() && success && hasSolution;
+         ++i)
+      success = solveFactor(query, factorQueries[i], factorValues[i],
+                            hasSolution);
+  }
+  if (!success || !hasSolution) {
+    values.clear();
+    return success;
+  }
+
+  //Used to rearrange all of the answers into the correct order
+  std::unordered_map<const Array*, std::vector<unsigned char> > retMap;
+  for (size_t f = 0; f < factorQueries.size(); ++f) {
+    const FactorQuery &fq = factorQueries[f];
+    std::vector<std::vector<unsigned char>> &tempValues = factorValues[f];
+    assert(tempValues.size() == fq.arrays.size() &&
+           "Should be equal number arrays and answers");
+    for (unsigned i = 0; i < tempValues.size(); i++) {
+      if (retMap.count(fq.arrays[i])) {
+        // We already have an array with some partially correct answers,
+        // so we need to place the answers to the new query into the right
+        // spot while avoiding the undetermined values also in the array
+        std::vector<unsigned char> *tempPtr = &retMap[fq.arrays[i]];
+        assert(tempPtr->size() == tempValues[i].size() &&
+               "we're talking about the same array here");
+        for (const IndependentElementSet *indep : fq.factors) {
+          auto find_it = indep->elements.find(fq.arrays[i]);
+          if (find_it != indep->elements.end()) {
+            const DenseSet<unsigned> &ds = find_it->second;
+            for (auto index : ds) {
+              (*tempPtr)[index] = tempValues[i][index];
             }
           }
-        } else {
-          // Dump all the new values into the array
-          retMap[arraysInFactor[i]] = tempValues[i];
         }
+      } else {
+        // Dump all the new values into the array
+        retMap[fq.arrays[i]] = std::move(tempValues[i]);
       }
-#ifdef INDEPENDENT_DEBUG
-      time::Span result_time = result_timer.delta();
-      llvm::errs() << "solver_time(us): " << solver_time.toMicroseconds()
-                   << " result_time(us): " << result_time.toMicroseconds()
-                   << "\n";
-#endif
     }
   }
   for (std::vector<const Array *>::const_iterator it = objects.begin();
@@ -528,10 +538,167 @@ bool IndependentSolver::computeInitialValuesBatch(const Query& query,
       values.push_back(retMap[arr]);
     }
   }
+  assert(assertCreatedPointEvaluatesToTrue(query, objects, values, retMap) && "should satisfy the equation");
+  return true;
+}
+
+bool IndependentSolver::solveFactor(
+    const Query &query, const FactorQuery &factorQuery,
+    std::vector<std::vector<unsigned char>> &values, bool &hasSolution) {
 #ifdef INDEPENDENT_DEBUG
-  time::Span total_time = total_timer.delta();
-  llvm::errs() << "total time(us): " << total_time.toMicroseconds() << '\n';
+  const WallTimer solver_timer;
 #endif
-  assert(assertCreatedPointEvaluatesToTrue(query, objects, values, retMap) && "should satisfy the equation");
+  bool success = solver->impl->computeInitialValues(
+      Query(query.constraintMgr, *factorQuery.constraints,
+            ConstantExpr::alloc(0, Expr::Bool), factorQuery.elements),
+      factorQuery.arrays, values, hasSolution);
+#ifdef INDEPENDENT_DEBUG
+  llvm::errs() << "solver_time(us): "
+               << solver_timer.delta().toMicroseconds() << "\n";
+#endif
+  return success;
+}
+
+/// Child side: solve and send back whether it succeeded, whether there is a
+/// solution and the size and bytes of every array.
+void IndependentSolver::runFactor(int fd, const Query &query,
+                                  const FactorQuery &factorQuery) {
+  std::vector<std::vector<unsigned char>> values;
+  bool hasSolution = false;
+  bool success = solveFactor(query, factorQuery, values, hasSolution);
+  unsigned char header[2] = {success, success && hasSolution};
+  if (!writeAll(fd, header, sizeof(header)) || !header[1])
+    return;
+  for (const auto &value : values) {
+    uint64_t size = value.size();
+    if (!writeAll(fd, &size, sizeof(size)) ||
+        !writeAll(fd, value.data(), size))
+      return;
+  }
+}
+
+/// Read the answer of a child to the values of `numArrays` arrays.
+/// \return false if the child did not send a complete answer
+static bool readFactor(int fd, size_t numArrays, bool &success,
+                       bool &hasSolution,
+                       std::vector<std::vector<unsigned char>> &values) {
+  unsigned char header[2];
+  if (!readAll(fd, header, sizeof(header)))
+    return false;
+  success = header[0];
+  hasSolution = header[1];
+  if (!hasSolution)
+    return true;
+  values.reserve(numArrays);
+  for (size_t i = 0; i < numArrays; ++i) {
+    uint64_t size;
+    if (!readAll(fd, &size, sizeof(size)))
+      return false;
+    values.emplace_back(size);
+    if (!readAll(fd, values.back().data(), size))
+      return false;
+  }
   return true;
 }
+
+bool IndependentSolver::solveFactorsForked(
+    const Query &query, const std::vector<FactorQuery> &factorQueries,
+    std::vector<std::vector<std::vector<unsigned char>>> &factorValues,
+    bool &hasSolution) {
+  fflush(stdout);
+  fflush(stderr);
+
+  /// A factor being solved in a child process
+  struct Job {
+    pid_t pid;
+    int fd;
+    size_t factor;
+  };
+  std::vector<Job> running;
+  size_t next = 0;
+  bool success = true;
+  while (success && hasSolution &&
+         (next < factorQueries.size() || !running.empty())) {
+    while (next < factorQueries.size() &&
+           running.size() < IndependentSolverJobs) {
+      int fds[2];
+      if (::pipe(fds) == -1) {
+        klee_warning_once(0, "pipe failed (for independent solver) - %s",
+                          llvm::sys::StrError(errno).c_str());
+        break;
+      }
+      pid_t pid = ::fork();
+      if (pid == -1) {
+        klee_warning_once(0, "fork failed (for independent solver) - %s",
+                          llvm::sys::StrError(errno).c_str());
+        ::close(fds[0]);
+        ::close(fds[1]);
+        break;
+      }
+      if (pid == 0) {
+        ::close(fds[0]);
+        for (const auto &job : running)
+          ::close(job.fd);
+        runFactor(fds[1], query, factorQueries[next]);
+        _exit(0);
+      }
+      ::close(fds[1]);
+      running.push_back({pid, fds[0], next++});
+    }
+    if (running.empty()) {
+      // no child could be started, so solve the next factor here
+      success = solveFactor(query, factorQueries[next], factorValues[next],
+                            hasSolution);
+      ++next;
+      continue;
+    }
+
+    std::vector<pollfd> pfds;
+    for (const auto &job : running)
+      pfds.push_back({job.fd, POLLIN, 0});
+    int ready = ::poll(pfds.data(), pfds.size(), -1);
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready < 0) {
+      klee_warning("poll failed (for independent solver) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      success = false;
+      break;
+    }
+
+    std::vector<Job> stillRunning;
+    for (size_t i = 0; i < running.size(); ++i) {
+      const Job &job = running[i];
+      if (!pfds[i].revents) {
+        stillRunning.push_back(job);
+        continue;
+      }
+      // the child only writes once it is done, and the pipe is closed when
+      // it exits, so this reads its whole answer
+      bool factorSuccess = false, factorHasSolution = false;
+      if (!readFactor(job.fd, factorQueries[job.factor].arrays.size(),
+                      factorSuccess, factorHasSolution,
+                      factorValues[job.factor])) {
+        klee_warning("independent solver child did not answer");
+        factorSuccess = false;
+      }
+      success = success && factorSuccess;
+      hasSolution = hasSolution && factorHasSolution;
+      ::close(job.fd);
+      int childStatus;
+      while (::waitpid(job.pid, &childStatus, 0) < 0 && errno == EINTR)
+        ;
+    }
+    running.swap(stillRunning);
+  }
+
+  // the answer is known without the factors still being solved
+  for (const auto &job : running) {
+    ::kill(job.pid, SIGKILL);
+    ::close(job.fd);
+    int childStatus;
+    while (::waitpid(job.pid, &childStatus, 0) < 0 && errno == EINTR)
+      ;
+  }
+  return success;
+}
@@ -0,0 +1,585 @@
+//===-- PersistentCachingSolver.cpp ---------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A query cache that survives the process. Results are keyed by a 128-bit
+// structural digest of (kind of request, constraints, query expression,
+// requested objects), which only depends on the content of the expressions
+// and not on their addresses, so that a later run asking the same question
+// finds the answer.
+//
+// A result is only returned if the query it was stored for is the same as
+// the one asked, not just its digest. Every record holds a canonical
+// serialization of its query, in which structurally equal subterms are
+// written once, and which is compared on a digest match.
+//
+// The store is an append-only file: a 4 byte magic and a version byte, then
+// one record per result: the digest as two little-endian uint64_t, the
+// little-endian uint32_t sizes of the query and of the payload, the query
+// and the payload. The store of a previous run is mapped and indexed at
+// startup; records are only read from the mapping on a digest match.
+//
+// Only the process which opened the store appends to it. Processes forked to
+// solve queries keep their results in memory, so records of concurrent
+// writers cannot interleave; the executor learns the results of its solver
+// workers itself.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver/Solver.h"
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/Support/FileHandling.h"
+#include "klee/Internal/Support/PathReader.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <unordered_map>
+
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+
+const char StoreMagic[4] = {'E', 'R', 'Q', 'C'};
+const unsigned StoreVersion = 2;
+const size_t StoreHeaderSize = sizeof(StoreMagic) + 1;
+const size_t RecordHeaderSize = 2 * sizeof(uint64_t) + 2 * sizeof(uint32_t);
+
+/// What a cached result answers. Mixed into the digest, so that the same
+/// query asked in different ways does not collide.
+enum RequestKind : uint8_t { ValidityRequest, TruthRequest, ValueRequest,
+                             InitialValuesRequest };
+
+struct Digest {
+  uint64_t lo, hi;
+
+  bool operator==(const Digest &other) const {
+    return lo == other.lo && hi == other.hi;
+  }
+};
+
+struct DigestHash {
+  size_t operator()(const Digest &d) const { return d.lo; }
+};
+
+inline uint64_t mix(uint64_t x) {
+  // splitmix64 finalizer
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+/// Accumulates values into two independently seeded 64-bit lanes.
+class DigestBuilder {
+  Digest d = {0x243f6a8885a308d3ULL, 0x13198a2e03707344ULL};
+
+public:
+  DigestBuilder &add(uint64_t v) {
+    d.lo = mix(d.lo ^ v);
+    d.hi = mix(d.hi + v * 0x9e3779b97f4a7c15ULL);
+    return *this;
+  }
+  DigestBuilder &add(const Digest &v) { return add(v.lo).add(v.hi); }
+  DigestBuilder &add(const std::string &s) {
+    add(s.size());
+    for (unsigned char c : s)
+      add(c);
+    return *this;
+  }
+  Digest get() const { return d; }
+};
+
+/// Computes structural digests of expressions, memoizing shared subterms.
+/// Memo tables are keyed by address, so an ExprDigester must not outlive the
+/// query it was built for.
+class ExprDigester {
+  std::unordered_map<const Expr *, Digest> exprs;
+  std::unordered_map<const UpdateNode *, Digest> updates;
+  std::unordered_map<const Array *, Digest> arrays;
+
+  Digest visit(const Array *array) {
+    auto it = arrays.find(array);
+    if (it != arrays.end())
+      return it->second;
+    DigestBuilder b;
+    b.add(array->name).add(array->size).add(array->domain).add(array->range);
+    b.add(array->constantValues.size());
+    for (const auto &value : array->constantValues)
+      b.add(visit(value));
+    return arrays[array] = b.get();
+  }
+
+  Digest visit(const UpdateList &ul) {
+    DigestBuilder b;
+    b.add(visit(ul.root));
+    // the chain is walked iteratively, as update lists can be very long
+    std::vector<const UpdateNode *> pending;
+    Digest tail = {0, 0};
+    for (const UpdateNode *un = ul.head.get(); un; un = un->next.get()) {
+      auto it = updates.find(un);
+      if (it != updates.end()) {
+        tail = it->second;
+        break;
+      }
+      pending.push_back(un);
+    }
+    for (auto it = pending.rbegin(); it != pending.rend(); ++it) {
+      DigestBuilder nb;
+      nb.add(tail).add(visit((*it)->index)).add(visit((*it)->value));
+      tail = updates[*it] = nb.get();
+    }
+    return b.add(tail).get();
+  }
+
+public:
+  Digest visit(const ref<Expr> &e) {
+    auto it = exprs.find(e.get());
+    if (it != exprs.end())
+      return it->second;
+    DigestBuilder b;
+    b.add(e->getKind()).add(e->getWidth());
+    switch (e->getKind()) {
+    case Expr::Constant: {
+      const llvm::APInt &value = cast<ConstantExpr>(e)->getAPValue();
+      for (unsigned i = 0; i < value.getNumWords(); ++i)
+        b.add(value.getRawData()[i]);
+      break;
+    }
+    case Expr::Read:
+      b.add(visit(cast<ReadExpr>(e)->updates));
+      break;
+    case Expr::Extract:
+      b.add(cast<ExtractExpr>(e)->offset);
+      break;
+    default:
+      break;
+    }
+    for (unsigned i = 0; i < e->getNumKids(); ++i)
+      b.add(visit(e->getKid(i)));
+    return exprs[e.get()] = b.get();
+  }
+};
+
+/// Writes the canonical form of a query. Subterms are numbered in the order
+/// they are completed, and a subterm structurally equal to a numbered one
+/// is written as a reference to it.
+class ExprSerializer {
+  std::string &out;
+  /// numbered expressions, by hash
+  std::unordered_map<unsigned, std::vector<std::pair<ref<Expr>, uint64_t>>>
+      exprs;
+  uint64_t numExprs = 0;
+  std::unordered_map<const UpdateNode *, uint64_t> updates;
+  std::unordered_map<const Array *, uint64_t> arrays;
+
+  void visit(const Array *array) {
+    auto it = arrays.find(array);
+    if (it != arrays.end()) {
+      add(it->second + 1);
+      return;
+    }
+    add(0).add(array->name).add(array->size).add(array->domain);
+    add(array->range).add(array->constantValues.size());
+    for (const auto &value : array->constantValues)
+      visit(value);
+    arrays.insert(std::make_pair(array, arrays.size()));
+  }
+
+  void visit(const UpdateList &ul) {
+    visit(ul.root);
+    std::vector<const UpdateNode *> pending;
+    uint64_t tail = 0;
+    for (const UpdateNode *un = ul.head.get(); un; un = un->next.get()) {
+      auto it = updates.find(un);
+      if (it != updates.end()) {
+        tail = it->second + 1;
+        break;
+      }
+      pending.push_back(un);
+    }
+    add(tail).add(pending.size());
+    for (auto it = pending.rbegin(); it != pending.rend(); ++it) {
+      visit((*it)->index);
+      visit((*it)->value);
+      updates.insert(std::make_pair(*it, updates.size()));
+    }
+  }
+
+public:
+  explicit ExprSerializer(std::string &out) : out(out) {}
+
+  /// Write `v` as LEB128.
+  ExprSerializer &add(uint64_t v) {
+    do {
+      unsigned char byte = v & 0x7f;
+      v >>= 7;
+      out.push_back(static_cast<char>(v ? byte | 0x80 : byte));
+    } while (v);
+    return *this;
+  }
+  ExprSerializer &add(const std::string &s) {
+    add(s.size());
+    out += s;
+    return *this;
+  }
+
+  void visit(const ref<Expr> &e) {
+    for (const auto &numbered : exprs[e->hash()]) {
+      if (numbered.first == e) {
+        add(numbered.second + 1);
+        return;
+      }
+    }
+    add(0).add(e->getKind()).add(e->getWidth());
+    switch (e->getKind()) {
+    case Expr::Constant: {
+      const llvm::APInt &value = cast<ConstantExpr>(e)->getAPValue();
+      for (unsigned i = 0; i < value.getNumWords(); ++i)
+        add(value.getRawData()[i]);
+      break;
+    }
+    case Expr::Read:
+      visit(cast<ReadExpr>(e)->updates);
+      break;
+    case Expr::Extract:
+      add(cast<ExtractExpr>(e)->offset);
+      break;
+    default:
+      break;
+    }
+    for (unsigned i = 0; i < e->getNumKids(); ++i)
+      visit(e->getKid(i));
+    // the kids may have grown the table
+    exprs[e->hash()].push_back(std::make_pair(e, numExprs++));
+  }
+};
+
+void writeLE(llvm::raw_ostream &os, uint64_t v, unsigned bytes) {
+  for (unsigned i = 0; i < bytes; ++i)
+    os << static_cast<char>(v >> (i * 8));
+}
+
+uint64_t readLE(const char *data, unsigned bytes) {
+  uint64_t v = 0;
+  for (unsigned i = 0; i < bytes; ++i)
+    v |= static_cast<uint64_t>(static_cast<uint8_t>(data[i])) << (i * 8);
+  return v;
+}
+
+} // namespace
+
+namespace klee {
+
+class PersistentCachingSolver : public SolverImpl {
+  /// A cached result, either in `warmStore` or in `added`
+  struct Record {
+    const char *query;
+    size_t querySize;
+    const char *payload;
+    size_t payloadSize;
+  };
+
+  /// A request in canonical form
+  struct Request {
+    Digest key;
+    std::string query;
+  };
+
+  Solver *solver;
+  MappedFile warmStore;
+  std::deque<std::string> added;
+  std::unordered_map<Digest, Record, DigestHash> index;
+  std::unique_ptr<llvm::raw_fd_ostream> store;
+  /// The process allowed to append to `store`
+  pid_t owner;
+
+  void loadStore(const std::string &path);
+  Request makeRequest(RequestKind kind, const Query &query,
+                      const std::vector<const Array *> *objects = nullptr);
+  bool lookup(const Request &request, Record &record);
+  void insert(const Request &request, std::string payload);
+
+public:
+  PersistentCachingSolver(Solver *s, const std::string &warmStorePath,
+                          const std::string &storePath);
+  ~PersistentCachingSolver() { delete solver; }
+
+  bool computeValidity(const Query &, Solver::Validity &result);
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char>> &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode() {
+    return solver->impl->getOperationStatusCode();
+  }
+  char *getConstraintLog(const Query &query) {
+    return solver->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span timeout) {
+    solver->impl->setCoreSolverTimeout(timeout);
+  }
+  void learnValidity(const Query &query, Solver::Validity result,
+                     const Assignment *trueModel,
+                     const Assignment *falseModel);
+};
+
+PersistentCachingSolver::PersistentCachingSolver(
+    Solver *s, const std::string &warmStorePath, const std::string &storePath)
+    : solver(s), owner(getpid()) {
+  if (!warmStorePath.empty())
+    loadStore(warmStorePath);
+
+  if (storePath.empty())
+    return;
+  std::string error;
+  store = klee_open_output_file(storePath, error);
+  if (!store)
+    klee_error("unable to open query cache %s: %s", storePath.c_str(),
+               error.c_str());
+  store->write(StoreMagic, sizeof(StoreMagic));
+  *store << static_cast<char>(StoreVersion);
+  // carry the results of the previous run over, so that the next run only
+  // needs the latest store
+  if (warmStore.size() > StoreHeaderSize)
+    store->write(warmStore.data() + StoreHeaderSize,
+                 warmStore.size() - StoreHeaderSize);
+  store->flush();
+}
+
+void PersistentCachingSolver::loadStore(const std::string &path) {
+  std::string error;
+  if (!warmStore.open(path, error)) {
+    klee_warning("query cache not loaded: %s", error.c_str());
+    return;
+  }
+  const char *data = warmStore.data();
+  size_t size = warmStore.size();
+  if (size < StoreHeaderSize || memcmp(data, StoreMagic, sizeof(StoreMagic)) ||
+      static_cast<uint8_t>(data[sizeof(StoreMagic)]) != StoreVersion)
+    klee_error("%s is not a query cache of version %u", path.c_str(),
+               StoreVersion);
+
+  size_t offset = StoreHeaderSize;
+  while (offset + RecordHeaderSize <= size) {
+    Digest key = {readLE(data + offset, 8), readLE(data + offset + 8, 8)};
+    size_t querySize = readLE(data + offset + 16, 4);
+    size_t payloadSize = readLE(data + offset + 20, 4);
+    const char *query = data + offset + RecordHeaderSize;
+    if (offset + RecordHeaderSize + querySize + payloadSize > size)
+      break;
+    index[key] = {query, querySize, query + querySize, payloadSize};
+    offset += RecordHeaderSize + querySize + payloadSize;
+  }
+  if (offset != size) {
+    // a run that was killed may leave a partial record behind
+    klee_warning("ignoring truncated record at the end of %s", path.c_str());
+    return;
+  }
+  klee_message("Loaded %zu cached query results from %s", index.size(),
+               path.c_str());
+}
+
+PersistentCachingSolver::Request PersistentCachingSolver::makeRequest(
+    RequestKind kind, const Query &query,
+    const std::vector<const Array *> *objects) {
+  ExprDigester digester;
+  // constraints are combined in digest order, as the order in which they
+  // were added to the state does not matter to the solver
+  std::vector<std::pair<Digest, ref<Expr>>> constraints;
+  constraints.reserve(query.constraints.size());
+  for (const auto &constraint : query.constraints)
+    constraints.push_back(
+        std::make_pair(digester.visit(constraint), constraint));
+  std::sort(constraints.begin(), constraints.end(),
+            [](const std::pair<Digest, ref<Expr>> &a,
+               const std::pair<Digest, ref<Expr>> &b) {
+              return a.first.lo < b.first.lo ||
+                     (a.first.lo == b.first.lo && a.first.hi < b.first.hi);
+            });
+
+  Request request;
+  DigestBuilder b;
+  ExprSerializer serializer(request.query);
+  b.add(kind).add(constraints.size());
+  serializer.add(kind).add(constraints.size());
+  for (const auto &constraint : constraints) {
+    b.add(constraint.first);
+    serializer.visit(constraint.second);
+  }
+  b.add(digester.visit(query.expr));
+  serializer.visit(query.expr);
+  if (objects) {
+    b.add(objects->size());
+    serializer.add(objects->size());
+    for (const auto *array : *objects) {
+      b.add(array->name).add(array->size);
+      serializer.add(array->name).add(array->size);
+    }
+  }
+  request.key = b.get();
+  return request;
+}
+
+bool PersistentCachingSolver::lookup(const Request &request, Record &record) {
+  auto it = index.find(request.key);
+  if (it == index.end() || it->second.querySize != request.query.size() ||
+      memcmp(it->second.query, request.query.data(), request.query.size())) {
+    ++stats::queryPersistentCacheMisses;
+    return false;
+  }
+  ++stats::queryPersistentCacheHits;
+  record = it->second;
+  return true;
+}
+
+void PersistentCachingSolver::insert(const Request &request,
+                                     std::string payload) {
+  if (store && getpid() == owner) {
+    writeLE(*store, request.key.lo, 8);
+    writeLE(*store, request.key.hi, 8);
+    writeLE(*store, request.query.size(), 4);
+    writeLE(*store, payload.size(), 4);
+    *store << request.query << payload;
+    // solver calls are expensive enough that the store can be kept
+    // complete, even if KLEE is killed
+    store->flush();
+  }
+  // a digest collision replaces the record: the latest query is more likely
+  // to be asked again
+  added.push_back(request.query + payload);
+  const char *data = added.back().data();
+  index[request.key] = {data, request.query.size(),
+                        data + request.query.size(), payload.size()};
+}
+
+bool PersistentCachingSolver::computeValidity(const Query &query,
+                                              Solver::Validity &result) {
+  Request request = makeRequest(ValidityRequest, query);
+  Record record;
+  if (lookup(request, record) && record.payloadSize == 1) {
+    result =
+        static_cast<Solver::Validity>(static_cast<int8_t>(record.payload[0]));
+    return true;
+  }
+  if (!solver->impl->computeValidity(query, result))
+    return false;
+  insert(request, std::string(1, static_cast<char>(result)));
+  return true;
+}
+
+void PersistentCachingSolver::learnValidity(const Query &query,
+                                            Solver::Validity result,
+                                            const Assignment *trueModel,
+                                            const Assignment *falseModel) {
+  Request request = makeRequest(ValidityRequest, query);
+  if (!index.count(request.key))
+    insert(request, std::string(1, static_cast<char>(result)));
+  solver->impl->learnValidity(query, result, trueModel, falseModel);
+}
+
+bool PersistentCachingSolver::computeTruth(const Query &query, bool &isValid) {
+  Request request = makeRequest(TruthRequest, query);
+  Record record;
+  if (lookup(request, record) && record.payloadSize == 1) {
+    isValid = record.payload[0];
+    return true;
+  }
+  if (!solver->impl->computeTruth(query, isValid))
+    return false;
+  insert(request, std::string(1, static_cast<char>(isValid)));
+  return true;
+}
+
+bool PersistentCachingSolver::computeValue(const Query &query,
+                                           ref<Expr> &result) {
+  Request request = makeRequest(ValueRequest, query);
+  Record record;
+  // payload: width as a uint32_t, then the words of the value
+  if (lookup(request, record) && record.payloadSize >= 4) {
+    Expr::Width width = readLE(record.payload, 4);
+    unsigned numWords = (width + 63) / 64;
+    if (record.payloadSize == 4 + numWords * 8) {
+      std::vector<uint64_t> words(numWords);
+      for (unsigned i = 0; i < numWords; ++i)
+        words[i] = readLE(record.payload + 4 + i * 8, 8);
+      result = ConstantExpr::alloc(llvm::APInt(width, words));
+      return true;
+    }
+  }
+  if (!solver->impl->computeValue(query, result))
+    return false;
+  if (ConstantExpr *ce = dyn_cast<ConstantExpr>(result)) {
+    std::string data;
+    llvm::raw_string_ostream os(data);
+    const llvm::APInt &value = ce->getAPValue();
+    writeLE(os, value.getBitWidth(), 4);
+    for (unsigned i = 0; i < value.getNumWords(); ++i)
+      writeLE(os, value.getRawData()[i], 8);
+    insert(request, os.str());
+  }
+  return true;
+}
+
+bool PersistentCachingSolver::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char>> &values, bool &hasSolution) {
+  Request request = makeRequest(InitialValuesRequest, query, &objects);
+  Record record;
+  // payload: whether there is a solution, then the bytes of every object
+  if (lookup(request, record) && record.payloadSize >= 1) {
+    size_t expected = 1;
+    if (record.payload[0])
+      for (const auto *array : objects)
+        expected += array->size;
+    if (record.payloadSize == expected) {
+      hasSolution = record.payload[0];
+      values.clear();
+      const char *pos = record.payload + 1;
+      if (hasSolution) {
+        for (const auto *array : objects) {
+          values.emplace_back(pos, pos + array->size);
+          pos += array->size;
+        }
+      }
+      return true;
+    }
+  }
+  if (!solver->impl->computeInitialValues(query, objects, values, hasSolution))
+    return false;
+  for (unsigned i = 0; hasSolution && i < objects.size(); ++i)
+    if (values[i].size() != objects[i]->size)
+      return true;
+  std::string data(1, static_cast<char>(hasSolution));
+  if (hasSolution)
+    for (const auto &value : values)
+      data.append(value.begin(), value.end());
+  insert(request, std::move(data));
+  return true;
+}
+
+Solver *createPersistentCachingSolver(Solver *s,
+                                      const std::string &warmStorePath,
+                                      const std::string &storePath) {
+  return new Solver(new PersistentCachingSolver(s, warmStorePath, storePath));
+}
+
+} // namespace klee
@@ -0,0 +1,55 @@
+//===-- PipeIO.h ------------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Reading and writing the answers of solvers run in child processes.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PIPEIO_H
+#define KLEE_PIPEIO_H
+
+#include <cerrno>
+#include <cstddef>
+#include <unistd.h>
+
+namespace klee {
+
+/// Write all of `size` bytes, retrying on short writes.
+inline bool writeAll(int fd, const void *buf, size_t size) {
+  const char *p = static_cast<const char *>(buf);
+  while (size) {
+    ssize_t n = ::write(fd, p, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+/// Read exactly `size` bytes. \return false on EOF or error
+inline bool readAll(int fd, void *buf, size_t size) {
+  char *p = static_cast<char *>(buf);
+  while (size) {
+    ssize_t n = ::read(fd, p, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+} // namespace klee
+
+#endif /* KLEE_PIPEIO_H */
@@ -0,0 +1,300 @@
+//===-- PortfolioSolver.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PipeIO.h"
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/ExprUtil.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+#include "klee/TimerStatIncrementer.h"
+
+#include "llvm/Support/Errno.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace klee;
+
+namespace klee {
+
+/// PortfolioSolverImpl - Runs every query on all backends at once, each one
+/// in its own process, and keeps the first answer. Processes rather than
+/// threads are used since neither STP nor the expression library is thread
+/// safe: children see the query through copy-on-write memory, and only the
+/// assignment goes back to the parent through a pipe.
+///
+/// Every query is answered through computeInitialValues, which is what the
+/// core solvers do internally as well.
+class PortfolioSolverImpl : public SolverImpl {
+public:
+  struct Backend {
+    Solver *solver;
+    /// Incremented every time this backend answers first
+    Statistic *wins;
+  };
+
+private:
+  std::vector<Backend> backends;
+  time::Span timeout;
+  SolverRunStatus runStatusCode;
+
+  /// A backend running in a child process
+  struct Racer {
+    pid_t pid;
+    int fd;
+    const Backend *backend;
+  };
+
+  void runBackend(const Backend &backend, int fd, const Query &query,
+                  const std::vector<const Array *> &objects);
+  SolverRunStatus race(const Query &query,
+                       const std::vector<const Array *> &objects,
+                       std::vector<std::vector<unsigned char>> &values,
+                       bool &hasSolution);
+
+public:
+  explicit PortfolioSolverImpl(std::vector<Backend> backends)
+      : backends(std::move(backends)), runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+    assert(!this->backends.empty() && "portfolio without backends");
+  }
+  ~PortfolioSolverImpl() {
+    for (auto &backend : backends)
+      delete backend.solver;
+  }
+
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char>> &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode() { return runStatusCode; }
+  char *getConstraintLog(const Query &query) {
+    return backends.front().solver->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span _timeout) {
+    timeout = _timeout;
+    for (auto &backend : backends)
+      backend.solver->impl->setCoreSolverTimeout(timeout);
+  }
+  void learnValidity(const Query &query, Solver::Validity result,
+                     const Assignment *trueModel,
+                     const Assignment *falseModel) {
+    for (auto &backend : backends)
+      backend.solver->impl->learnValidity(query, result, trueModel,
+                                          falseModel);
+  }
+};
+
+bool PortfolioSolverImpl::computeTruth(const Query &query, bool &isValid) {
+  std::vector<const Array *> objects;
+  std::vector<std::vector<unsigned char>> values;
+  bool hasSolution;
+
+  if (!computeInitialValues(query, objects, values, hasSolution))
+    return false;
+
+  isValid = !hasSolution;
+  return true;
+}
+
+bool PortfolioSolverImpl::computeValue(const Query &query, ref<Expr> &result) {
+  std::vector<const Array *> objects;
+  std::vector<std::vector<unsigned char>> values;
+  bool hasSolution;
+
+  findSymbolicObjects(query.expr, objects);
+  if (!computeInitialValues(query.withFalse(), objects, values, hasSolution))
+    return false;
+  assert(hasSolution && "state has invalid constraint set");
+
+  Assignment a(objects, values);
+  result = a.evaluate(query.expr);
+  return true;
+}
+
+bool PortfolioSolverImpl::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char>> &values, bool &hasSolution) {
+  TimerStatIncrementer t(stats::queryTime);
+  ++stats::queries;
+  if (!objects.empty())
+    ++stats::queryCounterexamples;
+
+  runStatusCode = race(query, objects, values, hasSolution);
+  bool success = runStatusCode == SOLVER_RUN_STATUS_SUCCESS_SOLVABLE ||
+                 runStatusCode == SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+  if (success) {
+    if (hasSolution)
+      ++stats::queriesInvalid;
+    else
+      ++stats::queriesValid;
+  }
+  return success;
+}
+
+/// Child side: solve and send back the run status, whether there is a
+/// solution and the bytes of every object.
+void PortfolioSolverImpl::runBackend(const Backend &backend, int fd,
+                                     const Query &query,
+                                     const std::vector<const Array *> &objects) {
+  std::vector<std::vector<unsigned char>> values;
+  bool hasSolution = false;
+  bool success = backend.solver->impl->computeInitialValues(query, objects,
+                                                            values, hasSolution);
+  unsigned char header[2] = {
+      static_cast<unsigned char>(
+          success ? (hasSolution ? SOLVER_RUN_STATUS_SUCCESS_SOLVABLE
+                                 : SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE)
+                  : backend.solver->impl->getOperationStatusCode()),
+      static_cast<unsigned char>(success && hasSolution)};
+  if (!writeAll(fd, header, sizeof(header)))
+    return;
+  if (success && hasSolution)
+    for (const auto &value : values)
+      if (!writeAll(fd, value.data(), value.size()))
+        return;
+}
+
+SolverImpl::SolverRunStatus
+PortfolioSolverImpl::race(const Query &query,
+                          const std::vector<const Array *> &objects,
+                          std::vector<std::vector<unsigned char>> &values,
+                          bool &hasSolution) {
+  fflush(stdout);
+  fflush(stderr);
+
+  std::vector<Racer> racers;
+  for (const auto &backend : backends) {
+    int fds[2];
+    if (::pipe(fds) == -1) {
+      klee_warning("pipe failed (for portfolio solver) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      break;
+    }
+    pid_t pid = ::fork();
+    if (pid == -1) {
+      klee_warning("fork failed (for portfolio solver) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      ::close(fds[0]);
+      ::close(fds[1]);
+      break;
+    }
+    if (pid == 0) {
+      ::close(fds[0]);
+      for (const auto &racer : racers)
+        ::close(racer.fd);
+      runBackend(backend, fds[1], query, objects);
+      _exit(0);
+    }
+    ::close(fds[1]);
+    racers.push_back({pid, fds[0], &backend});
+  }
+  if (racers.empty())
+    return SOLVER_RUN_STATUS_FORK_FAILED;
+
+  SolverRunStatus status = SOLVER_RUN_STATUS_FAILURE;
+  const Backend *winner = nullptr;
+  std::vector<Racer> running(racers);
+  time::Point deadline = time::getWallTime() + timeout;
+  while (!winner && !running.empty()) {
+    std::vector<pollfd> pfds;
+    for (const auto &racer : running)
+      pfds.push_back({racer.fd, POLLIN, 0});
+    int wait = -1;
+    if (timeout) {
+      time::Point now = time::getWallTime();
+      if (now >= deadline) {
+        status = SOLVER_RUN_STATUS_TIMEOUT;
+        break;
+      }
+      wait = std::max<int>(1, (deadline - now).toMicroseconds() / 1000);
+    }
+    int ready = ::poll(pfds.data(), pfds.size(), wait);
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready < 0) {
+      klee_warning("poll failed (for portfolio solver) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      break;
+    }
+
+    std::vector<Racer> stillRunning;
+    for (size_t i = 0; i < running.size(); ++i) {
+      const Racer &racer = running[i];
+      if (winner || !pfds[i].revents) {
+        stillRunning.push_back(racer);
+        continue;
+      }
+      // the child only writes once it is done, so this does not block for
+      // long; a child that died leaves us with a short read
+      unsigned char header[2];
+      if (!readAll(racer.fd, header, sizeof(header)))
+        continue;
+      auto childStatus = static_cast<SolverRunStatus>(header[0]);
+      if (childStatus != SOLVER_RUN_STATUS_SUCCESS_SOLVABLE &&
+          childStatus != SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
+        // keep the most informative failure in case every backend fails
+        if (status == SOLVER_RUN_STATUS_FAILURE)
+          status = childStatus;
+        continue;
+      }
+      hasSolution = header[1];
+      values.clear();
+      bool complete = true;
+      if (hasSolution) {
+        values.reserve(objects.size());
+        for (const auto object : objects) {
+          values.emplace_back(object->size);
+          if (object->size &&
+              !readAll(racer.fd, values.back().data(), object->size)) {
+            complete = false;
+            break;
+          }
+        }
+      }
+      if (!complete)
+        continue;
+      status = childStatus;
+      winner = racer.backend;
+    }
+    running.swap(stillRunning);
+  }
+
+  for (const auto &racer : running)
+    ::kill(racer.pid, SIGKILL);
+  for (const auto &racer : racers) {
+    ::close(racer.fd);
+    int childStatus;
+    while (::waitpid(racer.pid, &childStatus, 0) < 0 && errno == EINTR)
+      ;
+  }
+
+  if (winner)
+    ++*winner->wins;
+  else if (status == SOLVER_RUN_STATUS_TIMEOUT)
+    klee_warning("portfolio solver timed out");
+  return status;
+}
+
+Solver *createPortfolioSolver(Solver *stp, Solver *z3) {
+  return new Solver(new PortfolioSolverImpl(
+      {{stp, &stats::portfolioSTPWins}, {z3, &stats::portfolioZ3Wins}}));
+}
+
+} // namespace klee
@@ -219,6 +219,13 @@ void QueryLoggingSolver::setCoreSolverTimeout(time::Span timeout) {
   solver->impl->setCoreSolverTimeout(timeout);
 }
 
+void QueryLoggingSolver::learnValidity(const Query &query,
+                                       Solver::Validity result,
+                                       const Assignment *trueModel,
+                                       const Assignment *falseModel) {
+  solver->impl->learnValidity(query, result, trueModel, falseModel);
+}
+
 /*
 void QueryLoggingSolver::writeStackKQueries(std::string& buf) {
   logBuffer << buf;
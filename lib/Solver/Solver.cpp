@@ -108,6 +108,14 @@ Solver::getInitialValues(const Query& query,
   return success;
 }
 
+void Solver::learnValidity(const Query &query, Validity result,
+                           const Assignment *trueModel,
+                           const Assignment *falseModel) {
+  if (isa<ConstantExpr>(query.expr))
+    return;
+  impl->learnValidity(query, result, trueModel, falseModel);
+}
+
 // FIXME: to better handle solver timeout, getRange prototype should be changed
 // to return bool indicating success or not.
 std::pair< ref<Expr>, ref<Expr> > Solver::getRange(const Query& query) {
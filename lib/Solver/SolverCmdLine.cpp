@@ -54,6 +54,18 @@ cl::opt<bool> UseBranchCache("use-branch-cache", cl::init(true),
                              cl::desc("Use the branch cache (default=true)"),
                              cl::cat(SolvingCat));
 
+cl::opt<bool> UsePersistentQueryCache(
+    "use-persistent-query-cache", cl::init(false),
+    cl::desc("Record the results of solver queries in the output directory, "
+             "to be reused by later runs (default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<std::string> QueryCacheDir(
+    "query-cache-dir",
+    cl::desc("Reuse the solver results recorded in the given output directory "
+             "of a previous run. Implies --use-persistent-query-cache"),
+    cl::cat(SolvingCat));
+
 cl::opt<bool>
     UseIndependentSolver("use-independent-solver", cl::init(true),
                          cl::desc("Use constraint independence (default=true)"),
@@ -89,6 +101,13 @@ cl::opt<unsigned int> ExprNumThreshold(
         "Max number of exprs should IndependentSolver split (default=500)"),
     cl::cat(SolvingCat));
 
+cl::opt<unsigned> IndependentSolverJobs(
+    "independent-solver-jobs", cl::init(1),
+    cl::desc("Number of independent factors, or batches of them, the "
+             "IndependentSolver solves at once in forked processes when "
+             "computing a whole assignment (default=1)"),
+    cl::cat(SolvingCat));
+
 cl::opt<bool> DebugValidateSolver(
     "debug-validate-solver", cl::init(false),
     cl::desc("Crosscheck the results of the solver chain above the core solver "
@@ -228,7 +247,9 @@ cl::opt<CoreSolverType> CoreSolverToUse(
                clEnumValN(METASMT_SOLVER, "metasmt",
                           "metaSMT" METASMT_IS_DEFAULT_STR),
                clEnumValN(DUMMY_SOLVER, "dummy", "Dummy solver"),
-               clEnumValN(Z3_SOLVER, "z3", "Z3" Z3_IS_DEFAULT_STR)
+               clEnumValN(Z3_SOLVER, "z3", "Z3" Z3_IS_DEFAULT_STR),
+               clEnumValN(PORTFOLIO_SOLVER, "portfolio",
+                          "Race STP and Z3 on every query")
                    KLEE_LLVM_CL_VAL_END),
     cl::init(DEFAULT_CORE_SOLVER), cl::cat(SolvingCat));
 
@@ -18,9 +18,14 @@ Statistic stats::queryCacheHits("QueryCacheHits", "QChits") ;
 Statistic stats::queryCacheMisses("QueryCacheMisses", "QCmisses");
 Statistic stats::queryCexCacheHits("QueryCexCacheHits", "QCexHits") ;
 Statistic stats::queryCexCacheMisses("QueryCexCacheMisses", "QCexMisses");
+Statistic stats::queryPersistentCacheHits("QueryPersistentCacheHits", "QPChits");
+Statistic stats::queryPersistentCacheMisses("QueryPersistentCacheMisses", "QPCmisses");
 Statistic stats::queryConstructTime("QueryConstructTime", "QBtime") ;
 Statistic stats::queryConstructs("QueriesConstructs", "QB");
 Statistic stats::queryCounterexamples("QueriesCEX", "Qcex");
+Statistic stats::queryIncrementalResyncs("QueryIncrementalResyncs", "QIresync");
+Statistic stats::portfolioSTPWins("PortfolioSTPWins", "PfSTP");
+Statistic stats::portfolioZ3Wins("PortfolioZ3Wins", "PfZ3");
 Statistic stats::independentConstraints("IndepentConstraints", "ICons");
 Statistic stats::independentAllConstraints("IndependentAllConstraints", "IAllCons");
 Statistic stats::independentTime("IndependentTime", "Itime");
@@ -34,6 +34,9 @@ public:
   SolverRunStatus getOperationStatusCode();
   char *getConstraintLog(const Query &);
   void setCoreSolverTimeout(time::Span timeout);
+  void learnValidity(const Query &query, Solver::Validity result,
+                     const Assignment *trueModel,
+                     const Assignment *falseModel);
 };
 
 bool ValidatingSolver::computeTruth(const Query &query, bool &isValid) {
@@ -137,6 +140,13 @@ void ValidatingSolver::setCoreSolverTimeout(time::Span timeout) {
   solver->impl->setCoreSolverTimeout(timeout);
 }
 
+void ValidatingSolver::learnValidity(const Query &query,
+                                     Solver::Validity result,
+                                     const Assignment *trueModel,
+                                     const Assignment *falseModel) {
+  solver->impl->learnValidity(query, result, trueModel, falseModel);
+}
+
 Solver *createValidatingSolver(Solver *s, Solver *oracle) {
   return new Solver(new ValidatingSolver(s, oracle));
 }
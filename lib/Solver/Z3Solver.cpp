@@ -27,6 +27,8 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <unordered_set>
+
 namespace {
 // NOTE: Very useful for debugging Z3 behaviour. These files can be given to
 // the z3 binary to replay all Z3 API calls using its `-log` option.
@@ -51,6 +53,15 @@ llvm::cl::opt<bool> Z3ValidateModels(
     llvm::cl::desc("When generating Z3 models validate these against the query"),
     llvm::cl::cat(klee::SolvingCat));
 
+llvm::cl::opt<bool> Z3Incremental(
+    "z3-incremental", llvm::cl::init(false),
+    llvm::cl::desc("Keep one Z3 solver alive across queries. Constraints of "
+                   "the querying state are asserted once and each query runs "
+                   "in its own push/pop frame. Mostly useful for replay, "
+                   "where a single state's constraints grow monotonically "
+                   "(default=false)"),
+    llvm::cl::cat(klee::SolvingCat));
+
 llvm::cl::opt<unsigned>
     Z3VerbosityLevel("debug-z3-verbosity", llvm::cl::init(0),
                      llvm::cl::desc("Z3 verbosity level (default=0)"),
@@ -75,6 +86,27 @@ private:
                          const std::vector<const Array *> *objects,
                          std::vector<std::vector<unsigned char> > *values,
                          bool &hasSolution);
+  // Incremental solving (--z3-incremental).
+  // `incSolver` is persistent. Its base level holds every constraint in
+  // `incAsserted` together with the axioms of every constant array in
+  // `incConstantArrays`. A query only pushes a frame for its own expression.
+  // `incManager` is the ConstraintManager which the base level was last
+  // synced with, at version `incVersion`.
+  ::Z3_solver incSolver;
+  ExprHashSet incAsserted;
+  const ConstraintManager *incManager = nullptr;
+  uint64_t incVersion = 0;
+  std::unordered_set<const Array *> incConstantArrays;
+  void resetIncrementalSolver();
+  // Make the base level of `incSolver` consistent with the given query.
+  // Constraints managed by `query.constraintMgr` are asserted at the base
+  // level, while the rest are returned in `frameConstraints` and should only
+  // live in the frame of this query.
+  void syncIncrementalSolver(const Query &query,
+                             std::vector<ref<Expr>> &frameConstraints);
+  void assertConstantArrays(::Z3_solver theSolver,
+                            const ConstantArrayFinder &finder);
+
   int Z3GetInitialRead(const Array *array, ::Z3_model &theModel,
                        unsigned offset);
   bool validateZ3Model(::Z3_solver &theSolver, ::Z3_model &theModel);
@@ -92,6 +124,8 @@ public:
       timeoutInMilliSeconds = UINT_MAX;
     Z3_params_set_uint(builder->ctx, solverParameters, timeoutParamStrSymbol,
                        timeoutInMilliSeconds);
+    if (incSolver)
+      Z3_solver_set_params(builder->ctx, incSolver, solverParameters);
   }
 
   bool computeTruth(const Query &, bool &isValid);
@@ -115,7 +149,7 @@ Z3SolverImpl::Z3SolverImpl()
           /*z3LogInteractionFileArg=*/Z3LogInteractionFile.size() > 0
               ? Z3LogInteractionFile.c_str()
               : NULL)),
-      runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+      runStatusCode(SOLVER_RUN_STATUS_FAILURE), incSolver(nullptr) {
   assert(builder && "unable to create Z3Builder");
   solverParameters = Z3_mk_params(builder->ctx);
   Z3_params_inc_ref(builder->ctx, solverParameters);
@@ -143,6 +177,7 @@ Z3SolverImpl::Z3SolverImpl()
 }
 
 Z3SolverImpl::~Z3SolverImpl() {
+  resetIncrementalSolver();
   Z3_params_dec_ref(builder->ctx, solverParameters);
   delete builder;
 }
@@ -260,39 +295,48 @@ bool Z3SolverImpl::internalRunSolver(
     std::vector<std::vector<unsigned char> > *values, bool &hasSolution) {
 
   TimerStatIncrementerWithMax t(stats::queryTime, stats::queryTimeMaxOnce);
-  // NOTE: Z3 will switch to using a slower solver internally if push/pop are
-  // used so for now it is likely that creating a new solver each time is the
-  // right way to go until Z3 changes its behaviour.
-  //
-  // TODO: Investigate using a custom tactic as described in
-  // https://github.com/klee/klee/issues/653
-  Z3_solver theSolver = Z3_mk_solver(builder->ctx);
-  Z3_solver_inc_ref(builder->ctx, theSolver);
-  Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
-
+  Z3_solver theSolver;
+  ConstantArrayFinder constant_arrays_in_query;
   runStatusCode = SOLVER_RUN_STATUS_FAILURE;
 
-  ConstantArrayFinder constant_arrays_in_query;
-  for (auto const &constraint : query.constraints) {
-    Z3_solver_assert(builder->ctx, theSolver, builder->construct(constraint));
-    constant_arrays_in_query.visit(constraint);
+  std::vector<ref<Expr>> frameConstraints;
+  if (Z3Incremental) {
+    syncIncrementalSolver(query, frameConstraints);
+    theSolver = incSolver;
+  } else {
+    // NOTE: Z3 will switch to using a slower solver internally if push/pop
+    // are used so for now it is likely that creating a new solver each time
+    // is the right way to go until Z3 changes its behaviour.
+    //
+    // TODO: Investigate using a custom tactic as described in
+    // https://github.com/klee/klee/issues/653
+    theSolver = Z3_mk_solver(builder->ctx);
+    Z3_solver_inc_ref(builder->ctx, theSolver);
+    Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
+    frameConstraints.assign(query.constraints.begin(),
+                            query.constraints.end());
   }
   ++stats::queries;
   if (objects)
     ++stats::queryCounterexamples;
 
+  std::vector<Z3ASTHandle> z3FrameConstraints;
+  z3FrameConstraints.reserve(frameConstraints.size());
+  for (auto const &constraint : frameConstraints) {
+    z3FrameConstraints.push_back(builder->construct(constraint));
+    constant_arrays_in_query.visit(constraint);
+  }
   Z3ASTHandle z3QueryExpr =
       Z3ASTHandle(builder->construct(query.expr), builder->ctx);
   constant_arrays_in_query.visit(query.expr);
 
-  for (auto const &constant_array : constant_arrays_in_query.results) {
-    assert(builder->constant_array_assertions.count(constant_array) == 1 &&
-           "Constant array found in query, but not handled by Z3Builder");
-    for (auto const &arrayIndexValueExpr :
-         builder->constant_array_assertions[constant_array]) {
-      Z3_solver_assert(builder->ctx, theSolver, arrayIndexValueExpr);
-    }
-  }
+  // Constant array axioms hold regardless of the query. In incremental mode
+  // they are asserted before pushing so that they stay at the base level.
+  assertConstantArrays(theSolver, constant_arrays_in_query);
+  if (Z3Incremental)
+    Z3_solver_push(builder->ctx, theSolver);
+  for (auto const &z3Constraint : z3FrameConstraints)
+    Z3_solver_assert(builder->ctx, theSolver, z3Constraint);
 
   // KLEE Queries are validity queries i.e.
   // ∀ X Constraints(X) → query(X)
@@ -320,7 +364,10 @@ bool Z3SolverImpl::internalRunSolver(
       handleSolverResponse(theSolver, satisfiable, query.indep_elemset, objects,
                            values, hasSolution);
 
-  Z3_solver_dec_ref(builder->ctx, theSolver);
+  if (Z3Incremental)
+    Z3_solver_pop(builder->ctx, theSolver, 1);
+  else
+    Z3_solver_dec_ref(builder->ctx, theSolver);
   // Clear the builder's cache to prevent memory usage exploding.
   // By using ``autoClearConstructCache=false`` and clearning now
   // we allow Z3_ast expressions to be shared from an entire
@@ -352,6 +399,75 @@ bool Z3SolverImpl::internalRunSolver(
   return false; // failed
 }
 
+void Z3SolverImpl::resetIncrementalSolver() {
+  if (incSolver) {
+    Z3_solver_dec_ref(builder->ctx, incSolver);
+    incSolver = nullptr;
+  }
+  incAsserted.clear();
+  incConstantArrays.clear();
+}
+
+void Z3SolverImpl::syncIncrementalSolver(
+    const Query &query, std::vector<ref<Expr>> &frameConstraints) {
+  const Constraints_ty &managed = query.constraintMgr.getAllConstraints();
+  // Everything asserted at the base level must still be implied by the
+  // querying state. Extra constraints from the same path condition do not
+  // change the answer (the path condition is satisfiable), but constraints
+  // deleted by `ConstraintManager::rewriteConstraints` or belonging to an
+  // unrelated state do, so drop the whole context in that case.
+  // The manager last synced with only gained constraints unless its base
+  // version moved past the version synced with, so only another manager or
+  // a deletion needs the check.
+  const ConstraintManager &mgr = query.constraintMgr;
+  if (incSolver &&
+      (&mgr != incManager || mgr.getBaseVersion() > incVersion)) {
+    for (const ref<Expr> &e : incAsserted) {
+      if (!managed.count(e)) {
+        ++stats::queryIncrementalResyncs;
+        resetIncrementalSolver();
+        break;
+      }
+    }
+  }
+  if (!incSolver) {
+    incSolver = Z3_mk_solver(builder->ctx);
+    Z3_solver_inc_ref(builder->ctx, incSolver);
+    Z3_solver_set_params(builder->ctx, incSolver, solverParameters);
+  }
+
+  ConstantArrayFinder constant_arrays_in_base;
+  for (const ref<Expr> &constraint : query.constraints) {
+    if (incAsserted.count(constraint))
+      continue;
+    if (!managed.count(constraint)) {
+      // e.g. bindings added by the ValidatingSolver
+      frameConstraints.push_back(constraint);
+      continue;
+    }
+    Z3_solver_assert(builder->ctx, incSolver, builder->construct(constraint));
+    constant_arrays_in_base.visit(constraint);
+    incAsserted.insert(constraint);
+  }
+  assertConstantArrays(incSolver, constant_arrays_in_base);
+  incManager = &mgr;
+  incVersion = mgr.getVersion();
+}
+
+void Z3SolverImpl::assertConstantArrays(::Z3_solver theSolver,
+                                        const ConstantArrayFinder &finder) {
+  for (auto const &constant_array : finder.results) {
+    if (Z3Incremental && !incConstantArrays.insert(constant_array).second)
+      continue;
+    assert(builder->constant_array_assertions.count(constant_array) == 1 &&
+           "Constant array found in query, but not handled by Z3Builder");
+    for (auto const &arrayIndexValueExpr :
+         builder->constant_array_assertions[constant_array]) {
+      Z3_solver_assert(builder->ctx, theSolver, arrayIndexValueExpr);
+    }
+  }
+}
+
 inline int Z3SolverImpl::Z3GetInitialRead(const Array *array,
                                           ::Z3_model &theModel,
                                           unsigned offset) {
@@ -0,0 +1,259 @@
+//===-- PathFormat.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Config/config.h"
+#include "klee/Internal/Support/PathFormat.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/Support/Serialize.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/raw_ostream.h"
+
+#ifdef HAVE_ZLIB_H
+#include "zlib.h"
+#endif
+
+#include <cassert>
+#include <cstring>
+
+using namespace klee;
+using namespace klee::pathformat;
+
+namespace {
+/// Records of a v2 file, along with the places where a compressed file
+/// closes a block.
+struct EncodedBody {
+  std::vector<char> data;
+  /// (byte offset, entry index) of the first record of every block but the
+  /// first one
+  std::vector<std::pair<size_t, size_t>> cuts;
+
+  /// Called before encoding the record holding entry `index`
+  void beginRecord(size_t index) {
+    size_t blockStart = cuts.empty() ? 0 : cuts.back().first;
+    if (data.size() - blockStart >= BlockSize)
+      cuts.push_back(std::make_pair(data.size(), index));
+  }
+};
+
+void writeHeader(llvm::raw_ostream &os, const char (&magic)[4]) {
+  os.write(magic, sizeof(magic));
+  os << static_cast<char>(CurrentVersion);
+}
+
+/// Write a v2 file: header, prefix, then the records either as is or as
+/// compressed blocks followed by the footer index.
+void writeBody(llvm::raw_ostream &os, const char (&magic)[4],
+               const char (&compressedMagic)[4],
+               const std::vector<char> &prefix, const EncodedBody &body,
+               size_t numEntries, bool compress) {
+  if (!compress) {
+    writeHeader(os, magic);
+    os.write(prefix.data(), prefix.size());
+    os.write(body.data.data(), body.data.size());
+    return;
+  }
+
+  writeHeader(os, compressedMagic);
+  os.write(prefix.data(), prefix.size());
+  uint64_t offset = HeaderSize + prefix.size();
+
+  std::vector<char> index, block;
+  std::vector<std::pair<size_t, size_t>> bounds(body.cuts);
+  bounds.push_back(std::make_pair(body.data.size(), numEntries));
+  size_t numBlocks = body.data.empty() ? 0 : bounds.size();
+  encodeVarint(numBlocks, index);
+  size_t start = 0, firstEntry = 0;
+  for (size_t b = 0; b < numBlocks; ++b) {
+    const auto &bound = bounds[b];
+    if (!compressBlock(body.data.data() + start, bound.first - start, block))
+      klee_error("unable to compress trace block");
+    os.write(block.data(), block.size());
+    offset += block.size();
+    encodeVarint(block.size(), index);
+    encodeVarint(bound.first - start, index);
+    encodeVarint(bound.second - firstEntry, index);
+    start = bound.first;
+    firstEntry = bound.second;
+  }
+  os.write(index.data(), index.size());
+  for (unsigned byte = 0; byte < FooterSize; ++byte)
+    os << static_cast<char>(offset >> (byte * 8));
+}
+
+uint64_t payloadOf(const PathEntry &pe) {
+  switch (pe.t) {
+  case PathEntry::SWITCH_EXPIDX:
+  case PathEntry::SWITCH_BBIDX:
+    return pe.body.switchIndex;
+  case PathEntry::INDIRECTBR:
+    return pe.body.indirectbrIndex;
+  case PathEntry::DATAREC:
+    return pe.body.drec.width;
+  case PathEntry::SCHEDULE:
+    return pe.body.tgtid;
+  default:
+    klee_error("cannot encode PathEntry type %d", pe.t);
+  }
+}
+
+void encodeRecord(uint8_t type, uint64_t value, std::vector<char> &out) {
+  if (value < PayloadEscape) {
+    out.push_back(static_cast<char>(type | (value << TypeBits)));
+  } else {
+    out.push_back(static_cast<char>(type | (PayloadEscape << TypeBits)));
+    encodeVarint(value - PayloadEscape, out);
+  }
+}
+} // namespace
+
+unsigned pathformat::detectVersion(const char *data, size_t size,
+                                   FileKind kind, bool &compressed) {
+  const char *magic = kind == PathFile ? PathMagic : DataRecMagic;
+  const char *compressedMagic =
+      kind == PathFile ? CompressedPathMagic : CompressedDataRecMagic;
+  compressed = false;
+  if (size < HeaderSize)
+    return 1;
+  if (!memcmp(data, compressedMagic, sizeof(PathMagic)))
+    compressed = true;
+  else if (memcmp(data, magic, sizeof(PathMagic)))
+    return 1;
+  return static_cast<uint8_t>(data[sizeof(PathMagic)]);
+}
+
+bool pathformat::compressionSupported() {
+#ifdef HAVE_ZLIB_H
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool pathformat::compressBlock(const char *data, size_t size,
+                               std::vector<char> &out) {
+#ifdef HAVE_ZLIB_H
+  uLongf outSize = compressBound(size);
+  out.resize(outSize);
+  if (compress2(reinterpret_cast<Bytef *>(out.data()), &outSize,
+                reinterpret_cast<const Bytef *>(data), size,
+                Z_DEFAULT_COMPRESSION) != Z_OK)
+    return false;
+  out.resize(outSize);
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool pathformat::uncompressBlock(const char *src, size_t srcSize, char *dst,
+                                 size_t dstSize) {
+#ifdef HAVE_ZLIB_H
+  uLongf outSize = dstSize;
+  return uncompress(reinterpret_cast<Bytef *>(dst), &outSize,
+                    reinterpret_cast<const Bytef *>(src),
+                    srcSize) == Z_OK &&
+         outSize == dstSize;
+#else
+  return false;
+#endif
+}
+
+void pathformat::writePathFile(llvm::raw_ostream &os,
+                               const std::vector<PathEntry> &entries,
+                               unsigned version, bool compress) {
+  if (version == 1) {
+    assert(!compress && "version 1 .path cannot be compressed");
+    for (const auto &pe : entries)
+      serialize(os, pe);
+    return;
+  }
+  assert(version == CurrentVersion && "unsupported .path format version");
+
+  std::vector<char> prefix;
+  encodeVarint(entries.size(), prefix);
+  EncodedBody body;
+  std::vector<char> &buf = body.data;
+  for (size_t i = 0; i < entries.size();) {
+    const PathEntry &pe = entries[i];
+    body.beginRecord(i);
+    if (pe.t != PathEntry::FORK) {
+      encodeRecord(pe.t, payloadOf(pe), buf);
+      ++i;
+      continue;
+    }
+    // pack the run of consecutive FORK entries starting at i
+    size_t n = 1;
+    while (n < MaxForkRun && i + n < entries.size() &&
+           entries[i + n].t == PathEntry::FORK)
+      ++n;
+    buf.push_back(static_cast<char>(PathEntry::FORK | ((n - 1) << TypeBits)));
+    for (size_t byte = 0; byte < n; byte += 8) {
+      uint8_t bits = 0;
+      for (size_t bit = 0; bit < 8 && byte + bit < n; ++bit)
+        bits |= static_cast<uint8_t>(entries[i + byte + bit].body.br) << bit;
+      buf.push_back(static_cast<char>(bits));
+    }
+    i += n;
+  }
+
+  writeBody(os, PathMagic, CompressedPathMagic, prefix, body, entries.size(),
+            compress);
+}
+
+void pathformat::writeDataRecFile(llvm::raw_ostream &os,
+                                  const std::vector<DataRecEntry> &entries,
+                                  const std::vector<PathEntry> &pathEntries,
+                                  unsigned version, bool compress) {
+  if (version == 1) {
+    assert(!compress && "version 1 .path_datarec cannot be compressed");
+    for (const auto &dre : entries)
+      serialize(os, dre);
+    return;
+  }
+  assert(version == CurrentVersion && "unsupported .path_datarec format version");
+
+  // Intern (instruction ID, width) pairs. The same instruction always
+  // records values of the same width, but do not rely on it.
+  llvm::StringMap<llvm::DenseMap<unsigned, uint64_t>> dictIndex;
+  std::vector<std::pair<const std::string *, unsigned>> dict;
+  EncodedBody body;
+  std::vector<char> &records = body.data;
+  auto pe_it = pathEntries.begin();
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const DataRecEntry &dre = entries[i];
+    while (pe_it != pathEntries.end() && pe_it->t != PathEntry::DATAREC)
+      ++pe_it;
+    if (pe_it == pathEntries.end())
+      klee_error(".path has fewer DATAREC entries than .path_datarec");
+    unsigned width = (pe_it++)->body.drec.width;
+
+    auto inserted = dictIndex[dre.instUniqueID].insert(
+        std::make_pair(width, dict.size()));
+    if (inserted.second)
+      dict.push_back(std::make_pair(&dre.instUniqueID, width));
+    body.beginRecord(i);
+    encodeVarint(inserted.first->second, records);
+    for (unsigned byte = 0; byte * 8 < width && byte < sizeof(dre.data);
+         ++byte)
+      records.push_back(static_cast<char>(dre.data >> (byte * 8)));
+  }
+
+  std::vector<char> prefix;
+  encodeVarint(dict.size(), prefix);
+  for (const auto &id : dict) {
+    encodeVarint(id.second, prefix);
+    encodeVarint(id.first->size(), prefix);
+    prefix.insert(prefix.end(), id.first->begin(), id.first->end());
+  }
+
+  writeBody(os, DataRecMagic, CompressedDataRecMagic, prefix, body,
+            entries.size(), compress);
+}
@@ -0,0 +1,372 @@
+//===-- PathReader.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/PathReader.h"
+#include "klee/Internal/Support/PathFormat.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace klee;
+using namespace klee::pathformat;
+
+namespace {
+// How much of a trace we ask the kernel to read ahead of the replay cursor
+const size_t PrefetchChunkSize = 4 << 20;
+
+// Prefetch the next chunk once the cursor passes the middle of the last one.
+void prefetchAround(const MappedFile &file, size_t offset,
+                    size_t &prefetchedUntil) {
+  if (offset + PrefetchChunkSize / 2 < prefetchedUntil)
+    return;
+  size_t start = std::max(offset, prefetchedUntil);
+  file.prefetch(start, PrefetchChunkSize);
+  prefetchedUntil = start + PrefetchChunkSize;
+}
+} // namespace
+
+MappedFile::~MappedFile() {
+  if (begin)
+    munmap(const_cast<char *>(begin), length);
+}
+
+bool MappedFile::open(const std::string &name, std::string &error) {
+  int fd = ::open(name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    error = "unable to open " + name + ": " + strerror(errno);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    error = "unable to stat " + name + ": " + strerror(errno);
+    close(fd);
+    return false;
+  }
+  length = st.st_size;
+  if (length) {
+    void *addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      error = "unable to mmap " + name + ": " + strerror(errno);
+      length = 0;
+      close(fd);
+      return false;
+    }
+    begin = static_cast<const char *>(addr);
+    madvise(addr, length, MADV_SEQUENTIAL);
+  }
+  // the mapping stays valid after closing its file descriptor
+  close(fd);
+  return true;
+}
+
+void MappedFile::prefetch(size_t offset, size_t len) const {
+  if (offset >= length)
+    return;
+  static const size_t pageSize = sysconf(_SC_PAGESIZE);
+  size_t aligned = offset & ~(pageSize - 1);
+  len = std::min(len + (offset - aligned), length - aligned);
+  madvise(const_cast<char *>(begin) + aligned, len, MADV_WILLNEED);
+}
+
+bool TraceRecordReader::initBlocks(size_t offset, const std::string &name,
+                                   std::string &error) {
+  if (!compressed) {
+    blocks.push_back({offset, 0, file.size() - offset, 0, {{0, 0}}});
+    return true;
+  }
+  if (!compressionSupported()) {
+    error = name + " is compressed, but KLEE was built without zlib";
+    return false;
+  }
+  const char *data = file.data();
+  size_t size = file.size();
+  if (size < offset + FooterSize) {
+    error = name + " is truncated";
+    return false;
+  }
+  size -= FooterSize;
+  uint64_t indexOffset = 0;
+  for (unsigned byte = 0; byte < FooterSize; ++byte)
+    indexOffset |= static_cast<uint64_t>(static_cast<uint8_t>(data[size + byte]))
+                   << (byte * 8);
+  uint64_t numBlocks = 0;
+  size_t pos = indexOffset >= offset && indexOffset < size
+                   ? decodeVarint(data, size, indexOffset, numBlocks)
+                   : 0;
+  size_t firstEntry = 0;
+  for (uint64_t i = 0; pos && i < numBlocks; ++i) {
+    uint64_t compressedSize, blockSize, numEntries;
+    pos = decodeVarint(data, size, pos, compressedSize);
+    if (pos)
+      pos = decodeVarint(data, size, pos, blockSize);
+    if (pos)
+      pos = decodeVarint(data, size, pos, numEntries);
+    if (!pos || !compressedSize || compressedSize > indexOffset - offset)
+      pos = 0;
+    else {
+      blocks.push_back({offset, compressedSize, blockSize, firstEntry,
+                        {{firstEntry, 0}}});
+      offset += compressedSize;
+      firstEntry += numEntries;
+    }
+  }
+  if (!pos) {
+    error = name + " has a corrupted block index";
+    return false;
+  }
+  return true;
+}
+
+const char *TraceRecordReader::loadBlock(size_t block) {
+  const Block &b = blocks[block];
+  if (!b.compressedSize) {
+    prefetchAround(file, b.offset + cursor.offset, prefetchedUntil);
+    return file.data() + b.offset;
+  }
+  if (inflatedBlock != block) {
+    inflated.resize(b.size);
+    if (!uncompressBlock(file.data() + b.offset, b.compressedSize,
+                         inflated.data(), b.size))
+      return nullptr;
+    inflatedBlock = block;
+    // the next block will most likely be inflated soon
+    if (block + 1 < blocks.size())
+      file.prefetch(blocks[block + 1].offset, blocks[block + 1].compressedSize);
+  }
+  return inflated.data();
+}
+
+bool TraceRecordReader::seek(size_t index) {
+  // the last block starting at or before index
+  auto bit = std::upper_bound(
+      blocks.begin(), blocks.end(), index,
+      [](size_t i, const Block &b) { return i < b.firstEntry; });
+  if (bit == blocks.begin())
+    return false;
+  Block &b = *--bit;
+  size_t block = bit - blocks.begin();
+
+  if (cursorBlock != block || cursor.index > index) {
+    // restart from the closest checkpoint before index
+    size_t cp = std::min((index - b.firstEntry) / CheckpointInterval,
+                         b.checkpoints.size() - 1);
+    // a record holding several entries may start after its checkpoint
+    if (b.checkpoints[cp].index > index)
+      --cp;
+    cursorBlock = block;
+    cursor = b.checkpoints[cp];
+  }
+  cursorData = loadBlock(block);
+  cursorSize = b.size;
+  if (!cursorData)
+    return false;
+
+  for (;;) {
+    size_t count;
+    size_t next = decodeRecord(cursorData, cursorSize, cursor.offset, count);
+    if (!next)
+      return false;
+    if (index < cursor.index + count)
+      return true;
+    cursor.offset = next;
+    cursor.index += count;
+    if (cursor.index >=
+        b.firstEntry + b.checkpoints.size() * CheckpointInterval)
+      b.checkpoints.push_back(cursor);
+  }
+}
+
+std::unique_ptr<PathEntryReader> PathEntryReader::open(const std::string &name,
+                                                       std::string &error) {
+  std::unique_ptr<PathEntryReader> reader(new PathEntryReader());
+  MappedFile &file = reader->file;
+  if (!file.open(name, error))
+    return nullptr;
+  reader->version =
+      detectVersion(file.data(), file.size(), PathFile, reader->compressed);
+  if (reader->version == 1) {
+    if (file.size() % sizeof(PathEntry)) {
+      error = name + " is truncated";
+      return nullptr;
+    }
+    reader->numEntries = file.size() / sizeof(PathEntry);
+    return reader;
+  }
+  if (reader->version != CurrentVersion) {
+    error = name + " has unsupported format version " +
+            std::to_string(reader->version);
+    return nullptr;
+  }
+  uint64_t numEntries;
+  size_t offset = decodeVarint(file.data(), file.size(), HeaderSize,
+                               numEntries);
+  if (!offset) {
+    error = name + " is truncated";
+    return nullptr;
+  }
+  reader->numEntries = numEntries;
+  if (!reader->initBlocks(offset, name, error))
+    return nullptr;
+  return reader;
+}
+
+size_t PathEntryReader::decodeRecord(const char *data, size_t size,
+                                     size_t offset, size_t &count) {
+  PathEntry &pe = current;
+  if (offset >= size)
+    return 0;
+  uint8_t header = static_cast<uint8_t>(data[offset++]);
+  uint64_t value = header >> TypeBits;
+  pe.t = static_cast<PathEntry::PathEntry_t>(header & TypeMask);
+  count = 1;
+  if (pe.t == PathEntry::FORK) {
+    count = value + 1;
+    size_t bytes = (count + 7) / 8;
+    if (bytes > size - offset)
+      return 0;
+    pe.body.br = data[offset] & 1;
+    return offset + bytes;
+  }
+  if (value == PayloadEscape) {
+    offset = decodeVarint(data, size, offset, value);
+    if (!offset)
+      return 0;
+    value += PayloadEscape;
+  }
+  switch (pe.t) {
+  case PathEntry::SWITCH_EXPIDX:
+  case PathEntry::SWITCH_BBIDX:
+    pe.body.switchIndex = value;
+    break;
+  case PathEntry::INDIRECTBR:
+    pe.body.indirectbrIndex = value;
+    break;
+  case PathEntry::DATAREC:
+    // IDlen is not recorded in v2, IDs are interned in .path_datarec instead.
+    // Users compare DataRecEntryRef::instUniqueID rather than IDlen.
+    pe.body.drec.IDlen = 0;
+    pe.body.drec.width = value;
+    break;
+  case PathEntry::SCHEDULE:
+    pe.body.tgtid = value;
+    break;
+  default:
+    return 0;
+  }
+  return offset;
+}
+
+bool PathEntryReader::read(size_t index, PathEntry &pe) {
+  if (index >= numEntries)
+    return false;
+  if (version == 1) {
+    size_t offset = index * sizeof(PathEntry);
+    prefetchAround(file, offset, prefetchedUntil);
+    memcpy(&pe, file.data() + offset, sizeof(PathEntry));
+    return true;
+  }
+  if (!seek(index))
+    return false;
+  pe = current;
+  if (pe.t == PathEntry::FORK) {
+    size_t bit = index - cursor.index;
+    pe.body.br = (cursorData[cursor.offset + 1 + bit / 8] >> (bit % 8)) & 1;
+  }
+  return true;
+}
+
+std::unique_ptr<DataRecEntryReader>
+DataRecEntryReader::open(const std::string &name, std::string &error) {
+  std::unique_ptr<DataRecEntryReader> reader(new DataRecEntryReader());
+  MappedFile &file = reader->file;
+  if (!file.open(name, error))
+    return nullptr;
+  reader->version =
+      detectVersion(file.data(), file.size(), DataRecFile, reader->compressed);
+  if (reader->version == 1) {
+    reader->initBlocks(0, name, error);
+    return reader;
+  }
+  if (reader->version != CurrentVersion) {
+    error = name + " has unsupported format version " +
+            std::to_string(reader->version);
+    return nullptr;
+  }
+  // load the dictionary of interned instruction IDs
+  uint64_t numIDs;
+  size_t offset = decodeVarint(file.data(), file.size(), HeaderSize, numIDs);
+  for (uint64_t i = 0; offset && i < numIDs; ++i) {
+    uint64_t width, IDlen;
+    offset = decodeVarint(file.data(), file.size(), offset, width);
+    if (offset)
+      offset = decodeVarint(file.data(), file.size(), offset, IDlen);
+    if (!offset || IDlen > file.size() - offset) {
+      offset = 0;
+      break;
+    }
+    reader->dictionary.push_back(std::make_pair(
+        llvm::StringRef(file.data() + offset, IDlen), width));
+    offset += IDlen;
+  }
+  if (!offset) {
+    error = name + " is truncated";
+    return nullptr;
+  }
+  if (!reader->initBlocks(offset, name, error))
+    return nullptr;
+  return reader;
+}
+
+// v1 layout follows serialize(os, const DataRecEntry&) in Serialize.h:
+// uint64_t data, std::string::size_type length, length bytes of ID
+size_t DataRecEntryReader::decodeRecord(const char *data, size_t size,
+                                        size_t offset, size_t &count) {
+  DataRecEntryRef &dre = current;
+  count = 1;
+  if (version != 1) {
+    uint64_t id;
+    offset = decodeVarint(data, size, offset, id);
+    if (!offset || id >= dictionary.size())
+      return 0;
+    dre.instUniqueID = dictionary[id].first;
+    size_t bytes = std::min<size_t>((dictionary[id].second + 7) / 8,
+                                    sizeof(dre.data));
+    if (bytes > size - offset)
+      return 0;
+    dre.data = 0;
+    for (size_t byte = 0; byte < bytes; ++byte)
+      dre.data |= static_cast<uint64_t>(static_cast<uint8_t>(data[offset + byte]))
+                  << (byte * 8);
+    return offset + bytes;
+  }
+  const size_t headerSize = sizeof(uint64_t) + sizeof(std::string::size_type);
+  if (offset + headerSize > size)
+    return 0;
+  std::string::size_type IDlen;
+  memcpy(&dre.data, data + offset, sizeof(uint64_t));
+  memcpy(&IDlen, data + offset + sizeof(uint64_t), sizeof(IDlen));
+  offset += headerSize;
+  if (IDlen > size - offset)
+    return 0;
+  dre.instUniqueID = llvm::StringRef(data + offset, IDlen);
+  return offset + IDlen;
+}
+
+bool DataRecEntryReader::read(size_t index, DataRecEntryRef &dre) {
+  if (!seek(index))
+    return false;
+  dre = current;
+  return true;
+}
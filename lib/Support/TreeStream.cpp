@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "klee/Internal/ADT/TreeStream.h"
+#include "klee/Internal/Support/ErrorHandling.h"
 
 #include <cassert>
 #include <iomanip>
@@ -15,7 +16,10 @@
 #include <fstream>
 #include <iterator>
 
+#include <errno.h>
+#include <fcntl.h>
 #include <string.h>
+#include <unistd.h>
 
 using namespace klee;
 
@@ -30,7 +34,9 @@ TreeStreamWriter::TreeStreamWriter(const std::string &_path)
     path(_path),
     output(new std::ofstream(path.c_str(), 
                              std::ios::out | std::ios::binary)),
-    ids(1) {
+    inputFD(-1),
+    ids(1),
+    streams(1, StreamInfo{0, 0, {}}) {
   if (!output->good()) {
     delete output;
     output = 0;
@@ -40,6 +46,8 @@ TreeStreamWriter::TreeStreamWriter(const std::string &_path)
 TreeStreamWriter::~TreeStreamWriter() {
   flush();
   delete output;
+  if (inputFD >= 0)
+    close(inputFD);
 }
 
 bool TreeStreamWriter::good() {
@@ -58,6 +66,7 @@ TreeOStream TreeStreamWriter::open(const TreeOStream &os) {
   output->write(reinterpret_cast<const char*>(&os.id), 4);
   unsigned tag = id | (1<<31);
   output->write(reinterpret_cast<const char*>(&tag), 4);
+  streams.push_back(StreamInfo{os.id, streams[os.id].segments.size(), {}});
   return TreeOStream(*this, id, os.cnt);
 }
 
@@ -68,6 +77,9 @@ void TreeStreamWriter::flush_lastLen() {
     output->write(reinterpret_cast<const char*>(&lastLen), sizeof(lastLen));
     output->seekp(save_pos);
     lastLen_dirty = false;
+    Segment &segment = streams[lastID].segments.back();
+    segment.end = save_pos;
+    segment.len = lastLen;
   }
 }
 void TreeStreamWriter::write_metadata(TreeOStream &os) {
@@ -80,6 +92,8 @@ void TreeStreamWriter::write_metadata(TreeOStream &os) {
   lastID = os.id;
   output->write(reinterpret_cast<const char*>(&lastLen), sizeof(lastLen));
   isWritten = true;
+  std::streamoff begin = output->tellp();
+  streams[lastID].segments.push_back(Segment{begin, begin, 0});
 }
 
 void TreeStreamWriter::flush() {
@@ -87,6 +101,58 @@ void TreeStreamWriter::flush() {
   output->flush();
 }
 
+void TreeStreamWriter::readSegments(TreeStreamID streamID,
+                                    std::string &buffer,
+                                    std::vector<unsigned> &lengths) {
+  flush();
+  if (inputFD < 0) {
+    inputFD = ::open(path.c_str(), O_RDONLY);
+    if (inputFD < 0)
+      klee_error("unable to open %s: %s", path.c_str(), strerror(errno));
+  }
+
+  // (stream, number of its segments in the chain), from streamID to the root
+  std::vector<std::pair<unsigned, size_t>> chain;
+  size_t numSegments = streams[streamID].segments.size();
+  for (unsigned id = streamID; id; id = streams[id].parent) {
+    chain.push_back(std::make_pair(id, numSegments));
+    numSegments = streams[id].forkSegments;
+  }
+  KLEE_DEBUG({
+    llvm::errs() << "chain for " << streamID << ": ";
+    for (auto &c : chain)
+      llvm::errs() << c.first << " ";
+    llvm::errs() << "\n";
+  });
+
+  size_t bytes = 0;
+  for (auto &c : chain)
+    for (size_t i = 0; i < c.second; ++i) {
+      const Segment &segment = streams[c.first].segments[i];
+      bytes += segment.end - segment.begin;
+    }
+  buffer.resize(bytes);
+  size_t pos = 0;
+  for (auto c = chain.rbegin(); c != chain.rend(); ++c) {
+    for (size_t i = 0; i < c->second; ++i) {
+      const Segment &segment = streams[c->first].segments[i];
+      size_t size = segment.end - segment.begin;
+      for (size_t done = 0; done < size;) {
+        ssize_t ret = pread(inputFD, &buffer[pos + done], size - done,
+                            segment.begin + done);
+        if (ret < 0 && errno == EINTR)
+          continue;
+        if (ret <= 0)
+          klee_error("unable to read %s: %s", path.c_str(),
+                     ret ? strerror(errno) : "unexpected end of file");
+        done += ret;
+      }
+      pos += size;
+      lengths.push_back(segment.len);
+    }
+  }
+}
+
 TreeOStream::TreeOStream()
   : writer(NULL),
     id(0) {
@@ -0,0 +1,54 @@
+// RUN: %clang %s -emit-llvm %O0opt -DCOND_EXIT -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --allocate-determ --write-paths %t1.bc > %t3.good
+
+// The uninterrupted replay takes a checkpoint every two branches
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t2.bc
+// RUN: rm -rf %t.klee-out-2
+// RUN: %klee --output-dir=%t.klee-out-2 --allocate-determ --replay-path %t.klee-out/test000001.path --checkpoint-every=2 %t2.bc > %t3.log 2> %t3.save.log
+// RUN: diff %t3.log %t3.good
+// RUN: FileCheck %s -check-prefix=CHECK-SAVE --input-file=%t3.save.log
+// RUN: test -f %t.klee-out-2/replay.ckpt
+
+// Resuming from the last checkpoint finishes the replay the same way
+// RUN: rm -rf %t.klee-out-3
+// RUN: %klee --output-dir=%t.klee-out-3 --allocate-determ --replay-path %t.klee-out/test000001.path --resume-from %t.klee-out-2/replay.ckpt %t2.bc > %t3.resumed 2> %t3.resume.log
+// RUN: diff %t3.resumed %t3.good
+// RUN: FileCheck %s -check-prefix=CHECK-RESUME --input-file=%t3.resume.log
+// RUN: ls %t.klee-out-3 | not grep .err
+
+// CHECK-SAVE: checkpoint at trace position {{[0-9]+}} saved to
+// CHECK-RESUME: resumed from {{.*}}replay.ckpt at trace position
+
+#include <stdio.h>
+#include <stdlib.h>
+
+void cond_exit() {
+#ifdef COND_EXIT
+  klee_silent_exit(0);
+#endif
+}
+
+int main() {
+  unsigned x;
+  klee_make_symbolic(&x, sizeof x, "x");
+
+  // memory allocated and written before the checkpoints, read after them
+  int *squares = malloc(8 * sizeof(int));
+  int res = 1;
+  for (int i = 0; i < 8; ++i) {
+    squares[i] = i * i;
+    if (x & (1u << i))
+      res += squares[i];
+    else
+      cond_exit();
+  }
+
+  int sum = 0;
+  for (int i = 0; i < 8; ++i)
+    sum += squares[i];
+  printf("res: %d, sum: %d\n", res, sum);
+  free(squares);
+
+  return 0;
+}
@@ -0,0 +1,41 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --native-memory-routines=false --write-paths %t.bc > %t.good
+
+// Copying natively records the branches the body of memcpy takes, without
+// the instructions interpreting it would take
+// RUN: rm -rf %t.klee-out-2
+// RUN: %klee --output-dir=%t.klee-out-2 --max-instructions=20000 --write-paths %t.bc > %t2.log
+// RUN: diff %t2.log %t.good
+// RUN: cmp %t.klee-out/test000001.path %t.klee-out-2/test000001.path
+
+// and replays them
+// RUN: rm -rf %t.klee-out-3
+// RUN: %klee --output-dir=%t.klee-out-3 --max-instructions=20000 --replay-path %t.klee-out/test000001.path %t.bc > %t3.log
+// RUN: diff %t3.log %t.good
+
+#include <stdio.h>
+#include <string.h>
+
+#define N 65536
+
+char src[N], dst[N];
+
+int main() {
+  int res = 1;
+  int x;
+
+  klee_make_symbolic(&x, sizeof x, "x");
+  klee_assume(x > 100);
+
+  // llvm.memset and llvm.memcpy
+  memset(src, 'a', N);
+  memcpy(src + N / 2, &x, sizeof x);
+  memcpy(dst, src, N);
+
+  if (dst[0] == 'a') res *= 2;
+  if (*(int *)(dst + N / 2) > 50) res *= 3;
+  printf("res: %d\n", res);
+
+  return 0;
+}
@@ -0,0 +1,41 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --write-paths %t.bc > %t.all
+
+// Each path replayed on its own
+// RUN: rm -rf %t.klee-out-1
+// RUN: %klee --output-dir=%t.klee-out-1 --replay-path %t.klee-out/test000001.path %t.bc > %t.first
+// RUN: rm -rf %t.klee-out-2
+// RUN: %klee --output-dir=%t.klee-out-2 --replay-path %t.klee-out/test000002.path %t.bc > %t.second
+// RUN: cat %t.first %t.second | sort > %t.good
+
+// Both paths replayed together, forking where they diverge
+// RUN: rm -rf %t.klee-out-3
+// RUN: %klee --output-dir=%t.klee-out-3 --replay-path %t.klee-out/test000001.path --replay-path %t.klee-out/test000002.path %t.bc | sort > %t.both
+// RUN: diff %t.both %t.good
+// RUN: ls %t.klee-out-3 | grep .ktest | wc -l | grep 2
+// RUN: ls %t.klee-out-3 | not grep .err
+
+// A path given twice is replayed once
+// RUN: rm -rf %t.klee-out-4
+// RUN: %klee --output-dir=%t.klee-out-4 --replay-path %t.klee-out/test000001.path --replay-path %t.klee-out/test000001.path %t.bc > %t.twice 2> %t.twice.log
+// RUN: diff %t.twice %t.first
+// RUN: FileCheck %s --input-file=%t.twice.log
+// CHECK: test000001.path is the same as a path given before, replaying it once
+
+#include <stdio.h>
+
+int main() {
+  int res = 1;
+  int x;
+
+  klee_make_symbolic(&x, sizeof x, "x");
+
+  if (x & 1) res *= 2;
+  if (x & 2) res *= 3; else res *= 5;
+  if (x & 4) res *= 7;
+
+  printf("res: %d\n", res);
+
+  return 0;
+}
@@ -0,0 +1,34 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out-1
+// RUN: %klee --output-dir=%t.klee-out-1 %t.bc | sort > %t.serial
+// RUN: rm -rf %t.klee-out-2
+// RUN: %klee --output-dir=%t.klee-out-2 --solver-workers=2 %t.bc | sort > %t.workers
+// RUN: diff %t.serial %t.workers
+// RUN: ls %t.klee-out-1 | grep .ktest | wc -l > %t.serial-tests
+// RUN: ls %t.klee-out-2 | grep .ktest | wc -l > %t.workers-tests
+// RUN: diff %t.serial-tests %t.workers-tests
+// RUN: ls %t.klee-out-2 | not grep .err
+
+#include "klee/klee.h"
+
+#include <stdio.h>
+
+int main() {
+  int x, y, path = 0;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  klee_make_symbolic(&y, sizeof(y), "y");
+
+  if (x > 10)
+    path |= 1;
+  if (y < x)
+    path |= 2;
+  if (x + y == 42)
+    path |= 4;
+  if (x - y > 10)
+    path |= 8;
+  if ((y & 0xff) == 7 && x < 100)
+    path |= 16;
+
+  printf("path %d\n", path);
+  return 0;
+}
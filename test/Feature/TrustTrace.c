@@ -0,0 +1,43 @@
+// RUN: %clang %s -emit-llvm %O0opt -DCOND_EXIT -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --write-paths %t1.bc > %t3.good
+
+// The recorded branches are feasible, checked two at a time
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t2.bc
+// RUN: rm -rf %t.klee-out-2
+// RUN: %klee --output-dir=%t.klee-out-2 --replay-path %t.klee-out/test000001.path --trust-trace --trust-trace-batch=2 %t2.bc > %t3.log
+// RUN: diff %t3.log %t3.good
+// RUN: ls %t.klee-out-2 | not grep .err
+
+// The third branch is infeasible, the check at the end of the path finds it
+// RUN: %clang %s -emit-llvm %O0opt -DINFEASIBLE -c -o %t4.bc
+// RUN: rm -rf %t.klee-out-4
+// RUN: %klee --output-dir=%t.klee-out-4 --replay-path %t.klee-out/test000001.path --trust-trace --trust-trace-batch=0 %t4.bc 2>&1 | FileCheck %s
+// RUN: test -f %t.klee-out-4/test000001.replaypath.err
+
+#include <stdio.h>
+
+void cond_exit() {
+#ifdef COND_EXIT
+  klee_silent_exit(0);
+#endif
+}
+
+int main() {
+  int res = 1;
+  int x;
+
+  klee_make_symbolic(&x, sizeof x, "x");
+
+  if (x > 100) res *= 2; else cond_exit();
+  if (x & 2) res *= 3; else cond_exit();
+#ifdef INFEASIBLE
+  // CHECK: replay: trusted branch at {{[0-9]+}}/{{[0-9]+}} is infeasible
+  if (x < 50) res *= 5; else cond_exit();
+#else
+  if (x < 1000) res *= 5; else cond_exit();
+#endif
+  printf("res: %d\n", res);
+
+  return 0;
+}
@@ -0,0 +1,47 @@
+; The queries are in the ";Q " lines, their expressions are bound to the
+; instructions of @f below.
+; RUN: %llvmas %s -o %t.bc
+; RUN: grep '^;Q ' %s | sed 's/^;Q //' > %t.kquery
+; RUN: rm -f %t.kquery.ptwrite.cfg
+; RUN: %kleaver --select-datarec --bitcode=%t.bc %t.kquery > %t.log
+; RUN: FileCheck -input-file=%t.log %s
+; RUN: FileCheck -input-file=%t.kquery.ptwrite.cfg -check-prefix=CFG %s
+
+; Recording %sum concretizes the first value for less than %a and %b
+; together, the second value depends on y only.
+; CHECK: {{[0-9]+}} nodes, 3 instructions, 2 targets
+; CHECK-NEXT: 0 already concrete, 1 cannot be concretized by recording, 0 over budget
+; CHECK-NEXT: 1 instructions selected, 4 bytes to record
+; CHECK-NEXT: f:entry:sum{{[[:space:]]}}4 bytes, 1 targets
+; CFG: # 1 instructions, 4 bytes, best ranked first
+; CFG-NEXT: f:entry:sum
+; CFG-NOT: f:
+
+; RUN: %kleaver --select-datarec --bitcode=%t.bc --datarec-budget=3 --datarec-out=%t.budget.cfg %t.kquery > %t.budget.log
+; RUN: FileCheck -input-file=%t.budget.log -check-prefix=BUDGET %s
+; RUN: FileCheck -input-file=%t.budget.cfg -check-prefix=BUDGET-CFG %s
+; BUDGET: 0 already concrete, 1 cannot be concretized by recording, 1 over budget
+; BUDGET-NEXT: 0 instructions selected, 0 bytes to record
+; BUDGET-CFG: # 0 instructions, 0 bytes, best ranked first
+
+; There is no input file to name the output after
+; RUN: not %kleaver --select-datarec --bitcode=%t.bc < %t.kquery 2> %t.stdin.log
+; RUN: FileCheck -input-file=%t.stdin.log -check-prefix=STDIN %s
+; STDIN: --datarec-out is required when reading queries from stdin
+
+;Q array x[4] : w32 -> w8 = symbolic
+;Q array y[4] : w32 -> w8 = symbolic
+;Q (query [] false [N0:(Add w32 N1:(And w32 (ReadLSB w32 0 x) 3)
+;Q                               N2:(And w32 (ReadLSB w32 0 y) 3))])
+;Q #!N0:f:entry:sum
+;Q #!N1:f:entry:a
+;Q #!N2:f:entry:b
+;Q (query [] false [(Add w32 (ReadLSB w32 0 y) 1)])
+
+define i32 @f(i32 %x, i32 %y) {
+entry:
+  %a = and i32 %x, 3
+  %b = and i32 %y, 3
+  %sum = add i32 %a, %b
+  ret i32 %sum
+}
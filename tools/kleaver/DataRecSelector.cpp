@@ -0,0 +1,346 @@
+#include "DataRecSelector.h"
+
+#include "klee/Internal/Module/KInstruction.h"
+#include "klee/util/ExprConcretizer.h"
+
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <thread>
+
+using namespace klee;
+using namespace klee::expr;
+
+namespace {
+// whether PTWritePass knows how to record the result of `inst`
+bool isRecordableType(const llvm::Type *type, bool allowPointers) {
+  if (type->isPointerTy())
+    return allowPointers;
+  if (type->isIntegerTy())
+    return type->getIntegerBitWidth() <= 64;
+  return type->isFloatTy() || type->isDoubleTy();
+}
+} // namespace
+
+int DataRecSelector::getKInst(const KInstruction *ki) {
+  if (!ki)
+    return -1;
+  auto inserted = kinstIds.insert(std::make_pair(ki, kinsts.size()));
+  if (inserted.second) {
+    const llvm::Instruction *inst = ki->inst;
+    uint64_t cost = ki->getRecordingCost();
+    // without frequency info, count the instruction as executed once
+    if (!cost && !inst->getType()->isVoidTy())
+      cost = inst->getModule()->getDataLayout().getTypeSizeInBits(
+          inst->getType());
+    kinsts.push_back(
+        {ki, cost, cost && isRecordableType(inst->getType(),
+                                            opts.allowPointers)});
+  }
+  return inserted.first->second;
+}
+
+unsigned DataRecSelector::getNode(NodeKind kind, const void *p,
+                                  const Array *root) {
+  auto inserted = nodeIds.insert(std::make_pair(p, nodes.size()));
+  if (inserted.second) {
+    nodes.emplace_back();
+    worklist.push_back({kind, p, root, inserted.first->second});
+  }
+  return inserted.first->second;
+}
+
+void DataRecSelector::buildGraph() {
+  // Nodes get the same edges as in Drawer, except that constant expressions
+  // are leaves that are already concretized.
+  while (!worklist.empty()) {
+    WorkItem item = worklist.back();
+    worklist.pop_back();
+
+    std::vector<unsigned> kids;
+    int kinst = -1;
+    bool constant = false;
+    const Expr *index = nullptr;
+    if (item.kind == NUpdateNode) {
+      const UpdateNode *un = static_cast<const UpdateNode *>(item.p);
+      kinst = getKInst(un->kinst);
+      index = un->index.get();
+      if (index)
+        kids.push_back(getNode(NExpr, index));
+      if (const Expr *value = un->value.get())
+        kids.push_back(getNode(NExpr, value));
+      if (const UpdateNode *next = un->next.get())
+        kids.push_back(getNode(NUpdateNode, next, item.root));
+      else if (item.root->isSymbolicArray())
+        kids.push_back(getNode(NArray, item.root));
+    } else if (item.kind == NExpr) {
+      const Expr *e = static_cast<const Expr *>(item.p);
+      kinst = getKInst(e->getKInst());
+      if (isa<ConstantExpr>(e)) {
+        constant = true;
+      } else if (const ReadExpr *RE = dyn_cast<ReadExpr>(e)) {
+        index = RE->index.get();
+        if (index)
+          kids.push_back(getNode(NExpr, index));
+        const Array *root = RE->updates.root;
+        if (const UpdateNode *head = RE->updates.head.get())
+          kids.push_back(getNode(NUpdateNode, head, root));
+        else if (root->isSymbolicArray())
+          kids.push_back(getNode(NArray, root));
+      } else {
+        for (unsigned i = 0, N = e->getNumKids(); i < N; ++i)
+          if (const Expr *kid = e->getKid(i).get())
+            kids.push_back(getNode(NExpr, kid));
+      }
+    }
+    // NArray: a symbolic input, which cannot be concretized by recording
+
+    Node &node = nodes[item.id];
+    node.kids = std::move(kids);
+    node.kinst = kinst;
+    node.constant = constant;
+    if (index && !isa<ConstantExpr>(index))
+      node.index = index;
+  }
+}
+
+void DataRecSelector::addTarget(unsigned node, const Expr *e, int depth) {
+  // coverage score of hase.py
+  double weight = e->getWidth() / 8.0 * (1 + std::max(depth, 0));
+  auto inserted = targetIds.insert(std::make_pair(node, targets.size()));
+  if (inserted.second)
+    targets.push_back({node, weight});
+  else
+    targets[inserted.first->second].weight =
+        std::max(targets[inserted.first->second].weight, weight);
+}
+
+void DataRecSelector::addQuery(const QueryCommand &QC) {
+  std::vector<unsigned> roots;
+  for (const ref<Expr> &e : QC.Values)
+    roots.push_back(getNode(NExpr, e.get()));
+  for (const ref<Expr> &e : QC.Constraints)
+    roots.push_back(getNode(NExpr, e.get()));
+  buildGraph();
+
+  IndirectReadDepthCalculator depths(QC);
+  if (!QC.Values.empty()) {
+    for (unsigned i = 0; i < QC.Values.size(); ++i)
+      addTarget(roots[i], QC.Values[i].get(), depths.query(QC.Values[i]));
+    return;
+  }
+
+  // concretize the symbolic indices reachable from this query
+  std::vector<bool> visited(nodes.size());
+  std::vector<unsigned> stack(roots);
+  while (!stack.empty()) {
+    unsigned n = stack.back();
+    stack.pop_back();
+    if (visited[n])
+      continue;
+    visited[n] = true;
+    const Node &node = nodes[n];
+    if (node.index) {
+      int depth = depths.query(node.index);
+      if (depth >= opts.minIndirectDepth)
+        addTarget(node.kids.front(), node.index, depth);
+    }
+    for (unsigned kid : node.kids)
+      if (!visited[kid])
+        stack.push_back(kid);
+  }
+}
+
+std::vector<std::vector<unsigned>> DataRecSelector::getFactors() const {
+  // Union-find over nodes with kids. Leaves (constants and arrays) are
+  // shared by many targets but cost nothing to solve, so they do not tie
+  // factors together.
+  std::vector<unsigned> parent(nodes.size());
+  for (unsigned n = 0; n < nodes.size(); ++n)
+    parent[n] = n;
+  auto find = [&parent](unsigned n) {
+    while (parent[n] != n) {
+      parent[n] = parent[parent[n]];
+      n = parent[n];
+    }
+    return n;
+  };
+  for (unsigned n = 0; n < nodes.size(); ++n)
+    for (unsigned kid : nodes[n].kids)
+      if (!nodes[kid].kids.empty())
+        parent[find(kid)] = find(n);
+
+  std::unordered_map<unsigned, unsigned> factorIds;
+  std::vector<std::vector<unsigned>> factors;
+  for (unsigned t = 0; t < targets.size(); ++t) {
+    auto inserted =
+        factorIds.insert(std::make_pair(find(targets[t].node), factors.size()));
+    if (inserted.second)
+      factors.emplace_back();
+    factors[inserted.first->second].push_back(t);
+  }
+  return factors;
+}
+
+DataRecSelector::Strategy DataRecSelector::solveNode(
+    unsigned n, const std::unordered_map<unsigned, Strategy> &memo) const {
+  const Node &node = nodes[n];
+  Strategy s;
+  if (node.constant) {
+    s.feasible = true;
+    return s;
+  }
+
+  // concretize all kids, sharing the instructions they have in common
+  bool kidsFeasible = !node.kids.empty();
+  std::vector<unsigned> merged, tmp;
+  for (unsigned kid : node.kids) {
+    const Strategy &ks = memo.find(kid)->second;
+    if (!ks.feasible) {
+      kidsFeasible = false;
+      break;
+    }
+    tmp.clear();
+    std::set_union(merged.begin(), merged.end(), ks.kinsts.begin(),
+                   ks.kinsts.end(), std::back_inserter(tmp));
+    merged.swap(tmp);
+  }
+  uint64_t kidsCost = 0;
+  if (kidsFeasible)
+    for (unsigned k : merged)
+      kidsCost += kinsts[k].cost;
+
+  // or record the node itself
+  bool recordable = node.kinst >= 0 && kinsts[node.kinst].recordable;
+  if (kidsFeasible &&
+      (!recordable || kidsCost <= kinsts[node.kinst].cost)) {
+    s.feasible = true;
+    s.kinsts = std::move(merged);
+    s.cost = kidsCost;
+  } else if (recordable) {
+    s.feasible = true;
+    s.kinsts.push_back(node.kinst);
+    s.cost = kinsts[node.kinst].cost;
+  }
+  return s;
+}
+
+void DataRecSelector::solveFactor(const std::vector<unsigned> &factorTargets) {
+  // post-order walk, a node is solved once all of its kids are
+  std::unordered_map<unsigned, Strategy> memo;
+  std::vector<std::pair<unsigned, bool>> stack;
+  for (unsigned t : factorTargets) {
+    stack.push_back(std::make_pair(targets[t].node, false));
+    while (!stack.empty()) {
+      unsigned n = stack.back().first;
+      if (memo.count(n)) {
+        stack.pop_back();
+      } else if (!stack.back().second) {
+        stack.back().second = true;
+        for (unsigned kid : nodes[n].kids)
+          if (!memo.count(kid))
+            stack.push_back(std::make_pair(kid, false));
+      } else {
+        memo.insert(std::make_pair(n, solveNode(n, memo)));
+        stack.pop_back();
+      }
+    }
+    strategies[t] = memo.find(targets[t].node)->second;
+  }
+}
+
+void DataRecSelector::select() {
+  strategies.assign(targets.size(), Strategy());
+  std::vector<std::vector<unsigned>> factors = getFactors();
+  // start with the largest factors to balance the workers
+  std::sort(factors.begin(), factors.end(),
+            [](const std::vector<unsigned> &a, const std::vector<unsigned> &b) {
+              return a.size() > b.size();
+            });
+
+  // factors share no node that needs solving, and workers only read the
+  // graph, so they need no locking
+  unsigned jobs = opts.jobs ? opts.jobs : std::thread::hardware_concurrency();
+  jobs = std::max(1u, std::min<unsigned>(jobs, factors.size()));
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i; (i = next++) < factors.size();)
+      solveFactor(factors[i]);
+  };
+  if (jobs == 1) {
+    worker();
+  } else {
+    std::vector<std::thread> threads;
+    for (unsigned j = 0; j < jobs; ++j)
+      threads.emplace_back(worker);
+    for (auto &thread : threads)
+      thread.join();
+  }
+
+  std::vector<unsigned> ranked;
+  for (unsigned t = 0; t < targets.size(); ++t) {
+    const Strategy &s = strategies[t];
+    if (!s.feasible)
+      ++numInfeasible;
+    else if (s.kinsts.empty())
+      ++numConcrete;
+    else
+      ranked.push_back(t);
+  }
+  std::sort(ranked.begin(), ranked.end(), [this](unsigned a, unsigned b) {
+    double da = targets[a].weight / strategies[a].cost;
+    double db = targets[b].weight / strategies[b].cost;
+    if (da != db)
+      return da > db;
+    return targets[a].node < targets[b].node;
+  });
+
+  std::vector<int> selectedIds(kinsts.size(), -1);
+  uint64_t budgetBits = opts.budget * 8, totalBits = 0;
+  for (unsigned t : ranked) {
+    const Strategy &s = strategies[t];
+    uint64_t marginal = 0;
+    for (unsigned k : s.kinsts)
+      if (selectedIds[k] < 0)
+        marginal += kinsts[k].cost;
+    if (opts.budget && totalBits + marginal > budgetBits) {
+      ++numOverBudget;
+      continue;
+    }
+    totalBits += marginal;
+    for (unsigned k : s.kinsts) {
+      if (selectedIds[k] < 0) {
+        selectedIds[k] = selected.size();
+        selected.push_back({kinsts[k].kinst, (kinsts[k].cost + 7) / 8, 0});
+      }
+      ++selected[selectedIds[k]].targets;
+    }
+  }
+  selectedCost = (totalBits + 7) / 8;
+}
+
+void DataRecSelector::printSummary(llvm::raw_ostream &os) const {
+  os << nodes.size() << " nodes, " << kinsts.size() << " instructions, "
+     << targets.size() << " targets\n"
+     << "  " << numConcrete << " already concrete, " << numInfeasible
+     << " cannot be concretized by recording, " << numOverBudget
+     << " over budget\n"
+     << selected.size() << " instructions selected, " << selectedCost
+     << " bytes to record\n";
+  for (const Selection &sel : selected)
+    os << "  " << sel.kinst->getUniqueID() << "\t" << sel.cost << " bytes, "
+       << sel.targets << " targets\t" << getKInstDbgInfoOrNull(sel.kinst)
+       << "\n";
+}
+
+void DataRecSelector::writeConfig(llvm::raw_ostream &os) const {
+  os << "# " << selected.size() << " instructions, " << selectedCost
+     << " bytes, best ranked first\n";
+  for (const Selection &sel : selected)
+    os << sel.kinst->getUniqueID() << "\n";
+}
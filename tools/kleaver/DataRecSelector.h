@@ -0,0 +1,143 @@
+#ifndef KLEAVER_DATARECSELECTOR_H
+#define KLEAVER_DATARECSELECTOR_H
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/Parser/Parser.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace klee {
+struct KInstruction;
+
+// Chooses which instructions to record (with ptwrite) so that the given
+// queries become cheaper to solve, directly over the parsed queries. This is
+// the query mode of utils/visualize/hase.py without going through a drawn
+// constraint graph.
+//
+// Every query is first lowered to a plain dependency graph (Expr, UpdateNode
+// and symbolic Array nodes, with the same edges as Drawer). Then, for every
+// target node, the cheapest set of instructions whose recording concretizes
+// it is computed bottom-up: a node is concretized either by recording its
+// own instruction or by concretizing all of its kids, whichever costs less.
+// Targets are the query expressions if any, otherwise the symbolic indices
+// of reads and updates.
+//
+// Targets that share no node form independent factors, which are solved in
+// parallel. Both the graph construction and the per-factor analysis walk
+// explicit worklists, so deep expressions do not overflow the stack.
+//
+// Finally targets are ranked by their coverage score (width and indirect
+// depth, as in hase.py) per recorded byte, and their instructions are taken
+// in this order as long as they fit in the budget.
+class DataRecSelector {
+public:
+  struct Options {
+    // max number of bytes to record, 0 for no limit
+    uint64_t budget = 0;
+    // whether instructions producing pointers may be recorded
+    bool allowPointers = false;
+    // min indirect depth of read/update indices to concretize, only used for
+    // queries without query expressions
+    int minIndirectDepth = 1;
+    // number of worker threads, 0 for one per core
+    unsigned jobs = 0;
+  };
+
+  struct Selection {
+    const KInstruction *kinst;
+    // recording cost in bytes
+    uint64_t cost;
+    // number of targets this instruction was selected for
+    unsigned targets;
+  };
+
+private:
+  enum NodeKind { NExpr, NUpdateNode, NArray };
+
+  struct Node {
+    std::vector<unsigned> kids;
+    // index into kinsts, -1 if not produced by a known instruction
+    int kinst = -1;
+    bool constant = false;
+    // symbolic index of a read or update, the first kid
+    const Expr *index = nullptr;
+  };
+
+  struct KInstInfo {
+    const KInstruction *kinst;
+    // in bits, i.e. width * frequency
+    uint64_t cost;
+    bool recordable;
+  };
+
+  struct Target {
+    unsigned node;
+    double weight;
+  };
+
+  // cheapest way to concretize a node
+  struct Strategy {
+    bool feasible = false;
+    // sorted indices into kinsts
+    std::vector<unsigned> kinsts;
+    uint64_t cost = 0;
+  };
+
+  Options opts;
+  std::vector<Node> nodes;
+  std::unordered_map<const void *, unsigned> nodeIds;
+  std::vector<KInstInfo> kinsts;
+  std::unordered_map<const KInstruction *, unsigned> kinstIds;
+  std::vector<Target> targets;
+  std::unordered_map<unsigned, unsigned> targetIds;
+  // per target
+  std::vector<Strategy> strategies;
+  std::vector<Selection> selected;
+  uint64_t selectedCost = 0;
+  unsigned numInfeasible = 0, numConcrete = 0, numOverBudget = 0;
+
+  // nodes whose kids are not built yet
+  struct WorkItem {
+    NodeKind kind;
+    const void *p;
+    // array an update node belongs to
+    const Array *root;
+    unsigned id;
+  };
+  std::vector<WorkItem> worklist;
+
+  unsigned getNode(NodeKind kind, const void *p,
+                   const Array *root = nullptr);
+  int getKInst(const KInstruction *ki);
+  void buildGraph();
+  void addTarget(unsigned node, const Expr *e, int depth);
+
+  void solveFactor(const std::vector<unsigned> &factorTargets);
+  Strategy solveNode(unsigned n,
+                     const std::unordered_map<unsigned, Strategy> &memo) const;
+  std::vector<std::vector<unsigned>> getFactors() const;
+
+public:
+  explicit DataRecSelector(const Options &opts) : opts(opts) {}
+
+  void addQuery(const expr::QueryCommand &QC);
+  // compute the strategy of every target and pick instructions in the budget
+  void select();
+
+  // selected instructions, best ranked first
+  const std::vector<Selection> &getSelected() const { return selected; }
+  // in bytes
+  uint64_t getSelectedCost() const { return selectedCost; }
+
+  void printSummary(llvm::raw_ostream &os) const;
+  // one instruction ID per line, as expected by prepass -ptwrite-cfg
+  void writeConfig(llvm::raw_ostream &os) const;
+};
+} // namespace klee
+#endif // KLEAVER_DATARECSELECTOR_H
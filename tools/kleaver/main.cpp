@@ -20,6 +20,7 @@
 #include "klee/Expr/ExprDebugHelper.h"
 #include "klee/Internal/Support/PrintVersion.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/Support/FileHandling.h"
 #include "klee/OptionCategories.h"
 #include "klee/Solver/Solver.h"
 #include "klee/Solver/SolverCmdLine.h"
@@ -45,6 +46,7 @@
 #include "JsonDrawer.h"
 #include "ExprInPlaceTransformation.h"
 #include "DataRecReplaceVisitor.h"
+#include "DataRecSelector.h"
 
 using namespace klee;
 using namespace klee::expr;
@@ -92,6 +94,41 @@ llvm::cl::opt<std::string>
                                  "(only useful in datarec-replace mode)"),
                   llvm::cl::cat(klee::HASECat));
 
+llvm::cl::opt<std::string> DataRecOut(
+    "datarec-out", llvm::cl::init(""),
+    llvm::cl::desc("Where to write the selected instructions, in the format "
+                   "of prepass -ptwrite-cfg (default=<input>.ptwrite.cfg, "
+                   "required when reading from stdin, only useful in "
+                   "select-datarec mode)"),
+    llvm::cl::cat(klee::HASECat));
+
+llvm::cl::opt<unsigned long long> DataRecBudget(
+    "datarec-budget", llvm::cl::init(0),
+    llvm::cl::desc("Max number of bytes the selected instructions may record "
+                   "(default=0 (no limit), only useful in select-datarec "
+                   "mode)"),
+    llvm::cl::cat(klee::HASECat));
+
+llvm::cl::opt<bool> DataRecAllowPointers(
+    "datarec-allow-pointers", llvm::cl::init(false),
+    llvm::cl::desc("Allow recording instructions that produce pointers "
+                   "(default=false, only useful in select-datarec mode)"),
+    llvm::cl::cat(klee::HASECat));
+
+llvm::cl::opt<unsigned> DataRecMinDepth(
+    "datarec-min-depth", llvm::cl::init(1),
+    llvm::cl::desc("Min indirect depth of the symbolic indices to concretize "
+                   "in queries without query expressions (default=1, only "
+                   "useful in select-datarec mode)"),
+    llvm::cl::cat(klee::HASECat));
+
+llvm::cl::opt<unsigned> DataRecJobs(
+    "datarec-jobs", llvm::cl::init(0),
+    llvm::cl::desc("Number of threads analysing independent parts of the "
+                   "queries (default=0 (one per core), only useful in "
+                   "select-datarec mode)"),
+    llvm::cl::cat(klee::HASECat));
+
 enum class DrawFormats {
   GraphVizDOT = 0x1 << 0,
   JSON = 0x1 << 1,
@@ -109,7 +146,7 @@ static llvm::cl::opt<DrawFormats> DrawFormat(
             KLEE_LLVM_CL_VAL_END),
     llvm::cl::cat(klee::HASECat));
 
-enum ToolActions { PrintTokens, PrintAST, PrintSMTLIBv2, Evaluate, Analyze, Draw, KTestEval, DataRecReplace};
+enum ToolActions { PrintTokens, PrintAST, PrintSMTLIBv2, Evaluate, Analyze, Draw, KTestEval, DataRecReplace, SelectDataRec};
 
 static llvm::cl::opt<ToolActions> ToolAction(
     llvm::cl::desc("Tool actions:"), llvm::cl::init(Evaluate),
@@ -130,7 +167,10 @@ static llvm::cl::opt<ToolActions> ToolAction(
                    "constraints will be reported."),
         clEnumValN(
             DataRecReplace, "datarec-replace",
-            "Use oracle-ktest and datarec.cfg to simplify existing queries")
+            "Use oracle-ktest and datarec.cfg to simplify existing queries"),
+        clEnumValN(SelectDataRec, "select-datarec",
+                   "Select instructions to record to simplify the queries, "
+                   "and write them as a ptwrite-cfg")
         KLEE_LLVM_CL_VAL_END),
     llvm::cl::cat(klee::SolvingCat));
 
@@ -335,7 +375,8 @@ static bool EvaluateInputAST(const char *Filename,
                                    getQueryLogPath(ALL_QUERIES_SMT2_FILE_NAME),
                                    getQueryLogPath(SOLVER_QUERIES_SMT2_FILE_NAME),
                                    getQueryLogPath(ALL_QUERIES_KQUERY_FILE_NAME),
-                                   getQueryLogPath(SOLVER_QUERIES_KQUERY_FILE_NAME));
+                                   getQueryLogPath(SOLVER_QUERIES_KQUERY_FILE_NAME),
+                                   getQueryLogPath(QUERY_CACHE_FILE_NAME));
 
   std::set<std::pair<std::string, unsigned>> concretizedInputs;
   getAdditionalConcreteValues(Decls, concretizedInputs);
@@ -504,6 +545,10 @@ static bool AnalyzeInputAST(const char *Filename,
 static bool DrawInputAST(const char *Filename,
                          const MemoryBuffer *MB,
                          ExprBuilder *Builder) {
+  // the simplification below rewrites expressions in place
+  if (Expr::isHashConsing())
+    klee_error("drawing queries is not supported with --hash-cons-exprs");
+
   InputAST ast(Filename, MB, Builder);
   if (!ast.isValid())
     return false;
@@ -622,6 +667,41 @@ static bool DataRecReplaceInputAST(const char *Filename,
   return true;
 }
 
+static bool SelectDataRecInputAST(const char *Filename,
+                                  const MemoryBuffer *MB,
+                                  ExprBuilder *Builder) {
+  if (DataRecOut.empty() && InputFile == "-")
+    klee_error("--datarec-out is required when reading queries from stdin");
+  if (BitcodePath.empty()) {
+    klee_warning("No bitcode is provided while selecting instructions to "
+                 "record, no instruction can be selected");
+  }
+  InputAST ast(Filename, MB, Builder);
+  if (!ast.isValid())
+    return false;
+
+  DataRecSelector::Options opts;
+  opts.budget = DataRecBudget;
+  opts.allowPointers = DataRecAllowPointers;
+  opts.minIndirectDepth = DataRecMinDepth;
+  opts.jobs = DataRecJobs;
+  DataRecSelector selector(opts);
+  for (Decl *D : ast.getDecls())
+    if (QueryCommand *QC = dyn_cast<QueryCommand>(D))
+      selector.addQuery(*QC);
+  selector.select();
+  selector.printSummary(llvm::outs());
+
+  std::string outPath =
+      DataRecOut.empty() ? InputFile + ".ptwrite.cfg" : DataRecOut;
+  std::string error;
+  auto of = klee_open_output_file(outPath, error);
+  if (!of)
+    klee_error("cannot open %s: %s", outPath.c_str(), error.c_str());
+  selector.writeConfig(*of);
+  return true;
+}
+
 static bool printInputAsSMTLIBv2(const char *Filename,
                              const MemoryBuffer *MB,
                              ExprBuilder *Builder)
@@ -746,6 +826,10 @@ int main(int argc, char **argv) {
     success = DataRecReplaceInputAST(InputFile=="-"? "<stdin>" : InputFile.c_str(),
         MB.get(), Builder);
     break;
+  case SelectDataRec:
+    success = SelectDataRecInputAST(InputFile=="-"? "<stdin>" : InputFile.c_str(),
+        MB.get(), Builder);
+    break;
   default:
     llvm::errs() << argv[0] << ": error: Unknown program action!\n";
   }
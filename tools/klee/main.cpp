@@ -15,10 +15,13 @@
 #include "klee/Expr/Expr.h"
 #include "klee/Internal/ADT/KTest.h"
 #include "klee/Internal/ADT/TreeStream.h"
+#include "klee/Internal/Module/KModule.h"
 #include "klee/Internal/Support/Debug.h"
 #include "klee/Internal/Support/ErrorHandling.h"
 #include "klee/Internal/Support/FileHandling.h"
 #include "klee/Internal/Support/ModuleUtil.h"
+#include "klee/Internal/Support/PathFormat.h"
+#include "klee/Internal/Support/PathReader.h"
 #include "klee/Internal/Support/PrintVersion.h"
 #include "klee/Internal/System/Time.h"
 #include "klee/Interpreter.h"
@@ -27,6 +30,7 @@
 #include "klee/Statistics.h"
 
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Instruction.h"
@@ -131,6 +135,24 @@ namespace {
              cl::init(false),
              cl::cat(TestCaseCat));
 
+  cl::opt<unsigned>
+  PathFormatVersion("path-format-version",
+                    cl::desc("Format version of written .path and "
+                             ".path_datarec files: 1 is the uncompressed "
+                             "legacy format, 2 is the compact format, which "
+                             "tools reading version 1 cannot read "
+                             "(default=1)"),
+                    cl::init(1),
+                    cl::cat(TestCaseCat));
+
+  cl::opt<bool>
+  CompressPaths("compress-paths",
+                cl::desc("Store .path and .path_datarec files as independently "
+                         "compressed blocks, requires --path-format-version=2 "
+                         "(default=false)"),
+                cl::init(false),
+                cl::cat(TestCaseCat));
+
   cl::opt<bool>
   WriteSymPaths("write-sym-paths",
                 cl::desc("Write .sym.path files for each test case (default=false)"),
@@ -269,9 +291,11 @@ namespace {
                  cl::value_desc("output directory"),
                  cl::cat(ReplayCat));
 
-  cl::opt<std::string>
+  cl::list<std::string>
   ReplayPathFile("replay-path",
-                 cl::desc("Specify a path file to replay"),
+                 cl::desc("Specify a path file to replay. Can be given "
+                          "several times to replay the paths together, "
+                          "executing their common prefix once"),
                  cl::value_desc("path file"),
                  cl::cat(ReplayCat));
 
@@ -393,8 +417,8 @@ public:
 
   // load a .path file
   static void loadPathFile(std::string name,
-                           std::vector<PathEntry> &buffer,
-                           std::vector<DataRecEntry> &dataRecEntries);
+                           std::unique_ptr<PathEntryReader> &path,
+                           std::unique_ptr<DataRecEntryReader> &dataRec);
 
   static void getKTestFilesInDir(std::string directoryPath,
                                  std::vector<std::string> &results);
@@ -488,6 +512,14 @@ void KleeHandler::setInterpreter(Interpreter *i) {
   m_interpreter = i;
 
   if (WritePaths) {
+    if (PathFormatVersion != 1 &&
+        PathFormatVersion != pathformat::CurrentVersion)
+      klee_error("unsupported --path-format-version %u",
+                 (unsigned)PathFormatVersion);
+    if (CompressPaths && PathFormatVersion == 1)
+      klee_error("--compress-paths requires --path-format-version=2");
+    if (CompressPaths && !pathformat::compressionSupported())
+      klee_error("--compress-paths requires KLEE to be built with zlib");
     m_pathWriter = new TreeStreamWriter(getOutputFilename("paths.ts"));
     assert(m_pathWriter->good());
     m_interpreter->setPathWriter(m_pathWriter);
@@ -625,9 +657,8 @@ void KleeHandler::processTestCase(const ExecutionState &state,
                                concreteBranches);
       auto f = openTestFile("path", id);
       if (f) {
-        for (const auto &pe : concreteBranches) {
-          serialize(*f, pe);
-        }
+        pathformat::writePathFile(*f, concreteBranches, PathFormatVersion,
+                                  CompressPaths);
       }
       f->close();
       // data recording
@@ -636,9 +667,9 @@ void KleeHandler::processTestCase(const ExecutionState &state,
                                       dataRecEntries);
       auto data_f = openTestFile("path_datarec", id);
       if (data_f) {
-        for (const auto &dre: dataRecEntries) {
-          serialize(*data_f, dre);
-        }
+        pathformat::writeDataRecFile(*data_f, dataRecEntries,
+                                     concreteBranches, PathFormatVersion,
+                                     CompressPaths);
       }
       data_f->close();
     }
@@ -835,24 +866,34 @@ void KleeHandler::processTestCase(const ExecutionState &state,
     if (WriteTestInfo) {
       time::Span elapsed_time(time::getWallTime() - start_time);
       auto f = openTestFile("info", id);
-      if (f)
+      if (f) {
         *f << "Time to generate test case: " << elapsed_time << '\n';
+        if (ReplayPathFile.size() > 1)
+          *f << "Replayed path: "
+             << ReplayPathFile[m_interpreter->getReplayPathIndex(state)]
+             << '\n';
+      }
     }
 
     // Dump Suffix Function List
-    if (DumpFunctionListSuffixLen > 0 && !state.func_inst_map.empty()) {
+    if (DumpFunctionListSuffixLen > 0 && !state.functionCalls->empty()) {
       auto f = openTestFile("suffix_func_list.txt", id);
       if (f) {
-        for (auto &e : state.func_inst_map) {
-          const std::string &funcname = e.first;
-          const unsigned int &inst = e.second;
+        // functions are listed once, in the order of their first call in the
+        // suffix
+        std::set<const KFunction *> listed;
+        const auto &calls = *state.functionCalls;
+        for (size_t i = 0, n = calls.size(); i < n; ++i) {
           // FIXME: the DumpFunctionListSuffixLen specifies the number of
           // instructions from all component (libc, POSIX, app)
           // I can refactor (track number of executed instructions per frame)
           // the instruction counting stats to filter the suffix by component as
           // well.
-          if (inst + DumpFunctionListSuffixLen >= state.steppedInstructions)
-            *f << funcname << '\n';
+          if (calls[i].instruction + DumpFunctionListSuffixLen <
+              state.steppedInstructions)
+            continue;
+          if (listed.insert(calls[i].kf).second)
+            *f << calls[i].kf->function->getName() << '\n';
         }
       }
     }
@@ -865,34 +906,21 @@ void KleeHandler::processTestCase(const ExecutionState &state,
 }
 
 // load a .path file
+// Both .path and .path_datarec are memory mapped and decoded lazily during
+// replay. Their format version is detected from the file header.
 void KleeHandler::loadPathFile(std::string name,
-                               std::vector<PathEntry> &buffer,
-                               std::vector<DataRecEntry> &dataRecEntries) {
-  std::ifstream f(name.c_str(), std::ios::in | std::ios::binary);
-
-  if (!f.good())
-    assert(0 && "unable to open path file");
-
-  while (1) {
-    f.peek();
-    if (!f.good()) break;
-    PathEntry pe;
-    deserialize(f, pe);
-    buffer.push_back(pe);
-  }
-  f.close();
+                               std::unique_ptr<PathEntryReader> &path,
+                               std::unique_ptr<DataRecEntryReader> &dataRec) {
+  std::string error;
+  path = PathEntryReader::open(name, error);
+  if (!path)
+    klee_error("unable to load path file: %s", error.c_str());
 
-  std::ifstream data_f((name + "_datarec").c_str(), std::ios::in | std::ios::binary);
   // .path_datarec is optional. if the correponding .path has "DATAREC" record 
   // but no .path_datarec provided here, Executor will complain later
-  while (1) {
-    data_f.peek();
-    if (!data_f.good()) break;
-    DataRecEntry dre;
-    deserialize(data_f, dre);
-    dataRecEntries.push_back(dre);
-  }
-  data_f.close();
+  dataRec = DataRecEntryReader::open(name + "_datarec", error);
+  if (!dataRec)
+    dataRec.reset(new DataRecEntryReader());
 }
 
 void KleeHandler::getKTestFilesInDir(std::string directoryPath,
@@ -1753,13 +1781,17 @@ int main(int argc, char **argv, char **envp) {
   externalsAndGlobalsCheck(finalModule);
 
   // load replayPath
-  std::vector<PathEntry> replayPath;
-  std::vector<DataRecEntry> dataRecEntries;
-
-  if (ReplayPathFile != "") {
-    KleeHandler::loadPathFile(ReplayPathFile, replayPath, dataRecEntries);
-    interpreter->setReplayPath(&replayPath);
-    interpreter->setReplayDataRecEntries(&dataRecEntries);
+  std::vector<std::unique_ptr<PathEntryReader>> replayPaths;
+  std::vector<std::unique_ptr<DataRecEntryReader>> dataRecEntries;
+
+  for (const std::string &name : ReplayPathFile) {
+    replayPaths.emplace_back();
+    dataRecEntries.emplace_back();
+    KleeHandler::loadPathFile(name, replayPaths.back(), dataRecEntries.back());
+    if (!interpreter->addReplayPath(replayPaths.back().get(),
+                                    dataRecEntries.back().get()))
+      klee_warning("%s is the same as a path given before, replaying it once",
+                   name.c_str());
   }
 
   auto startTime = std::time(nullptr);
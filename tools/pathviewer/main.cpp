@@ -1,3 +1,4 @@
+#include "klee/Internal/Support/PathReader.h"
 #include "klee/Internal/Support/PrintVersion.h"
 #include "klee/Internal/Support/Serialize.h"
 
@@ -29,6 +30,17 @@ static cl::opt<bool> DumpDataRec(
       "If this is true, \"*.path_datarec\" is needed."),
     cl::init(false), cl::cat(PathViewerCmdOpt)
     );
+static cl::opt<size_t> DumpStart(
+    "start",
+    cl::desc("Index of the first entry to dump (default=0). Compressed paths "
+      "only inflate the blocks holding dumped entries."),
+    cl::init(0), cl::cat(PathViewerCmdOpt)
+    );
+static cl::opt<size_t> DumpCount(
+    "count",
+    cl::desc("Number of entries to dump (default=0, dump until the end)"),
+    cl::init(0), cl::cat(PathViewerCmdOpt)
+    );
 static cl::opt<std::string> PathFile(cl::desc("*.path"),
     cl::Positional, cl::Required, cl::cat(PathViewerCmdOpt));
 
@@ -71,13 +83,13 @@ static std::ostream &operator<<(std::ostream &os, PathEntry pe) {
   return os;
 }
 
-static std::ostream &operator<<(std::ostream &os, std::pair<PathEntry, DataRecEntry> &&entry_pair) {
+static std::ostream &operator<<(std::ostream &os, std::pair<PathEntry, DataRecEntryRef> &&entry_pair) {
   PathEntry &pe = entry_pair.first;
-  DataRecEntry &drec = entry_pair.second;
+  DataRecEntryRef &drec = entry_pair.second;
   if (pe.t == PathEntry::DATAREC) {
     APInt var((unsigned int)(pe.body.drec.width), drec.data);
     os << "DATAREC w" << std::dec << (unsigned int)(pe.body.drec.width)
-      << " (" << drec.instUniqueID << "): 0x" << std::hex << var.getLimitedValue();
+      << " (" << drec.instUniqueID.str() << "): 0x" << std::hex << var.getLimitedValue();
   }
   else {
     os << "only DATAREC can be printed with recorded data";
@@ -91,30 +103,23 @@ int main(int argc, char **argv) {
     cl::SetVersionPrinter(klee::printVersion);
     cl::ParseCommandLineOptions(argc, argv);
 
-    // load given *.path
-    std::vector<PathEntry> pathentries;
-    std::ifstream fpath(PathFile);
-    assert(fpath.good() && "Cannot open input .path file");
-    while (fpath.good()) {
-      PathEntry pe;
-      deserialize(fpath, pe);
-      fpath.peek();
-      pathentries.push_back(pe);
+    // map given *.path
+    std::string error;
+    std::unique_ptr<PathEntryReader> pathentries =
+        PathEntryReader::open(PathFile, error);
+    if (!pathentries) {
+      std::cerr << error << '\n';
+      return 1;
     }
-    fpath.close();
 
-    // load associated *.path_datarec if necessary
-    std::vector<DataRecEntry> dataentries;
+    // map associated *.path_datarec if necessary
+    std::unique_ptr<DataRecEntryReader> dataentries;
     if (DumpDataRec) {
-      std::ifstream fdpath(PathFile + "_datarec");
-      assert(fdpath.good() && "Cannot open associated .path_datarec file");
-      while (fdpath.good()) {
-        DataRecEntry drec;
-        deserialize(fdpath, drec);
-        fdpath.peek();
-        dataentries.push_back(drec);
+      dataentries = DataRecEntryReader::open(PathFile + "_datarec", error);
+      if (!dataentries) {
+        std::cerr << error << '\n';
+        return 1;
       }
-      fdpath.close();
     }
 
     uint32_t type_cnt[PathEntry::NUM_PATHENTRY_T] = {0};
@@ -122,12 +127,22 @@ int main(int argc, char **argv) {
     switch (ToolAction) {
       case Dump:
         {
-          auto drec_it = dataentries.begin();
-          for (auto &pe: pathentries) {
+          size_t drec_idx = 0;
+          PathEntry pe;
+          if (DumpDataRec) {
+            // DATAREC entries skipped before DumpStart
+            for (size_t i = 0; i < DumpStart && pathentries->read(i, pe); ++i)
+              if (pe.t == PathEntry::DATAREC)
+                ++drec_idx;
+          }
+          size_t end = DumpCount ? DumpStart + DumpCount : pathentries->size();
+          for (size_t i = DumpStart; i < end && pathentries->read(i, pe); ++i) {
             if (DumpDataRec && (pe.t == PathEntry::DATAREC)) {
-              assert(drec_it != dataentries.end() && ".path_datarec exhausts too early");
-              std::cout << std::make_pair(pe, *drec_it) << '\n';
-              ++drec_it;
+              DataRecEntryRef drec;
+              bool success __attribute__((unused)) =
+                  dataentries->read(drec_idx++, drec);
+              assert(success && ".path_datarec exhausts too early");
+              std::cout << std::make_pair(pe, drec) << '\n';
             }
             else if (DumpDataRec || (pe.t != PathEntry::DATAREC)){
               // do not print an DATAREC entry here without DumpDataRec
@@ -136,8 +151,9 @@ int main(int argc, char **argv) {
           }
         }
         break;
-      case GetInfo:
-        for (auto &pe: pathentries) {
+      case GetInfo: {
+        PathEntry pe;
+        for (size_t i = 0; pathentries->read(i, pe); ++i) {
           if (pe.t < PathEntry::NUM_PATHENTRY_T) {
             if (pe.t == PathEntry::DATAREC) {
               datarec_bytes += pe.body.drec.width / 8;
@@ -150,6 +166,7 @@ int main(int argc, char **argv) {
         }
         std::cout << "DataRecBytes: " << datarec_bytes << std::endl;
         break;
+      }
       default:
         ;
     }
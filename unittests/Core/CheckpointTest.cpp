@@ -0,0 +1,208 @@
+//===-- CheckpointTest.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "../../lib/Core/Checkpoint.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Internal/Module/Cell.h"
+#include "klee/Internal/Module/KModule.h"
+
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+
+#include <string>
+
+using namespace klee;
+
+namespace {
+
+ref<Expr> read8(const UpdateList &ul, unsigned index) {
+  return ReadExpr::create(ul, ConstantExpr::create(index, Expr::Int32));
+}
+
+/// Writes values into a checkpoint in a temporary file and opens it again,
+/// with a module without functions. Reading into the array cache of the
+/// written expressions yields the same symbolic arrays, so that expressions
+/// compare equal.
+class CheckpointRoundTrip {
+  KModule kmodule;
+  KModuleIndex index{&kmodule};
+  llvm::SmallString<128> path;
+
+public:
+  CheckpointWriter writer{index};
+  CheckpointReader reader;
+
+  explicit CheckpointRoundTrip(ArrayCache &ac) : reader(index, ac) {
+    EXPECT_FALSE(llvm::sys::fs::createTemporaryFile("checkpoint", "ckpt", path));
+  }
+  ~CheckpointRoundTrip() { llvm::sys::fs::remove(path); }
+
+  void reopen() {
+    std::string error;
+    ASSERT_TRUE(writer.commit(path.str().str(), error)) << error;
+    reader.open(path.str().str());
+  }
+};
+
+TEST(CheckpointTest, Exprs) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 8);
+  UpdateList ul(a, nullptr);
+  ref<Expr> x = Expr::createTempRead(a, Expr::Int32);
+  ref<Expr> wide = ConstantExpr::alloc(
+      llvm::APInt(128, "123456789abcdef0123456789abcdef", 16));
+
+  std::vector<ref<Expr>> exprs = {
+      x,
+      AddExpr::create(x, ConstantExpr::create(3, Expr::Int32)),
+      UltExpr::create(x, ConstantExpr::create(100, Expr::Int32)),
+      ExtractExpr::create(x, 8, Expr::Int16),
+      ZExtExpr::create(x, Expr::Int64),
+      SExtExpr::create(read8(ul, 5), Expr::Int32),
+      SelectExpr::create(EqExpr::create(read8(ul, 0), read8(ul, 1)), x,
+                         MulExpr::create(x, x)),
+      NotExpr::create(x),
+      AShrExpr::create(x, ZExtExpr::create(ReadExpr::create(ul, x),
+                                           Expr::Int32)),
+      wide,
+      ConcatExpr::create(wide, x),
+  };
+
+  CheckpointRoundTrip rt(ac);
+  for (const auto &e : exprs)
+    rt.writer.write(e);
+  rt.writer.write(ref<Expr>());
+  rt.reopen();
+
+  for (const auto &e : exprs) {
+    ref<Expr> copy = rt.reader.readExpr();
+    ASSERT_FALSE(copy.isNull());
+    EXPECT_EQ(0, e->compare(*copy));
+  }
+  EXPECT_TRUE(rt.reader.readExpr().isNull());
+}
+
+TEST(CheckpointTest, SharedSubtermsStayShared) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 4);
+  ref<Expr> x = Expr::createTempRead(a, Expr::Int32);
+  ref<Expr> sum = AddExpr::create(x, ConstantExpr::create(1, Expr::Int32));
+  ref<Expr> lhs = MulExpr::create(sum, sum);
+  ref<Expr> rhs = XorExpr::create(sum, x);
+
+  CheckpointRoundTrip rt(ac);
+  rt.writer.write(lhs);
+  rt.writer.write(rhs);
+  rt.writer.write(a);
+  rt.reopen();
+
+  ref<Expr> lhsCopy = rt.reader.readExpr();
+  ref<Expr> rhsCopy = rt.reader.readExpr();
+  const Array *aCopy = rt.reader.readArray();
+  EXPECT_EQ(0, lhs->compare(*lhsCopy));
+  EXPECT_EQ(0, rhs->compare(*rhsCopy));
+  // both kids of the product and the first one of the xor are the same sum
+  EXPECT_EQ(lhsCopy->getKid(0).get(), lhsCopy->getKid(1).get());
+  EXPECT_EQ(lhsCopy->getKid(0).get(), rhsCopy->getKid(0).get());
+
+  // the array is read by the expressions, and written once
+  EXPECT_EQ(a, aCopy);
+  const ReadExpr *re = dyn_cast<ReadExpr>(
+      ExtractExpr::create(rhsCopy->getKid(1), 0, Expr::Int8));
+  ASSERT_NE(nullptr, re);
+  EXPECT_EQ(aCopy, re->updates.root);
+}
+
+TEST(CheckpointTest, UpdateLists) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 16);
+  ref<Expr> i = Expr::createTempRead(ac.CreateArray("i", 4), Expr::Int32);
+
+  UpdateList base(a, nullptr);
+  base.extend(ConstantExpr::create(0, Expr::Int32),
+              ConstantExpr::create(42, Expr::Int8));
+  base.extend(i, ConstantExpr::create(7, Expr::Int8));
+  // a second list branching off the first one, sharing its tail
+  UpdateList branch = base;
+  branch.extend(ConstantExpr::create(3, Expr::Int32), read8(base, 0), 1);
+  base.extend(ConstantExpr::create(4, Expr::Int32),
+              ConstantExpr::create(1, Expr::Int8));
+
+  CheckpointRoundTrip rt(ac);
+  rt.writer.write(base);
+  rt.writer.write(branch);
+  rt.writer.write(UpdateList(a, nullptr));
+  rt.reopen();
+
+  UpdateList baseCopy = rt.reader.readUpdates();
+  UpdateList branchCopy = rt.reader.readUpdates();
+  UpdateList emptyCopy = rt.reader.readUpdates();
+  EXPECT_EQ(0, base.compare(baseCopy));
+  EXPECT_EQ(0, branch.compare(branchCopy));
+  EXPECT_EQ(3u, baseCopy.getSize());
+  EXPECT_EQ(3u, branchCopy.getSize());
+  EXPECT_EQ(1u, branchCopy.head->flags);
+  EXPECT_EQ(baseCopy.head->next.get(), branchCopy.head->next.get());
+  EXPECT_EQ(baseCopy.root, branchCopy.root);
+  EXPECT_EQ(0u, emptyCopy.getSize());
+  EXPECT_EQ(baseCopy.root, emptyCopy.root);
+}
+
+TEST(CheckpointTest, ConstantArrays) {
+  ArrayCache ac;
+  std::vector<ref<ConstantExpr>> values;
+  for (unsigned i = 0; i < 4; ++i)
+    values.push_back(ConstantExpr::create(i * 3, Expr::Int8));
+  const Array *c = ac.CreateArray("c", values.size(), values.data(),
+                                  values.data() + values.size());
+
+  CheckpointRoundTrip rt(ac);
+  rt.writer.write(c);
+  rt.writer.write(static_cast<const Array *>(nullptr));
+  rt.reopen();
+
+  const Array *copy = rt.reader.readArray();
+  ASSERT_NE(nullptr, copy);
+  EXPECT_TRUE(copy->isConstantArray());
+  ASSERT_EQ(values.size(), copy->constantValues.size());
+  for (unsigned i = 0; i < values.size(); ++i)
+    EXPECT_EQ(0, values[i]->compare(*copy->constantValues[i]));
+  EXPECT_EQ(nullptr, rt.reader.readArray());
+}
+
+TEST(CheckpointTest, BodyValues) {
+  ArrayCache ac;
+  CheckpointRoundTrip rt(ac);
+  rt.writer.write(uint64_t(0));
+  rt.writer.write(uint64_t(127));
+  rt.writer.write(uint64_t(128));
+  rt.writer.write(~uint64_t(0));
+  rt.writer.writeBool(true);
+  rt.writer.write(std::string("state"));
+  const char bytes[3] = {'\0', '\x80', '\xff'};
+  rt.writer.writeBytes(bytes, sizeof(bytes));
+  rt.reopen();
+
+  EXPECT_EQ(0u, rt.reader.read());
+  EXPECT_EQ(127u, rt.reader.read());
+  EXPECT_EQ(128u, rt.reader.read());
+  EXPECT_EQ(~uint64_t(0), rt.reader.read());
+  EXPECT_TRUE(rt.reader.readBool());
+  EXPECT_EQ("state", rt.reader.readString());
+  char copy[3];
+  rt.reader.readBytes(copy, sizeof(copy));
+  EXPECT_TRUE(std::equal(bytes, bytes + sizeof(bytes), copy));
+}
+
+} // namespace
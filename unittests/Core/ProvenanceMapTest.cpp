@@ -0,0 +1,126 @@
+//===-- ProvenanceMapTest.cpp ---------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "../../lib/Core/ProvenanceMap.h"
+
+#include <random>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+const Provenance P0 = {0, nullptr};
+const Provenance P1 = {1, nullptr};
+const Provenance P2 = {2, nullptr};
+
+/// The provenance of every byte, the number of runs it takes and whether
+/// `map` agrees.
+void expectBytes(const ProvenanceMap &map,
+                 const std::vector<Provenance> &bytes) {
+  size_t runs = 1;
+  for (unsigned i = 0; i < bytes.size(); ++i) {
+    EXPECT_EQ(bytes[i], map.get(i)) << "byte " << i;
+    if (i && bytes[i] != bytes[i - 1])
+      ++runs;
+  }
+  EXPECT_EQ(runs, map.getNumRuns());
+}
+
+TEST(ProvenanceMapTest, Split) {
+  ProvenanceMap map(8, P0);
+  EXPECT_EQ(1u, map.getNumRuns());
+  map.set(2, 5, P1);
+  expectBytes(map, {P0, P0, P1, P1, P1, P0, P0, P0});
+  map.set(3, 4, P2);
+  expectBytes(map, {P0, P0, P1, P2, P1, P0, P0, P0});
+  // ranges touching the ends of the object
+  map.set(0, 1, P2);
+  map.set(7, 8, P1);
+  expectBytes(map, {P2, P0, P1, P2, P1, P0, P0, P1});
+}
+
+TEST(ProvenanceMapTest, Extend) {
+  ProvenanceMap map(8, P0);
+  // a loop writing byte after byte grows a single run
+  for (unsigned i = 1; i < 7; ++i) {
+    map.set(i, i + 1, P1);
+    EXPECT_EQ(3u, map.getNumRuns());
+  }
+  expectBytes(map, {P0, P1, P1, P1, P1, P1, P1, P0});
+  // and backwards
+  map.set(0, 1, P1);
+  expectBytes(map, {P1, P1, P1, P1, P1, P1, P1, P0});
+}
+
+TEST(ProvenanceMapTest, Merge) {
+  ProvenanceMap map(8, P0);
+  map.set(2, 4, P1);
+  map.set(4, 6, P2);
+  expectBytes(map, {P0, P0, P1, P1, P2, P2, P0, P0});
+  // overwriting the runs between two runs of the same provenance joins them
+  map.set(2, 6, P0);
+  expectBytes(map, {P0, P0, P0, P0, P0, P0, P0, P0});
+
+  map.set(1, 3, P1);
+  map.set(5, 7, P1);
+  expectBytes(map, {P0, P1, P1, P0, P0, P1, P1, P0});
+  // a range ending inside a run of the same provenance
+  map.set(3, 6, P1);
+  expectBytes(map, {P0, P1, P1, P1, P1, P1, P1, P0});
+  map.set(0, 8, P2);
+  expectBytes(map, std::vector<Provenance>(8, P2));
+}
+
+TEST(ProvenanceMapTest, CopiesAreUnshared) {
+  ProvenanceMap map(8, P0);
+  map.set(2, 4, P1);
+  ProvenanceMap copy = map;
+  // a write which changes nothing keeps the runs shared
+  copy.set(2, 3, P1);
+  expectBytes(copy, {P0, P0, P1, P1, P0, P0, P0, P0});
+
+  copy.set(3, 6, P2);
+  expectBytes(copy, {P0, P0, P1, P2, P2, P2, P0, P0});
+  expectBytes(map, {P0, P0, P1, P1, P0, P0, P0, P0});
+
+  map.set(0, 2, P1);
+  expectBytes(map, {P1, P1, P1, P1, P0, P0, P0, P0});
+  expectBytes(copy, {P0, P0, P1, P2, P2, P2, P0, P0});
+}
+
+TEST(ProvenanceMapTest, RandomWrites) {
+  const Provenance provenances[] = {P0, P1, P2};
+  std::mt19937 rng(42);
+  for (unsigned round = 0; round < 20; ++round) {
+    const unsigned size = 1 + rng() % 40;
+    ProvenanceMap map(size, P0);
+    std::vector<Provenance> bytes(size, P0);
+    std::vector<ProvenanceMap> copies;
+    std::vector<std::vector<Provenance>> copiedBytes;
+    for (unsigned i = 0; i < 200; ++i) {
+      unsigned begin = rng() % size;
+      unsigned end = begin + 1 + rng() % (size - begin);
+      Provenance p = provenances[rng() % 3];
+      map.set(begin, end, p);
+      std::fill(bytes.begin() + begin, bytes.begin() + end, p);
+      expectBytes(map, bytes);
+      if (i % 50 == 0) {
+        copies.push_back(map);
+        copiedBytes.push_back(bytes);
+      }
+    }
+    for (unsigned i = 0; i < copies.size(); ++i)
+      expectBytes(copies[i], copiedBytes[i]);
+  }
+}
+
+} // namespace
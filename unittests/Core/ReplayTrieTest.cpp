@@ -0,0 +1,200 @@
+//===-- ReplayTrieTest.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "../../lib/Core/ReplayTrie.h"
+
+#include "klee/Internal/Support/PathFormat.h"
+#include "klee/Internal/Support/PathReader.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+/// Builds a trie from traces written to temporary .path files.
+class TrieBuilder {
+  llvm::SmallString<128> dir;
+  std::vector<std::string> files;
+  std::vector<std::unique_ptr<PathEntryReader>> paths;
+  std::vector<std::unique_ptr<DataRecEntryReader>> dataRecs;
+
+public:
+  ReplayTrie trie;
+
+  TrieBuilder() {
+    EXPECT_FALSE(llvm::sys::fs::createUniqueDirectory("replaytrie", dir));
+  }
+  ~TrieBuilder() {
+    for (const auto &file : files)
+      llvm::sys::fs::remove(file);
+    llvm::sys::fs::remove(dir);
+  }
+
+  /// Add a trace of FORK entries, '0' or '1', and DATAREC entries, 'd',
+  /// which record the next value of `data`.
+  bool add(const std::string &entries,
+           const std::vector<uint64_t> &data = {}) {
+    std::vector<PathEntry> path;
+    std::vector<DataRecEntry> dataRec;
+    for (char c : entries) {
+      PathEntry pe;
+      if (c == 'd') {
+        pe.t = PathEntry::DATAREC;
+        pe.body.drec.width = 64;
+        pe.body.drec.IDlen = 0;
+        dataRec.push_back({"main:entry:0", data.at(dataRec.size())});
+      } else {
+        pe.t = PathEntry::FORK;
+        pe.body.br = c == '1';
+      }
+      path.push_back(pe);
+    }
+
+    std::string name =
+        (dir + "/trace" + std::to_string(files.size()) + ".path").str();
+    std::string pathBuf, dataRecBuf;
+    llvm::raw_string_ostream pathOS(pathBuf), dataRecOS(dataRecBuf);
+    pathformat::writePathFile(pathOS, path);
+    pathformat::writeDataRecFile(dataRecOS, dataRec, path);
+    std::ofstream(name, std::ios::binary) << pathOS.str();
+    std::ofstream(name + "_datarec", std::ios::binary) << dataRecOS.str();
+    files.push_back(name);
+    files.push_back(name + "_datarec");
+
+    std::string error;
+    paths.push_back(PathEntryReader::open(name, error));
+    EXPECT_TRUE(paths.back() != nullptr) << error;
+    dataRecs.push_back(DataRecEntryReader::open(name + "_datarec", error));
+    EXPECT_TRUE(dataRecs.back() != nullptr) << error;
+    return trie.addTrace(paths.back().get(), dataRecs.back().get());
+  }
+
+  /// The traces replayed by the children of `node`
+  std::vector<unsigned> childTraces(unsigned node) const {
+    std::vector<unsigned> result;
+    for (unsigned child : trie.getChildren(node))
+      result.push_back(trie.getTraceIndex(child));
+    return result;
+  }
+};
+
+TEST(ReplayTrieTest, SingleTrace) {
+  TrieBuilder b;
+  ASSERT_TRUE(b.add("101"));
+  const ReplayTrie &trie = b.trie;
+  EXPECT_EQ(1u, trie.getNumNodes());
+  EXPECT_EQ(3u, trie.getEnd(trie.getRoot()));
+  EXPECT_FALSE(trie.hasDiverged(trie.getRoot(), 3));
+}
+
+TEST(ReplayTrieTest, DivergeAtFirstEntry) {
+  TrieBuilder b;
+  ASSERT_TRUE(b.add("10"));
+  ASSERT_TRUE(b.add("01"));
+  const ReplayTrie &trie = b.trie;
+  unsigned root = trie.getRoot();
+  EXPECT_EQ(0u, trie.getEnd(root));
+  EXPECT_TRUE(trie.hasDiverged(root, 0));
+  EXPECT_EQ(std::vector<unsigned>({0, 1}), b.childTraces(root));
+  for (unsigned child : trie.getChildren(root)) {
+    EXPECT_EQ(2u, trie.getEnd(child));
+    EXPECT_FALSE(trie.hasDiverged(child, 2));
+  }
+}
+
+TEST(ReplayTrieTest, DivergeInTheMiddle) {
+  TrieBuilder b;
+  ASSERT_TRUE(b.add("1100"));
+  ASSERT_TRUE(b.add("1101"));
+  ASSERT_TRUE(b.add("1011"));
+  const ReplayTrie &trie = b.trie;
+  unsigned root = trie.getRoot();
+  EXPECT_EQ(1u, trie.getEnd(root));
+  EXPECT_FALSE(trie.hasDiverged(root, 0));
+  EXPECT_TRUE(trie.hasDiverged(root, 1));
+  // the first two traces share "110" and are split again under the first
+  // child, the third one forks off the root
+  EXPECT_EQ(std::vector<unsigned>({0, 2}), b.childTraces(root));
+  unsigned shared = trie.getChildren(root)[0];
+  EXPECT_EQ(3u, trie.getEnd(shared));
+  EXPECT_EQ(std::vector<unsigned>({0, 1}), b.childTraces(shared));
+  EXPECT_EQ(5u, trie.getNumNodes());
+}
+
+TEST(ReplayTrieTest, PrefixAddedAfter) {
+  TrieBuilder b;
+  ASSERT_TRUE(b.add("110"));
+  ASSERT_TRUE(b.add("11"));
+  const ReplayTrie &trie = b.trie;
+  unsigned root = trie.getRoot();
+  EXPECT_EQ(2u, trie.getEnd(root));
+  EXPECT_TRUE(trie.hasDiverged(root, 2));
+  ASSERT_EQ(std::vector<unsigned>({0, 1}), b.childTraces(root));
+  // the prefix ends where it diverges, in an empty leaf
+  unsigned rest = trie.getChildren(root)[0], prefix = trie.getChildren(root)[1];
+  EXPECT_EQ(3u, trie.getEnd(rest));
+  EXPECT_EQ(2u, trie.getEnd(prefix));
+  EXPECT_FALSE(trie.hasDiverged(prefix, 2));
+}
+
+TEST(ReplayTrieTest, PrefixAddedBefore) {
+  TrieBuilder b;
+  ASSERT_TRUE(b.add("11"));
+  ASSERT_TRUE(b.add("110"));
+  const ReplayTrie &trie = b.trie;
+  unsigned root = trie.getRoot();
+  EXPECT_EQ(2u, trie.getEnd(root));
+  EXPECT_TRUE(trie.hasDiverged(root, 2));
+  ASSERT_EQ(std::vector<unsigned>({0, 1}), b.childTraces(root));
+  unsigned prefix = trie.getChildren(root)[0], rest = trie.getChildren(root)[1];
+  EXPECT_EQ(2u, trie.getEnd(prefix));
+  EXPECT_EQ(3u, trie.getEnd(rest));
+  // a third trace ending at the same point is the same as the prefix
+  EXPECT_FALSE(b.add("11"));
+}
+
+TEST(ReplayTrieTest, IdenticalTraces) {
+  TrieBuilder b;
+  ASSERT_TRUE(b.add("101"));
+  EXPECT_FALSE(b.add("101"));
+  EXPECT_EQ(1u, b.trie.getNumNodes());
+
+  ASSERT_TRUE(b.add("100"));
+  size_t nodes = b.trie.getNumNodes();
+  EXPECT_FALSE(b.add("100"));
+  EXPECT_FALSE(b.add("101"));
+  EXPECT_EQ(nodes, b.trie.getNumNodes());
+  // duplicates are still indexed, but never replayed
+  EXPECT_EQ(5u, b.trie.getNumTraces());
+}
+
+TEST(ReplayTrieTest, DataRecEntries) {
+  TrieBuilder b;
+  ASSERT_TRUE(b.add("1d0d", {1, 2}));
+  EXPECT_FALSE(b.add("1d0d", {1, 2}));
+  // same branches, diverging at the second recorded value
+  ASSERT_TRUE(b.add("1d0d", {1, 3}));
+  const ReplayTrie &trie = b.trie;
+  unsigned root = trie.getRoot();
+  EXPECT_EQ(3u, trie.getEnd(root));
+  EXPECT_TRUE(trie.hasDiverged(root, 3));
+  EXPECT_EQ(std::vector<unsigned>({0, 2}), b.childTraces(root));
+}
+
+} // namespace
@@ -0,0 +1,229 @@
+//===-- ConstraintsTest.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+
+using namespace klee;
+
+namespace {
+
+static ArrayCache ac;
+
+ref<Expr> readAt(const Array *array, unsigned index) {
+  return ReadExpr::create(UpdateList(array, 0),
+                          ConstantExpr::create(index, Expr::Int32));
+}
+
+TEST(ConstraintsTest, RewriteContainingConstraints) {
+  const Array *a = ac.CreateArray("cs_r", 16);
+  ConstraintManager cm;
+  ref<Expr> sum = AddExpr::create(readAt(a, 0), readAt(a, 1));
+  ASSERT_TRUE(cm.addConstraint(
+      UltExpr::create(sum, ConstantExpr::create(200, Expr::Int8))));
+  ASSERT_TRUE(cm.addConstraint(
+      UltExpr::create(readAt(a, 2), ConstantExpr::create(100, Expr::Int8))));
+
+  ASSERT_TRUE(cm.addConstraint(
+      EqExpr::create(ConstantExpr::create(3, Expr::Int8), readAt(a, 0))));
+  ref<Expr> rewritten = UltExpr::create(
+      AddExpr::create(ConstantExpr::create(3, Expr::Int8), readAt(a, 1)),
+      ConstantExpr::create(200, Expr::Int8));
+  const Constraints_ty &constraints = cm.getAllConstraints();
+  EXPECT_EQ(constraints.size(), 3u);
+  EXPECT_TRUE(constraints.count(rewritten));
+  EXPECT_TRUE(constraints.count(
+      UltExpr::create(readAt(a, 2), ConstantExpr::create(100, Expr::Int8))));
+}
+
+TEST(ConstraintsTest, RewriteRewrittenConstraints) {
+  const Array *a = ac.CreateArray("cs_o", 16);
+  ConstraintManager cm;
+  ref<Expr> c = UltExpr::create(
+      AddExpr::create(readAt(a, 0), AddExpr::create(readAt(a, 1),
+                                                    readAt(a, 2))),
+      ConstantExpr::create(200, Expr::Int8));
+  ASSERT_TRUE(cm.addConstraint(c));
+
+  // each rewriting indexes the new constraint under its reads, so that the
+  // next equality finds it
+  ASSERT_TRUE(cm.addConstraint(
+      EqExpr::create(ConstantExpr::create(2, Expr::Int8), readAt(a, 1))));
+  ASSERT_TRUE(cm.addConstraint(
+      EqExpr::create(ConstantExpr::create(3, Expr::Int8), readAt(a, 0))));
+  const Constraints_ty &constraints = cm.getAllConstraints();
+  EXPECT_EQ(constraints.size(), 3u);
+  EXPECT_TRUE(constraints.count(UltExpr::create(
+      AddExpr::create(ConstantExpr::create(5, Expr::Int8), readAt(a, 2)),
+      ConstantExpr::create(200, Expr::Int8))));
+
+  // the last rewriting makes the constraint true, which drops it
+  ASSERT_TRUE(cm.addConstraint(
+      EqExpr::create(ConstantExpr::create(4, Expr::Int8), readAt(a, 2))));
+  EXPECT_EQ(constraints.size(), 3u);
+  EXPECT_FALSE(constraints.count(c));
+  for (const ref<Expr> &e : constraints)
+    EXPECT_EQ(e->getKind(), Expr::Eq);
+}
+
+TEST(ConstraintsTest, RewriteCompoundEquality) {
+  const Array *a = ac.CreateArray("cs_m", 16);
+  ConstraintManager cm;
+  ref<Expr> sum = AddExpr::create(readAt(a, 0), readAt(a, 1));
+  ref<Expr> withSum =
+      UltExpr::create(sum, ConstantExpr::create(100, Expr::Int8));
+  // read the two bytes, but not their sum
+  ref<Expr> withBoth = UltExpr::create(readAt(a, 0), readAt(a, 1));
+  ref<Expr> withOne =
+      UltExpr::create(readAt(a, 0), ConstantExpr::create(50, Expr::Int8));
+  ASSERT_TRUE(cm.addConstraint(withSum));
+  ASSERT_TRUE(cm.addConstraint(withBoth));
+  ASSERT_TRUE(cm.addConstraint(withOne));
+
+  ASSERT_TRUE(
+      cm.addConstraint(EqExpr::create(ConstantExpr::create(9, Expr::Int8), sum)));
+  const Constraints_ty &constraints = cm.getAllConstraints();
+  EXPECT_FALSE(constraints.count(withSum));
+  EXPECT_TRUE(constraints.count(withBoth));
+  EXPECT_TRUE(constraints.count(withOne));
+  EXPECT_EQ(constraints.size(), 3u);
+
+  // an equality on a read no constraint contains rewrites nothing
+  ref<Expr> unread =
+      EqExpr::create(ConstantExpr::create(1, Expr::Int8), readAt(a, 7));
+  ASSERT_TRUE(cm.addConstraint(unread));
+  EXPECT_EQ(constraints.size(), 4u);
+  EXPECT_TRUE(constraints.count(withBoth));
+  EXPECT_TRUE(constraints.count(withOne));
+  EXPECT_TRUE(constraints.count(unread));
+}
+
+TEST(ConstraintsTest, CopiesKeepTheirIndex) {
+  const Array *a = ac.CreateArray("cs_k", 16);
+  ref<Expr> c =
+      UltExpr::create(AddExpr::create(readAt(a, 0), readAt(a, 1)),
+                      ConstantExpr::create(100, Expr::Int8));
+  ConstraintManager cm;
+  ASSERT_TRUE(cm.addConstraint(c));
+  ConstraintManager copy(cm);
+
+  ASSERT_TRUE(copy.addConstraint(
+      EqExpr::create(ConstantExpr::create(3, Expr::Int8), readAt(a, 0))));
+  EXPECT_FALSE(copy.getAllConstraints().count(c));
+  EXPECT_TRUE(cm.getAllConstraints().count(c));
+  EXPECT_EQ(cm.getAllConstraints().size(), 1u);
+
+  // the original still finds its own constraint
+  ASSERT_TRUE(cm.addConstraint(
+      EqExpr::create(ConstantExpr::create(4, Expr::Int8), readAt(a, 1))));
+  EXPECT_FALSE(cm.getAllConstraints().count(c));
+  EXPECT_TRUE(cm.getAllConstraints().count(UltExpr::create(
+      AddExpr::create(ConstantExpr::create(4, Expr::Int8), readAt(a, 0)),
+      ConstantExpr::create(100, Expr::Int8))));
+}
+
+TEST(ConstraintsTest, BaseVersionChangesOnDeletion) {
+  const Array *a = ac.CreateArray("cs_v", 16);
+  ConstraintManager cm;
+  uint64_t base = cm.getBaseVersion();
+  uint64_t version = cm.getVersion();
+  ref<Expr> c =
+      UltExpr::create(AddExpr::create(readAt(a, 0), readAt(a, 1)),
+                      ConstantExpr::create(100, Expr::Int8));
+  ASSERT_TRUE(cm.addConstraint(c));
+  // an equality which rewrites nothing only adds a constraint
+  ASSERT_TRUE(cm.addConstraint(
+      EqExpr::create(ConstantExpr::create(1, Expr::Int8), readAt(a, 2))));
+  EXPECT_EQ(base, cm.getBaseVersion());
+  EXPECT_LT(version, cm.getVersion());
+  version = cm.getVersion();
+
+  // copies get their own base version, as they grow apart
+  ConstraintManager copy(cm);
+  EXPECT_LT(version, copy.getBaseVersion());
+  EXPECT_EQ(base, cm.getBaseVersion());
+
+  // rewriting `c` deletes it
+  ASSERT_TRUE(cm.addConstraint(
+      EqExpr::create(ConstantExpr::create(3, Expr::Int8), readAt(a, 0))));
+  EXPECT_FALSE(cm.getAllConstraints().count(c));
+  EXPECT_LT(version, cm.getBaseVersion());
+  EXPECT_LE(cm.getBaseVersion(), cm.getVersion());
+
+  // moving constraints into a manager starts a new base version
+  version = cm.getVersion();
+  ConstraintManager moved(std::move(cm));
+  EXPECT_LT(version, moved.getBaseVersion());
+}
+
+TEST(ConstraintsTest, SimplifyAfterConstraintsChange) {
+  const Array *a = ac.CreateArray("cs_s", 16);
+  const Array *b = ac.CreateArray("cs_s2", 16);
+  ConstraintManager cm;
+  ref<Expr> c = UltExpr::create(AddExpr::create(readAt(a, 0), readAt(a, 1)),
+                                ConstantExpr::create(250, Expr::Int8));
+  ref<Expr> sum = AddExpr::create(readAt(a, 0), readAt(a, 2));
+  EXPECT_EQ(cm.simplifyExpr(c), c);
+  EXPECT_EQ(cm.simplifyExpr(sum), sum);
+
+  // the earlier simplification of c must not be reused
+  ASSERT_TRUE(cm.addConstraint(c));
+  EXPECT_TRUE(cm.simplifyExpr(c)->isTrue());
+
+  // equalities on other arrays leave sum alone
+  ASSERT_TRUE(cm.addConstraint(
+      EqExpr::create(ConstantExpr::create(7, Expr::Int8), readAt(b, 0))));
+  EXPECT_EQ(cm.simplifyExpr(sum), sum);
+
+  ASSERT_TRUE(cm.addConstraint(
+      EqExpr::create(ConstantExpr::create(3, Expr::Int8), readAt(a, 2))));
+  EXPECT_EQ(cm.simplifyExpr(sum),
+            AddExpr::create(ConstantExpr::create(3, Expr::Int8),
+                            readAt(a, 0)));
+  ASSERT_TRUE(cm.addConstraint(
+      EqExpr::create(ConstantExpr::create(4, Expr::Int8), readAt(a, 0))));
+  EXPECT_EQ(cm.simplifyExpr(sum), ConstantExpr::create(7, Expr::Int8));
+  EXPECT_TRUE(cm.simplifyExpr(c)->isTrue());
+}
+
+TEST(ConstraintsTest, CopyAndMoveAssignment) {
+  const Array *a = ac.CreateArray("cs_c", 16);
+  ref<Expr> c0 =
+      UltExpr::create(readAt(a, 0), ConstantExpr::create(100, Expr::Int8));
+  ref<Expr> c1 =
+      UltExpr::create(readAt(a, 1), ConstantExpr::create(100, Expr::Int8));
+  ConstraintManager cm;
+  ASSERT_TRUE(cm.addConstraint(c0));
+  ASSERT_TRUE(cm.addConstraint(c1));
+  EXPECT_TRUE(cm.simplifyExpr(c0)->isTrue());
+
+  ConstraintManager snapshot;
+  snapshot = cm;
+  EXPECT_EQ(snapshot, cm);
+  EXPECT_EQ(snapshot.factor_size(), cm.factor_size());
+
+  // the factors of the snapshot are its own
+  ConstraintManager moved;
+  moved = std::move(snapshot);
+  EXPECT_TRUE(snapshot.empty());
+  EXPECT_EQ(snapshot.factor_size(), 0u);
+  EXPECT_EQ(moved, cm);
+  moved = ConstraintManager();
+  EXPECT_TRUE(moved.empty());
+
+  ASSERT_TRUE(cm.addConstraint(
+      UltExpr::create(readAt(a, 0), readAt(a, 1))));
+  EXPECT_EQ(cm.factor_size(), 1u);
+  EXPECT_TRUE(cm.simplifyExpr(c1)->isTrue());
+}
+
+} // namespace
@@ -264,4 +264,54 @@ TEST(ExprTest, ReadExprFoldingSymbolicIndexUpdate) {
     EXPECT_EQ(Expr::Read, read.get()->getKind());
   }
 }
+
+TEST(ExprTest, HashConsing) {
+  auto *option = static_cast<llvm::cl::opt<bool> *>(
+      llvm::cl::getRegisteredOptions()["hash-cons-exprs"]);
+  ASSERT_NE(nullptr, option);
+  option->setValue(true);
+
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 256);
+  ref<Expr> read = Expr::createTempRead(array, Expr::Int32);
+  ref<Expr> sum1 = AddExpr::create(read, getConstant(1, Expr::Int32));
+  ref<Expr> sum2 = AddExpr::create(Expr::createTempRead(array, Expr::Int32),
+                                   getConstant(1, Expr::Int32));
+  EXPECT_EQ(sum1.get(), sum2.get());
+  ref<Expr> sum3 = AddExpr::create(read, getConstant(2, Expr::Int32));
+  EXPECT_NE(sum1.get(), sum3.get());
+
+  // a node leaves the table once it is no longer referenced
+  sum3 = nullptr;
+  sum3 = AddExpr::create(read, getConstant(2, Expr::Int32));
+  EXPECT_EQ(Expr::Add, sum3->getKind());
+
+  option->setValue(false);
+  ref<Expr> sum5 = AddExpr::create(read, getConstant(1, Expr::Int32));
+  EXPECT_NE(sum1.get(), sum5.get());
+  EXPECT_EQ(0, sum5->compare(*sum1));
+}
+
+TEST(ExprTest, SharedSmallConstants) {
+  for (Expr::Width w : {Expr::Int8, Expr::Int16, Expr::Int32, Expr::Int64}) {
+    for (int value : {0, 1, 42, 255, -1, -16}) {
+      ref<Expr> a = getConstant(value, w);
+      EXPECT_EQ(a.get(), getConstant(value, w).get());
+      EXPECT_EQ(w, a->getWidth());
+    }
+  }
+  EXPECT_EQ(ConstantExpr::alloc(1, Expr::Bool).get(),
+            ConstantExpr::alloc(1, Expr::Bool).get());
+  // folded constants are shared too
+  ref<Expr> sum = AddExpr::create(getConstant(3, Expr::Int32),
+                                  getConstant(4, Expr::Int32));
+  EXPECT_EQ(getConstant(7, Expr::Int32).get(), sum.get());
+
+  // larger values are allocated, but equal
+  ref<Expr> big = getConstant(1000, Expr::Int32);
+  EXPECT_NE(big.get(), getConstant(1000, Expr::Int32).get());
+  EXPECT_EQ(0, big->compare(*getConstant(1000, Expr::Int32)));
+  ref<Expr> odd = getConstant(1, 7);
+  EXPECT_NE(odd.get(), getConstant(1, 7).get());
+}
 }
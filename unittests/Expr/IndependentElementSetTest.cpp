@@ -0,0 +1,115 @@
+//===-- IndependentElementSetTest.cpp -------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Internal/Support/IndependentElementSet.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+static ArrayCache ac;
+
+std::vector<unsigned> elementsOf(const DenseSet<unsigned> &s) {
+  return std::vector<unsigned>(s.begin(), s.end());
+}
+
+ref<Expr> readAt(const Array *array, ref<Expr> index) {
+  return ReadExpr::create(UpdateList(array, 0), index);
+}
+
+ref<Expr> readAt(const Array *array, unsigned index) {
+  return readAt(array, ConstantExpr::create(index, Expr::Int32));
+}
+
+TEST(DenseSetTest, AddRanges) {
+  DenseSet<unsigned> s;
+  s.add(10, 14);
+  s.add(2);
+  s.add(14, 16);
+  s.add(4, 6);
+  EXPECT_EQ(elementsOf(s),
+            std::vector<unsigned>({2, 4, 5, 10, 11, 12, 13, 14, 15}));
+  s.add(3, 11);
+  EXPECT_EQ(elementsOf(s),
+            std::vector<unsigned>({2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+                                   14, 15}));
+}
+
+TEST(DenseSetTest, AddSet) {
+  DenseSet<unsigned> a, b;
+  a.add(0, 4);
+  a.add(20, 24);
+  b.add(2, 6);
+  b.add(30);
+  EXPECT_TRUE(a.add(b));
+  EXPECT_EQ(elementsOf(a),
+            std::vector<unsigned>({0, 1, 2, 3, 4, 5, 20, 21, 22, 23, 30}));
+  EXPECT_FALSE(a.add(b));
+
+  DenseSet<unsigned> c;
+  c.add(21);
+  EXPECT_FALSE(a.add(c));
+}
+
+TEST(DenseSetTest, Intersects) {
+  DenseSet<unsigned> a, b, c;
+  a.add(0, 4);
+  a.add(100, 200);
+  b.add(4, 100);
+  c.add(150);
+  EXPECT_FALSE(a.intersects(b));
+  EXPECT_FALSE(b.intersects(a));
+  EXPECT_TRUE(a.intersects(c));
+  EXPECT_TRUE(c.intersects(a));
+  EXPECT_FALSE(b.intersects(c));
+}
+
+TEST(IndependentElementSetTest, WholeObjectIntersectsElements) {
+  const Array *a = ac.CreateArray("ies_a", 16);
+  const Array *b = ac.CreateArray("ies_b", 16);
+  const Array *c = ac.CreateArray("ies_c", 16);
+  // a is accessed with a symbolic index, b and c at constant ones
+  IndependentElementSet whole(EqExpr::create(
+      readAt(a, ZExtExpr::create(readAt(b, 0), Expr::Int32)),
+      ConstantExpr::create(0, Expr::Int8)));
+  // more arrays accessed at constant indices than `whole`
+  IndependentElementSet elements(EqExpr::create(
+      AddExpr::create(readAt(a, 3), readAt(c, 1)), readAt(c, 2)));
+  EXPECT_TRUE(whole.intersects(elements));
+  EXPECT_TRUE(elements.intersects(whole));
+}
+
+TEST(IndependentElementSetTest, FactorsMerge) {
+  const Array *a = ac.CreateArray("ies_m", 16);
+  ConstraintManager cm;
+  for (unsigned i = 0; i < 4; ++i)
+    ASSERT_TRUE(cm.addConstraint(UltExpr::create(
+        readAt(a, i), ConstantExpr::create(100 + i, Expr::Int8))));
+  EXPECT_EQ(cm.factor_size(), 4u);
+
+  // joins the factors of bytes 0 and 1
+  ASSERT_TRUE(cm.addConstraint(UltExpr::create(readAt(a, 0), readAt(a, 1))));
+  EXPECT_EQ(cm.factor_size(), 3u);
+
+  // a symbolic index joins all of them
+  ASSERT_TRUE(cm.addConstraint(UltExpr::create(
+      readAt(a, ZExtExpr::create(readAt(a, 5), Expr::Int32)),
+      ConstantExpr::create(50, Expr::Int8))));
+  ASSERT_EQ(cm.factor_size(), 1u);
+  EXPECT_EQ((*cm.factor_begin())->exprs.size(), cm.size());
+}
+
+} // namespace
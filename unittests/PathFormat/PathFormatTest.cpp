@@ -0,0 +1,189 @@
+#include "klee/Internal/Support/PathFormat.h"
+#include "klee/Internal/Support/PathReader.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+std::vector<PathEntry> makePath() {
+  std::vector<PathEntry> path;
+  PathEntry pe;
+  // a run longer than one FORK record
+  for (unsigned i = 0; i < 70; ++i) {
+    pe.t = PathEntry::FORK;
+    pe.body.br = (i % 3) == 0;
+    path.push_back(pe);
+  }
+  pe.t = PathEntry::SWITCH_EXPIDX;
+  pe.body.switchIndex = 3;
+  path.push_back(pe);
+  pe.t = PathEntry::SWITCH_BBIDX;
+  pe.body.switchIndex = 40000;
+  path.push_back(pe);
+  pe.t = PathEntry::INDIRECTBR;
+  pe.body.indirectbrIndex = 200;
+  path.push_back(pe);
+  for (unsigned i = 0; i < 3; ++i) {
+    pe.t = PathEntry::DATAREC;
+    pe.body.drec.width = i == 1 ? 8 : 64;
+    pe.body.drec.IDlen = 0;
+    path.push_back(pe);
+    pe.t = PathEntry::FORK;
+    pe.body.br = true;
+    path.push_back(pe);
+  }
+  pe.t = PathEntry::SCHEDULE;
+  pe.body.tgtid = 30;
+  path.push_back(pe);
+  return path;
+}
+
+std::vector<DataRecEntry> makeDataRec() {
+  return {{"main:entry:3", 0x1122334455667788ull},
+          {"main:bb1:0", 0xab},
+          {"main:entry:3", 42}};
+}
+
+// A trace large enough to span several compressed blocks
+void makeLargeTrace(std::vector<PathEntry> &path,
+                    std::vector<DataRecEntry> &dataRec) {
+  PathEntry pe;
+  for (unsigned i = 0; i < 400000; ++i) {
+    if (i % 5 == 0) {
+      pe.t = PathEntry::SWITCH_BBIDX;
+      pe.body.switchIndex = i % 50000;
+    } else if (i % 7 == 0) {
+      pe.t = PathEntry::DATAREC;
+      pe.body.drec.width = 32;
+      pe.body.drec.IDlen = 0;
+      dataRec.push_back({"f:bb:" + std::to_string(i % 100), i * 2654435761u});
+    } else {
+      pe.t = PathEntry::FORK;
+      pe.body.br = ((i * 2654435761u) >> 13) & 1;
+    }
+    path.push_back(pe);
+  }
+}
+
+void writeFiles(const std::string &name, const std::vector<PathEntry> &path,
+                const std::vector<DataRecEntry> &dataRec, unsigned version,
+                bool compress = false) {
+  std::string pathBuf, dataRecBuf;
+  llvm::raw_string_ostream pathOS(pathBuf), dataRecOS(dataRecBuf);
+  pathformat::writePathFile(pathOS, path, version, compress);
+  pathformat::writeDataRecFile(dataRecOS, dataRec, path, version, compress);
+  std::ofstream(name, std::ios::binary) << pathOS.str();
+  std::ofstream(name + "_datarec", std::ios::binary) << dataRecOS.str();
+}
+
+void writeFiles(const std::string &name, unsigned version) {
+  writeFiles(name, makePath(), makeDataRec(), version);
+}
+
+void checkFiles(const std::string &name,
+                const std::vector<PathEntry> &expected = makePath(),
+                const std::vector<DataRecEntry> &expectedData = makeDataRec()) {
+  std::string error;
+  auto path = PathEntryReader::open(name, error);
+  ASSERT_TRUE(path != nullptr) << error;
+  auto dataRec = DataRecEntryReader::open(name + "_datarec", error);
+  ASSERT_TRUE(dataRec != nullptr) << error;
+
+  ASSERT_EQ(expected.size(), path->size());
+  // read backwards and with strides first to exercise seeking, then
+  // sequentially
+  PathEntry pe;
+  for (size_t i = expected.size(); i-- > 0;) {
+    ASSERT_TRUE(path->read(i, pe));
+    ASSERT_EQ(expected[i].t, pe.t);
+  }
+  for (size_t i = 0; i < expected.size(); i += 7919) {
+    ASSERT_TRUE(path->read(i, pe));
+    ASSERT_EQ(expected[i].t, pe.t);
+  }
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_TRUE(path->read(i, pe));
+    ASSERT_EQ(expected[i].t, pe.t);
+    switch (pe.t) {
+    case PathEntry::FORK:
+      ASSERT_EQ(expected[i].body.br, pe.body.br);
+      break;
+    case PathEntry::SWITCH_EXPIDX:
+    case PathEntry::SWITCH_BBIDX:
+      ASSERT_EQ(expected[i].body.switchIndex, pe.body.switchIndex);
+      break;
+    case PathEntry::INDIRECTBR:
+      ASSERT_EQ(expected[i].body.indirectbrIndex, pe.body.indirectbrIndex);
+      break;
+    case PathEntry::DATAREC:
+      ASSERT_EQ(expected[i].body.drec.width, pe.body.drec.width);
+      break;
+    case PathEntry::SCHEDULE:
+      ASSERT_EQ(expected[i].body.tgtid, pe.body.tgtid);
+      break;
+    default:
+      FAIL();
+    }
+  }
+  ASSERT_FALSE(path->read(expected.size(), pe));
+
+  DataRecEntryRef dre;
+  for (size_t i = expectedData.size(); i-- > 0;) {
+    ASSERT_TRUE(dataRec->read(i, dre));
+    ASSERT_EQ(expectedData[i].data, dre.data);
+  }
+  for (size_t i = 0; i < expectedData.size(); ++i) {
+    ASSERT_TRUE(dataRec->read(i, dre));
+    ASSERT_EQ(expectedData[i].data, dre.data);
+    ASSERT_EQ(expectedData[i].instUniqueID, dre.instUniqueID.str());
+  }
+  ASSERT_FALSE(dataRec->read(expectedData.size(), dre));
+}
+} // namespace
+
+TEST(PathFormatTest, ReadV1) {
+  writeFiles("pathformat_v1.path", 1);
+  checkFiles("pathformat_v1.path");
+}
+
+TEST(PathFormatTest, ReadV2) {
+  writeFiles("pathformat_v2.path", 2);
+  checkFiles("pathformat_v2.path");
+}
+
+TEST(PathFormatTest, V2IsSmaller) {
+  writeFiles("pathformat_size_v1.path", 1);
+  writeFiles("pathformat_size_v2.path", 2);
+  std::ifstream v1("pathformat_size_v1.path", std::ios::ate | std::ios::binary);
+  std::ifstream v2("pathformat_size_v2.path", std::ios::ate | std::ios::binary);
+  ASSERT_LT(v2.tellg() * 5, v1.tellg());
+}
+
+TEST(PathFormatTest, ReadLargeV2) {
+  std::vector<PathEntry> path;
+  std::vector<DataRecEntry> dataRec;
+  makeLargeTrace(path, dataRec);
+  writeFiles("pathformat_large.path", path, dataRec, 2);
+  checkFiles("pathformat_large.path", path, dataRec);
+}
+
+TEST(PathFormatTest, ReadCompressed) {
+  if (!pathformat::compressionSupported())
+    return;
+  std::vector<PathEntry> path;
+  std::vector<DataRecEntry> dataRec;
+  makeLargeTrace(path, dataRec);
+  writeFiles("pathformat_compressed.path", path, dataRec, 2, true);
+  checkFiles("pathformat_compressed.path", path, dataRec);
+
+  writeFiles("pathformat_compressed_small.path", makePath(), makeDataRec(), 2,
+             true);
+  checkFiles("pathformat_compressed_small.path");
+}
@@ -0,0 +1,133 @@
+//===-- RingBufferTest.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/ADT/RingBuffer.h"
+#include "gtest/gtest.h"
+
+#include <deque>
+#include <random>
+
+using namespace klee;
+
+namespace {
+
+void expectElements(const RingBuffer<int> &rb, const std::deque<int> &model) {
+  ASSERT_EQ(model.size(), rb.size());
+  EXPECT_EQ(model.empty(), rb.empty());
+  for (size_t i = 0; i < model.size(); ++i)
+    EXPECT_EQ(model[i], rb[i]) << "element " << i;
+  if (!model.empty()) {
+    EXPECT_EQ(model.front(), rb.front());
+    EXPECT_EQ(model.back(), rb.back());
+  }
+}
+
+TEST(RingBufferTest, Wraparound) {
+  RingBuffer<int> rb(3);
+  EXPECT_TRUE(rb.empty());
+  rb.push_back(1);
+  rb.push_back(2);
+  expectElements(rb, {1, 2});
+  rb.push_back(3);
+  expectElements(rb, {1, 2, 3});
+  // a full buffer drops its oldest element, indices start from the oldest
+  rb.push_back(4);
+  expectElements(rb, {2, 3, 4});
+  rb.push_back(5);
+  rb.push_back(6);
+  rb.push_back(7);
+  expectElements(rb, {5, 6, 7});
+  EXPECT_EQ(3u, rb.getCapacity());
+
+  rb.clear();
+  expectElements(rb, {});
+  rb.push_back(8);
+  expectElements(rb, {8});
+}
+
+TEST(RingBufferTest, PopFront) {
+  RingBuffer<int> rb(4);
+  for (int i = 0; i < 6; ++i)
+    rb.push_back(i);
+  rb.pop_front();
+  expectElements(rb, {3, 4, 5});
+  // the freed slot is reused without dropping anything
+  rb.push_back(6);
+  expectElements(rb, {3, 4, 5, 6});
+  rb.push_back(7);
+  expectElements(rb, {4, 5, 6, 7});
+
+  for (int i = 0; i < 4; ++i)
+    rb.pop_front();
+  expectElements(rb, {});
+  rb.push_back(8);
+  expectElements(rb, {8});
+}
+
+TEST(RingBufferTest, GrowAfterPop) {
+  // storage grows up to the capacity, also when the oldest element is not
+  // the first one stored
+  RingBuffer<int> rb(5);
+  rb.push_back(1);
+  rb.push_back(2);
+  rb.pop_front();
+  rb.push_back(3);
+  rb.push_back(4);
+  expectElements(rb, {2, 3, 4});
+  rb.push_back(5);
+  rb.push_back(6);
+  rb.push_back(7);
+  expectElements(rb, {3, 4, 5, 6, 7});
+}
+
+TEST(RingBufferTest, Copies) {
+  RingBuffer<int> rb(3);
+  for (int i = 0; i < 5; ++i)
+    rb.push_back(i);
+  RingBuffer<int> copy = rb;
+  expectElements(copy, {2, 3, 4});
+  EXPECT_EQ(3u, copy.getCapacity());
+
+  copy.push_back(5);
+  rb.pop_front();
+  expectElements(copy, {3, 4, 5});
+  expectElements(rb, {3, 4});
+
+  copy = rb;
+  copy.push_back(6);
+  copy.push_back(7);
+  expectElements(copy, {4, 6, 7});
+  expectElements(rb, {3, 4});
+}
+
+TEST(RingBufferTest, RandomOperations) {
+  std::mt19937 rng(42);
+  for (size_t capacity = 1; capacity < 8; ++capacity) {
+    RingBuffer<int> rb(capacity);
+    std::deque<int> model;
+    for (int i = 0; i < 500; ++i) {
+      unsigned op = rng() % 8;
+      if (op == 0 && !model.empty()) {
+        rb.pop_front();
+        model.pop_front();
+      } else if (op == 1) {
+        RingBuffer<int> copy = rb;
+        rb = copy;
+      } else {
+        rb.push_back(i);
+        model.push_back(i);
+        if (model.size() > capacity)
+          model.pop_front();
+      }
+      expectElements(rb, model);
+    }
+  }
+}
+
+} // namespace
@@ -0,0 +1,177 @@
+//===-- PersistentCacheTest.cpp -------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+
+/// Answers every query the same way and counts how often it was asked.
+class CountingSolver : public SolverImpl {
+public:
+  unsigned &calls;
+
+  explicit CountingSolver(unsigned &calls) : calls(calls) {}
+
+  bool computeTruth(const Query &, bool &isValid) {
+    ++calls;
+    isValid = false;
+    return true;
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    ++calls;
+    result = ConstantExpr::create(42, query.expr->getWidth());
+    return true;
+  }
+  bool computeInitialValues(const Query &,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char>> &values,
+                            bool &hasSolution) {
+    ++calls;
+    hasSolution = true;
+    values.clear();
+    for (const auto *array : objects)
+      values.emplace_back(array->size, 7);
+    return true;
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  }
+};
+
+/// Build the same queries from scratch, so that only their structure is
+/// shared between runs.
+struct Queries {
+  ArrayCache ac;
+  const Array *array;
+  ConstraintManager constraints;
+  ref<Expr> cond, value;
+
+  explicit Queries(uint64_t bound) {
+    array = ac.CreateArray("x", 4);
+    ref<Expr> x = Expr::createTempRead(array, Expr::Int32);
+    constraints.addConstraint(
+        UltExpr::create(x, ConstantExpr::create(100, Expr::Int32)));
+    cond = UltExpr::create(x, ConstantExpr::create(bound, Expr::Int32));
+    value = AddExpr::create(x, ConstantExpr::create(1, Expr::Int32));
+  }
+};
+
+void ask(Solver &solver, Queries &q) {
+  bool result;
+  ASSERT_TRUE(solver.mustBeTrue(Query(q.constraints, q.cond), result));
+  EXPECT_FALSE(result);
+  Solver::Validity validity;
+  ASSERT_TRUE(solver.evaluate(Query(q.constraints, q.cond), validity));
+  ref<ConstantExpr> value;
+  ASSERT_TRUE(solver.getValue(Query(q.constraints, q.value), value));
+  EXPECT_EQ(42u, value->getZExtValue());
+  std::vector<std::vector<unsigned char>> values;
+  ASSERT_TRUE(solver.getInitialValues(Query(q.constraints, q.cond),
+                                      {q.array}, values));
+  ASSERT_EQ(1u, values.size());
+  EXPECT_EQ(std::vector<unsigned char>(4, 7), values[0]);
+}
+
+TEST(PersistentCacheTest, WarmStart) {
+  llvm::SmallString<128> dir;
+  ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("qcache", dir));
+  std::string first = (dir + "/first.qcache").str();
+  std::string second = (dir + "/second.qcache").str();
+
+  unsigned calls = 0;
+  {
+    Solver *solver = createPersistentCachingSolver(
+        new Solver(new CountingSolver(calls)), "", first);
+    Queries q(10);
+    ask(*solver, q);
+    unsigned solved = calls;
+    EXPECT_GT(solved, 0u);
+    ask(*solver, q);
+    EXPECT_EQ(solved, calls);
+    delete solver;
+  }
+
+  calls = 0;
+  {
+    Solver *solver = createPersistentCachingSolver(
+        new Solver(new CountingSolver(calls)), first, second);
+    Queries q(10);
+    ask(*solver, q);
+    EXPECT_EQ(0u, calls);
+    Queries other(20);
+    ask(*solver, other);
+    EXPECT_GT(calls, 0u);
+    delete solver;
+  }
+
+  // the second store holds the results of both runs
+  calls = 0;
+  {
+    Solver *solver = createPersistentCachingSolver(
+        new Solver(new CountingSolver(calls)), second, "");
+    Queries q(10), other(20);
+    ask(*solver, q);
+    ask(*solver, other);
+    EXPECT_EQ(0u, calls);
+    delete solver;
+  }
+
+  llvm::sys::fs::remove(first);
+  llvm::sys::fs::remove(second);
+  llvm::sys::fs::remove(dir);
+}
+
+TEST(PersistentCacheTest, ForkedChildDoesNotWrite) {
+  llvm::SmallString<128> dir;
+  ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("qcache", dir));
+  std::string path = (dir + "/store.qcache").str();
+
+  unsigned calls = 0;
+  Solver *solver = createPersistentCachingSolver(
+      new Solver(new CountingSolver(calls)), "", path);
+  Queries q(10);
+  ask(*solver, q);
+  uint64_t size;
+  ASSERT_FALSE(llvm::sys::fs::file_size(path, size));
+
+  // a forked solver worker solves a new query, which only it remembers
+  pid_t pid = fork();
+  ASSERT_NE(-1, pid);
+  if (pid == 0) {
+    Queries other(20);
+    bool result;
+    solver->mustBeTrue(Query(other.constraints, other.cond), result);
+    _exit(0);
+  }
+  int status;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  uint64_t sizeAfterChild;
+  ASSERT_FALSE(llvm::sys::fs::file_size(path, sizeAfterChild));
+  EXPECT_EQ(size, sizeAfterChild);
+  delete solver;
+
+  llvm::sys::fs::remove(path);
+  llvm::sys::fs::remove(dir);
+}
+
+} // namespace
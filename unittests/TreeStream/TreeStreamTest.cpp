@@ -46,3 +46,35 @@ TEST(TreeStreamTest, WriteLargerThanBufferSize) {
   for (unsigned i=0; i<NBYTES; i++)
     ASSERT_EQ('A', out[0][i]);
 }
+
+/* A branched stream contains the entries its ancestors wrote before it was
+   opened, followed by its own entries. */
+TEST(TreeStreamTest, Branch) {
+  TreeStreamWriter tsw("tsw3.out");
+  ASSERT_TRUE(tsw.good());
+
+  TreeOStream root = tsw.open();
+  root << 'a' << 'b';
+  TreeOStream left = root.branch();
+  root << 'c';
+  TreeOStream right = root.branch();
+  left << 'x';
+  root << 'd';
+  right << 'y' << 'z';
+  TreeOStream leftChild = left.branch();
+  left << 'u';
+  leftChild << 'v';
+
+  std::vector<char> out;
+  tsw.readStream(root.getID(), out);
+  ASSERT_EQ(std::string("abcd"), std::string(out.begin(), out.end()));
+  out.clear();
+  tsw.readStream(left.getID(), out);
+  ASSERT_EQ(std::string("abxu"), std::string(out.begin(), out.end()));
+  out.clear();
+  tsw.readStream(right.getID(), out);
+  ASSERT_EQ(std::string("abcyz"), std::string(out.begin(), out.end()));
+  out.clear();
+  tsw.readStream(leftChild.getID(), out);
+  ASSERT_EQ(std::string("abxv"), std::string(out.begin(), out.end()));
+}